@@ -0,0 +1,129 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef AUOMS_ACKPROTOCOL_H
+#define AUOMS_ACKPROTOCOL_H
+
+#include "EventId.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+/*
+ * Ack mode negotiation for the raw event format.
+ *
+ * Acks (receiver -> sender) are 20 bytes: sec (u64), msec (u32), serial (u64).
+ * The sender treats an ack as cumulative: acking an event also acks every event sent before it.
+ *
+ * Version 1 (default): The receiver acks every event.
+ *
+ * Version 2: The receiver acks the last handled event every N events or T microseconds.
+ *   1) On connect, the receiver sends a hello ack: sec == 0, msec == ACK_HELLO_MAGIC, serial == ack version.
+ *      Senders that don't know about it just ignore it, as it doesn't match any sent event.
+ *   2) A sender that supports version 2 replies with a control frame in the event stream:
+ *      hdr (u32: ACK_CONTROL_VERSION << 24 | ACK_CONTROL_SIZE), ack version (u32), window (u32), reserved (u32)
+ *      where window is the max number of un-acked events the sender will have in flight.
+ *   3) From then on the receiver batches its acks, using a batch size smaller than the sender's window.
+ * The receiver keeps acking every event until it receives the control frame, so old senders are unaffected.
+ *
+ * Shared memory ring (see SharedRing.h), requires version 2:
+ *   1) The receiver sets ACK_FEATURE_SHARED_RING in the upper 32 bits of the hello's serial.
+ *   2) The sender requests the ring by setting ACK_CONTROL_FLAG_RING_REQUEST in the control frame's reserved field.
+ *   3) The receiver creates the ring and sends a ring offer ack (sec == 0, msec == ACK_RING_OFFER_MAGIC)
+ *      with the ring fds attached (SCM_RIGHTS). From then on its acks are published in the ring.
+ *   4) The sender sends a control frame with ACK_CONTROL_FLAG_RING_SWITCH after the last event sent on the socket,
+ *      and writes all following events to the ring.
+ */
+
+constexpr uint32_t ACK_PROTOCOL_V1 = 1;
+constexpr uint32_t ACK_PROTOCOL_V2 = 2;
+
+constexpr uint32_t ACK_HELLO_MAGIC = 0xAC4B4E45;
+constexpr uint32_t ACK_RING_OFFER_MAGIC = 0xAC4B5249;
+
+constexpr uint32_t ACK_FEATURE_SHARED_RING = 1;
+
+constexpr uint32_t ACK_CONTROL_FLAG_RING_REQUEST = 1;
+constexpr uint32_t ACK_CONTROL_FLAG_RING_SWITCH = 2;
+
+// Uses an event header version that is never used for events
+constexpr uint32_t ACK_CONTROL_VERSION = 0xFF;
+constexpr uint32_t ACK_CONTROL_SIZE = 16;
+
+constexpr size_t ACK_SIZE = 8+4+8;
+
+inline void EncodeAck(const EventId& event_id, uint8_t* data) {
+    uint64_t sec = event_id.Seconds();
+    uint32_t msec = event_id.Milliseconds();
+    uint64_t serial = event_id.Serial();
+    memcpy(data, &sec, sizeof(sec));
+    memcpy(data+8, &msec, sizeof(msec));
+    memcpy(data+12, &serial, sizeof(serial));
+}
+
+inline EventId MakeAckHello(uint32_t ack_version, uint32_t features = 0) {
+    return EventId(0, ACK_HELLO_MAGIC, (static_cast<uint64_t>(features) << 32) | ack_version);
+}
+
+// Returns the ack version advertised by the receiver, or 0 if event_id is not a hello
+inline uint32_t GetAckHelloVersion(const EventId& event_id) {
+    if (event_id.Seconds() == 0 && event_id.Milliseconds() == ACK_HELLO_MAGIC) {
+        return static_cast<uint32_t>(event_id.Serial() & 0xFFFFFFFF);
+    }
+    return 0;
+}
+
+// Returns the features advertised by the receiver, event_id must be a hello
+inline uint32_t GetAckHelloFeatures(const EventId& event_id) {
+    return static_cast<uint32_t>(event_id.Serial() >> 32);
+}
+
+inline EventId MakeAckRingOffer() {
+    return EventId(0, ACK_RING_OFFER_MAGIC, 0);
+}
+
+inline bool IsAckRingOffer(const EventId& event_id) {
+    return event_id.Seconds() == 0 && event_id.Milliseconds() == ACK_RING_OFFER_MAGIC;
+}
+
+inline std::array<uint8_t, ACK_CONTROL_SIZE> MakeAckControl(uint32_t ack_version, uint32_t window, uint32_t flags = 0) {
+    std::array<uint8_t, ACK_CONTROL_SIZE> data;
+    uint32_t fields[4] = {(ACK_CONTROL_VERSION << 24) | ACK_CONTROL_SIZE, ack_version, window, flags};
+    memcpy(data.data(), fields, sizeof(fields));
+    return data;
+}
+
+inline bool IsAckControl(const void* data, size_t size) {
+    return size == ACK_CONTROL_SIZE && (*reinterpret_cast<const uint32_t*>(data) >> 24) == ACK_CONTROL_VERSION;
+}
+
+// data must be a frame for which IsAckControl() returned true
+inline void ParseAckControl(const void* data, uint32_t* ack_version, uint32_t* window) {
+    uint32_t fields[4];
+    memcpy(fields, data, sizeof(fields));
+    *ack_version = fields[1];
+    *window = fields[2];
+}
+
+// data must be a frame for which IsAckControl() returned true
+inline uint32_t GetAckControlFlags(const void* data) {
+    uint32_t fields[4];
+    memcpy(fields, data, sizeof(fields));
+    return fields[3];
+}
+
+#endif //AUOMS_ACKPROTOCOL_H
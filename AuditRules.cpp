@@ -1412,7 +1412,8 @@ std::string AuditRule::get_str_field(uint32_t field) const {
 }
 
 void AuditRule::append_field_name(std::string& out, int field) const {
-    out.append(FieldIdToName(field));
+    std::string unknown_str;
+    out.append(FieldIdToName(field, unknown_str));
 }
 
 void AuditRule::append_op(std::string& out, int op) const {
@@ -1548,7 +1549,10 @@ void AuditRule::append_field(std::string& out, int idx, bool is_watch) const {
             out.append(" -F ");
             append_field_name(out, field);
             append_op(out, op);
-            out.append(RecordTypeToName(static_cast<RecordType>(value)));
+            {
+                std::string unknown_str;
+                out.append(RecordTypeToName(static_cast<RecordType>(value), unknown_str));
+            }
             break;
         case AUDIT_SUBJ_USER:
             /* fallthrough */
@@ -1836,6 +1840,7 @@ void AuditRule::append_syscalls(std::string& out) const {
         out.append(" -S ");
 
         bool first = true;
+        std::string name;
         for (int i = 0; i < AUDIT_BITMASK_SIZE; ++i) {
             if (ruleptr()->mask[i] != 0) {
                 for (int x = 0; x < 32; ++x) {
@@ -1844,8 +1849,7 @@ void AuditRule::append_syscalls(std::string& out) const {
                         if (!first) {
                             out.append(",");
                         }
-                        auto name = SyscallToName(mach, s);
-                        if (starts_with(name, "unknown-syscall")) {
+                        if (!SyscallToName(mach, s, name)) {
                             out.append(std::to_string(s));
                         } else {
                             out.append(name);
@@ -0,0 +1,131 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "BufferedReader.h"
+
+#include <algorithm>
+#include <cstring>
+
+ssize_t BufferedReader::fill(size_t min_free, const std::function<bool()>& fn) {
+    if (_buffer.size() - _end < min_free) {
+        if (_start > 0) {
+            memmove(_buffer.data(), _buffer.data() + _start, _end - _start);
+            _end -= _start;
+            _start = 0;
+        }
+        if (_buffer.size() - _end < min_free) {
+            _buffer.resize(_end + min_free);
+        }
+    }
+    ssize_t nr;
+    do {
+        nr = _reader->Read(_buffer.data() + _end, _buffer.size() - _end, fn);
+        // Like IOBase::ReadAll(), retry if interrupted unless fn() says to stop
+    } while (nr == IO::INTERRUPTED && !(fn && fn()));
+    if (nr > 0) {
+        _end += nr;
+    }
+    return nr;
+}
+
+size_t BufferedReader::copy_out(void* buf, size_t size) {
+    auto n = std::min(size, Available());
+    memcpy(buf, _buffer.data() + _start, n);
+    Consume(n);
+    return n;
+}
+
+ssize_t BufferedReader::Peek(size_t size, const void** data, const std::function<bool()>& fn) {
+    while (Available() < size) {
+        auto ret = fill(size - Available(), fn);
+        if (ret <= 0) {
+            return ret;
+        }
+    }
+    *data = _buffer.data() + _start;
+    return IO::OK;
+}
+
+ssize_t BufferedReader::WaitReadable(long timeout) {
+    if (Available() > 0) {
+        return IO::OK;
+    }
+    return _reader->WaitReadable(timeout);
+}
+
+ssize_t BufferedReader::Read(void *buf, size_t buf_size, const std::function<bool()>& fn) {
+    if (Available() == 0) {
+        if (buf_size >= _buffer.size()) {
+            return _reader->Read(buf, buf_size, fn);
+        }
+        auto ret = fill(1, fn);
+        if (ret <= 0) {
+            return ret;
+        }
+    }
+    return copy_out(buf, buf_size);
+}
+
+ssize_t BufferedReader::Read(void *buf, size_t buf_size, long timeout, const std::function<bool()>& fn) {
+    if (Available() == 0) {
+        ssize_t ret;
+        do {
+            ret = _reader->WaitReadable(timeout);
+        } while (ret == IO::INTERRUPTED && !(fn && fn()));
+        if (ret != IO::OK) {
+            return ret;
+        }
+    }
+    return Read(buf, buf_size, fn);
+}
+
+ssize_t BufferedReader::ReadAll(void *buf, size_t buf_size, const std::function<bool()>& fn) {
+    auto n = copy_out(buf, buf_size);
+    if (n == buf_size) {
+        return IO::OK;
+    }
+    auto ptr = reinterpret_cast<uint8_t*>(buf) + n;
+    auto nleft = buf_size - n;
+    if (nleft >= _buffer.size()) {
+        return _reader->ReadAll(ptr, nleft, fn);
+    }
+    while (nleft > 0) {
+        auto ret = fill(1, fn);
+        if (ret <= 0) {
+            return ret;
+        }
+        n = copy_out(ptr, nleft);
+        ptr += n;
+        nleft -= n;
+    }
+    return IO::OK;
+}
+
+ssize_t BufferedReader::DiscardAll(size_t size, const std::function<bool()>& fn) {
+    auto n = std::min(size, Available());
+    Consume(n);
+    auto nleft = size - n;
+    while (nleft > 0) {
+        auto ret = fill(1, fn);
+        if (ret <= 0) {
+            return ret;
+        }
+        n = std::min(nleft, Available());
+        Consume(n);
+        nleft -= n;
+    }
+    return IO::OK;
+}
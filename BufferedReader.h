@@ -0,0 +1,87 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef AUOMS_BUFFEREDREADER_H
+#define AUOMS_BUFFEREDREADER_H
+
+#include "IO.h"
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * Read-ahead wrapper for an IReader.
+ *
+ * Each read from the underlying reader asks for as much data as fits in the buffer, so that small reads
+ * (e.g. the 4 byte event header followed by the event body) are served from memory instead of
+ * costing a syscall each. Peek() returns a view of the buffered data without copying.
+ *
+ * Reads larger than the buffer bypass it once the buffered data has been consumed.
+ */
+class BufferedReader: public IReader {
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 256*1024;
+
+    explicit BufferedReader(IReader* reader, size_t buffer_size = DEFAULT_BUFFER_SIZE):
+        _reader(reader), _buffer(buffer_size), _start(0), _end(0) {}
+
+    // The number of bytes already buffered
+    size_t Available() const {
+        return _end - _start;
+    }
+
+    /*
+     * Make at least size bytes available (growing the buffer if needed) and point data at them.
+     * The data remains valid until the next call that reads from this BufferedReader.
+     * Return OK on success
+     * Return CLOSED if fd closed
+     * Return FAILED if read failed
+     * Return INTERRUPTED if signal received
+     */
+    ssize_t Peek(size_t size, const void** data, const std::function<bool()>& fn);
+
+    // Remove size bytes (which must be <= Available()) from the buffer
+    void Consume(size_t size) {
+        _start += size;
+        if (_start == _end) {
+            _start = 0;
+            _end = 0;
+        }
+    }
+
+    ssize_t WaitReadable(long timeout) override;
+    ssize_t Read(void *buf, size_t buf_size, const std::function<bool()>& fn) override;
+    ssize_t Read(void *buf, size_t buf_size, long timeout, const std::function<bool()>& fn) override;
+    ssize_t ReadAll(void *buf, size_t buf_size, const std::function<bool()>& fn) override;
+    ssize_t DiscardAll(size_t size, const std::function<bool()>& fn) override;
+
+    using IReader::Read;
+    using IReader::ReadAll;
+    using IReader::DiscardAll;
+
+private:
+    // Read once from the underlying reader (after making room for at least min_free bytes).
+    // Returns >0 on success, or CLOSED, FAILED, INTERRUPTED.
+    ssize_t fill(size_t min_free, const std::function<bool()>& fn);
+    size_t copy_out(void* buf, size_t size);
+
+    IReader* _reader;
+    std::vector<uint8_t> _buffer;
+    size_t _start;
+    size_t _end;
+};
+
+#endif //AUOMS_BUFFEREDREADER_H
@@ -15,12 +15,14 @@
 */
 #include "Event.h"
 
+#include "FieldNameDictionary.h"
 #include "Queue.h"
 
 #include "Logger.h"
 
 #include <cstring>
 #include <algorithm>
+#include <charconv>
 #include <exception>
 #include <iostream>
 
@@ -58,6 +60,44 @@
  *              char[] field_name (null terminated)
  *              char[] raw_value (null terminated)
  *              char[] interp_value  (null terminated, only present if interp_value_size > 0)
+ *
+ *  Event (v2):
+ *      The event header is identical to v1 (with version == 2).
+ *      The first record, and every record and field, start on a 4 byte boundary (relative to the start of the event).
+ *      Records:
+ *          uint32_t record_type
+ *          uint16_t num_fields
+ *          uint16_t record_name_size
+ *          uint16_t record_text_size
+ *          uint8_t index_width (2 or 4)
+ *          uint8_t record_flags
+ *          FieldIndex: (original order)
+ *              uint16_t or uint32_t offsets (from start of record)
+ *          FieldIndex: (sorted by field name)
+ *              uint16_t or uint32_t offsets (from start of record)
+ *          FieldHashIndex: (only present if record_flags & RECORD_V2_FLAG_HASH_INDEX)
+ *              uint16_t[RECORD_V2_HASH_INDEX_SIZE(num_fields)] (field index + 1, 0 == empty slot)
+ *          char[] record_type_name (null terminated)
+ *          char[] record_text (null terminated)
+ *          padding (to 4 byte boundary)
+ *          Fields:
+ *              uint8_t field_type
+ *              uint8_t flags
+ *              uint16_t field_name_id (FIELD_NAME_ID_UNKNOWN if the name is not in the field name dictionary)
+ *              uint16_t raw_value_size, uint16_t interp_value_size (uint32_t for both if flags & FIELD_V2_FLAG_WIDE)
+ *              int64_t int_value (only present if flags & FIELD_V2_FLAG_INT)
+ *              uint16_t field_name_size (only present if field_name_id == FIELD_NAME_ID_UNKNOWN)
+ *              char[] field_name (null terminated, only present if field_name_id == FIELD_NAME_ID_UNKNOWN)
+ *              char[] raw_value (null terminated)
+ *              char[] interp_value  (null terminated, only present if interp_value_size > 0)
+ *              padding (to 4 byte boundary)
+ *
+ *      The field indexes are 16 bits wide unless the record is larger than 64KB.
+ *      Fixed width (instead of variable length) index entries are used so that FieldAt() and
+ *      the binary search in FieldByName() can still index directly into the field index.
+ *
+ *      The optional field hash index is an open addressing (linear probing) hash table
+ *      keyed by FIELD_NAME_HASH() of the field name. It makes FieldByName() O(1).
  */
 
 inline uint32_t& INDEX_VALUE(uint8_t* data, uint32_t offset, uint32_t index) {
@@ -239,10 +279,151 @@ constexpr uint32_t FIELD_NAME_OFFSET = FIELD_HEADER_SIZE;
 constexpr uint32_t FIELD_RAW_VALUE_OFFSET(uint16_t name_size) { return FIELD_NAME_OFFSET + name_size; }
 constexpr uint32_t FIELD_INTERP_VALUE_OFFSET(uint16_t name_size, uint32_t raw_size) { return FIELD_NAME_OFFSET + name_size + raw_size; }
 
+constexpr uint32_t ALIGN4(uint32_t size) { return (size + 3) & ~static_cast<uint32_t>(3); }
+
+inline uint32_t FIELD_INDEX_VALUE(const uint8_t* data, uint32_t offset, uint32_t index, uint8_t width) {
+    if (width == sizeof(uint16_t)) {
+        return *reinterpret_cast<const uint16_t*>(data+offset+sizeof(uint16_t)*index);
+    }
+    return *reinterpret_cast<const uint32_t*>(data+offset+sizeof(uint32_t)*index);
+}
+
+constexpr uint32_t RECORD_V2_INDEX_WIDTH_OFFSET = RECORD_TEXT_SIZE_OFFSET + RECORD_TEXT_SIZE_SIZE;
+inline uint8_t& RECORD_V2_INDEX_WIDTH(uint8_t* data, uint32_t record_offset) {
+    return *(data+record_offset+RECORD_V2_INDEX_WIDTH_OFFSET);
+}
+inline uint8_t RECORD_V2_INDEX_WIDTH(const uint8_t* data, uint32_t record_offset) {
+    return *(data+record_offset+RECORD_V2_INDEX_WIDTH_OFFSET);
+}
+
+constexpr uint32_t RECORD_V2_FLAGS_OFFSET = RECORD_V2_INDEX_WIDTH_OFFSET + sizeof(uint8_t);
+constexpr uint8_t RECORD_V2_FLAG_HASH_INDEX = 1;
+inline uint8_t& RECORD_V2_FLAGS(uint8_t* data, uint32_t record_offset) {
+    return *(data+record_offset+RECORD_V2_FLAGS_OFFSET);
+}
+inline uint8_t RECORD_V2_FLAGS(const uint8_t* data, uint32_t record_offset) {
+    return *(data+record_offset+RECORD_V2_FLAGS_OFFSET);
+}
+
+// Records with more fields than this do not get a hash index
+constexpr uint16_t RECORD_V2_HASH_INDEX_MAX_FIELDS = 4096;
+
+// Number of slots in the hash index: the smallest power of 2 that is >= 2*num_fields
+constexpr uint32_t RECORD_V2_HASH_INDEX_SIZE(uint16_t num_fields) {
+    uint32_t size = 4;
+    while (size < static_cast<uint32_t>(num_fields)*2) {
+        size <<= 1;
+    }
+    return size;
+}
+
+// FNV-1a
+inline uint32_t FIELD_NAME_HASH(const std::string_view& name) {
+    uint32_t hash = 2166136261u;
+    for (auto c : name) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+constexpr uint32_t RECORD_V2_FIELD_INDEX_OFFSET = RECORD_V2_FLAGS_OFFSET + sizeof(uint8_t);
+constexpr uint32_t RECORD_V2_FIELD_SORTED_INDEX_OFFSET(uint16_t num_fields, uint8_t width) { return RECORD_V2_FIELD_INDEX_OFFSET + width * num_fields; }
+constexpr uint32_t RECORD_V2_HASH_INDEX_OFFSET(uint16_t num_fields, uint8_t width) { return RECORD_V2_FIELD_INDEX_OFFSET + width * num_fields * 2; }
+constexpr uint32_t RECORD_V2_TYPE_NAME_OFFSET(uint16_t num_fields, uint8_t width, uint8_t flags) {
+    return RECORD_V2_HASH_INDEX_OFFSET(num_fields, width) + (((flags & RECORD_V2_FLAG_HASH_INDEX) != 0) ? sizeof(uint16_t) * RECORD_V2_HASH_INDEX_SIZE(num_fields) : 0);
+}
+constexpr uint32_t RECORD_V2_TEXT_OFFSET(uint16_t num_fields, uint8_t width, uint8_t flags, uint16_t name_size) { return RECORD_V2_TYPE_NAME_OFFSET(num_fields, width, flags) + name_size; }
+constexpr uint32_t RECORD_V2_HEADER_SIZE(uint16_t num_fields, uint8_t width, uint8_t flags, uint16_t name_size, uint16_t text_size) {
+    return ALIGN4(RECORD_V2_TYPE_NAME_OFFSET(num_fields, width, flags) + name_size + text_size);
+}
+
+// The v2 field accessors take the offset of the field from the start of the event
+constexpr uint8_t FIELD_V2_FLAG_WIDE = 1;
+constexpr uint8_t FIELD_V2_FLAG_INT = 2;
+
+constexpr uint32_t FIELD_V2_TYPE_OFFSET = 0;
+constexpr uint32_t FIELD_V2_FLAGS_OFFSET = FIELD_V2_TYPE_OFFSET + sizeof(uint8_t);
+constexpr uint32_t FIELD_V2_NAME_ID_OFFSET = FIELD_V2_FLAGS_OFFSET + sizeof(uint8_t);
+constexpr uint32_t FIELD_V2_RAW_SIZE_OFFSET = FIELD_V2_NAME_ID_OFFSET + sizeof(uint16_t);
+constexpr uint32_t FIELD_V2_INT_VALUE_OFFSET(uint8_t flags) {
+    return FIELD_V2_RAW_SIZE_OFFSET + (((flags & FIELD_V2_FLAG_WIDE) != 0) ? sizeof(uint32_t)*2 : sizeof(uint16_t)*2);
+}
+constexpr uint32_t FIELD_V2_HEADER_SIZE(uint8_t flags) {
+    return FIELD_V2_INT_VALUE_OFFSET(flags) + (((flags & FIELD_V2_FLAG_INT) != 0) ? sizeof(int64_t) : 0);
+}
+
+inline uint8_t FIELD_V2_TYPE(const uint8_t* data, uint32_t offset) {
+    return *(data+offset+FIELD_V2_TYPE_OFFSET);
+}
+
+inline uint8_t FIELD_V2_FLAGS(const uint8_t* data, uint32_t offset) {
+    return *(data+offset+FIELD_V2_FLAGS_OFFSET);
+}
+
+inline uint16_t FIELD_V2_NAME_ID(const uint8_t* data, uint32_t offset) {
+    return *reinterpret_cast<const uint16_t*>(data+offset+FIELD_V2_NAME_ID_OFFSET);
+}
+
+// Includes the null terminator
+inline uint32_t FIELD_V2_RAW_SIZE(const uint8_t* data, uint32_t offset) {
+    if ((FIELD_V2_FLAGS(data, offset) & FIELD_V2_FLAG_WIDE) != 0) {
+        return *reinterpret_cast<const uint32_t*>(data+offset+FIELD_V2_RAW_SIZE_OFFSET);
+    }
+    return *reinterpret_cast<const uint16_t*>(data+offset+FIELD_V2_RAW_SIZE_OFFSET);
+}
+
+// Includes the null terminator, 0 if there is no interp value
+inline uint32_t FIELD_V2_INTERP_SIZE(const uint8_t* data, uint32_t offset) {
+    if ((FIELD_V2_FLAGS(data, offset) & FIELD_V2_FLAG_WIDE) != 0) {
+        return *reinterpret_cast<const uint32_t*>(data+offset+FIELD_V2_RAW_SIZE_OFFSET+sizeof(uint32_t));
+    }
+    return *reinterpret_cast<const uint16_t*>(data+offset+FIELD_V2_RAW_SIZE_OFFSET+sizeof(uint16_t));
+}
+
+// Fields are only 4 byte aligned, so the value is copied out
+inline int64_t FIELD_V2_INT_VALUE(const uint8_t* data, uint32_t offset) {
+    int64_t value;
+    memcpy(&value, data+offset+FIELD_V2_INT_VALUE_OFFSET(FIELD_V2_FLAGS(data, offset)), sizeof(value));
+    return value;
+}
+
+// Size (including the null terminator) of the inline field name, 0 if the name is in the dictionary
+inline uint32_t FIELD_V2_INLINE_NAME_SIZE(const uint8_t* data, uint32_t offset) {
+    if (FIELD_V2_NAME_ID(data, offset) != FIELD_NAME_ID_UNKNOWN) {
+        return 0;
+    }
+    return *reinterpret_cast<const uint16_t*>(data+offset+FIELD_V2_HEADER_SIZE(FIELD_V2_FLAGS(data, offset)));
+}
+
+inline std::string_view FIELD_V2_NAME(const uint8_t* data, uint32_t offset) {
+    auto id = FIELD_V2_NAME_ID(data, offset);
+    if (id != FIELD_NAME_ID_UNKNOWN) {
+        return FieldIdToName(id);
+    }
+    auto hdr_size = FIELD_V2_HEADER_SIZE(FIELD_V2_FLAGS(data, offset));
+    return std::string_view(CHAR_PTR(data, offset+hdr_size+sizeof(uint16_t)),
+                            *reinterpret_cast<const uint16_t*>(data+offset+hdr_size) - 1);
+}
+
+inline uint32_t FIELD_V2_RAW_VALUE_OFFSET(const uint8_t* data, uint32_t offset) {
+    auto hdr_size = FIELD_V2_HEADER_SIZE(FIELD_V2_FLAGS(data, offset));
+    if (FIELD_V2_NAME_ID(data, offset) != FIELD_NAME_ID_UNKNOWN) {
+        return offset+hdr_size;
+    }
+    return offset+hdr_size+sizeof(uint16_t)+*reinterpret_cast<const uint16_t*>(data+offset+hdr_size);
+}
+
 /*****************************************************************************
  ** EventBuilder
  *****************************************************************************/
 
+EventBuilder::EventBuilder(std::shared_ptr<IEventBuilderAllocator> allocator, uint32_t version): _allocator(std::move(allocator)), _version(version), _field_hash_index(false), _int_values(false), _data(nullptr), _size(0) {
+    if (!Event::IsSupportedVersion(version)) {
+        throw std::invalid_argument("Unsupported event format version: " + std::to_string(version));
+    }
+}
+
 int EventBuilder::BeginEvent(uint64_t sec, uint32_t msec, uint64_t serial, uint16_t num_records) {
     if (_data != nullptr) {
         throw std::runtime_error("Event already started!");
@@ -253,6 +434,9 @@ int EventBuilder::BeginEvent(uint64_t sec, uint32_t msec, uint64_t serial, uint1
     }
 
     _roffset = EVENT_HEADER_SIZE(num_records);
+    if (_version == EVENT_FORMAT_V2) {
+        _roffset = ALIGN4(_roffset);
+    }
     _record_idx = 0;
 
     size_t size = _roffset;
@@ -262,7 +446,11 @@ int EventBuilder::BeginEvent(uint64_t sec, uint32_t msec, uint64_t serial, uint1
     }
     _size = size;
 
-    SET_EVENT_VERSION(_data, 1);
+    if (_version == EVENT_FORMAT_V2) {
+        memset(_data+EVENT_HEADER_SIZE(num_records), 0, _roffset-EVENT_HEADER_SIZE(num_records));
+    }
+
+    SET_EVENT_VERSION(_data, _version);
     SET_EVENT_SIZE(_data, 0);
     EVENT_SEC(_data) = sec;
     EVENT_MSEC(_data) = msec;
@@ -366,7 +554,17 @@ int EventBuilder::BeginRecord(uint32_t record_type, const std::string_view& reco
         throw std::runtime_error("record_text length exceeds limit");
     }
 
-    size_t record_hdr_size = RECORD_HEADER_SIZE(num_fields, static_cast<uint16_t>(name_size), static_cast<uint16_t>(text_size));
+    uint8_t record_flags = 0;
+    if (_field_hash_index && num_fields <= RECORD_V2_HASH_INDEX_MAX_FIELDS) {
+        record_flags |= RECORD_V2_FLAG_HASH_INDEX;
+    }
+
+    size_t record_hdr_size;
+    if (_version == EVENT_FORMAT_V2) {
+        record_hdr_size = RECORD_V2_HEADER_SIZE(num_fields, sizeof(uint32_t), record_flags, static_cast<uint16_t>(name_size), static_cast<uint16_t>(text_size));
+    } else {
+        record_hdr_size = RECORD_HEADER_SIZE(num_fields, static_cast<uint16_t>(name_size), static_cast<uint16_t>(text_size));
+    }
     size_t size = _size+record_hdr_size;
     int ret = _allocator->Allocate(reinterpret_cast<void**>(&_data), size);
     if (ret != 1) {
@@ -380,6 +578,24 @@ int EventBuilder::BeginRecord(uint32_t record_type, const std::string_view& reco
     RECORD_NAME_SIZE(_data, _roffset) = static_cast<uint16_t>(name_size);
     RECORD_TEXT_SIZE(_data, _roffset) = static_cast<uint16_t>(text_size);
 
+    if (_version == EVENT_FORMAT_V2) {
+        RECORD_V2_INDEX_WIDTH(_data, _roffset) = sizeof(uint32_t);
+        RECORD_V2_FLAGS(_data, _roffset) = record_flags;
+
+        auto name_offset = _roffset+RECORD_V2_TYPE_NAME_OFFSET(num_fields, sizeof(uint32_t), record_flags);
+        memcpy(_data+name_offset, record_name.data(), record_name.size());
+        _data[name_offset+name_size-1] = 0;
+        memcpy(_data+name_offset+name_size, record_text.data(), record_text.size());
+        _data[name_offset+name_size+text_size-1] = 0;
+        // Zero the alignment padding
+        memset(_data+name_offset+name_size+text_size, 0, _roffset+record_hdr_size-(name_offset+name_size+text_size));
+
+        _foffset = record_hdr_size;
+        _fidxoffset = _roffset+RECORD_V2_FIELD_INDEX_OFFSET;
+        _fsortedidxoffset = _roffset+RECORD_V2_FIELD_SORTED_INDEX_OFFSET(num_fields, sizeof(uint32_t));
+        return 1;
+    }
+
     memcpy(RECORD_TYPE_NAME_PTR(_data, _roffset, num_fields), record_name.data(), record_name.size());
     RECORD_TYPE_NAME_PTR(_data, _roffset, num_fields)[name_size-1] = 0;
 
@@ -402,6 +618,10 @@ int EventBuilder::EndRecord() {
         throw std::runtime_error("EventRecord ended prematurely: Expected " + std::to_string(_num_fields) + " fields, only " + std::to_string(_field_idx) + " where added");
     }
 
+    if (_version == EVENT_FORMAT_V2) {
+        return end_record_v2();
+    }
+
     // Sort fields
     memcpy(_data+_fsortedidxoffset, _data+_fidxoffset, sizeof(uint32_t)*_num_fields);
     uint32_t* start = INDEX_PTR(_data, _fsortedidxoffset, 0);
@@ -417,6 +637,59 @@ int EventBuilder::EndRecord() {
     return 1;
 }
 
+int EventBuilder::end_record_v2() {
+    // Sort fields
+    memcpy(_data+_fsortedidxoffset, _data+_fidxoffset, sizeof(uint32_t)*_num_fields);
+    uint32_t* start = INDEX_PTR(_data, _fsortedidxoffset, 0);
+    uint32_t* end = INDEX_PTR(_data, _fsortedidxoffset, _num_fields);
+    std::sort(start, end, [this](uint32_t a, uint32_t b) -> bool {
+        auto a_id = FIELD_V2_NAME_ID(_data, _roffset+a);
+        auto b_id = FIELD_V2_NAME_ID(_data, _roffset+b);
+        if (a_id != FIELD_NAME_ID_UNKNOWN && b_id != FIELD_NAME_ID_UNKNOWN) {
+            return FieldIdToRank(a_id) < FieldIdToRank(b_id);
+        }
+        return FIELD_V2_NAME(_data, _roffset+a) < FIELD_V2_NAME(_data, _roffset+b);
+    });
+
+    if ((RECORD_V2_FLAGS(_data, _roffset) & RECORD_V2_FLAG_HASH_INDEX) != 0) {
+        auto hash_size = RECORD_V2_HASH_INDEX_SIZE(_num_fields);
+        auto table = reinterpret_cast<uint16_t*>(_data+_roffset+RECORD_V2_HASH_INDEX_OFFSET(_num_fields, sizeof(uint32_t)));
+        memset(table, 0, sizeof(uint16_t)*hash_size);
+        for (uint32_t i = 0; i < _num_fields; ++i) {
+            auto slot = FIELD_NAME_HASH(FIELD_V2_NAME(_data, _roffset+INDEX_VALUE(_data, _fidxoffset, i))) & (hash_size-1);
+            while (table[slot] != 0) {
+                slot = (slot+1) & (hash_size-1);
+            }
+            table[slot] = static_cast<uint16_t>(i+1);
+        }
+    }
+
+    // The field indexes are built with 32bit offsets. If all the (adjusted) offsets fit in 16 bits,
+    // convert both indexes in place then shift the rest of the record down.
+    // The shift is a multiple of 4 so the alignment of the fields is preserved.
+    uint32_t shrink = static_cast<uint32_t>(sizeof(uint16_t)*2*_num_fields);
+    if (_size-_roffset-shrink <= UINT16_MAX) {
+        for (uint32_t i = 0; i < _num_fields*2u; ++i) {
+            *reinterpret_cast<uint16_t*>(_data+_fidxoffset+sizeof(uint16_t)*i) = static_cast<uint16_t>(INDEX_VALUE(_data, _fidxoffset, i) - shrink);
+        }
+        uint32_t from = _fidxoffset+sizeof(uint32_t)*2*_num_fields;
+        memmove(_data+from-shrink, _data+from, _size-from);
+        RECORD_V2_INDEX_WIDTH(_data, _roffset) = sizeof(uint16_t);
+
+        size_t size = _size-shrink;
+        int ret = _allocator->Allocate(reinterpret_cast<void**>(&_data), size);
+        if (ret != 1) {
+            return ret;
+        }
+        _size = size;
+    }
+
+    _record_idx += 1;
+    _roffset = static_cast<uint32_t>(_size);
+
+    return 1;
+}
+
 int EventBuilder::AddField(const char *field_name, const char* raw_value, const char* interp_value, field_type_t field_type) {
     size_t name_size = strlen(field_name);
     size_t raw_size = strlen(raw_value);
@@ -433,6 +706,10 @@ int EventBuilder::AddField(const std::string_view& field_name, const std::string
         throw std::runtime_error("Event not started!");
     }
 
+    if (_version == EVENT_FORMAT_V2) {
+        return add_field_v2(field_name, raw_value, interp_value, field_type, nullptr);
+    }
+
     size_t name_size = field_name.size()+1;
     size_t raw_size = raw_value.size()+1;
     size_t fsize = FIELD_HEADER_SIZE + name_size + raw_size;
@@ -489,6 +766,125 @@ int EventBuilder::AddField(const std::string_view& field_name, const std::string
     return 1;
 }
 
+int EventBuilder::AddField(const std::string_view& field_name, const std::string_view& raw_value, const std::string_view& interp_value, field_type_t field_type, int64_t int_value) {
+    if (_data == nullptr) {
+        throw std::runtime_error("Event not started!");
+    }
+
+    if (_version == EVENT_FORMAT_V2) {
+        return add_field_v2(field_name, raw_value, interp_value, field_type, &int_value);
+    }
+
+    return AddField(field_name, raw_value, interp_value, field_type);
+}
+
+int EventBuilder::add_field_v2(const std::string_view& field_name, const std::string_view& raw_value, const std::string_view& interp_value, field_type_t field_type, const int64_t* int_value) {
+    if (static_cast<uint32_t>(field_type) > UINT8_MAX) {
+        throw std::runtime_error("field_type exceeds limit");
+    }
+
+    size_t name_size = field_name.size()+1;
+    size_t raw_size = raw_value.size()+1;
+    size_t interp_size = 0;
+    if (!interp_value.empty()) {
+        interp_size = interp_value.size()+1;
+    }
+
+    if (name_size > UINT16_MAX) {
+        throw std::runtime_error("field_name length exceeds limit");
+    }
+
+    if (raw_size > UINT32_MAX) {
+        throw std::runtime_error("raw_value length exceeds limit");
+    }
+
+    if (interp_size > UINT32_MAX) {
+        throw std::runtime_error("interp_value length exceeds limit");
+    }
+
+    if (_field_idx >= _num_fields) {
+        throw std::runtime_error("field count exceeds allocated number");
+    }
+
+    uint16_t name_id = FieldNameToDictionaryId(field_name);
+    uint8_t flags = 0;
+    if (raw_size > UINT16_MAX || interp_size > UINT16_MAX) {
+        flags |= FIELD_V2_FLAG_WIDE;
+    }
+
+    int64_t parsed_int = 0;
+    if (_int_values) {
+        if (int_value != nullptr) {
+            parsed_int = *int_value;
+            flags |= FIELD_V2_FLAG_INT;
+        } else if (name_id != FIELD_NAME_ID_UNKNOWN && FieldIdIsNumeric(name_id) && !raw_value.empty()) {
+            auto res = std::from_chars(raw_value.data(), raw_value.data()+raw_value.size(), parsed_int, 10);
+            if (res.ec == std::errc() && res.ptr == raw_value.data()+raw_value.size()) {
+                flags |= FIELD_V2_FLAG_INT;
+            }
+        }
+    }
+
+    size_t hdr_size = FIELD_V2_HEADER_SIZE(flags);
+    size_t inline_name_size = 0;
+    if (name_id == FIELD_NAME_ID_UNKNOWN) {
+        inline_name_size = sizeof(uint16_t) + name_size;
+    }
+    size_t used_size = hdr_size + inline_name_size + raw_size + interp_size;
+    size_t fsize = (used_size + 3) & ~static_cast<size_t>(3);
+
+    size_t size = _size+fsize;
+    int ret = _allocator->Allocate(reinterpret_cast<void**>(&_data), size);
+    if (ret != 1) {
+        return ret;
+    }
+    _size = size;
+
+    uint8_t* ptr = _data + _roffset + _foffset;
+    ptr[FIELD_V2_TYPE_OFFSET] = static_cast<uint8_t>(field_type);
+    ptr[FIELD_V2_FLAGS_OFFSET] = flags;
+    *reinterpret_cast<uint16_t*>(ptr+FIELD_V2_NAME_ID_OFFSET) = name_id;
+    if ((flags & FIELD_V2_FLAG_WIDE) != 0) {
+        reinterpret_cast<uint32_t*>(ptr+FIELD_V2_RAW_SIZE_OFFSET)[0] = static_cast<uint32_t>(raw_size);
+        reinterpret_cast<uint32_t*>(ptr+FIELD_V2_RAW_SIZE_OFFSET)[1] = static_cast<uint32_t>(interp_size);
+    } else {
+        reinterpret_cast<uint16_t*>(ptr+FIELD_V2_RAW_SIZE_OFFSET)[0] = static_cast<uint16_t>(raw_size);
+        reinterpret_cast<uint16_t*>(ptr+FIELD_V2_RAW_SIZE_OFFSET)[1] = static_cast<uint16_t>(interp_size);
+    }
+    if ((flags & FIELD_V2_FLAG_INT) != 0) {
+        memcpy(ptr+FIELD_V2_INT_VALUE_OFFSET(flags), &parsed_int, sizeof(parsed_int));
+    }
+    ptr += hdr_size;
+
+    if (inline_name_size > 0) {
+        *reinterpret_cast<uint16_t*>(ptr) = static_cast<uint16_t>(name_size);
+        ptr += sizeof(uint16_t);
+        memcpy(ptr, field_name.data(), field_name.size());
+        ptr[name_size-1] = 0;
+        ptr += name_size;
+    }
+
+    memcpy(ptr, raw_value.data(), raw_value.size());
+    ptr[raw_size-1] = 0;
+    ptr += raw_size;
+
+    if (interp_size > 0) {
+        memcpy(ptr, interp_value.data(), interp_value.size());
+        ptr[interp_size-1] = 0;
+        ptr += interp_size;
+    }
+
+    // Zero the alignment padding
+    memset(ptr, 0, fsize-used_size);
+
+    INDEX_VALUE(_data, _fidxoffset, _field_idx) = _foffset;
+
+    _foffset += fsize;
+    _field_idx += 1;
+
+    return 1;
+}
+
 int EventBuilder::GetFieldCount() {
     return _field_idx;
 }
@@ -498,32 +894,59 @@ int EventBuilder::GetFieldCount() {
  *****************************************************************************/
 
 const char* EventRecordField::FieldNamePtr() const {
+    if (_version == EVENT_FORMAT_V2) {
+        return FIELD_V2_NAME(_data, _roffset + _foffset).data();
+    }
     return CHAR_PTR(_data, _roffset + _foffset + FIELD_NAME_OFFSET);
 }
 
 uint16_t EventRecordField::FieldNameSize() const {
+    if (_version == EVENT_FORMAT_V2) {
+        return static_cast<uint16_t>(FIELD_V2_NAME(_data, _roffset + _foffset).size());
+    }
     return FIELD_NAME_SIZE(_data, _roffset, _foffset) - static_cast<uint16_t>(1);
 }
 
 std::string_view EventRecordField::FieldName() const {
+    if (_version == EVENT_FORMAT_V2) {
+        return FIELD_V2_NAME(_data, _roffset + _foffset);
+    }
     return std::string_view(CHAR_PTR(_data, _roffset + _foffset + FIELD_NAME_OFFSET),
                             FIELD_NAME_SIZE(_data, _roffset, _foffset) - static_cast<uint16_t>(1));
 }
 
 const char* EventRecordField::RawValuePtr() const {
+    if (_version == EVENT_FORMAT_V2) {
+        return CHAR_PTR(_data, FIELD_V2_RAW_VALUE_OFFSET(_data, _roffset + _foffset));
+    }
     return CHAR_PTR(_data, _roffset + _foffset + FIELD_RAW_VALUE_OFFSET(FIELD_NAME_SIZE(_data, _roffset, _foffset)));
 }
 
 uint32_t EventRecordField::RawValueSize() const {
+    if (_version == EVENT_FORMAT_V2) {
+        return FIELD_V2_RAW_SIZE(_data, _roffset + _foffset) - 1;
+    }
     return FIELD_RAW_SIZE(_data, _roffset, _foffset) - static_cast<uint16_t>(1);
 }
 
 std::string_view EventRecordField::RawValue() const {
+    if (_version == EVENT_FORMAT_V2) {
+        return std::string_view(CHAR_PTR(_data, FIELD_V2_RAW_VALUE_OFFSET(_data, _roffset + _foffset)),
+                                FIELD_V2_RAW_SIZE(_data, _roffset + _foffset) - 1);
+    }
     return std::string_view(CHAR_PTR(_data, _roffset + _foffset + FIELD_RAW_VALUE_OFFSET(FIELD_NAME_SIZE(_data, _roffset, _foffset))),
                             FIELD_RAW_SIZE(_data, _roffset, _foffset) - static_cast<uint16_t>(1));
 }
 
 const char* EventRecordField::InterpValuePtr() const {
+    if (_version == EVENT_FORMAT_V2) {
+        auto offset = _roffset + _foffset;
+        if (FIELD_V2_INTERP_SIZE(_data, offset) > 0) {
+            return CHAR_PTR(_data, FIELD_V2_RAW_VALUE_OFFSET(_data, offset) + FIELD_V2_RAW_SIZE(_data, offset));
+        } else {
+            return nullptr;
+        }
+    }
     if (FIELD_INTERP_SIZE(_data, _roffset, _foffset) > 0) {
         return CHAR_PTR(_data, _roffset + _foffset + FIELD_INTERP_VALUE_OFFSET(
                 FIELD_NAME_SIZE(_data, _roffset, _foffset),
@@ -535,6 +958,10 @@ const char* EventRecordField::InterpValuePtr() const {
 }
 
 uint32_t EventRecordField::InterpValueSize() const {
+    if (_version == EVENT_FORMAT_V2) {
+        auto size = FIELD_V2_INTERP_SIZE(_data, _roffset + _foffset);
+        return size > 0 ? size - 1 : 0;
+    }
     if (FIELD_INTERP_SIZE(_data, _roffset, _foffset) > 0) {
         return FIELD_INTERP_SIZE(_data, _roffset, _foffset) - static_cast<uint16_t>(1);
     } else {
@@ -543,6 +970,15 @@ uint32_t EventRecordField::InterpValueSize() const {
 }
 
 std::string_view EventRecordField::InterpValue() const {
+    if (_version == EVENT_FORMAT_V2) {
+        auto offset = _roffset + _foffset;
+        auto size = FIELD_V2_INTERP_SIZE(_data, offset);
+        if (size > 0) {
+            return std::string_view(CHAR_PTR(_data, FIELD_V2_RAW_VALUE_OFFSET(_data, offset) + FIELD_V2_RAW_SIZE(_data, offset)), size - 1);
+        } else {
+            return std::string_view();
+        }
+    }
     if (FIELD_INTERP_SIZE(_data, _roffset, _foffset) > 0) {
         return std::string_view(CHAR_PTR(_data, _roffset + _foffset + FIELD_INTERP_VALUE_OFFSET(
                                          FIELD_NAME_SIZE(_data, _roffset, _foffset),
@@ -553,7 +989,24 @@ std::string_view EventRecordField::InterpValue() const {
     }
 }
 
+bool EventRecordField::HasIntValue() const {
+    if (_version == EVENT_FORMAT_V2) {
+        return (FIELD_V2_FLAGS(_data, _roffset + _foffset) & FIELD_V2_FLAG_INT) != 0;
+    }
+    return false;
+}
+
+int64_t EventRecordField::IntValue() const {
+    if (HasIntValue()) {
+        return FIELD_V2_INT_VALUE(_data, _roffset + _foffset);
+    }
+    return 0;
+}
+
 field_type_t EventRecordField::FieldType() const {
+    if (_version == EVENT_FORMAT_V2) {
+        return static_cast<enum field_type_t>(FIELD_V2_TYPE(_data, _roffset + _foffset));
+    }
     return static_cast<enum field_type_t>(FIELD_TYPE(_data, _roffset, _foffset));
 }
 
@@ -570,8 +1023,14 @@ EventRecordField::EventRecordField(const uint8_t* data, uint32_t roffset, uint32
     _roffset = roffset;
     _fidxoffset = fidxoffset;
     _index = index;
+    _version = static_cast<uint8_t>(EVENT_VERSION(_data));
+    if (_version == EVENT_FORMAT_V2) {
+        _index_width = RECORD_V2_INDEX_WIDTH(_data, _roffset);
+    } else {
+        _index_width = sizeof(uint32_t);
+    }
     if (_index < RECORD_NUM_FIELDS(_data, _roffset)) {
-        _foffset = INDEX_VALUE(_data, _fidxoffset, _index);
+        _foffset = FIELD_INDEX_VALUE(_data, _fidxoffset, _index, _index_width);
     } else {
         _foffset = EVENT_SIZE(_data);
     }
@@ -580,7 +1039,7 @@ EventRecordField::EventRecordField(const uint8_t* data, uint32_t roffset, uint32
 void EventRecordField::move(int32_t n) {
     _index += n;
     if (_index < RECORD_NUM_FIELDS(_data, _roffset)) {
-        _foffset = INDEX_VALUE(_data, _fidxoffset, _index);
+        _foffset = FIELD_INDEX_VALUE(_data, _fidxoffset, _index, _index_width);
     } else {
         _foffset = EVENT_SIZE(_data);
     }
@@ -595,6 +1054,9 @@ uint32_t EventRecord::RecordType() const {
 }
 
 const char* EventRecord::RecordTypeNamePtr() const {
+    if (_version == EVENT_FORMAT_V2) {
+        return CHAR_PTR(_data, _roffset + RECORD_V2_TYPE_NAME_OFFSET(RECORD_NUM_FIELDS(_data, _roffset), RECORD_V2_INDEX_WIDTH(_data, _roffset), RECORD_V2_FLAGS(_data, _roffset)));
+    }
     return RECORD_TYPE_NAME_PTR(_data, _roffset, RECORD_NUM_FIELDS(_data, _roffset));
 }
 
@@ -603,11 +1065,13 @@ uint16_t EventRecord::RecordTypeNameSize() const {
 }
 
 std::string_view EventRecord::RecordTypeName() const {
-    return std::string_view(RECORD_TYPE_NAME_PTR(_data, _roffset, RECORD_NUM_FIELDS(_data, _roffset)),
-                            RECORD_NAME_SIZE(_data, _roffset) - static_cast<uint16_t>(1));
+    return std::string_view(RecordTypeNamePtr(), RECORD_NAME_SIZE(_data, _roffset) - static_cast<uint16_t>(1));
 }
 
 const char* EventRecord::RecordTextPtr() const {
+    if (_version == EVENT_FORMAT_V2) {
+        return CHAR_PTR(_data, _roffset + RECORD_V2_TEXT_OFFSET(RECORD_NUM_FIELDS(_data, _roffset), RECORD_V2_INDEX_WIDTH(_data, _roffset), RECORD_V2_FLAGS(_data, _roffset), RECORD_NAME_SIZE(_data, _roffset)));
+    }
     return RECORD_TEXT_PTR(_data, _roffset, RECORD_NUM_FIELDS(_data, _roffset), RECORD_NAME_SIZE(_data, _roffset));
 }
 
@@ -616,14 +1080,27 @@ uint16_t EventRecord::RecordTextSize() const {
 }
 
 std::string_view EventRecord::RecordText() const {
-    return std::string_view(RECORD_TEXT_PTR(_data, _roffset, RECORD_NUM_FIELDS(_data, _roffset), RECORD_NAME_SIZE(_data, _roffset)),
-                            RECORD_TEXT_SIZE(_data, _roffset) - static_cast<uint16_t>(1));
+    return std::string_view(RecordTextPtr(), RECORD_TEXT_SIZE(_data, _roffset) - static_cast<uint16_t>(1));
 }
 
 uint16_t EventRecord::NumFields() const {
     return RECORD_NUM_FIELDS(_data, _roffset);
 }
 
+uint32_t EventRecord::field_index_offset() const {
+    if (_version == EVENT_FORMAT_V2) {
+        return _roffset + RECORD_V2_FIELD_INDEX_OFFSET;
+    }
+    return _roffset + RECORD_FIELD_INDEX_OFFSET;
+}
+
+uint32_t EventRecord::field_sorted_index_offset() const {
+    if (_version == EVENT_FORMAT_V2) {
+        return _roffset + RECORD_V2_FIELD_SORTED_INDEX_OFFSET(RECORD_NUM_FIELDS(_data, _roffset), RECORD_V2_INDEX_WIDTH(_data, _roffset));
+    }
+    return _roffset + RECORD_FIELD_SORTED_INDEX_OFFSET(RECORD_NUM_FIELDS(_data, _roffset));
+}
+
 EventRecordField EventRecord::FieldAt(uint32_t idx) const {
     if (idx >= RECORD_NUM_FIELDS(_data, _roffset)) {
         throw std::out_of_range("Field index out of range for EventRecord: " + std::to_string(idx));
@@ -631,17 +1108,67 @@ EventRecordField EventRecord::FieldAt(uint32_t idx) const {
     return EventRecordField(
             _data,
             _roffset,
-            _roffset+RECORD_FIELD_INDEX_OFFSET,
+            field_index_offset(),
             idx
     );
 
 }
 
+template<typename T>
+inline const T* find_field_v2(const uint8_t* data, uint32_t roffset, const T* start, const T* end, const std::string_view& name) {
+    auto res = std::lower_bound(start, end, name, [data, roffset](T e, const std::string_view& v) -> bool {
+        return v.compare(FIELD_V2_NAME(data, roffset + e)) > 0;
+    });
+
+    if (res == end || name != FIELD_V2_NAME(data, roffset + *res)) {
+        return nullptr;
+    }
+    return res;
+}
+
 EventRecordField EventRecord::FieldByName(const std::string_view& name) const {
     uint16_t num_fields = RECORD_NUM_FIELDS(_data, _roffset);
     if (num_fields == 0) {
         throw std::out_of_range("Record has no fields");
     }
+
+    if (_version == EVENT_FORMAT_V2) {
+        auto width = RECORD_V2_INDEX_WIDTH(_data, _roffset);
+        if ((RECORD_V2_FLAGS(_data, _roffset) & RECORD_V2_FLAG_HASH_INDEX) != 0) {
+            auto hash_size = RECORD_V2_HASH_INDEX_SIZE(num_fields);
+            auto table = reinterpret_cast<const uint16_t*>(_data+_roffset+RECORD_V2_HASH_INDEX_OFFSET(num_fields, width));
+            auto fidxoffset = field_index_offset();
+            auto slot = FIELD_NAME_HASH(name) & (hash_size-1);
+            while (table[slot] != 0) {
+                uint32_t idx = table[slot]-1u;
+                if (FIELD_V2_NAME(_data, _roffset+FIELD_INDEX_VALUE(_data, fidxoffset, idx, width)) == name) {
+                    return EventRecordField(_data, _roffset, fidxoffset, idx);
+                }
+                slot = (slot+1) & (hash_size-1);
+            }
+            return EventRecordField();
+        }
+
+        uint32_t idxoffset = field_sorted_index_offset();
+        uint32_t idx;
+        if (width == sizeof(uint16_t)) {
+            auto start = reinterpret_cast<const uint16_t*>(_data+idxoffset);
+            auto res = find_field_v2(_data, _roffset, start, start+num_fields, name);
+            if (res == nullptr) {
+                return EventRecordField();
+            }
+            idx = static_cast<uint32_t>(res - start);
+        } else {
+            auto start = INDEX_PTR(_data, idxoffset, 0);
+            auto res = find_field_v2(_data, _roffset, start, start+num_fields, name);
+            if (res == nullptr) {
+                return EventRecordField();
+            }
+            idx = static_cast<uint32_t>(res - start);
+        }
+        return EventRecordField(_data, _roffset, idxoffset, idx);
+    }
+
     uint32_t idxoffset = _roffset+RECORD_FIELD_SORTED_INDEX_OFFSET(num_fields);
     const uint32_t* start = INDEX_PTR(_data, idxoffset, 0);
     const uint32_t* end = INDEX_PTR(_data, idxoffset, num_fields);
@@ -673,7 +1200,7 @@ EventRecordField EventRecord::begin() const {
         return EventRecordField(
                 _data,
                 _roffset,
-                _roffset + RECORD_FIELD_INDEX_OFFSET,
+                field_index_offset(),
                 0
         );
     } else {
@@ -686,7 +1213,7 @@ EventRecordField EventRecord::end() const {
         return EventRecordField(
                 _data,
                 _roffset,
-                _roffset+RECORD_FIELD_INDEX_OFFSET,
+                field_index_offset(),
                 RECORD_NUM_FIELDS(_data, _roffset)
         );
     } else {
@@ -699,7 +1226,7 @@ EventRecordField EventRecord::begin_sorted() const {
         return EventRecordField(
                 _data,
                 _roffset,
-                _roffset+RECORD_FIELD_SORTED_INDEX_OFFSET(RECORD_NUM_FIELDS(_data, _roffset)),
+                field_sorted_index_offset(),
                 0
         );
     } else {
@@ -712,7 +1239,7 @@ EventRecordField EventRecord::end_sorted() const {
         return EventRecordField(
                 _data,
                 _roffset,
-                _roffset+RECORD_FIELD_SORTED_INDEX_OFFSET(RECORD_NUM_FIELDS(_data, _roffset)),
+                field_sorted_index_offset(),
                 RECORD_NUM_FIELDS(_data, _roffset)
         );
     } else {
@@ -723,6 +1250,7 @@ EventRecordField EventRecord::end_sorted() const {
 EventRecord::EventRecord(const uint8_t* data, uint32_t index) {
     _data = data;
     _index = index;
+    _version = static_cast<uint8_t>(EVENT_VERSION(_data));
     if (_index < EVENT_NUM_RECORDS(_data)) {
         _roffset = INDEX_VALUE(_data, EVENT_RECORD_INDEX_OFFSET, _index);
     } else {
@@ -751,6 +1279,10 @@ uint32_t Event::Size() const {
     return EVENT_SIZE(_data);
 }
 
+uint32_t Event::Version() const {
+    return EVENT_VERSION(_data);
+}
+
 uint64_t Event::Seconds() const {
     return EVENT_SEC(_data);
 }
@@ -802,6 +1334,9 @@ int Event::Validate() const {
     if (_size <= EVENT_RECORD_INDEX_OFFSET) {
         return 1;
     }
+    if (EVENT_VERSION(_data) == EVENT_FORMAT_V2) {
+        return validate_v2();
+    }
     if (_size <= EVENT_RECORD_INDEX_OFFSET+EVENT_NUM_RECORDS(_data)*sizeof(uint32_t)) {
         return 2;
     }
@@ -845,6 +1380,77 @@ int Event::Validate() const {
     return 0;
 }
 
+int Event::validate_v2() const {
+    if (_size <= EVENT_RECORD_INDEX_OFFSET+EVENT_NUM_RECORDS(_data)*sizeof(uint32_t)) {
+        return 2;
+    }
+    for (int ridx = 0; ridx < EVENT_NUM_RECORDS(_data); ++ridx) {
+        auto roffset = INDEX_VALUE(_data, EVENT_RECORD_INDEX_OFFSET, ridx);
+        if (_size <= roffset) {
+            return 3;
+        }
+        if (_size <= roffset + RECORD_V2_FIELD_INDEX_OFFSET) {
+            return 4;
+        }
+        auto num_fields = RECORD_NUM_FIELDS(_data, roffset);
+        auto width = RECORD_V2_INDEX_WIDTH(_data, roffset);
+        if (width != sizeof(uint16_t) && width != sizeof(uint32_t)) {
+            return 5;
+        }
+        auto flags = RECORD_V2_FLAGS(_data, roffset);
+        if (_size <= roffset + RECORD_V2_TYPE_NAME_OFFSET(num_fields, width, flags)) {
+            return 5;
+        }
+        if ((flags & RECORD_V2_FLAG_HASH_INDEX) != 0) {
+            // Every field must be in the table, and the table must have at least one empty slot
+            auto table = reinterpret_cast<const uint16_t*>(_data+roffset+RECORD_V2_HASH_INDEX_OFFSET(num_fields, width));
+            uint32_t used = 0;
+            for (uint32_t i = 0; i < RECORD_V2_HASH_INDEX_SIZE(num_fields); ++i) {
+                if (table[i] > num_fields) {
+                    return 5;
+                }
+                if (table[i] != 0) {
+                    used++;
+                }
+            }
+            if (used != num_fields) {
+                return 5;
+            }
+        }
+        if (_size <= roffset + RECORD_V2_TYPE_NAME_OFFSET(num_fields, width, flags) + RECORD_NAME_SIZE(_data, roffset)) {
+            return 6;
+        }
+        if (_size < roffset + RECORD_V2_TEXT_OFFSET(num_fields, width, flags, RECORD_NAME_SIZE(_data, roffset)) + RECORD_TEXT_SIZE(_data, roffset)) {
+            return 7;
+        }
+
+        for (int fidx = 0; fidx < num_fields; ++fidx) {
+            auto foffset = roffset + FIELD_INDEX_VALUE(_data, roffset + RECORD_V2_FIELD_INDEX_OFFSET, fidx, width);
+            if (_size <= foffset) {
+                return 8;
+            }
+            if (_size < foffset + FIELD_V2_RAW_SIZE_OFFSET || _size < foffset + FIELD_V2_HEADER_SIZE(FIELD_V2_FLAGS(_data, foffset))) {
+                return 9;
+            }
+            auto name_size = FIELD_V2_INLINE_NAME_SIZE(_data, foffset);
+            if (FIELD_V2_NAME_ID(_data, foffset) != FIELD_NAME_ID_UNKNOWN) {
+                if (FieldIdToName(FIELD_V2_NAME_ID(_data, foffset)).empty()) {
+                    return 10;
+                }
+            } else if (name_size == 0 || _size < foffset + FIELD_V2_HEADER_SIZE(FIELD_V2_FLAGS(_data, foffset)) + sizeof(uint16_t) + name_size) {
+                return 10;
+            }
+            auto raw_offset = FIELD_V2_RAW_VALUE_OFFSET(_data, foffset);
+            if (_size < raw_offset + FIELD_V2_RAW_SIZE(_data, foffset)) {
+                return 11;
+            }
+            if (_size < raw_offset + FIELD_V2_RAW_SIZE(_data, foffset) + FIELD_V2_INTERP_SIZE(_data, foffset)) {
+                return 12;
+            }
+        }
+    }
+    return 0;
+}
 
 std::string EventToRawText(const Event& event, bool include_interp) {
     std::string id;
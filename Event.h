@@ -19,24 +19,52 @@
 #include "FieldType.h"
 
 #include <cstdint>
+#include <cstring>
 #include <iterator>
 #include <memory>
 #include <string_view>
 
 
 constexpr uint32_t EVENT_FLAG_IS_AUOMS_EVENT = 1;
+// The event was forwarded with its raw fields only because auoms was in degraded mode (see OverloadController)
+constexpr uint32_t EVENT_FLAG_IS_DEGRADED = 2;
+
+// Binary event format versions (stored in the top 8 bits of the event size)
+constexpr uint32_t EVENT_FORMAT_V1 = 1;
+constexpr uint32_t EVENT_FORMAT_V2 = 2;
 
 class IEventBuilderAllocator {
 public:
     virtual int Allocate(void** data, size_t size) = 0;
     virtual int Commit() = 0;
     virtual int Rollback() = 0;
+
+    // Add an event that was already built elsewhere
+    virtual int Put(const void* data, size_t size) {
+        void* ptr;
+        auto ret = Allocate(&ptr, size);
+        if (ret == 1) {
+            memcpy(ptr, data, size);
+            ret = Commit();
+        }
+        return ret;
+    }
 };
 
 class EventBuilder {
 public:
-    EventBuilder(std::shared_ptr<IEventBuilderAllocator> allocator): _allocator(allocator), _data(nullptr), _size(0)
-    {}
+    EventBuilder(std::shared_ptr<IEventBuilderAllocator> allocator, uint32_t version = EVENT_FORMAT_V1);
+
+    // Add a field name hash index to each record (v2 format only) so that EventRecord::FieldByName is O(1)
+    void SetFieldHashIndex(bool enable) {
+        _field_hash_index = enable && _version == EVENT_FORMAT_V2;
+    }
+
+    // Store a pre-parsed integer along with the raw value of well known numeric fields (v2 format only).
+    // See EventRecordField::HasIntValue()
+    void SetIntValues(bool enable) {
+        _int_values = enable && _version == EVENT_FORMAT_V2;
+    }
 
     ~EventBuilder() {
     }
@@ -53,11 +81,19 @@ public:
     int EndRecord();
     int AddField(const char *field_name, const char* raw_value, const char* interp_value, field_type_t field_type);
     int AddField(const std::string_view& field_name, const std::string_view& raw_value, const std::string_view& interp_value, field_type_t field_type);
+    // Add a field with an already parsed integer value (ignored unless SetIntValues(true))
+    int AddField(const std::string_view& field_name, const std::string_view& raw_value, const std::string_view& interp_value, field_type_t field_type, int64_t int_value);
     int GetFieldCount();
 
 private:
+    int end_record_v2();
+    int add_field_v2(const std::string_view& field_name, const std::string_view& raw_value, const std::string_view& interp_value, field_type_t field_type, const int64_t* int_value);
+
     std::shared_ptr<IEventBuilderAllocator> _allocator;
 
+    uint32_t _version;
+    bool _field_hash_index;
+    bool _int_values;
     uint8_t* _data;
     size_t _size;
     uint32_t _roffset;
@@ -86,6 +122,8 @@ public:
         _fidxoffset = 0;
         _foffset = 0;
         _index = 0;
+        _version = EVENT_FORMAT_V1;
+        _index_width = sizeof(uint32_t);
     }
 
     EventRecordField(const EventRecordField& other) = default;
@@ -105,6 +143,11 @@ public:
     uint32_t InterpValueSize() const;
     std::string_view InterpValue() const;
 
+    // True if a base 10 integer value was parsed from the raw value when the event was built
+    bool HasIntValue() const;
+    // Returns 0 if !HasIntValue()
+    int64_t IntValue() const;
+
     field_type_t FieldType() const;
 
     uint32_t RecordType() const;
@@ -151,6 +194,8 @@ private:
     uint32_t _fidxoffset;
     uint32_t _foffset;
     uint32_t _index;
+    uint8_t _version;
+    uint8_t _index_width;
 };
 
 class EventRecord {
@@ -166,6 +211,7 @@ public:
         _data = nullptr;
         _roffset = 0;
         _index = 0;
+        _version = EVENT_FORMAT_V1;
     }
 
     EventRecord(const EventRecord& other) = default;
@@ -233,10 +279,13 @@ private:
 
     EventRecord(const uint8_t* data, uint32_t index);
     void move(int32_t n);
+    uint32_t field_index_offset() const;
+    uint32_t field_sorted_index_offset() const;
 
     const uint8_t* _data;
     uint32_t _roffset;
     uint32_t _index;
+    uint8_t _version;
 };
 
 class Event {
@@ -246,6 +295,10 @@ public:
         return std::make_pair(hdr >> 24, hdr & 0x00FFFFFF);
     }
 
+    static inline bool IsSupportedVersion(uint32_t version) {
+        return version == EVENT_FORMAT_V1 || version == EVENT_FORMAT_V2;
+    }
+
     Event(const void* data, size_t size) {
         _data = reinterpret_cast<const uint8_t*>(data);
         _size = size;
@@ -258,6 +311,7 @@ public:
 
     const void* Data() const;
     uint32_t Size() const;
+    uint32_t Version() const;
     uint64_t Seconds() const;
     uint32_t Milliseconds() const;
     uint64_t Serial() const;
@@ -273,6 +327,8 @@ public:
 
     int Validate() const;
 private:
+    int validate_v2() const;
+
     friend class EventRecord;
 
     const uint8_t* _data;
@@ -0,0 +1,226 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved. 
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "EventColumns.h"
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "EventBenchmarks"
+#include <boost/test/unit_test.hpp>
+
+#include "TestEventQueue.h"
+#include "TestEventData.h"
+#include "RecordType.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace std::string_view_literals;
+
+BOOST_AUTO_TEST_CASE( test_format_benchmark )
+{
+    constexpr int num_events = 20000;
+    auto records = make_test_records();
+
+    for (auto version : {EVENT_FORMAT_V1, EVENT_FORMAT_V2}) {
+        std::vector<std::vector<uint8_t>> events;
+        events.reserve(num_events);
+
+        auto queue = std::make_shared<TestEventQueue>();
+        EventBuilder builder(queue, version);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_events; ++i) {
+            BOOST_REQUIRE_EQUAL(build_test_event(builder, records, i), 1);
+        }
+        auto build_usecs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+        size_t total_size = 0;
+        for (int i = 0; i < num_events; ++i) {
+            total_size += queue->GetEvent(i).Size();
+        }
+
+        size_t checksum = 0;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_events; ++i) {
+            auto event = queue->GetEvent(i);
+            for (auto& rec : event) {
+                for (auto& field : rec) {
+                    checksum += field.FieldName().size() + field.RawValue().size() + field.InterpValue().size();
+                }
+            }
+        }
+        auto iter_usecs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_events; ++i) {
+            auto event = queue->GetEvent(i);
+            auto rec = event.RecordAt(0);
+            for (auto name : {"syscall", "pid", "exe", "key", "x_custom_field"}) {
+                checksum += rec.FieldByName(name).RawValueSize();
+            }
+        }
+        auto lookup_usecs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+        BOOST_TEST_MESSAGE("Event v" << version << ": " << num_events << " events, avg size " << total_size/num_events
+            << " bytes, build " << build_usecs << " usec, iterate " << iter_usecs << " usec, FieldByName x5 "
+            << lookup_usecs << " usec (" << checksum << ")");
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_field_by_name_benchmark )
+{
+    constexpr int num_loops = 2000;
+
+    struct Variant {
+        const char* name;
+        uint32_t version;
+        bool hash_index;
+    };
+
+    // The SYSCALL/PATH/EXECVE records as collected, plus the processed events from TestEventData
+    std::vector<std::string> names;
+    auto raw_records = make_test_records();
+    for (auto& rec : raw_records) {
+        for (auto& f : rec.fields) {
+            names.emplace_back(f.name);
+        }
+    }
+    for (auto& e : test_events) {
+        for (auto& rec : e._records) {
+            for (auto& f : rec._fields) {
+                names.emplace_back(f._name);
+            }
+        }
+    }
+
+    for (auto& variant : {Variant{"v1", EVENT_FORMAT_V1, false}, Variant{"v2", EVENT_FORMAT_V2, false}, Variant{"v2+hash", EVENT_FORMAT_V2, true}}) {
+        auto queue = std::make_shared<TestEventQueue>();
+        auto builder = std::make_shared<EventBuilder>(queue, variant.version);
+        builder->SetFieldHashIndex(variant.hash_index);
+
+        BOOST_REQUIRE_EQUAL(build_test_event(*builder, raw_records, 1), 1);
+        for (auto e : test_events) {
+            e.Write(builder);
+        }
+
+        std::vector<Event> events;
+        size_t total_size = 0;
+        for (int i = 0; i < queue->GetEventCount(); ++i) {
+            events.emplace_back(queue->GetEvent(i));
+            total_size += events.back().Size();
+        }
+
+        size_t found = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_loops; ++i) {
+            for (auto& event : events) {
+                for (auto& rec : event) {
+                    for (auto& name : names) {
+                        if (rec.FieldByName(name)) {
+                            found++;
+                        }
+                    }
+                }
+            }
+        }
+        auto usecs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+        size_t lookups = 0;
+        for (auto& event : events) {
+            lookups += event.NumRecords() * names.size() * num_loops;
+        }
+
+        BOOST_TEST_MESSAGE("FieldByName " << variant.name << ": " << lookups << " lookups (" << found << " found) in " << usecs
+            << " usec, " << (usecs*1000.0)/lookups << " nsec/lookup, " << total_size << " event bytes");
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_event_columns_benchmark )
+{
+    constexpr int num_loops = 2000;
+
+    struct Rule {
+        std::string_view syscall;
+        int32_t pid;
+    };
+
+    auto queue = std::make_shared<TestEventQueue>();
+    auto builder = std::make_shared<EventBuilder>(queue, EVENT_FORMAT_V2);
+    BOOST_REQUIRE_EQUAL(build_test_event(*builder, make_test_records(), 1), 1);
+    for (auto e : test_events) {
+        e.Write(builder);
+    }
+    std::vector<Event> events;
+    for (int i = 0; i < queue->GetEventCount(); ++i) {
+        events.emplace_back(queue->GetEvent(i));
+    }
+
+    // Several independent (pid, syscall) rules (e.g. one per output) evaluated over the same batch
+    std::vector<Rule> rules;
+    for (auto syscall : {"execve"sv, "open"sv, "connect"sv, "openat"sv}) {
+        rules.push_back({syscall, events.front().Pid()});
+        rules.push_back({syscall, events.back().Pid()});
+    }
+
+    // One event at a time through the accessors
+    size_t matched = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_loops; ++i) {
+        for (auto& rule : rules) {
+            for (auto& event : events) {
+                for (auto rec : event) {
+                    if (rec.RecordType() != static_cast<uint32_t>(RecordType::SYSCALL)) {
+                        continue;
+                    }
+                    auto syscall = rec.FieldByName("syscall");
+                    if (syscall) {
+                        if (event.Pid() == rule.pid && syscall.InterpValue() == rule.syscall) {
+                            matched++;
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    auto event_usecs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    // Columns built once per batch, then each rule is a few tight loops
+    size_t col_matched = 0;
+    EventColumns columns;
+    std::vector<uint8_t> match;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_loops; ++i) {
+        columns.Clear();
+        for (auto& event : events) {
+            columns.Add(event);
+        }
+        for (auto& rule : rules) {
+            match.assign(columns.Size(), 1);
+            columns.MatchRecordType(static_cast<uint32_t>(RecordType::SYSCALL), match);
+            columns.MatchPid(rule.pid, match);
+            columns.MatchSyscall(rule.syscall, match);
+            for (auto m : match) {
+                col_matched += m;
+            }
+        }
+    }
+    auto col_usecs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    BOOST_CHECK_EQUAL(matched, col_matched);
+    BOOST_TEST_MESSAGE("Batch filter: " << events.size()*num_loops << " events, " << rules.size() << " rules, per event "
+        << event_usecs << " usec, columnar " << col_usecs << " usec");
+}
@@ -0,0 +1,147 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "EventColumns.h"
+#include "RecordType.h"
+
+#include <charconv>
+
+using namespace std::string_view_literals;
+
+namespace {
+
+inline bool is_primary_record_type(uint32_t rtype) {
+    switch (static_cast<RecordType>(rtype)) {
+        case RecordType::SYSCALL:
+        case RecordType::AUOMS_SYSCALL:
+        case RecordType::AUOMS_SYSCALL_FRAGMENT:
+        case RecordType::AUOMS_EXECVE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+inline int32_t field_int(const EventRecordField& field, int32_t dflt) {
+    if (!field) {
+        return dflt;
+    }
+    if (field.HasIntValue()) {
+        return static_cast<int32_t>(field.IntValue());
+    }
+    auto raw = field.RawValue();
+    int32_t val;
+    auto ret = std::from_chars(raw.data(), raw.data()+raw.size(), val);
+    if (ret.ec != std::errc() || ret.ptr != raw.data()+raw.size()) {
+        return dflt;
+    }
+    return val;
+}
+
+}
+
+void EventColumns::Clear() {
+    _events.clear();
+    _record_types.clear();
+    _syscall_nums.clear();
+    _syscalls.clear();
+    _pids.clear();
+}
+
+void EventColumns::Reserve(size_t size) {
+    _events.reserve(size);
+    _record_types.reserve(size);
+    _syscall_nums.reserve(size);
+    _syscalls.reserve(size);
+    _pids.reserve(size);
+}
+
+void EventColumns::Add(const Event& event) {
+    static auto SV_SYSCALL = "syscall"sv;
+
+    _events.emplace_back(event);
+    _pids.emplace_back(event.Pid());
+
+    EventRecord rec;
+    EventRecordField syscall;
+    for (auto r : event) {
+        if (r.RecordType() == static_cast<uint32_t>(RecordType::SYSCALL)) {
+            auto field = r.FieldByName(SV_SYSCALL);
+            if (field) {
+                rec = r;
+                syscall = field;
+                break;
+            }
+        }
+        if (!rec && is_primary_record_type(r.RecordType())) {
+            rec = r;
+        }
+    }
+    if (!rec && event.NumRecords() > 0) {
+        rec = event.RecordAt(0);
+    }
+
+    if (!rec) {
+        _record_types.emplace_back(0);
+        _syscall_nums.emplace_back(NO_SYSCALL);
+        _syscalls.emplace_back();
+        return;
+    }
+
+    if (!syscall) {
+        syscall = rec.FieldByName(SV_SYSCALL);
+    }
+
+    _record_types.emplace_back(rec.RecordType());
+    _syscall_nums.emplace_back(field_int(syscall, NO_SYSCALL));
+    _syscalls.emplace_back(syscall ? syscall.InterpValue() : std::string_view());
+}
+
+void EventColumns::MatchRecordType(uint32_t rtype, std::vector<uint8_t>& match) const {
+    const auto n = _record_types.size();
+    const auto col = _record_types.data();
+    auto m = match.data();
+    for (size_t i = 0; i < n; ++i) {
+        m[i] &= static_cast<uint8_t>(col[i] == rtype);
+    }
+}
+
+void EventColumns::MatchSyscall(int32_t syscall, std::vector<uint8_t>& match) const {
+    const auto n = _syscall_nums.size();
+    const auto col = _syscall_nums.data();
+    auto m = match.data();
+    for (size_t i = 0; i < n; ++i) {
+        m[i] &= static_cast<uint8_t>(col[i] == syscall);
+    }
+}
+
+void EventColumns::MatchSyscall(const std::string_view& syscall, std::vector<uint8_t>& match) const {
+    const auto n = _syscalls.size();
+    for (size_t i = 0; i < n; ++i) {
+        if (match[i] != 0) {
+            match[i] = static_cast<uint8_t>(_syscalls[i] == syscall);
+        }
+    }
+}
+
+void EventColumns::MatchPid(int32_t pid, std::vector<uint8_t>& match) const {
+    const auto n = _pids.size();
+    const auto col = _pids.data();
+    auto m = match.data();
+    for (size_t i = 0; i < n; ++i) {
+        m[i] &= static_cast<uint8_t>(col[i] == pid);
+    }
+}
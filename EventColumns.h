@@ -0,0 +1,70 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef AUOMS_EVENTCOLUMNS_H
+#define AUOMS_EVENTCOLUMNS_H
+
+#include "Event.h"
+
+#include <string_view>
+#include <vector>
+
+/*
+ * A columnar (struct-of-arrays) view of the hot fields of a batch of events.
+ *
+ * The columns are filled once per batch so that filters can evaluate predicates over whole
+ * columns with tight loops instead of walking the record/field accessors of each event.
+ *
+ * The hot fields are taken from the first SYSCALL record that has a syscall field (the record EventFilter
+ * has always matched on). If there is no such record, the first AUOMS_SYSCALL, AUOMS_SYSCALL_FRAGMENT or
+ * AUOMS_EXECVE record is used, or the first record if the event has none of these.
+ *
+ * The string columns reference the event data, so the event data must outlive the batch (or the next Clear()).
+ */
+class EventColumns {
+public:
+    static constexpr int32_t NO_SYSCALL = -1;
+
+    void Clear();
+    void Reserve(size_t size);
+    void Add(const Event& event);
+
+    inline size_t Size() const { return _events.size(); }
+    inline const Event& EventAt(size_t idx) const { return _events[idx]; }
+
+    inline const std::vector<uint32_t>& RecordTypes() const { return _record_types; }
+    inline const std::vector<int32_t>& SyscallNums() const { return _syscall_nums; }
+    inline const std::vector<std::string_view>& Syscalls() const { return _syscalls; }
+    inline const std::vector<int32_t>& Pids() const { return _pids; }
+
+    // Column predicates.
+    // match must have Size() entries. Each predicate clears match[i] for events that do not satisfy it,
+    // so calling several predicates on the same match vector ANDs them together.
+    void MatchRecordType(uint32_t rtype, std::vector<uint8_t>& match) const;
+    void MatchSyscall(int32_t syscall, std::vector<uint8_t>& match) const;
+    // Matches the interpreted syscall name
+    void MatchSyscall(const std::string_view& syscall, std::vector<uint8_t>& match) const;
+    void MatchPid(int32_t pid, std::vector<uint8_t>& match) const;
+
+private:
+    std::vector<Event> _events;
+    std::vector<uint32_t> _record_types;
+    std::vector<int32_t> _syscall_nums;
+    std::vector<std::string_view> _syscalls;
+    std::vector<int32_t> _pids;
+};
+
+#endif //AUOMS_EVENTCOLUMNS_H
@@ -66,3 +66,40 @@ bool EventFilter::IsEventFiltered(const Event& event) {
 
     return !syscall.empty() && _filtersEngine->IsEventFiltered(syscall, p, _filterFlagsMask);
 }
+
+void EventFilter::FilterEvents(const EventColumns& columns, std::vector<uint8_t>& filtered) {
+    // Same as IsEventFiltered(): only events with a SYSCALL record that has a syscall value can be filtered.
+    _pending.assign(columns.Size(), 1);
+    columns.MatchRecordType(static_cast<uint32_t>(RecordType::SYSCALL), _pending);
+
+    auto& syscalls = columns.Syscalls();
+    auto& pids = columns.Pids();
+
+    std::fill(filtered.begin(), filtered.end(), 0);
+    for (size_t i = 0; i < columns.Size(); ++i) {
+        if (_pending[i] == 0) {
+            continue;
+        }
+        if (syscalls[i].empty()) {
+            _pending[i] = 0;
+            continue;
+        }
+
+        // Every event in the batch from the same process with the same syscall gets the same result,
+        // so look up the process and evaluate the filter once for the whole group.
+        _group.assign(_pending.begin(), _pending.end());
+        columns.MatchPid(pids[i], _group);
+        columns.MatchSyscall(syscalls[i], _group);
+
+        _syscall.assign(syscalls[i].data(), syscalls[i].size());
+        auto p = _processTree->GetInfoForPid(pids[i]);
+        auto is_filtered = static_cast<uint8_t>(_filtersEngine->IsEventFiltered(_syscall, p, _filterFlagsMask));
+
+        for (size_t j = i; j < columns.Size(); ++j) {
+            if (_group[j] != 0) {
+                filtered[j] = is_filtered;
+                _pending[j] = 0;
+            }
+        }
+    }
+}
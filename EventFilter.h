@@ -24,6 +24,8 @@
 #include "FiltersEngine.h"
 #include "ProcessTree.h"
 
+#include <algorithm>
+
 class AllPassEventFilter: public IEventFilter {
 public:
     static std::shared_ptr<IEventFilter> NewEventFilter() {
@@ -33,6 +35,10 @@ public:
     bool IsEventFiltered(const Event& event) override {
         return false;
     }
+
+    void FilterEvents(const EventColumns& columns, std::vector<uint8_t>& filtered) override {
+        std::fill(filtered.begin(), filtered.end(), 0);
+    }
 };
 
 class EventFilter: public IEventFilter {
@@ -41,6 +47,7 @@ public:
     static std::shared_ptr<IEventFilter> NewEventFilter(const std::string& name, const Config& config, std::shared_ptr<UserDB> user_db, std::shared_ptr<FiltersEngine> filtersEngine, std::shared_ptr<ProcessTree> processTree);
 
     bool IsEventFiltered(const Event& event) override;
+    void FilterEvents(const EventColumns& columns, std::vector<uint8_t>& filtered) override;
 private:
     EventFilter(const std::string& name, const std::bitset<FILTER_BITSET_SIZE>& filterFlagsMask, const std::shared_ptr<ProcFilter>& proc_filter, std::shared_ptr<FiltersEngine> filtersEngine, std::shared_ptr<ProcessTree> processTree):
             _name(name), _filterFlagsMask(filterFlagsMask), _proc_filter(proc_filter), _filtersEngine(filtersEngine), _processTree(processTree)
@@ -52,6 +59,11 @@ private:
     std::shared_ptr<ProcFilter> _proc_filter;
     std::shared_ptr<FiltersEngine> _filtersEngine;
     std::shared_ptr<ProcessTree> _processTree;
+
+    // FilterEvents() scratch space, reused between batches
+    std::vector<uint8_t> _pending;
+    std::vector<uint8_t> _group;
+    std::string _syscall;
 };
 
 
@@ -22,12 +22,17 @@
 #include "TempDir.h"
 #include "TestEventData.h"
 #include "RawEventProcessor.h"
+#include "Interpret.h"
+#include "ParallelEventProcessor.h"
+#include "ProcessInventory.h"
 #include "RawEventAccumulator.h"
 #include "StringUtils.h"
+#include "Signals.h"
 
 #include <fstream>
 #include <stdexcept>
 #include <iostream>
+#include <thread>
 
 extern "C" {
 #include <sys/types.h>
@@ -229,48 +234,34 @@ void diff_event(int idx, const Event& e, const Event& a) {
     }
 }
 
-BOOST_AUTO_TEST_CASE( basic_test ) {
-    TempDir dir("/tmp/EventProcessorTests");
-
+// Writes the test passwd and group files to dir and returns a UserDB loaded from them
+static std::shared_ptr<UserDB> new_test_user_db(TempDir& dir) {
     write_file(dir.Path() + "/passwd", passwd_file_text);
     write_file(dir.Path() + "/group", group_file_text);
 
     auto user_db = std::make_shared<UserDB>(dir.Path());
-
     user_db->update();
+    return user_db;
+}
 
-    auto expected_queue = new TestEventQueue();
-    auto actual_queue = new TestEventQueue();
-    auto metrics_queue = new TestEventQueue();
-    auto expected_allocator = std::shared_ptr<IEventBuilderAllocator>(expected_queue);
-    auto actual_allocator = std::shared_ptr<IEventBuilderAllocator>(actual_queue);
-    auto metrics_allocator = std::shared_ptr<IEventBuilderAllocator>(metrics_queue);
-    auto expected_builder = std::make_shared<EventBuilder>(expected_allocator);
-    auto actual_builder = std::make_shared<EventBuilder>(actual_allocator);
-    auto metrics_builder = std::make_shared<EventBuilder>(metrics_allocator);
-
-    auto proc_filter = std::make_shared<ProcFilter>(user_db);
-    auto filtersEngine = std::make_shared<FiltersEngine>();
-    auto processTree = std::make_shared<ProcessTree>(user_db, filtersEngine);
-
-    auto metrics = std::make_shared<Metrics>(metrics_builder);
-
-    auto raw_proc = std::make_shared<RawEventProcessor>(actual_builder, user_db, processTree, filtersEngine, metrics);
-
-    auto actual_raw_queue = new RawEventQueue(raw_proc);
-    auto actual_raw_allocator = std::shared_ptr<IEventBuilderAllocator>(actual_raw_queue);
-    auto actual_raw_builder = std::make_shared<EventBuilder>(actual_raw_allocator);
+static std::shared_ptr<Metrics> new_test_metrics() {
+    return std::make_shared<Metrics>(std::make_shared<EventBuilder>(std::make_shared<TestEventQueue>()));
+}
 
+// Adds the expected (processed) test_events to queue
+static void add_expected_events(const std::shared_ptr<TestEventQueue>& queue) {
+    auto builder = std::make_shared<EventBuilder>(queue);
     for (auto e : test_events) {
-        e.Write(expected_builder);
+        e.Write(builder);
     }
+}
 
-    RawEventAccumulator accumulator(actual_raw_builder, metrics);
+// Parses raw_test_events and passes the accumulated events to builder
+static void add_raw_test_events(const std::shared_ptr<EventBuilder>& builder, const std::shared_ptr<Metrics>& metrics) {
+    RawEventAccumulator accumulator(builder, metrics);
 
     for (int i = 0; i < raw_test_events.size(); i++) {
-        auto raw_event = raw_test_events[i];
-        auto do_flush = raw_events_do_flush[i];
-        std::string event_txt = raw_event;
+        std::string event_txt = raw_test_events[i];
         auto lines = split(event_txt, '\n');
         for (auto& line: lines) {
             std::unique_ptr<RawEventRecord> record = std::make_unique<RawEventRecord>();
@@ -281,14 +272,365 @@ BOOST_AUTO_TEST_CASE( basic_test ) {
                 Logger::Warn("Received unparsable event data: %s", line.c_str());
             }
         }
-        if (do_flush) {
+        if (raw_events_do_flush[i]) {
             accumulator.Flush(0);
         }
     }
+}
 
+// Returns a builder whose events are passed to raw_proc
+static std::shared_ptr<EventBuilder> new_raw_proc_builder(const std::shared_ptr<RawEventProcessor>& raw_proc) {
+    return std::make_shared<EventBuilder>(std::make_shared<RawEventQueue>(raw_proc));
+}
+
+static void check_events(const std::shared_ptr<TestEventQueue>& expected_queue, const std::shared_ptr<TestEventQueue>& actual_queue) {
     BOOST_REQUIRE_EQUAL(expected_queue->GetEventCount(), actual_queue->GetEventCount());
 
     for (size_t idx = 0; idx < expected_queue->GetEventCount(); ++idx) {
         diff_event(idx, expected_queue->GetEvent(idx), actual_queue->GetEvent(idx));
     }
 }
+
+// The UserDB, queues, process tree and RawEventProcessor the event processor test cases run against.
+// Any filters are added to the FiltersEngine before the ProcessTree is created.
+struct ProcessorTestEnv {
+    explicit ProcessorTestEnv(const std::vector<ProcFilterSpec>& filters = std::vector<ProcFilterSpec>()):
+        dir("/tmp/EventProcessorTests"),
+        user_db(new_test_user_db(dir)),
+        expected_queue(std::make_shared<TestEventQueue>()),
+        actual_queue(std::make_shared<TestEventQueue>()),
+        actual_builder(std::make_shared<EventBuilder>(actual_queue)),
+        filtersEngine(std::make_shared<FiltersEngine>()),
+        metrics(new_test_metrics())
+    {
+        if (!filters.empty()) {
+            filtersEngine->AddFilterList(filters, "test");
+        }
+        processTree = std::make_shared<ProcessTree>(user_db, filtersEngine);
+        raw_proc = std::make_shared<RawEventProcessor>(actual_builder, user_db, processTree, filtersEngine, metrics);
+    }
+
+    TempDir dir;
+    std::shared_ptr<UserDB> user_db;
+    std::shared_ptr<TestEventQueue> expected_queue;
+    std::shared_ptr<TestEventQueue> actual_queue;
+    std::shared_ptr<EventBuilder> actual_builder;
+    std::shared_ptr<FiltersEngine> filtersEngine;
+    std::shared_ptr<Metrics> metrics;
+    std::shared_ptr<ProcessTree> processTree;
+    std::shared_ptr<RawEventProcessor> raw_proc;
+};
+
+BOOST_AUTO_TEST_CASE( basic_test ) {
+    ProcessorTestEnv env;
+
+    add_expected_events(env.expected_queue);
+    add_raw_test_events(new_raw_proc_builder(env.raw_proc), env.metrics);
+
+    check_events(env.expected_queue, env.actual_queue);
+}
+
+BOOST_AUTO_TEST_CASE( interpret_cache_test ) {
+    ProcessorTestEnv env;
+    // Small enough that entries get evicted
+    env.raw_proc->SetInterpretCacheSize(2);
+
+    auto raw_builder = new_raw_proc_builder(env.raw_proc);
+
+    // The second pass gets its interpreted values from the cache, the result must be the same
+    for (int pass = 0; pass < 2; ++pass) {
+        add_expected_events(env.expected_queue);
+        add_raw_test_events(raw_builder, env.metrics);
+    }
+
+    check_events(env.expected_queue, env.actual_queue);
+}
+
+BOOST_AUTO_TEST_CASE( deferred_interp_test ) {
+    ProcessorTestEnv env;
+    env.raw_proc->SetDeferInterpretation(true);
+
+    add_expected_events(env.expected_queue);
+    add_raw_test_events(new_raw_proc_builder(env.raw_proc), env.metrics);
+
+    auto& expected_queue = env.expected_queue;
+    auto& actual_queue = env.actual_queue;
+    BOOST_REQUIRE_EQUAL(expected_queue->GetEventCount(), actual_queue->GetEventCount());
+
+    // The deferred interp values must not be in the event, but FieldInterpValue must produce the same value
+    std::string buf;
+    int deferred = 0;
+    for (size_t idx = 0; idx < expected_queue->GetEventCount(); ++idx) {
+        auto expected = expected_queue->GetEvent(idx);
+        auto actual = actual_queue->GetEvent(idx);
+        BOOST_REQUIRE_EQUAL(expected.NumRecords(), actual.NumRecords());
+        for (int r = 0; r < expected.NumRecords(); ++r) {
+            auto erec = expected.RecordAt(r);
+            auto arec = actual.RecordAt(r);
+            BOOST_REQUIRE_EQUAL(erec.NumFields(), arec.NumFields());
+            for (int f = 0; f < erec.NumFields(); ++f) {
+                auto efield = erec.FieldAt(f);
+                auto afield = arec.FieldAt(f);
+                BOOST_REQUIRE_EQUAL(efield.FieldName(), afield.FieldName());
+                BOOST_REQUIRE_EQUAL(efield.RawValue(), afield.RawValue());
+                if (IsDeferredInterpFieldType(afield.FieldType())) {
+                    BOOST_REQUIRE_EQUAL(afield.InterpValueSize(), 0);
+                    deferred++;
+                }
+                BOOST_REQUIRE_EQUAL(efield.InterpValue(), FieldInterpValue(afield, buf));
+            }
+        }
+    }
+    BOOST_REQUIRE(deferred > 0);
+}
+
+BOOST_AUTO_TEST_CASE( filter_test ) {
+    // Filter all syscalls made by the iptables (xtables-multi) process
+    std::vector<std::string> syscalls({"*"});
+    std::vector<ProcFilterSpec> filters;
+    filters.emplace_back(PFS_MATCH_EXE_CONTAINS, -1, 0, 0, syscalls, "xtables-multi", std::vector<cmdlineFilter>());
+    ProcessorTestEnv env(filters);
+
+    add_expected_events(env.expected_queue);
+    add_raw_test_events(new_raw_proc_builder(env.raw_proc), env.metrics);
+
+    auto& expected_queue = env.expected_queue;
+    auto& actual_queue = env.actual_queue;
+
+    // The execve of xtables-multi (pid 91098) and the following syscall from the same pid are dropped
+    BOOST_REQUIRE_EQUAL(expected_queue->GetEventCount(), actual_queue->GetEventCount() + 2);
+
+    size_t actual_idx = 0;
+    for (size_t idx = 0; idx < expected_queue->GetEventCount(); ++idx) {
+        auto expected = expected_queue->GetEvent(idx);
+        if (expected.Serial() == 7605215 || expected.Serial() == 7605216) {
+            continue;
+        }
+        diff_event(idx, expected, actual_queue->GetEvent(actual_idx));
+        actual_idx++;
+    }
+}
+
+BOOST_AUTO_TEST_CASE( parallel_test ) {
+    // The worker threads are stopped with SIGQUIT
+    Signals::Init();
+    Signals::Start();
+
+    ProcessorTestEnv env;
+    auto raw_queue = std::make_shared<TestEventQueue>();
+
+    add_expected_events(env.expected_queue);
+    add_raw_test_events(std::make_shared<EventBuilder>(raw_queue), env.metrics);
+
+    ParallelEventProcessor proc(4, env.actual_queue, EVENT_FORMAT_V1, false, false, env.user_db, env.processTree, env.filtersEngine, env.metrics);
+    BOOST_REQUIRE_EQUAL(proc.NumWorkers(), 4);
+    proc.Start();
+
+    // Hand the events over in small batches so that the workers complete them out of order
+    for (size_t idx = 0; idx < raw_queue->GetEventCount(); ++idx) {
+        auto event = raw_queue->GetEvent(idx);
+        proc.ProcessData(event.Data(), event.Size());
+        if (idx % 3 == 2) {
+            proc.Flush();
+        }
+    }
+    proc.Flush();
+    proc.Stop();
+
+    check_events(env.expected_queue, env.actual_queue);
+}
+
+static bool has_inventory_event(const std::shared_ptr<TestEventQueue>& queue, size_t start, int pid) {
+    auto pid_str = std::to_string(pid);
+    for (size_t idx = start; idx < queue->GetEventCount(); ++idx) {
+        auto rec = queue->GetEvent(idx).RecordAt(0);
+        if (static_cast<RecordType>(rec.RecordType()) == RecordType::AUOMS_PROCESS_INVENTORY && rec.FieldByName("pid").RawValue() == pid_str) {
+            return true;
+        }
+    }
+    return false;
+}
+
+BOOST_AUTO_TEST_CASE( process_inventory_test ) {
+    ProcessorTestEnv env;
+    auto& actual_queue = env.actual_queue;
+
+    // A refresh interval this long limits every sweep after the first one to one process per call
+    ProcessInventory inventory(env.actual_builder, env.user_db, env.processTree, env.metrics, 1000000000, 1000000);
+
+    // The first sweep covers all of /proc
+    inventory.DoProcessInventory();
+    auto num_procs = actual_queue->GetEventCount();
+    BOOST_REQUIRE(num_procs > 0);
+    BOOST_REQUIRE(has_inventory_event(actual_queue, 0, getpid()));
+
+    inventory.DoProcessInventory();
+    BOOST_REQUIRE_EQUAL(actual_queue->GetEventCount(), num_procs + 1);
+
+    // A process that exec'd is reported on the next call
+    env.processTree->AddProcess(ProcessTreeSource_execve, getpid(), getppid(), getuid(), getgid(), "/bin/test", "test");
+    inventory.DoProcessInventory();
+    BOOST_REQUIRE_EQUAL(actual_queue->GetEventCount(), num_procs + 3);
+    BOOST_REQUIRE(has_inventory_event(actual_queue, num_procs + 1, getpid()));
+
+    // Only once
+    inventory.DoProcessInventory();
+    BOOST_REQUIRE_EQUAL(actual_queue->GetEventCount(), num_procs + 4);
+}
+
+BOOST_AUTO_TEST_CASE( shed_test ) {
+    ProcessorTestEnv env;
+
+    // A class that matches every event, active from the first Update()
+    auto overload = std::make_shared<OverloadController>(std::make_shared<Queue>(Queue::MIN_QUEUE_SIZE), [](uint64_t* bytes, uint64_t* items) { *bytes = 0; *items = 0; }, env.metrics);
+    auto sc = std::make_unique<OverloadShedClass>("all");
+    sc->_lag = 1;
+    BOOST_REQUIRE(overload->AddShedClass(std::move(sc)));
+    overload->Update(0, 1);
+    BOOST_REQUIRE(overload->IsShedding());
+
+    auto raw_proc = std::make_shared<RawEventProcessor>(env.actual_builder, env.user_db, env.processTree, env.filtersEngine, env.metrics, overload);
+    add_raw_test_events(new_raw_proc_builder(raw_proc), env.metrics);
+
+    // Nothing is sent, but the shed execve events still reach the process tree
+    BOOST_REQUIRE_EQUAL(env.actual_queue->GetEventCount(), 0);
+    auto p = env.processTree->GetInfoForPid(26918);
+    BOOST_REQUIRE(p);
+    BOOST_REQUIRE_EQUAL(p->_source, ProcessTreeSource_execve);
+    BOOST_REQUIRE_EQUAL(p->_exe, "/usr/bin/logger");
+}
+
+BOOST_AUTO_TEST_CASE( rate_limit_test ) {
+    auto metrics = new_test_metrics();
+
+    auto rl_config = std::make_shared<RateLimitConfig>();
+    rl_config->_max_buckets = 2;
+    rl_config->_report_secs = 10;
+    auto limit = std::make_unique<RateLimit>("stat");
+    limit->_keys.emplace("noisy");
+    limit->_rate = 1;
+    limit->_burst = 2;
+    rl_config->_limits.emplace_back(std::move(limit));
+    limit = std::make_unique<RateLimit>("pid");
+    limit->_by = RateLimitBy::PID;
+    limit->_rate = 1;
+    limit->_burst = 1;
+    rl_config->_limits.emplace_back(std::move(limit));
+
+    auto actual_queue = std::make_shared<TestEventQueue>();
+    auto actual_builder = std::make_shared<EventBuilder>(actual_queue);
+
+    RateLimiter limiter(rl_config, actual_builder, metrics);
+    std::vector<RateLimitSummary> summaries;
+
+    // Burst of 2, then 1 per second
+    BOOST_REQUIRE(!limiter.ShouldSuppress("noisy", "/bin/stat", "stat", 10, 1000, 0));
+    BOOST_REQUIRE(!limiter.ShouldSuppress("other\001noisy", "/bin/stat", "stat", 11, 1000, 100));
+    BOOST_REQUIRE(limiter.ShouldSuppress("noisy", "/bin/stat", "stat", 12, 1000, 200));
+    BOOST_REQUIRE(limiter.ShouldSuppress("noisy", "/bin/stat", "stat", 13, 1000, 300));
+    BOOST_REQUIRE(!limiter.ShouldSuppress("noisy", "/bin/stat", "stat", 14, 1001, 300));
+    BOOST_REQUIRE(limiter.ShouldSuppress("noisy", "/bin/stat", "stat", 15, 1001, 400));
+    // Other (exe, syscall) pairs have their own bucket
+    BOOST_REQUIRE(!limiter.ShouldSuppress("noisy", "/bin/stat", "lstat", 16, 1001, 450));
+
+    // The second limit matches all other events, by pid. Its first bucket evicts the oldest (stat) bucket.
+    BOOST_REQUIRE(!limiter.ShouldSuppress("", "/bin/ls", "open", 20, 1001, 500));
+    BOOST_REQUIRE(limiter.ShouldSuppress("", "/bin/cat", "read", 20, 1001, 600));
+
+    // The report is not due yet, but the evicted bucket is reported right away
+    BOOST_REQUIRE(limiter.TakeSummaries(summaries));
+    BOOST_REQUIRE_EQUAL(summaries.size(), 1);
+    BOOST_REQUIRE_EQUAL(summaries[0].limit_name, "stat");
+    BOOST_REQUIRE_EQUAL(summaries[0].exe, "/bin/stat");
+    BOOST_REQUIRE_EQUAL(summaries[0].syscall, "stat");
+    BOOST_REQUIRE_EQUAL(summaries[0].pid, -1);
+    BOOST_REQUIRE_EQUAL(summaries[0].count, 3);
+    BOOST_REQUIRE_EQUAL(summaries[0].first_msec, 1000200);
+    BOOST_REQUIRE_EQUAL(summaries[0].last_msec, 1001400);
+    summaries.clear();
+    BOOST_REQUIRE(!limiter.TakeSummaries(summaries));
+
+    // Events without a pid are not subject to the limits by pid
+    for (int i = 0; i < 3; ++i) {
+        BOOST_REQUIRE(!limiter.ShouldSuppress("", "/bin/cat", "read", -1, 1001, 700));
+    }
+
+    // The remaining counts are only reported when the report is due
+    BOOST_REQUIRE(!limiter.TakeSummaries(summaries));
+    BOOST_REQUIRE(limiter.TakeSummaries(summaries, true));
+    BOOST_REQUIRE_EQUAL(summaries.size(), 1);
+    BOOST_REQUIRE_EQUAL(summaries[0].limit_name, "pid");
+    BOOST_REQUIRE_EQUAL(summaries[0].exe, "/bin/ls");
+    BOOST_REQUIRE_EQUAL(summaries[0].pid, 20);
+    BOOST_REQUIRE_EQUAL(summaries[0].count, 1);
+    summaries.clear();
+    BOOST_REQUIRE(!limiter.TakeSummaries(summaries, true));
+
+    // The summaries are added as AUOMS_SUPPRESSED events
+    BOOST_REQUIRE(limiter.ShouldSuppress("", "/bin/cat", "read", 20, 1001, 800));
+    limiter.Flush(false);
+    BOOST_REQUIRE_EQUAL(actual_queue->GetEventCount(), 0);
+    limiter.Flush(true);
+    BOOST_REQUIRE_EQUAL(actual_queue->GetEventCount(), 1);
+    auto event = actual_queue->GetEvent(0);
+    BOOST_REQUIRE_EQUAL(event.Seconds(), 1001);
+    BOOST_REQUIRE_EQUAL(event.Milliseconds(), 800);
+    auto rec = event.begin();
+    BOOST_REQUIRE_EQUAL(rec.RecordType(), static_cast<uint32_t>(RecordType::AUOMS_SUPPRESSED));
+    BOOST_REQUIRE_EQUAL(rec.FieldByName("rate_limit").RawValue(), "pid");
+    BOOST_REQUIRE_EQUAL(rec.FieldByName("pid").RawValue(), "20");
+    BOOST_REQUIRE_EQUAL(rec.FieldByName("suppressed").RawValue(), "1");
+
+    // The remaining counts are reported when the RateLimiter is stopped
+    Signals::Init();
+    BOOST_REQUIRE(limiter.ShouldSuppress("", "/bin/cat", "read", 20, 1001, 900));
+    limiter.Start();
+    limiter.Stop();
+    BOOST_REQUIRE_EQUAL(actual_queue->GetEventCount(), 2);
+}
+
+BOOST_AUTO_TEST_CASE( rate_limit_sharded_test ) {
+    auto metrics = new_test_metrics();
+
+    // The default max buckets gives the most shards
+    auto rl_config = std::make_shared<RateLimitConfig>();
+    auto limit = std::make_unique<RateLimit>("all");
+    limit->_rate = 1;
+    limit->_burst = 1;
+    rl_config->_limits.emplace_back(std::move(limit));
+
+    auto actual_builder = std::make_shared<EventBuilder>(std::make_shared<TestEventQueue>());
+    RateLimiter limiter(rl_config, actual_builder, metrics);
+
+    // Each thread has its own exes, the second event of each exe is suppressed
+    constexpr int num_threads = 4;
+    constexpr int num_exes = 500;
+    std::vector<std::thread> threads;
+    std::vector<int> num_suppressed(num_threads, 0);
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&limiter,&num_suppressed,t]() {
+            for (int i = 0; i < num_exes; ++i) {
+                auto exe = "/bin/test" + std::to_string(t) + "_" + std::to_string(i);
+                for (int n = 0; n < 2; ++n) {
+                    if (limiter.ShouldSuppress("", exe, "read", 100+t, 1000, 0)) {
+                        num_suppressed[t]++;
+                    }
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (auto n : num_suppressed) {
+        BOOST_REQUIRE_EQUAL(n, num_exes);
+    }
+
+    std::vector<RateLimitSummary> summaries;
+    BOOST_REQUIRE(limiter.TakeSummaries(summaries, true));
+    BOOST_REQUIRE_EQUAL(summaries.size(), num_threads*num_exes);
+    for (auto& summary : summaries) {
+        BOOST_REQUIRE_EQUAL(summary.count, 1);
+    }
+}
@@ -45,6 +45,11 @@ public:
         return 1;
     }
 
+    // The event is copied straight into the queue
+    int Put(const void* data, size_t size) override {
+        return _queue->Put(const_cast<void*>(data), size);
+    }
+
 private:
     std::vector<uint8_t> _buffer;
     size_t _size;
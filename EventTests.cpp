@@ -14,6 +14,7 @@
     THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 #include "Event.h"
+#include "EventColumns.h"
 #define BOOST_TEST_DYN_LINK
 #define BOOST_TEST_MODULE "EventTests"
 #include <boost/test/unit_test.hpp>
@@ -21,10 +22,17 @@
 #include "Queue.h"
 #include "EventQueue.h"
 #include "TempFile.h"
+#include "TestEventQueue.h"
+#include "TestEventData.h"
+#include "RecordType.h"
 
+#include <cstring>
+#include <string>
+#include <vector>
 
 
-BOOST_AUTO_TEST_CASE( test )
+
+void test_event(uint32_t version, bool hash_index)
 {
     TempFile file("/tmp/EventTests.");
 
@@ -33,7 +41,8 @@ BOOST_AUTO_TEST_CASE( test )
 
     queue->Open();
 
-    EventBuilder builder(event_queue);
+    EventBuilder builder(event_queue, version);
+    builder.SetFieldHashIndex(hash_index);
 
     int ret = builder.BeginEvent(1, 3, 4, 2);
     if (ret != 1) {
@@ -92,6 +101,8 @@ BOOST_AUTO_TEST_CASE( test )
 
     Event event(data, size);
 
+    BOOST_CHECK_EQUAL(event.Version(), version);
+    BOOST_CHECK_EQUAL(event.Validate(), 0);
     BOOST_CHECK_EQUAL(event.Seconds(), 1);
     BOOST_CHECK_EQUAL(event.Milliseconds(), 3);
     BOOST_CHECK_EQUAL(event.Serial(), 4);
@@ -248,3 +259,294 @@ BOOST_AUTO_TEST_CASE( test )
     }
     BOOST_CHECK_EQUAL(x, rec.NumFields());
 }
+
+BOOST_AUTO_TEST_CASE( test )
+{
+    test_event(EVENT_FORMAT_V1, false);
+}
+
+BOOST_AUTO_TEST_CASE( test_v2 )
+{
+    test_event(EVENT_FORMAT_V2, false);
+}
+
+BOOST_AUTO_TEST_CASE( test_v2_hash_index )
+{
+    test_event(EVENT_FORMAT_V2, true);
+}
+
+void check_test_event(const Event& event, const std::vector<TestRecord>& records) {
+    BOOST_REQUIRE_EQUAL(event.Validate(), 0);
+    BOOST_REQUIRE_EQUAL(event.NumRecords(), records.size());
+    for (int r = 0; r < records.size(); ++r) {
+        auto& trec = records[r];
+        auto rec = event.RecordAt(r);
+        BOOST_CHECK_EQUAL(rec.RecordType(), trec.type);
+        BOOST_CHECK_EQUAL(rec.RecordTypeName(), trec.name);
+        BOOST_CHECK_EQUAL(std::string(rec.RecordTypeNamePtr()), trec.name);
+        BOOST_CHECK_EQUAL(rec.RecordText(), trec.text);
+        BOOST_CHECK_EQUAL(std::string(rec.RecordTextPtr()), trec.text);
+        BOOST_REQUIRE_EQUAL(rec.NumFields(), trec.fields.size());
+        for (int i = 0; i < trec.fields.size(); ++i) {
+            auto& tf = trec.fields[i];
+            auto field = rec.FieldAt(i);
+            BOOST_CHECK_EQUAL(field.FieldName(), tf.name);
+            BOOST_CHECK_EQUAL(std::string(field.FieldNamePtr()), tf.name);
+            BOOST_CHECK_EQUAL(field.FieldNameSize(), tf.name.size());
+            BOOST_CHECK_EQUAL(field.RawValue(), tf.raw);
+            BOOST_CHECK_EQUAL(std::string(field.RawValuePtr()), tf.raw);
+            BOOST_CHECK_EQUAL(field.RawValueSize(), tf.raw.size());
+            BOOST_CHECK_EQUAL(field.InterpValue(), tf.interp);
+            BOOST_CHECK_EQUAL(field.InterpValueSize(), tf.interp.size());
+            if (tf.interp.empty()) {
+                BOOST_CHECK(field.InterpValuePtr() == nullptr);
+            } else {
+                BOOST_CHECK_EQUAL(std::string(field.InterpValuePtr()), tf.interp);
+            }
+            BOOST_CHECK_EQUAL(static_cast<uint16_t>(field.FieldType()), static_cast<uint16_t>(tf.type));
+            BOOST_CHECK_EQUAL(rec.FieldByName(tf.name), field);
+        }
+        BOOST_CHECK(!rec.FieldByName("not_a_field"));
+
+        std::string last;
+        for (auto itr = rec.begin_sorted(); itr != rec.end_sorted(); ++itr) {
+            BOOST_CHECK(last < std::string(itr->FieldName()));
+            last = std::string(itr->FieldName());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_v1_v2_equivalent )
+{
+    auto records = make_test_records();
+
+    auto v1_queue = std::make_shared<TestEventQueue>();
+    auto v2_queue = std::make_shared<TestEventQueue>();
+    auto v2h_queue = std::make_shared<TestEventQueue>();
+    EventBuilder v1_builder(v1_queue, EVENT_FORMAT_V1);
+    EventBuilder v2_builder(v2_queue, EVENT_FORMAT_V2);
+    EventBuilder v2h_builder(v2h_queue, EVENT_FORMAT_V2);
+    v2h_builder.SetFieldHashIndex(true);
+
+    BOOST_REQUIRE_EQUAL(build_test_event(v1_builder, records, 1), 1);
+    BOOST_REQUIRE_EQUAL(build_test_event(v2_builder, records, 1), 1);
+    BOOST_REQUIRE_EQUAL(build_test_event(v2h_builder, records, 1), 1);
+
+    auto v1_event = v1_queue->GetEvent(0);
+    auto v2_event = v2_queue->GetEvent(0);
+    auto v2h_event = v2h_queue->GetEvent(0);
+
+    BOOST_CHECK_EQUAL(v1_event.Version(), EVENT_FORMAT_V1);
+    BOOST_CHECK_EQUAL(v2_event.Version(), EVENT_FORMAT_V2);
+    BOOST_CHECK_LT(v2_event.Size(), v1_event.Size());
+
+    check_test_event(v1_event, records);
+    check_test_event(v2_event, records);
+    check_test_event(v2h_event, records);
+
+    BOOST_CHECK_EQUAL(EventToRawText(v1_event, true), EventToRawText(v2_event, true));
+    BOOST_CHECK_EQUAL(EventToRawText(v1_event, true), EventToRawText(v2h_event, true));
+}
+
+BOOST_AUTO_TEST_CASE( test_v2_int_values )
+{
+    auto records = make_test_records();
+    records[0].fields[3].raw = "-2"; // exit
+    records[0].fields[21].raw = "4294967295"; // ses
+    records[1].fields[2].raw = "not-a-number"; // inode
+
+    for (auto version : {EVENT_FORMAT_V1, EVENT_FORMAT_V2}) {
+        auto queue = std::make_shared<TestEventQueue>();
+        EventBuilder builder(queue, version);
+        builder.SetIntValues(true);
+        builder.SetFieldHashIndex(true);
+        BOOST_REQUIRE_EQUAL(build_test_event(builder, records, 1), 1);
+
+        BOOST_REQUIRE_EQUAL(builder.BeginEvent(1, 2, 3, 1), 1);
+        BOOST_REQUIRE_EQUAL(builder.BeginRecord(1300, "SYSCALL", "", 2), 1);
+        BOOST_REQUIRE_EQUAL(builder.AddField("x_parsed", "0x10", "", field_type_t::UNCLASSIFIED, 16), 1);
+        BOOST_REQUIRE_EQUAL(builder.AddField("pid", "12", "", field_type_t::UNCLASSIFIED), 1);
+        BOOST_REQUIRE_EQUAL(builder.EndRecord(), 1);
+        BOOST_REQUIRE_EQUAL(builder.EndEvent(), 1);
+
+        auto event = queue->GetEvent(0);
+        check_test_event(event, records);
+
+        auto rec = event.RecordAt(0);
+        if (version == EVENT_FORMAT_V1) {
+            BOOST_CHECK(!rec.FieldByName("pid").HasIntValue());
+            BOOST_CHECK_EQUAL(rec.FieldByName("pid").IntValue(), 0);
+            continue;
+        }
+
+        BOOST_CHECK(rec.FieldByName("pid").HasIntValue());
+        BOOST_CHECK_EQUAL(rec.FieldByName("pid").IntValue(), 26918);
+        BOOST_CHECK_EQUAL(rec.FieldByName("syscall").IntValue(), 59);
+        BOOST_CHECK_EQUAL(rec.FieldByName("exit").IntValue(), -2);
+        BOOST_CHECK_EQUAL(rec.FieldByName("ses").IntValue(), 4294967295);
+        BOOST_CHECK_EQUAL(rec.FieldByName("uid").IntValue(), 0);
+        BOOST_CHECK(!rec.FieldByName("success").HasIntValue());
+        BOOST_CHECK(!rec.FieldByName("tty").HasIntValue());
+        BOOST_CHECK(!rec.FieldByName("a0").HasIntValue());
+        BOOST_CHECK(!rec.FieldByName("exe").HasIntValue());
+        BOOST_CHECK(!rec.FieldByName("x_custom_field").HasIntValue());
+
+        rec = event.RecordAt(1);
+        BOOST_CHECK_EQUAL(rec.FieldByName("item").IntValue(), 0);
+        BOOST_CHECK(!rec.FieldByName("inode").HasIntValue());
+
+        rec = queue->GetEvent(1).RecordAt(0);
+        BOOST_CHECK(rec.FieldByName("x_parsed").HasIntValue());
+        BOOST_CHECK_EQUAL(rec.FieldByName("x_parsed").IntValue(), 16);
+        BOOST_CHECK_EQUAL(rec.FieldByName("x_parsed").RawValue(), "0x10");
+        BOOST_CHECK_EQUAL(rec.FieldByName("pid").IntValue(), 12);
+        BOOST_CHECK_EQUAL(queue->GetEvent(1).Validate(), 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_v2_large_values )
+{
+    // Large values need wide field sizes and a record > 64KB needs 32bit field indexes
+    std::vector<TestRecord> records;
+    records.emplace_back(TestRecord{1300, "SYSCALL", "", {
+        {"pid", "1", "", field_type_t::UNCLASSIFIED},
+        {"proctitle", std::string(70000, 'A'), std::string(10, 'B'), field_type_t::PROCTITLE},
+        {"unknown_name", "2", std::string(66000, 'C'), field_type_t::UNCLASSIFIED},
+        {"exe", "\"/bin/ls\"", "/bin/ls", field_type_t::ESCAPED},
+    }});
+    records.emplace_back(TestRecord{1302, "PATH", "", {
+        {"name", "\"/bin/ls\"", "/bin/ls", field_type_t::ESCAPED},
+    }});
+
+    for (bool hash_index : {false, true}) {
+        auto queue = std::make_shared<TestEventQueue>();
+        EventBuilder builder(queue, EVENT_FORMAT_V2);
+        builder.SetFieldHashIndex(hash_index);
+        BOOST_REQUIRE_EQUAL(build_test_event(builder, records, 1), 1);
+        check_test_event(queue->GetEvent(0), records);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_v2_validate )
+{
+    auto records = make_test_records();
+    auto queue = std::make_shared<TestEventQueue>();
+    EventBuilder builder(queue, EVENT_FORMAT_V2);
+    builder.SetFieldHashIndex(true);
+    BOOST_REQUIRE_EQUAL(build_test_event(builder, records, 1), 1);
+
+    // Truncating only the alignment padding after the last field leaves a valid event
+    auto event = queue->GetEvent(0);
+    for (size_t size = 0; size+3 < event.Size(); ++size) {
+        BOOST_CHECK_NE(Event(event.Data(), size).Validate(), 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_event_columns )
+{
+    auto records = make_test_records();
+
+    auto queue = std::make_shared<TestEventQueue>();
+    auto builder = std::make_shared<EventBuilder>(queue, EVENT_FORMAT_V2);
+    BOOST_REQUIRE_EQUAL(build_test_event(*builder, records, 1), 1);
+    // Same event, but with the PATH record first
+    std::swap(records[0], records[1]);
+    BOOST_REQUIRE_EQUAL(build_test_event(*builder, records, 2), 1);
+    for (auto e : test_events) {
+        e.Write(builder);
+    }
+
+    EventColumns columns;
+    for (int i = 0; i < queue->GetEventCount(); ++i) {
+        columns.Add(queue->GetEvent(i));
+    }
+    BOOST_REQUIRE_EQUAL(columns.Size(), queue->GetEventCount());
+
+    for (int i = 0; i < 2; ++i) {
+        BOOST_CHECK_EQUAL(columns.RecordTypes()[i], static_cast<uint32_t>(RecordType::SYSCALL));
+        BOOST_CHECK_EQUAL(columns.SyscallNums()[i], 59);
+        BOOST_CHECK_EQUAL(columns.Syscalls()[i], "execve");
+    }
+
+    // The columns must agree with the Event accessors
+    for (size_t i = 0; i < columns.Size(); ++i) {
+        auto& event = columns.EventAt(i);
+        BOOST_CHECK_EQUAL(columns.Pids()[i], event.Pid());
+        EventRecordField syscall;
+        for (auto r : event) {
+            if (r.RecordType() == static_cast<uint32_t>(RecordType::SYSCALL) && r.FieldByName("syscall")) {
+                syscall = r.FieldByName("syscall");
+                break;
+            }
+        }
+        if (syscall) {
+            BOOST_CHECK_EQUAL(columns.RecordTypes()[i], static_cast<uint32_t>(RecordType::SYSCALL));
+            BOOST_CHECK_EQUAL(columns.Syscalls()[i], syscall.InterpValue());
+            BOOST_CHECK_EQUAL(columns.SyscallNums()[i], std::stoi(std::string(syscall.RawValue())));
+        } else {
+            BOOST_CHECK_NE(columns.RecordTypes()[i], static_cast<uint32_t>(RecordType::SYSCALL));
+        }
+    }
+
+    std::vector<uint8_t> match(columns.Size(), 1);
+    columns.MatchSyscall(59, match);
+    columns.MatchSyscall("execve", match);
+    BOOST_CHECK_EQUAL(match[0], 1);
+    BOOST_CHECK_EQUAL(match[1], 1);
+    for (size_t i = 0; i < columns.Size(); ++i) {
+        bool expected = columns.SyscallNums()[i] == 59 && columns.Syscalls()[i] == "execve";
+        BOOST_CHECK_EQUAL(match[i], static_cast<uint8_t>(expected));
+    }
+
+    match.assign(columns.Size(), 1);
+    columns.MatchRecordType(static_cast<uint32_t>(RecordType::SYSCALL), match);
+    columns.MatchPid(columns.Pids()[0], match);
+    BOOST_CHECK_EQUAL(match[0], 1);
+    columns.MatchSyscall("open", match);
+    BOOST_CHECK_EQUAL(match[0], 0);
+
+    columns.Clear();
+    BOOST_CHECK_EQUAL(columns.Size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_event_columns_any_syscall_record )
+{
+    // Like EventFilter::IsEventFiltered, the columns use the first SYSCALL record with a syscall field,
+    // even when other syscall-like records come first.
+    auto queue = std::make_shared<TestEventQueue>();
+    EventBuilder builder(queue, EVENT_FORMAT_V2);
+    BOOST_REQUIRE_EQUAL(builder.BeginEvent(1, 2, 3, 3), 1);
+    BOOST_REQUIRE_EQUAL(builder.BeginRecord(static_cast<uint32_t>(RecordType::AUOMS_SYSCALL), "AUOMS_SYSCALL", "", 1), 1);
+    BOOST_REQUIRE_EQUAL(builder.AddField("syscall", "2", "open", field_type_t::SYSCALL), 1);
+    BOOST_REQUIRE_EQUAL(builder.EndRecord(), 1);
+    BOOST_REQUIRE_EQUAL(builder.BeginRecord(static_cast<uint32_t>(RecordType::SYSCALL), "SYSCALL", "", 1), 1);
+    BOOST_REQUIRE_EQUAL(builder.AddField("arch", "c000003e", "x86_64", field_type_t::ARCH), 1);
+    BOOST_REQUIRE_EQUAL(builder.EndRecord(), 1);
+    BOOST_REQUIRE_EQUAL(builder.BeginRecord(static_cast<uint32_t>(RecordType::SYSCALL), "SYSCALL", "", 1), 1);
+    BOOST_REQUIRE_EQUAL(builder.AddField("syscall", "59", "execve", field_type_t::SYSCALL), 1);
+    BOOST_REQUIRE_EQUAL(builder.EndRecord(), 1);
+    BOOST_REQUIRE_EQUAL(builder.EndEvent(), 1);
+
+    // No SYSCALL record
+    BOOST_REQUIRE_EQUAL(builder.BeginEvent(1, 2, 4, 1), 1);
+    BOOST_REQUIRE_EQUAL(builder.BeginRecord(static_cast<uint32_t>(RecordType::AUOMS_SYSCALL), "AUOMS_SYSCALL", "", 1), 1);
+    BOOST_REQUIRE_EQUAL(builder.AddField("syscall", "2", "open", field_type_t::SYSCALL), 1);
+    BOOST_REQUIRE_EQUAL(builder.EndRecord(), 1);
+    BOOST_REQUIRE_EQUAL(builder.EndEvent(), 1);
+
+    EventColumns columns;
+    columns.Add(queue->GetEvent(0));
+    columns.Add(queue->GetEvent(1));
+
+    BOOST_CHECK_EQUAL(columns.RecordTypes()[0], static_cast<uint32_t>(RecordType::SYSCALL));
+    BOOST_CHECK_EQUAL(columns.SyscallNums()[0], 59);
+    BOOST_CHECK_EQUAL(columns.Syscalls()[0], "execve");
+
+    BOOST_CHECK_EQUAL(columns.RecordTypes()[1], static_cast<uint32_t>(RecordType::AUOMS_SYSCALL));
+    BOOST_CHECK_EQUAL(columns.Syscalls()[1], "open");
+
+    std::vector<uint8_t> match(columns.Size(), 1);
+    columns.MatchRecordType(static_cast<uint32_t>(RecordType::SYSCALL), match);
+    BOOST_CHECK_EQUAL(match[0], 1);
+    BOOST_CHECK_EQUAL(match[1], 0);
+}
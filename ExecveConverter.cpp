@@ -70,29 +70,55 @@ int parse_execve_fieldname(const std::string_view& fname, const std::string_view
     return -1;
 }
 
-void ExecveConverter::Convert(std::vector<EventRecord> execve_recs, std::string& cmdline) {
-    static auto S_ELIPSIS = std::string("...");
-    static auto S_MISSING_ARG_PIECE = std::string("<...>");
+// Same as unescape_raw_field() followed by bash_escape_string(), but only hex encoded values are copied (decoded)
+// before being escaped into cmdline.
+void ExecveConverter::append_arg(std::string& cmdline, const char* raw, size_t size) {
+    if (size > 0 && raw[0] == '"') {
+        if (size >= 2 && raw[size-1] == '"') {
+            bash_escape_string(cmdline, raw+1, size-2);
+        } else {
+            bash_escape_string(cmdline, raw, size);
+        }
+        return;
+    } else if (size > 0 && raw[0] == '(') {
+        bash_escape_string(cmdline, raw, size);
+        return;
+    }
+    unescape_raw_field(_unescaped_val, raw, size);
+    bash_escape_string(cmdline, _unescaped_val.data(), _unescaped_val.size());
+}
 
-    cmdline.resize(0);
+void ExecveConverter::Convert(const EventRecord* execve_recs, size_t num_recs, std::string& cmdline) {
+    using namespace std::string_view_literals;
 
-    // Sort EXECVE records so that args (e.g. a0, a1, a2 ...) will be in order.
-    std::sort(execve_recs.begin(), execve_recs.end(), [](const EventRecord& a, const EventRecord& b) -> int {
-        auto fa = a.FieldAt(0);
-        auto fb = b.FieldAt(0);
-        int a_num = parse_execve_argnum(fa.FieldName());
-        int b_num = parse_execve_argnum(fb.FieldName());
+    static auto S_ELIPSIS = "..."sv;
+    static auto S_MISSING_ARG_PIECE = "<...>"sv;
 
-        return a_num < b_num;
-    });
+    cmdline.resize(0);
 
+    // Order the EXECVE records so that args (e.g. a0, a1, a2 ...) will be in order.
+    // The records are almost always already in order, so only sort when needed.
+    _order.resize(0);
+    bool in_order = true;
+    for (size_t i = 0; i < num_recs; ++i) {
+        int num = parse_execve_argnum(execve_recs[i].FieldAt(0).FieldName());
+        if (!_order.empty() && num < _order.back().first) {
+            in_order = false;
+        }
+        _order.emplace_back(num, i);
+    }
+    if (!in_order) {
+        std::stable_sort(_order.begin(), _order.end(), [](const std::pair<int, size_t>& a, const std::pair<int, size_t>& b) {
+            return a.first < b.first;
+        });
+    }
 
     int expected_arg_num = 0;
     int expected_arg_len = 0;
     int accum_arg_len = 0;
     int expected_arg_idx = 0;
-    for (auto& rec : execve_recs) {
-        for (auto &f : rec) {
+    for (auto& order : _order) {
+        for (auto f : execve_recs[order.second]) {
             auto fname = f.FieldName();
             auto val = f.RawValue();
             int arg_num = 0;
@@ -108,8 +134,7 @@ void ExecveConverter::Convert(std::vector<EventRecord> execve_recs, std::string&
             if (expected_arg_num < arg_num && expected_arg_len > 0) {
                 if (accum_arg_len) {
                     if (!_tmp_val.empty()) {
-                        unescape_raw_field(_unescaped_val, _tmp_val.data(), _tmp_val.size());
-                        bash_escape_string(cmdline, _unescaped_val.data(), _unescaped_val.length());
+                        append_arg(cmdline, _tmp_val.data(), _tmp_val.size());
                     }
                     if (expected_arg_len > accum_arg_len) {
                         cmdline.append(S_MISSING_ARG_PIECE);
@@ -126,9 +151,9 @@ void ExecveConverter::Convert(std::vector<EventRecord> execve_recs, std::string&
                     cmdline.push_back(' ');
                 }
                 cmdline.push_back('<');
-                cmdline.append(std::to_string(expected_arg_num));
+                append_int(cmdline, expected_arg_num);
                 cmdline.append(S_ELIPSIS);
-                cmdline.append(std::to_string(arg_num-1));
+                append_int(cmdline, arg_num-1);
                 cmdline.push_back('>');
                 expected_arg_num = arg_num;
             }
@@ -138,20 +163,17 @@ void ExecveConverter::Convert(std::vector<EventRecord> execve_recs, std::string&
                     // Previous arg might have been multi-part
                     if (expected_arg_len > 0) {
                         if (!_tmp_val.empty()) {
-                            unescape_raw_field(_unescaped_val, _tmp_val.data(), _tmp_val.size());
-                            bash_escape_string(cmdline, _unescaped_val.data(), _unescaped_val.length());
+                            append_arg(cmdline, _tmp_val.data(), _tmp_val.size());
                         }
                         cmdline.append(S_MISSING_ARG_PIECE);
                         expected_arg_len = 0;
                         expected_arg_idx = 0;
                     }
 
-                    _unescaped_val.resize(0);
                     if (!cmdline.empty()) {
                         cmdline.push_back(' ');
                     }
-                    unescape_raw_field(_unescaped_val, val.data(), val.size());
-                    bash_escape_string(cmdline, _unescaped_val.data(), _unescaped_val.length());
+                    append_arg(cmdline, val.data(), val.size());
                     expected_arg_num += 1;
                     break;
                 case 1: // a%d_len=%d
@@ -159,7 +181,6 @@ void ExecveConverter::Convert(std::vector<EventRecord> execve_recs, std::string&
                     accum_arg_len = 0;
                     expected_arg_idx = 0;
                     _tmp_val.resize(0);
-                    _unescaped_val.resize(0);
                     break;
                 case 2: { // a%d[%d]
                     if (expected_arg_len == 0) {
@@ -173,20 +194,18 @@ void ExecveConverter::Convert(std::vector<EventRecord> execve_recs, std::string&
                         // There's a gap in the parts, so unescape and bash escape the part we have
                         // then fill in the missing parts with the place holder
                         if (!_tmp_val.empty()) {
-                            unescape_raw_field(_unescaped_val, _tmp_val.data(), _tmp_val.size());
-                            bash_escape_string(cmdline, _unescaped_val.data(), _unescaped_val.length());
+                            append_arg(cmdline, _tmp_val.data(), _tmp_val.size());
                         }
                         cmdline.append(S_MISSING_ARG_PIECE);
                         _tmp_val.resize(0);
-                        _unescaped_val.resize(0);
                         expected_arg_idx = arg_idx;
                     }
+                    // The parts are reassembled as they arrive, and decoded once the arg is complete
                     _tmp_val.append(val);
                     accum_arg_len += val.size();
                     expected_arg_idx += 1;
                     if (expected_arg_len <= accum_arg_len) {
-                        unescape_raw_field(_unescaped_val, _tmp_val.data(), _tmp_val.size());
-                        bash_escape_string(cmdline, _unescaped_val.data(), _unescaped_val.length());
+                        append_arg(cmdline, _tmp_val.data(), _tmp_val.size());
                         expected_arg_len = 0;
                         accum_arg_len = 0;
                         expected_arg_idx = 0;
@@ -201,8 +220,7 @@ void ExecveConverter::Convert(std::vector<EventRecord> execve_recs, std::string&
     // Last arg might have been a multi-part (a%d_len=%d a%d[%d])
     if (expected_arg_len > 0) {
         if (!_tmp_val.empty()) {
-            unescape_raw_field(_unescaped_val, _tmp_val.data(), _tmp_val.size());
-            bash_escape_string(cmdline, _unescaped_val.data(), _unescaped_val.length());
+            append_arg(cmdline, _tmp_val.data(), _tmp_val.size());
         }
         if (expected_arg_len > accum_arg_len) {
             cmdline.append(S_MISSING_ARG_PIECE);
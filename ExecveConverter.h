@@ -7,16 +7,28 @@
 
 #include "Event.h"
 
+#include <string>
+#include <utility>
 #include <vector>
 
 class ExecveConverter {
 public:
-    void Convert(std::vector<EventRecord> execve_recs, std::string& cmdline);
+    // Convert the EXECVE records (in any order) into a bash escaped cmdline.
+    // The records are only read, the converter's buffers are reused between calls.
+    void Convert(const EventRecord* execve_recs, size_t num_recs, std::string& cmdline);
+
+    inline void Convert(const std::vector<EventRecord>& execve_recs, std::string& cmdline) {
+        Convert(execve_recs.data(), execve_recs.size(), cmdline);
+    }
 
     // Assumes that raw_cmdline contains NUL delimited args
     static void ConvertRawCmdline(const std::string_view& raw_cmdline, std::string& cmdline);
 
 private:
+    void append_arg(std::string& cmdline, const char* raw, size_t size);
+
+    // (first arg num, record index) of each record, in arg order
+    std::vector<std::pair<int, size_t>> _order;
     std::string _tmp_val;
     std::string _unescaped_val;
 };
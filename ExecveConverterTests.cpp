@@ -23,6 +23,7 @@
 #include "ExecveConverter.h"
 #include "TestEventQueue.h"
 
+#include <chrono>
 #include <fstream>
 #include <stdexcept>
 #include <iostream>
@@ -168,6 +169,14 @@ std::vector<TestData> test_data = {
                 },
                 R"cmdline(arg1 arg2 <2...2> arg4)cmdline"
         },
+        {
+                "out-of-order",
+                {
+                        R"event(type=EXECVE msg=audit(1.001:8): a2_len=5 a2[0]=3031 a2[1]=323334 a3="arg4")event",
+                        R"event(type=EXECVE msg=audit(1.001:8): argc=4 a0="arg1" a1=(null))event",
+                },
+                R"cmdline(arg1 "(null)" 01234 arg4)cmdline"
+        },
 };
 
 BOOST_AUTO_TEST_CASE( basic_test ) {
@@ -203,3 +212,117 @@ BOOST_AUTO_TEST_CASE( basic_test ) {
         BOOST_REQUIRE_MESSAGE(test_data[idx].cmdline == actual_cmdlines[idx], "Test [" << test_data[idx].test_name << "] failed: \nExpected: " << test_data[idx].cmdline << "\nGot: " << actual_cmdlines[idx]);
     }
 }
+
+static void add_raw_records(RawEventAccumulator& accumulator, const std::vector<std::string>& lines) {
+    for (auto& line: lines) {
+        std::unique_ptr<RawEventRecord> record = std::make_unique<RawEventRecord>();
+        std::memcpy(record->Data(), line.data(), line.size());
+        BOOST_REQUIRE(record->Parse(RecordType::UNKNOWN, line.size()));
+        accumulator.AddRecord(std::move(record));
+    }
+    accumulator.Flush(0);
+}
+
+static std::string to_hex(const std::string& str) {
+    std::string hex;
+    for (auto c : str) {
+        hex.push_back("0123456789ABCDEF"[static_cast<uint8_t>(c) >> 4]);
+        hex.push_back("0123456789ABCDEF"[c & 0xF]);
+    }
+    return hex;
+}
+
+BOOST_AUTO_TEST_CASE( convert_benchmark ) {
+    constexpr size_t total_bytes = 64*1024*1024;
+
+    auto queue = new TestEventQueue();
+    auto allocator = std::shared_ptr<IEventBuilderAllocator>(queue);
+    auto builder = std::make_shared<EventBuilder>(allocator);
+
+    auto metrics_queue = new TestEventQueue();
+    auto metrics_allocator = std::shared_ptr<IEventBuilderAllocator>(metrics_queue);
+    auto metrics_builder = std::make_shared<EventBuilder>(metrics_allocator);
+    auto metrics = std::make_shared<Metrics>(metrics_builder);
+
+    RawEventAccumulator accumulator(builder, metrics);
+
+    std::vector<const char*> names;
+
+    // A short command line
+    names.emplace_back("short");
+    add_raw_records(accumulator, {
+            R"event(type=EXECVE msg=audit(1.001:1): argc=3 a0="ls" a1="-l" a2="/tmp")event",
+    });
+
+    // Many args, some of them hex encoded (they have spaces or non-ASCII chars), spread over several records
+    names.emplace_back("many-args");
+    {
+        std::vector<std::string> lines;
+        std::string line = "type=EXECVE msg=audit(1.001:2): argc=200";
+        for (int i = 0; i < 200; ++i) {
+            std::string arg = "--option" + std::to_string(i) + "=/var/lib/app/data" + std::to_string(i);
+            std::string field = " a" + std::to_string(i) + "=";
+            if (i % 4 == 0) {
+                field += to_hex(arg + " with space");
+            } else {
+                field += "\"" + arg + "\"";
+            }
+            if (line.size() + field.size() > 8000) {
+                lines.emplace_back(line);
+                line = "type=EXECVE msg=audit(1.001:2):";
+            }
+            line += field;
+        }
+        lines.emplace_back(line);
+        add_raw_records(accumulator, lines);
+    }
+
+    // One large arg split into parts (a1_len, a1[N]), spread over several records
+    names.emplace_back("split-arg");
+    {
+        std::string arg;
+        while (arg.size() < 32*1024) {
+            arg += "import sys; print(sys.argv) # \t";
+        }
+        auto hex = to_hex(arg);
+        std::vector<std::string> lines;
+        lines.emplace_back("type=EXECVE msg=audit(1.001:3): argc=3 a0=\"python3\" a1_len=" + std::to_string(hex.size()));
+        for (size_t i = 0; i*7000 < hex.size(); ++i) {
+            lines.emplace_back("type=EXECVE msg=audit(1.001:3): a1[" + std::to_string(i) + "]=" + hex.substr(i*7000, 7000));
+        }
+        lines.emplace_back("type=EXECVE msg=audit(1.001:3): a2=\"-u\"");
+        add_raw_records(accumulator, lines);
+    }
+
+    BOOST_REQUIRE_EQUAL(queue->GetEventCount(), names.size());
+
+    ExecveConverter converter;
+    std::string cmdline;
+    for (size_t idx = 0; idx < queue->GetEventCount(); ++idx) {
+        auto event = queue->GetEvent(idx);
+        std::vector<EventRecord> recs;
+        size_t raw_size = 0;
+        for (auto rec : event) {
+            if (rec.RecordType() == static_cast<uint32_t>(RecordType::EXECVE)) {
+                recs.emplace_back(rec);
+                raw_size += rec.RecordTextSize();
+            }
+        }
+
+        converter.Convert(recs, cmdline);
+        BOOST_REQUIRE(!cmdline.empty());
+        BOOST_REQUIRE(cmdline.find("<...>") == std::string::npos);
+
+        size_t loops = std::max<size_t>(total_bytes / raw_size, 1);
+        size_t checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < loops; ++i) {
+            converter.Convert(recs, cmdline);
+            checksum += cmdline.size();
+        }
+        auto usecs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+        BOOST_TEST_MESSAGE("Convert " << names[idx] << " (" << recs.size() << " records, " << raw_size << " bytes): "
+            << (usecs*1000.0)/loops << " nsec/event, " << (usecs > 0 ? (loops*raw_size)/usecs : 0) << " MB/s (" << checksum << ")");
+    }
+}
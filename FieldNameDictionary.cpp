@@ -0,0 +1,117 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "FieldNameDictionary.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+using namespace std::string_view_literals;
+
+// APPEND ONLY!
+const std::string_view FIELD_NAME_DICTIONARY[] = {
+        "auid"sv, "uid"sv, "euid"sv, "suid"sv, "fsuid"sv, "ouid"sv, "oauid"sv, "old-auid"sv, "iuid"sv, "id"sv,
+        "inode_uid"sv, "sauid"sv, "obj_uid"sv, "obj_gid"sv, "gid"sv, "egid"sv, "sgid"sv, "fsgid"sv, "ogid"sv, "igid"sv,
+        "inode_gid"sv, "new_gid"sv, "syscall"sv, "arch"sv, "exit"sv, "success"sv, "items"sv, "ppid"sv, "pid"sv,
+        "ses"sv, "tty"sv, "comm"sv, "exe"sv, "key"sv, "subj"sv, "a0"sv, "a1"sv, "a2"sv, "a3"sv, "argc"sv, "a4"sv, "a5"sv,
+        "a6"sv, "a7"sv, "a8"sv, "a9"sv, "item"sv, "name"sv, "inode"sv, "dev"sv, "mode"sv, "rdev"sv, "nametype"sv,
+        "cap_fp"sv, "cap_fi"sv, "cap_fe"sv, "cap_fver"sv, "cap_frootid"sv, "path"sv, "file"sv, "watch"sv, "cwd"sv,
+        "cmd"sv, "acct"sv, "dir"sv, "vm"sv, "old-chardev"sv, "new-chardev"sv, "old-disk"sv, "new-disk"sv, "old-fs"sv,
+        "new-fs"sv, "old-net"sv, "new-net"sv, "device"sv, "cgroup"sv, "perm"sv, "perm_mask"sv, "saddr"sv, "prom"sv,
+        "old_prom"sv, "capability"sv, "res"sv, "result"sv, "sig"sv, "list"sv, "data"sv, "old-ses"sv, "cap_pi"sv,
+        "cap_pe"sv, "cap_pp"sv, "fp"sv, "fi"sv, "fe"sv, "old_pp"sv, "old_pi"sv, "old_pe"sv, "new_pp"sv, "new_pi"sv,
+        "new_pe"sv, "family"sv, "icmptype"sv, "proto"sv, "addr"sv, "apparmor"sv, "operation"sv, "denied_mask"sv,
+        "info"sv, "profile"sv, "requested_mask"sv, "per"sv, "code"sv, "old-rng"sv, "new-rng"sv, "oflag"sv, "ocomm"sv,
+        "flags"sv, "sigev_signo"sv, "obj"sv, "scontext"sv, "tcontext"sv, "vm-ctx"sv, "img-ctx"sv, "proctitle"sv,
+        "grp"sv, "new_group"sv, "hook"sv, "action"sv, "macproto"sv, "invalid_context"sv, "ioctlcmd"sv, "op"sv,
+        "hostname"sv, "terminal"sv, "msg"sv, "fd0"sv, "fd1"sv, "ver"sv, "format"sv, "kernel"sv, "old"sv,
+        "audit_enabled"sv, "audit_pid"sv, "audit_backlog_limit"sv, "audit_failure"sv, "nlnk-fam"sv,
+        "nlnk-grp"sv, "nlnk-pid"sv, "table"sv, "entries"sv, "ino"sv, "objtype"sv, "hash"sv, "node"sv,
+        "unparsed_text"sv, "cmdline"sv, "containerid"sv, "path_name"sv, "path_nametype"sv, "path_mode"sv,
+        "path_ouid"sv, "path_ogid"sv, "seq"sv, "errors"sv, "version"sv, "Namespace"sv, "Name"sv, "SamplePeriod"sv,
+        "StartTime"sv, "EndTime"sv, "NumSamples"sv, "Min"sv, "Max"sv, "Avg"sv
+};
+
+const std::string_view NUMERIC_FIELD_NAMES[] = {
+        "syscall"sv, "pid"sv, "ppid"sv, "exit"sv, "items"sv, "item"sv, "inode"sv, "argc"sv, "ses"sv, "old-ses"sv,
+        "auid"sv, "uid"sv, "euid"sv, "suid"sv, "fsuid"sv, "ouid"sv, "oauid"sv, "old-auid"sv, "iuid"sv, "sauid"sv,
+        "obj_uid"sv, "inode_uid"sv, "gid"sv, "egid"sv, "sgid"sv, "fsgid"sv, "ogid"sv, "igid"sv, "obj_gid"sv,
+        "inode_gid"sv, "new_gid"sv
+};
+
+const uint16_t FIELD_NAME_DICTIONARY_SIZE = static_cast<uint16_t>(sizeof(FIELD_NAME_DICTIONARY)/sizeof(FIELD_NAME_DICTIONARY[0]));
+
+static_assert(sizeof(FIELD_NAME_DICTIONARY)/sizeof(FIELD_NAME_DICTIONARY[0]) < FIELD_NAME_ID_UNKNOWN, "Too many entries in field name dictionary");
+
+namespace {
+
+class FieldNameDictionary {
+public:
+    FieldNameDictionary(): _ids(FIELD_NAME_DICTIONARY_SIZE), _ranks(FIELD_NAME_DICTIONARY_SIZE), _numeric(FIELD_NAME_DICTIONARY_SIZE, false) {
+        std::vector<uint16_t> sorted(FIELD_NAME_DICTIONARY_SIZE);
+        for (uint16_t id = 0; id < FIELD_NAME_DICTIONARY_SIZE; ++id) {
+            _ids.emplace(FIELD_NAME_DICTIONARY[id], id);
+            sorted[id] = id;
+        }
+        std::sort(sorted.begin(), sorted.end(), [](uint16_t a, uint16_t b) {
+            return FIELD_NAME_DICTIONARY[a] < FIELD_NAME_DICTIONARY[b];
+        });
+        for (uint16_t rank = 0; rank < FIELD_NAME_DICTIONARY_SIZE; ++rank) {
+            _ranks[sorted[rank]] = rank;
+        }
+        for (auto& name : NUMERIC_FIELD_NAMES) {
+            _numeric[_ids.at(name)] = true;
+        }
+    }
+
+    inline uint16_t ToId(const std::string_view& name) const {
+        auto itr = _ids.find(name);
+        if (itr != _ids.end()) {
+            return itr->second;
+        }
+        return FIELD_NAME_ID_UNKNOWN;
+    }
+
+    inline uint16_t ToRank(uint16_t id) const {
+        return _ranks[id];
+    }
+
+    inline bool IsNumeric(uint16_t id) const {
+        return id < _numeric.size() && _numeric[id];
+    }
+
+private:
+    std::unordered_map<std::string_view, uint16_t> _ids;
+    std::vector<uint16_t> _ranks;
+    std::vector<bool> _numeric;
+};
+
+const FieldNameDictionary s_dictionary;
+
+}
+
+uint16_t FieldNameToDictionaryId(const std::string_view& name) {
+    return s_dictionary.ToId(name);
+}
+
+uint16_t FieldIdToRank(uint16_t id) {
+    return s_dictionary.ToRank(id);
+}
+
+bool FieldIdIsNumeric(uint16_t id) {
+    return s_dictionary.IsNumeric(id);
+}
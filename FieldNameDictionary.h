@@ -0,0 +1,54 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef AUOMS_FIELD_NAME_DICTIONARY_H
+#define AUOMS_FIELD_NAME_DICTIONARY_H
+
+#include <cstdint>
+#include <string_view>
+
+/*
+ * Dictionary of well known field names used by the v2 event format (see Event.cpp).
+ *
+ * The ids are stored in events (queue files, and the collector to auoms stream)
+ * so existing entries must never be removed or reordered. New names may only be appended.
+ */
+
+constexpr uint16_t FIELD_NAME_ID_UNKNOWN = 0xFFFF;
+
+extern const std::string_view FIELD_NAME_DICTIONARY[];
+extern const uint16_t FIELD_NAME_DICTIONARY_SIZE;
+
+// Returns FIELD_NAME_ID_UNKNOWN if the name is not in the dictionary
+uint16_t FieldNameToDictionaryId(const std::string_view& name);
+
+// Returns an empty string_view if the id is not in the dictionary.
+// The returned value is always null terminated.
+inline std::string_view FieldIdToName(uint16_t id) {
+    if (id < FIELD_NAME_DICTIONARY_SIZE) {
+        return FIELD_NAME_DICTIONARY[id];
+    }
+    return std::string_view();
+}
+
+// The position of the name in the (byte wise) sorted list of dictionary names.
+// For two ids, comparing ranks gives the same result as comparing the names.
+uint16_t FieldIdToRank(uint16_t id);
+
+// True if the field's raw value is normally a base 10 integer (e.g. pid, uid, syscall)
+bool FieldIdIsNumeric(uint16_t id);
+
+#endif //AUOMS_FIELD_NAME_DICTIONARY_H
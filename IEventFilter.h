@@ -18,10 +18,19 @@
 #define AUOMS_IEVENTFILTER_H
 
 #include "Event.h"
+#include "EventColumns.h"
 
 class IEventFilter {
 public:
     virtual bool IsEventFiltered(const Event& event) = 0;
+
+    // Set filtered[i] to 1 if the i'th event of the batch is filtered, 0 otherwise.
+    // filtered must have columns.Size() entries.
+    virtual void FilterEvents(const EventColumns& columns, std::vector<uint8_t>& filtered) {
+        for (size_t i = 0; i < columns.Size(); ++i) {
+            filtered[i] = static_cast<uint8_t>(IsEventFiltered(columns.EventAt(i)));
+        }
+    }
 };
 
 #endif //AUOMS_IEVENTFILTER_H
@@ -0,0 +1,321 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "IOUring.h"
+
+#include <cerrno>
+#include <cstring>
+#include <atomic>
+
+extern "C" {
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+}
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+#ifndef __NR_io_uring_register
+#define __NR_io_uring_register 427
+#endif
+
+// user_data value used for non-write operations (which are expected to return 0)
+#define NON_WRITE_OP_DATA 0xFFFFFFFFFFFFFFFFUL
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* p) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+// io_uring_setup is available since 5.1, but IORING_OP_WRITE was only added in 5.6 (along with
+// IORING_REGISTER_PROBE), so a kernel without the probe can't do the writes either.
+static bool have_required_ops(int fd) {
+    constexpr unsigned NUM_OPS = 256;
+    static const unsigned required_ops[] = {IORING_OP_WRITE, IORING_OP_FSYNC};
+
+    alignas(struct io_uring_probe) char buf[sizeof(struct io_uring_probe) + NUM_OPS*sizeof(struct io_uring_probe_op)];
+    memset(buf, 0, sizeof(buf));
+    auto probe = reinterpret_cast<struct io_uring_probe*>(buf);
+
+    if (sys_io_uring_register(fd, IORING_REGISTER_PROBE, probe, NUM_OPS) < 0) {
+        return false;
+    }
+
+    for (auto op : required_ops) {
+        if (op > probe->last_op || (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename T>
+static inline T load_acquire(T* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+template<typename T>
+static inline void store_release(T* ptr, T val) {
+    __atomic_store_n(ptr, val, __ATOMIC_RELEASE);
+}
+
+IOUring::IOUring(): _fd(-1), _sq_ptr(nullptr), _sq_size(0), _cq_ptr(nullptr), _cq_size(0), _sqes(nullptr), _sqes_size(0),
+    _sq_head(nullptr), _sq_tail(nullptr), _sq_mask(nullptr), _sq_array(nullptr), _sq_entries(0),
+    _cq_head(nullptr), _cq_tail(nullptr), _cq_mask(nullptr), _cqes(nullptr),
+    _queued(0), _inflight(0), _error(0), _last_sqe(nullptr)
+{}
+
+IOUring::~IOUring() {
+    Close();
+}
+
+bool IOUring::Open(unsigned entries) {
+    if (_fd >= 0) {
+        return true;
+    }
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int fd = sys_io_uring_setup(entries, &params);
+    if (fd < 0) {
+        return false;
+    }
+    if (!have_required_ops(fd)) {
+        close(fd);
+        return false;
+    }
+    _fd = fd;
+
+    _sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    _cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+        if (_cq_size > _sq_size) {
+            _sq_size = _cq_size;
+        }
+        _cq_size = 0;
+    }
+
+    _sq_ptr = mmap(nullptr, _sq_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+    if (_sq_ptr == MAP_FAILED) {
+        _sq_ptr = nullptr;
+        Close();
+        return false;
+    }
+
+    if (_cq_size > 0) {
+        _cq_ptr = mmap(nullptr, _cq_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+        if (_cq_ptr == MAP_FAILED) {
+            _cq_ptr = nullptr;
+            Close();
+            return false;
+        }
+    } else {
+        _cq_ptr = _sq_ptr;
+    }
+
+    _sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, _sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, _fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        Close();
+        return false;
+    }
+    _sqes = reinterpret_cast<io_uring_sqe*>(sqes);
+
+    auto sq = reinterpret_cast<char*>(_sq_ptr);
+    _sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    _sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    _sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    _sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    _sq_entries = params.sq_entries;
+
+    auto cq = reinterpret_cast<char*>(_cq_ptr);
+    _cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    _cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    _cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    _cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    _queued = 0;
+    _inflight = 0;
+    _error = 0;
+    _last_sqe = nullptr;
+
+    return true;
+}
+
+void IOUring::Close() {
+    if (_sqes != nullptr) {
+        munmap(_sqes, _sqes_size);
+        _sqes = nullptr;
+    }
+    if (_cq_ptr != nullptr && _cq_ptr != _sq_ptr) {
+        munmap(_cq_ptr, _cq_size);
+    }
+    _cq_ptr = nullptr;
+    if (_sq_ptr != nullptr) {
+        munmap(_sq_ptr, _sq_size);
+        _sq_ptr = nullptr;
+    }
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+}
+
+io_uring_sqe* IOUring::get_sqe() {
+    if (_queued + _inflight >= _sq_entries) {
+        auto ret = Flush();
+        if (ret != 0) {
+            _error = ret;
+        }
+    }
+
+    unsigned tail = *_sq_tail;
+    unsigned idx = tail & *_sq_mask;
+    auto sqe = &_sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    _sq_array[idx] = idx;
+    store_release(_sq_tail, tail+1);
+    _queued++;
+
+    // Link to the previously queued op so that they execute in order
+    if (_last_sqe != nullptr) {
+        _last_sqe->flags |= IOSQE_IO_LINK;
+    }
+    _last_sqe = sqe;
+
+    return sqe;
+}
+
+int IOUring::Write(int fd, const void* ptr, size_t size, off_t offset) {
+    if (_fd < 0) {
+        return -EBADF;
+    }
+
+    auto data = reinterpret_cast<const char*>(ptr);
+    while (size > 0) {
+        size_t len = size > MAX_WRITE_SIZE ? MAX_WRITE_SIZE : size;
+        auto sqe = get_sqe();
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(data);
+        sqe->len = static_cast<uint32_t>(len);
+        sqe->off = static_cast<uint64_t>(offset);
+        sqe->user_data = len;
+        data += len;
+        offset += len;
+        size -= len;
+    }
+    return 0;
+}
+
+int IOUring::Fdatasync(int fd) {
+    if (_fd < 0) {
+        return -EBADF;
+    }
+
+    auto sqe = get_sqe();
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = fd;
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    sqe->user_data = NON_WRITE_OP_DATA;
+    return 0;
+}
+
+int IOUring::Flush() {
+    if (_fd < 0) {
+        return -EBADF;
+    }
+
+    // The last op ends the chain
+    if (_last_sqe != nullptr) {
+        _last_sqe->flags &= ~IOSQE_IO_LINK;
+        _last_sqe = nullptr;
+    }
+
+    while (_queued > 0) {
+        auto ret = sys_io_uring_enter(_fd, _queued, 0, 0);
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            // Nothing more can be submitted, drop the queued ops by rewinding the tail
+            store_release(_sq_tail, *_sq_tail - _queued);
+            _queued = 0;
+            if (_error == 0) {
+                _error = -errno;
+            }
+            break;
+        }
+        _queued -= ret;
+        _inflight += ret;
+    }
+
+    auto ret = reap(_inflight);
+    if (ret != 0 && _error == 0) {
+        _error = ret;
+    }
+
+    ret = _error;
+    _error = 0;
+    return ret;
+}
+
+int IOUring::reap(unsigned min_complete) {
+    int error = 0;
+    while (_inflight > 0) {
+        unsigned head = *_cq_head;
+        unsigned tail = load_acquire(_cq_tail);
+        if (head == tail) {
+            if (min_complete == 0) {
+                break;
+            }
+            if (sys_io_uring_enter(_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR && errno != EAGAIN) {
+                return -errno;
+            }
+            continue;
+        }
+        while (head != tail) {
+            auto cqe = &_cqes[head & *_cq_mask];
+            if (error == 0) {
+                if (cqe->res < 0) {
+                    error = cqe->res;
+                } else if (cqe->user_data != NON_WRITE_OP_DATA && static_cast<uint64_t>(cqe->res) != cqe->user_data) {
+                    error = -EIO;
+                }
+            }
+            head++;
+            _inflight--;
+            if (min_complete > 0) {
+                min_complete--;
+            }
+        }
+        store_release(_cq_head, head);
+    }
+    return error;
+}
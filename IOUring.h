@@ -0,0 +1,91 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef AUOMS_IOURING_H
+#define AUOMS_IOURING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/*
+ * Minimal io_uring wrapper (using the raw syscalls, liburing is not required) for submitting ordered
+ * file writes and fdatasync.
+ *
+ * All operations queued between calls to Flush() are linked (IOSQE_IO_LINK) so they execute in the order
+ * they were queued, and a failed operation cancels the ones after it.
+ */
+class IOUring {
+public:
+    static constexpr unsigned DEFAULT_ENTRIES = 32;
+    static constexpr size_t MAX_WRITE_SIZE = 256*1024*1024;
+
+    IOUring();
+    ~IOUring();
+
+    IOUring(const IOUring&) = delete;
+    IOUring& operator=(const IOUring&) = delete;
+
+    // Return false if io_uring is not available (old kernel, or disabled by seccomp or sysctl), or the
+    // kernel doesn't support the write and fsync ops (checked with IORING_REGISTER_PROBE).
+    bool Open(unsigned entries = DEFAULT_ENTRIES);
+    void Close();
+    inline bool IsOpen() const { return _fd >= 0; }
+
+    // Queue a write. If the submission queue is full, the queued operations are flushed first.
+    // Returns 0 on success or -errno.
+    int Write(int fd, const void* ptr, size_t size, off_t offset);
+
+    // Queue an fdatasync. Returns 0 on success or -errno.
+    int Fdatasync(int fd);
+
+    // Submit all queued operations and wait for them to complete.
+    // Returns 0 if all succeeded, otherwise -errno of the first failure (a short write is reported as -EIO).
+    int Flush();
+
+private:
+    io_uring_sqe* get_sqe();
+    int reap(unsigned min_complete);
+
+    int _fd;
+    void* _sq_ptr;
+    size_t _sq_size;
+    void* _cq_ptr;
+    size_t _cq_size;
+    io_uring_sqe* _sqes;
+    size_t _sqes_size;
+
+    unsigned* _sq_head;
+    unsigned* _sq_tail;
+    unsigned* _sq_mask;
+    unsigned* _sq_array;
+    unsigned _sq_entries;
+
+    unsigned* _cq_head;
+    unsigned* _cq_tail;
+    unsigned* _cq_mask;
+    io_uring_cqe* _cqes;
+
+    unsigned _queued;   // Queued, not yet submitted
+    unsigned _inflight; // Submitted, not yet reaped
+    int _error;
+    io_uring_sqe* _last_sqe;
+};
+
+#endif //AUOMS_IOURING_H
@@ -18,11 +18,161 @@
 #include "Event.h"
 #include "Logger.h"
 
+#include <algorithm>
+#include <cstring>
+
+void InputAckWriter::Add(uint64_t seq, const EventId& event_id) {
+    std::lock_guard<std::mutex> lock(_run_mutex);
+    _pending.emplace_back(seq, event_id);
+    _run_cond.notify_all();
+}
+
+void InputAckWriter::SetSenderAckMode(uint32_t ack_version, uint32_t window) {
+    std::lock_guard<std::mutex> lock(_run_mutex);
+    if (ack_version < ACK_PROTOCOL_V2 || _max_batch_count <= 1) {
+        return;
+    }
+    // Stay well below the sender's window, so that the sender never has to wait for the batch timeout
+    _batch_count = std::max(static_cast<size_t>(1), std::min(_max_batch_count, static_cast<size_t>(window/2)));
+    Logger::Info("Input(%d): Using v2 acks (batch size %ld, sender window %d)", _fd, _batch_count, window);
+}
+
+void InputAckWriter::OfferRing(std::shared_ptr<SharedRing> ring) {
+    std::lock_guard<std::mutex> lock(_run_mutex);
+    _ring_offer = std::move(ring);
+    _run_cond.notify_all();
+}
+
+bool InputAckWriter::send_ring_offer(std::shared_ptr<SharedRing> ring) {
+    std::array<uint8_t, ACK_SIZE> data;
+    EncodeAck(MakeAckRingOffer(), data.data());
+    auto fds = ring->Fds();
+    if (SharedRing::SendWithFds(_fd, data.data(), data.size(), fds.data(), fds.size()) != IO::OK) {
+        Logger::Info("Input(%d): Ring offer write failed", _fd);
+        return false;
+    }
+    // The sender reads the offer before any ack published in the ring
+    _ring = std::move(ring);
+    Logger::Info("Input(%d): Offered shared memory ring", _fd);
+    return true;
+}
+
+bool InputAckWriter::write_ack(const EventId& event_id) {
+    if (_ring) {
+        _ring->Ack(event_id);
+        return true;
+    }
+    auto ret = _reader.WriteAck(event_id, _conn);
+    if (ret != IO::OK) {
+        switch (ret) {
+            case IO::CLOSED:
+                Logger::Info("Input(%d): Ack write failed due to closed connection", _fd);
+                break;
+            case IO::INTERRUPTED:
+                Logger::Info("Input(%d): Ack write interrupted", _fd);
+                break;
+            default:
+                Logger::Info("Input(%d): Ack write failed", _fd);
+                break;
+        }
+        // The connection is broken, so the Input's next read will fail too.
+        return false;
+    }
+    return true;
+}
+
+void InputAckWriter::run() {
+    if (_max_batch_count > 1 && !write_ack(MakeAckHello(ACK_PROTOCOL_V2, _hello_features))) {
+        return;
+    }
+
+    // The number of handled events not yet acked, and the last of them
+    size_t unacked = 0;
+    EventId last_id;
+    std::chrono::steady_clock::time_point deadline;
+
+    std::unique_lock<std::mutex> lock(_run_mutex);
+    while (true) {
+        if (_ring_offer) {
+            auto ring = std::move(_ring_offer);
+            _ring_offer.reset();
+            lock.unlock();
+            if (!send_ring_offer(ring)) {
+                return;
+            }
+            lock.lock();
+            continue;
+        }
+        if (_pending.empty()) {
+            if (unacked == 0) {
+                _run_cond.wait(lock, [this]() { return _stop || !_pending.empty() || _ring_offer; });
+                if (_pending.empty() && !_ring_offer) {
+                    // Stopped, and all acks have been written
+                    return;
+                }
+                continue;
+            }
+            _run_cond.wait_until(lock, deadline, [this]() { return _stop || !_pending.empty() || _ring_offer; });
+            if (_pending.empty() && !_ring_offer) {
+                // Batch timeout, or stopping
+                lock.unlock();
+                if (!write_ack(last_id)) {
+                    return;
+                }
+                unacked = 0;
+                lock.lock();
+            }
+            continue;
+        }
+
+        auto ack = _pending.front();
+        auto batch_count = _batch_count;
+        lock.unlock();
+
+        int ret;
+        if (unacked == 0) {
+            ret = _buffer->WaitHandled(ack.first) ? 1 : -1;
+        } else {
+            ret = _buffer->WaitHandledUntil(ack.first, deadline);
+        }
+        if (ret < 0) {
+            // The buffer was closed, the remaining events will not be handled
+            return;
+        }
+
+        if (ret == 0) {
+            // Batch timeout
+            if (!write_ack(last_id)) {
+                return;
+            }
+            unacked = 0;
+        } else {
+            if (unacked == 0) {
+                deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(_batch_usecs);
+            }
+            last_id = ack.second;
+            unacked++;
+            if (unacked >= batch_count) {
+                if (!write_ack(last_id)) {
+                    return;
+                }
+                unacked = 0;
+            }
+        }
+
+        lock.lock();
+        if (ret > 0) {
+            _pending.pop_front();
+        }
+    }
+}
+
 void Input::on_stopping() {
     _conn->Close();
 }
 
 void Input::on_stop() {
+    _ack_writer.Stop();
     _stop_fn();
     Logger::Info("Input(%d): Stopped", _fd);
 }
@@ -30,67 +180,135 @@ void Input::on_stop() {
 void Input::run() {
     Logger::Info("Input(%d): Started", _fd);
 
+    _ack_writer.Start();
+
     while (!IsStopping()) {
         void* ptr = nullptr;
-        if (!_buffer->BeginWrite(&ptr)) {
+        int slot = _buffer->BeginWrite(&ptr);
+        if (slot < 0) {
             Logger::Info("Input(%d): Stopping", _fd);
             on_stopping();
             return;
         }
 
-        auto ret = _reader.ReadEvent(ptr, _buffer->MAX_DATA_SIZE, _conn.get(), [this]() { return IsStopping(); });
+        auto ret = _reader.ReadEvent(ptr, _buffer->MAX_DATA_SIZE, &_in, [this]() { return IsStopping(); });
         if (ret <= 0) {
-            switch (ret) {
-                case IO::FAILED:
-                    Logger::Info("Input(%d): Stopping due to failed event read", _fd);
-                    break;
-                case IO::CLOSED:
-                    Logger::Info("Input(%d): Stopping due to closed connection", _fd);
-                    break;
-                case IO::INTERRUPTED:
-                    Logger::Info("Input(%d): Stopping due to interrupted event read", _fd);
-                    break;
-                default:
-                    Logger::Info("Input(%d): Stopping due to failed event read", _fd);
-                    break;
+            _buffer->AbandonWrite(slot);
+            stop_reading(ret);
+            return;
+        }
+
+        if (IsAckControl(ptr, ret)) {
+            uint32_t ack_version;
+            uint32_t window;
+            ParseAckControl(ptr, &ack_version, &window);
+            auto flags = GetAckControlFlags(ptr);
+            _buffer->AbandonWrite(slot);
+            if ((flags & ACK_CONTROL_FLAG_RING_SWITCH) != 0) {
+                if (!_ring) {
+                    Logger::Info("Input(%d): Stopping due to ring switch without a ring", _fd);
+                    stop_reading(IO::FAILED);
+                    return;
+                }
+                run_ring();
+                return;
+            }
+            _ack_writer.SetSenderAckMode(ack_version, window);
+            if ((flags & ACK_CONTROL_FLAG_RING_REQUEST) != 0 && _ring_size > 0 && !_ring) {
+                _ring = SharedRing::Create(_ring_size);
+                if (_ring) {
+                    _ack_writer.OfferRing(_ring);
+                } else {
+                    Logger::Warn("Input(%d): Failed to create shared memory ring, using the socket", _fd);
+                }
             }
-            _buffer->AbandonWrite();
-            // For CLOSED and INTERRUPTED just stop.
-            // INTERRUPTED should only be returned if IsStopping() is true
+            continue;
+        }
+
+        Event event(ptr, ret);
+        EventId event_id(event.Seconds(), event.Milliseconds(), event.Serial());
+
+        uint64_t seq;
+        if (!_buffer->CommitWrite(slot, ret, &seq)) {
+            Logger::Info("Input(%d): Stopping", _fd);
             on_stopping();
             return;
         }
+        _ack_writer.Add(seq, event_id);
+    }
+
+    Logger::Info("Input(%d): Stopping", _fd);
+}
 
-        if (_buffer->CommitWrite(ret)) {
-            Event event(ptr, ret);
+void Input::run_ring() {
+    Logger::Info("Input(%d): Reading events from shared memory ring", _fd);
 
-            ret = _reader.WriteAck(event, _conn.get());
+    while (!IsStopping()) {
+        const void* data = nullptr;
+        auto size = _ring->Peek(&data);
+        if (size == 0) {
+            auto ret = _ring->WaitData(_fd, [this]() { return IsStopping(); });
             if (ret != IO::OK) {
-                switch (ret) {
-                    case IO::FAILED:
-                        Logger::Info("Input(%d): Stopping due to failed ack write", _fd);
-                        break;
-                    case IO::CLOSED:
-                        Logger::Info("Input(%d): Stopping due to closed connection", _fd);
-                        break;
-                    case IO::INTERRUPTED:
-                        Logger::Info("Input(%d): Stopping due to interrupted ack write", _fd);
-                        break;
-                    default:
-                        Logger::Info("Input(%d): Stopping due to failed ack write", _fd);
-                        break;
-                }
-                // For CLOSED and INTERRUPTED just stop.
-                // INTERRUPTED should only be returned is IsStopping() is true
-                on_stopping();
+                stop_reading(ret);
                 return;
             }
-        } else {
+            continue;
+        }
+
+        uint32_t hdr = 0;
+        if (size >= static_cast<ssize_t>(sizeof(hdr))) {
+            memcpy(&hdr, data, sizeof(hdr));
+        }
+        if (size < static_cast<ssize_t>(sizeof(hdr)) || static_cast<size_t>(size) > _buffer->MAX_DATA_SIZE ||
+            (hdr & 0x00FFFFFF) != static_cast<uint32_t>(size) || !Event::IsSupportedVersion(hdr >> 24)) {
+            Logger::Info("Input(%d): Stopping due to invalid event in shared memory ring", _fd);
+            stop_reading(IO::FAILED);
+            return;
+        }
+
+        void* ptr = nullptr;
+        int slot = _buffer->BeginWrite(&ptr);
+        if (slot < 0) {
+            Logger::Info("Input(%d): Stopping", _fd);
+            on_stopping();
+            return;
+        }
+        memcpy(ptr, data, size);
+        _ring->Consume();
+
+        Event event(ptr, size);
+        EventId event_id(event.Seconds(), event.Milliseconds(), event.Serial());
+
+        uint64_t seq;
+        if (!_buffer->CommitWrite(slot, size, &seq)) {
             Logger::Info("Input(%d): Stopping", _fd);
             on_stopping();
             return;
         }
+        _ack_writer.Add(seq, event_id);
     }
 
     Logger::Info("Input(%d): Stopping", _fd);
 }
+
+void Input::stop_reading(ssize_t ret) {
+    switch (ret) {
+        case IO::FAILED:
+            Logger::Info("Input(%d): Stopping due to failed event read", _fd);
+            break;
+        case IO::CLOSED:
+            Logger::Info("Input(%d): Stopping due to closed connection", _fd);
+            break;
+        case IO::INTERRUPTED:
+            Logger::Info("Input(%d): Stopping due to interrupted event read", _fd);
+            break;
+        default:
+            Logger::Info("Input(%d): Stopping due to failed event read", _fd);
+            break;
+    }
+    // Send the acks for the events already read before closing the connection.
+    _ack_writer.Stop();
+    // For CLOSED and INTERRUPTED just stop.
+    // INTERRUPTED should only be returned if IsStopping() is true
+    on_stopping();
+}
@@ -21,11 +21,70 @@
 #include "IO.h"
 #include "InputBuffer.h"
 #include "RawEventReader.h"
+#include "EventId.h"
+#include "SharedRing.h"
+
+#include <deque>
+
+/*
+ * Writes the acks for the events read by an Input.
+ *
+ * An event is acked only after it has been handled (taken out of the InputBuffer and processed),
+ * so that the Input can keep reading while earlier events are being processed.
+ * Acks are written in the order the events were read.
+ *
+ * If max_batch_count > 1, the v2 ack protocol (see AckProtocol.h) is offered to the sender. Once the sender
+ * accepts it, only the last handled event is acked, every batch_count events or batch_usecs microseconds.
+ * If hello_features includes ACK_FEATURE_SHARED_RING, the sender may request a SharedRing, once offered, acks are
+ * published in the ring instead of written to the connection.
+ */
+class InputAckWriter: public RunBase {
+public:
+    static constexpr size_t DEFAULT_ACK_BATCH_COUNT = 32;
+    static constexpr long DEFAULT_ACK_BATCH_USECS = 1000;
+
+    InputAckWriter(IOBase* conn, int fd, std::shared_ptr<InputBuffer> buffer, size_t max_batch_count, long batch_usecs, uint32_t hello_features = 0):
+        _conn(conn), _fd(fd), _buffer(std::move(buffer)), _max_batch_count(max_batch_count), _batch_usecs(batch_usecs),
+        _hello_features(hello_features), _batch_count(1) {}
+
+    // Queue the ack for the event committed to the buffer with sequence number seq
+    void Add(uint64_t seq, const EventId& event_id);
+
+    // Called when the sender's ack control frame is received
+    void SetSenderAckMode(uint32_t ack_version, uint32_t window);
+
+    // Send the ring offer (with the ring fds) to the sender, and publish all following acks in the ring
+    void OfferRing(std::shared_ptr<SharedRing> ring);
+
+protected:
+    void run() override;
+
+private:
+    bool write_ack(const EventId& event_id);
+    bool send_ring_offer(std::shared_ptr<SharedRing> ring);
+
+    IOBase* _conn;
+    int _fd;
+    std::shared_ptr<InputBuffer> _buffer;
+    RawEventReader _reader;
+    size_t _max_batch_count;
+    long _batch_usecs;
+    uint32_t _hello_features;
+    size_t _batch_count;
+    std::deque<std::pair<uint64_t, EventId>> _pending;
+    std::shared_ptr<SharedRing> _ring_offer;
+    std::shared_ptr<SharedRing> _ring;
+};
 
 class Input: public RunBase {
 public:
-    Input(std::unique_ptr<IOBase> conn, std::shared_ptr<InputBuffer> buffer, std::function<void()>&& stop_fn)
-    : _conn(std::move(conn)), _fd(_conn->GetFd()), _buffer(std::move(buffer)), _stop_fn(std::move(stop_fn)) {}
+    // If ring_size > 0 (and ack batching is enabled), a SharedRing of ring_size bytes is offered to the sender.
+    Input(std::unique_ptr<IOBase> conn, std::shared_ptr<InputBuffer> buffer, std::function<void()>&& stop_fn,
+          size_t ack_batch_count = InputAckWriter::DEFAULT_ACK_BATCH_COUNT, long ack_batch_usecs = InputAckWriter::DEFAULT_ACK_BATCH_USECS,
+          size_t ring_size = 0)
+    : _conn(std::move(conn)), _fd(_conn->GetFd()), _in(_conn.get()), _buffer(std::move(buffer)), _stop_fn(std::move(stop_fn)),
+      _ring_size(ack_batch_count > 1 ? ring_size : 0),
+      _ack_writer(_conn.get(), _fd, _buffer, ack_batch_count, ack_batch_usecs, _ring_size > 0 ? ACK_FEATURE_SHARED_RING : 0) {}
 
 protected:
     void on_stopping() override;
@@ -33,11 +92,20 @@ protected:
     void run() override;
 
 private:
+    // Read events from the ring once the sender has switched to it
+    void run_ring();
+    void stop_reading(ssize_t ret);
+
     std::unique_ptr<IOBase> _conn;
     int _fd;
+    // Reads ahead, so that most events are read without a syscall
+    BufferedReader _in;
     RawEventReader _reader;
     std::shared_ptr<InputBuffer> _buffer;
     std::function<void()> _stop_fn;
+    size_t _ring_size;
+    std::shared_ptr<SharedRing> _ring;
+    InputAckWriter _ack_writer;
 };
 
 
@@ -17,73 +17,229 @@
 #ifndef AUOMS_INPUTBUFFER_H
 #define AUOMS_INPUTBUFFER_H
 
-#include <array>
-#include <mutex>
+#include "LargeBuffer.h"
+#include "Metrics.h"
+
+#include <algorithm>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
 
+/*
+ * A multi-slot ring used to hand events from the Input (connection) threads to the processing thread.
+ *
+ * Each slot holds one event of up to MAX_DATA_SIZE bytes. Any number of producers may hold a slot at a time.
+ * CommitWrite does not wait for the data to be handled, so a producer can read its next event while
+ * earlier ones are being processed. Committed data is handled in commit order, and each commit is assigned
+ * a sequence number that can be passed to WaitHandled to find out when it has been handled (e.g. to ack it).
+ *
+ * HandleData handles all the data committed since the last call in one handoff.
+ */
 class InputBuffer {
 public:
     static constexpr size_t MAX_DATA_SIZE = 256*1024;
+    static constexpr size_t DEFAULT_NUM_SLOTS = 16;
+    static constexpr size_t MAX_NUM_SLOTS = 1024;
+
+    explicit InputBuffer(size_t num_slots = DEFAULT_NUM_SLOTS):
+        _num_slots(std::min(std::max(num_slots, static_cast<size_t>(1)), MAX_NUM_SLOTS)), _data(_num_slots*MAX_DATA_SIZE),
+        _sizes(_num_slots, 0), _next_seq(0), _handled_seq(0), _close(false), _next_listener_id(0)
+    {
+        for (size_t i = 0; i < _num_slots; ++i) {
+            _free.push_back(static_cast<int>(i));
+        }
+        _handling.reserve(_num_slots);
+    }
+
+    inline size_t NumSlots() const { return _num_slots; }
+
+    // Both metrics are optional.
+    // occupancy is set to the percentage of slots in use each time data is handed off.
+    // full is incremented each time a producer has to wait for a free slot.
+    void SetMetrics(const std::shared_ptr<Metric>& occupancy, const std::shared_ptr<Metric>& full) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _occupancy_metric = occupancy;
+        _full_metric = full;
+    }
+
+    // Called (without any InputBuffer lock held) each time data has been handled, and when the buffer is closed.
+    // The listener must not call back into the InputBuffer.
+    // Returns an id to pass to RemoveHandledListener.
+    int AddHandledListener(std::function<void()> fn) {
+        std::lock_guard<std::mutex> lock(_listener_mutex);
+        auto id = _next_listener_id++;
+        _listeners.emplace_back(id, std::move(fn));
+        return id;
+    }
+
+    void RemoveHandledListener(int id) {
+        std::lock_guard<std::mutex> lock(_listener_mutex);
+        _listeners.erase(std::remove_if(_listeners.begin(), _listeners.end(), [id](const std::pair<int, std::function<void()>>& l) { return l.first == id; }), _listeners.end());
+    }
 
-    InputBuffer(): _data(std::make_unique<std::array<char,MAX_DATA_SIZE>>()), _data_size(0), _has_writer(false), _close(false) {}
+    // Like BeginWrite(), but returns -1 immediately if there are no free slots.
+    int TryBeginWrite(void** data_ptr) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_close || _free.empty()) {
+            if (!_close && _full_metric) {
+                _full_metric->Add(1.0);
+            }
+            *data_ptr = nullptr;
+            return -1;
+        }
+        int slot = _free.front();
+        _free.pop_front();
+        *data_ptr = slot_ptr(slot);
+        return slot;
+    }
+
+    bool IsClosed() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _close;
+    }
 
-    bool BeginWrite(void** data_ptr) {
+    // The number of items handled so far. The item with sequence number seq has been handled if seq < HandledSeq().
+    uint64_t HandledSeq() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _handled_seq;
+    }
+
+    // Wait for a free slot.
+    // Returns the slot index, or -1 if the buffer was closed.
+    int BeginWrite(void** data_ptr) {
         std::unique_lock<std::mutex> lock(_mutex);
-        // Wait until there is no writer and buffer is empty
-        _cond.wait(lock, [this]() { return _close || (!_has_writer && _data_size == 0); });
+        if (!_close && _free.empty() && _full_metric) {
+            _full_metric->Add(1.0);
+        }
+        _cond.wait(lock, [this]() { return _close || !_free.empty(); });
         if (_close) {
             *data_ptr = nullptr;
-            return false;
+            return -1;
         }
-        *data_ptr = _data->data();
-        return true;
+        int slot = _free.front();
+        _free.pop_front();
+        *data_ptr = slot_ptr(slot);
+        return slot;
     }
 
-    bool CommitWrite(size_t size) {
+    // Make the data in slot available to the reader.
+    // seq is set to the sequence number assigned to the data.
+    // Returns false if the buffer was closed (the data will not be handled).
+    bool CommitWrite(int slot, size_t size, uint64_t* seq) {
         std::unique_lock<std::mutex> lock(_mutex);
-        _has_writer = false;
-        _data_size = size;
-        _cond.notify_all();
-        // Wait until reader has handled data in buffer
-        _cond.wait(lock, [this]() { return _close || _data_size == 0; });
         if (_close) {
             return false;
         }
+        _sizes[slot] = size;
+        _ready.push_back(slot);
+        *seq = _next_seq++;
+        _cond.notify_all();
         return true;
     }
 
-    void AbandonWrite() {
+    void AbandonWrite(int slot) {
         std::unique_lock<std::mutex> lock(_mutex);
-        _has_writer = false;
-        _data_size = 0;
+        _free.push_back(slot);
         _cond.notify_all();
     }
 
-    bool HandleData(const std::function<void(void*,size_t)>& fn) {
+    // Wait until the data with sequence number seq has been handled.
+    // Returns false if the buffer was closed before the data was handled.
+    bool WaitHandled(uint64_t seq) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cond.wait(lock, [this,seq]() { return _close || _handled_seq > seq; });
+        return _handled_seq > seq;
+    }
+
+    // Like WaitHandled(), but gives up at deadline.
+    // Returns 1 if the data was handled, 0 on timeout, -1 if the buffer was closed before the data was handled.
+    int WaitHandledUntil(uint64_t seq, std::chrono::steady_clock::time_point deadline) {
         std::unique_lock<std::mutex> lock(_mutex);
-        _cond.wait(lock, [this]() { return _close || _data_size != 0; });
-        if (_data_size > 0) {
-            fn(_data->data(), _data_size);
-            _data_size = 0;
-            _cond.notify_all();
-            return true;
+        _cond.wait_until(lock, deadline, [this,seq]() { return _close || _handled_seq > seq; });
+        if (_handled_seq > seq) {
+            return 1;
         }
-        return _close;
+        return _close ? -1 : 0;
+    }
+
+    // Wait for data, then call fn, in commit order, for each item committed since the last call.
+    // If done_fn is set, it is called after the last fn call and before the items are marked as handled,
+    // so fn may hand the data off to other threads as long as done_fn waits for them to be done with it.
+    // Only one thread may call HandleData.
+    // Returns false if the buffer was closed.
+    bool HandleData(const std::function<void(void*,size_t)>& fn, const std::function<void()>& done_fn = nullptr) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cond.wait(lock, [this]() { return _close || !_ready.empty(); });
+        if (_ready.empty()) {
+            return false;
+        }
+        if (_occupancy_metric) {
+            _occupancy_metric->Set(static_cast<double>(_num_slots - _free.size()) * 100.0 / static_cast<double>(_num_slots));
+        }
+        _handling.assign(_ready.begin(), _ready.end());
+        _ready.clear();
+        lock.unlock();
+
+        // The producers cannot touch slots that are committed, so fn can be called without holding the lock.
+        for (auto slot : _handling) {
+            fn(slot_ptr(slot), _sizes[slot]);
+        }
+        if (done_fn) {
+            done_fn();
+        }
+
+        lock.lock();
+        for (auto slot : _handling) {
+            _free.push_back(slot);
+        }
+        _handled_seq += _handling.size();
+        _cond.notify_all();
+        lock.unlock();
+
+        notify_listeners();
+        return true;
     }
 
     void Close() {
         std::unique_lock<std::mutex> lock(_mutex);
         _close = true;
         _cond.notify_all();
+        lock.unlock();
+
+        notify_listeners();
     }
 private:
+    inline char* slot_ptr(int slot) {
+        return _data.Data() + static_cast<size_t>(slot)*MAX_DATA_SIZE;
+    }
+
+    void notify_listeners() {
+        std::lock_guard<std::mutex> lock(_listener_mutex);
+        for (auto& l : _listeners) {
+            l.second();
+        }
+    }
+
     std::mutex _mutex;
     std::condition_variable _cond;
-    std::unique_ptr<std::array<char,MAX_DATA_SIZE>> _data;
-    size_t _data_size;
-    bool _has_writer;
+    size_t _num_slots;
+    LargeBuffer _data;
+    std::vector<size_t> _sizes;
+    std::deque<int> _free;
+    std::deque<int> _ready;
+    std::vector<int> _handling;
+    uint64_t _next_seq;
+    uint64_t _handled_seq;
     bool _close;
+    std::shared_ptr<Metric> _occupancy_metric;
+    std::shared_ptr<Metric> _full_metric;
+    std::mutex _listener_mutex;
+    int _next_listener_id;
+    std::vector<std::pair<int, std::function<void()>>> _listeners;
 };
 
 
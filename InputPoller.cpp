@@ -0,0 +1,445 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "InputPoller.h"
+#include "AckProtocol.h"
+#include "Event.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+
+extern "C" {
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+}
+
+InputPoller::~InputPoller() {
+    if (_listener_id >= 0) {
+        _buffer->RemoveHandledListener(_listener_id);
+    }
+    for (auto& c : _conns) {
+        close(c.first);
+    }
+    for (auto fd : _new_fds) {
+        close(fd);
+    }
+    if (_event_fd >= 0) {
+        close(_event_fd);
+    }
+    if (_epoll_fd >= 0) {
+        close(_epoll_fd);
+    }
+}
+
+bool InputPoller::Initialize() {
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (_epoll_fd < 0) {
+        Logger::Error("InputPoller: epoll_create1() failed: %s", std::strerror(errno));
+        return false;
+    }
+
+    _event_fd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+    if (_event_fd < 0) {
+        Logger::Error("InputPoller: eventfd() failed: %s", std::strerror(errno));
+        return false;
+    }
+
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = _event_fd;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _event_fd, &ev) != 0) {
+        Logger::Error("InputPoller: epoll_ctl() failed: %s", std::strerror(errno));
+        return false;
+    }
+
+    // Wake up to send acks (or resume blocked connections) whenever events are handled
+    _listener_id = _buffer->AddHandledListener([this]() { notify(); });
+    return true;
+}
+
+void InputPoller::AddConnection(int fd) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _new_fds.push_back(fd);
+        _num_connections++;
+    }
+    notify();
+}
+
+size_t InputPoller::NumConnections() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _num_connections;
+}
+
+void InputPoller::on_stopping() {
+    notify();
+}
+
+void InputPoller::notify() {
+    uint64_t val = 1;
+    // Can only fail if the counter would overflow, in which case the poller is already signaled
+    auto ret = write(_event_fd, &val, sizeof(val));
+    (void)ret;
+}
+
+void InputPoller::run() {
+    Logger::Info("InputPoller: Started");
+
+    std::array<epoll_event, MAX_EVENTS_PER_WAKE> events;
+    std::vector<int> to_close;
+
+    while (!IsStopping()) {
+        auto nevents = epoll_wait(_epoll_fd, events.data(), static_cast<int>(events.size()), next_timeout(std::chrono::steady_clock::now()));
+        if (nevents < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            Logger::Error("InputPoller: epoll_wait() failed: %s", std::strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < nevents; ++i) {
+            auto fd = events[i].data.fd;
+            if (fd == _event_fd) {
+                uint64_t val;
+                auto ret = read(_event_fd, &val, sizeof(val));
+                (void)ret;
+                continue;
+            }
+            auto itr = _conns.find(fd);
+            if (itr == _conns.end()) {
+                continue;
+            }
+            auto& conn = *itr->second;
+            if ((events[i].events & (EPOLLIN|EPOLLHUP|EPOLLERR)) != 0) {
+                handle_read(conn);
+            }
+            if ((events[i].events & EPOLLOUT) != 0) {
+                flush_out(conn);
+            }
+        }
+
+        add_new_connections();
+
+        auto handled_seq = _buffer->HandledSeq();
+        auto buffer_closed = _buffer->IsClosed();
+        auto now = std::chrono::steady_clock::now();
+        to_close.clear();
+        for (auto& c : _conns) {
+            auto& conn = *c.second;
+            if (conn.blocked && !conn.failed) {
+                conn.blocked = false;
+                if (!process_input(conn)) {
+                    conn.failed = true;
+                }
+            }
+            process_acks(conn, handled_seq, now);
+            if (!conn.failed) {
+                flush_out(conn);
+            }
+            if (buffer_closed || conn.failed ||
+                (conn.read_closed && !conn.blocked && conn.pending.empty() && conn.unacked == 0 && conn.out_offset >= conn.out.size())) {
+                to_close.push_back(c.first);
+            } else {
+                update_events(conn);
+            }
+        }
+        for (auto fd : to_close) {
+            close_connection(fd);
+        }
+    }
+
+    while (!_conns.empty()) {
+        close_connection(_conns.begin()->first);
+    }
+
+    Logger::Info("InputPoller: Stopped");
+}
+
+void InputPoller::add_new_connections() {
+    std::vector<int> fds;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        fds.swap(_new_fds);
+    }
+
+    for (auto fd : fds) {
+        int flags = fcntl(fd, F_GETFL, 0);
+        if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+            Logger::Error("Input(%d): Failed to set O_NONBLOCK: %s", fd, std::strerror(errno));
+        }
+        auto conn = std::make_unique<Connection>(fd);
+        if (_ack_batch_count > 1) {
+            queue_ack(*conn, MakeAckHello(ACK_PROTOCOL_V2));
+        }
+        auto& c = *conn;
+        _conns.emplace(fd, std::move(conn));
+        Logger::Info("Input(%d): Started", fd);
+        flush_out(c);
+        update_events(c);
+    }
+}
+
+void InputPoller::handle_read(Connection& conn) {
+    // Limit the reads per wake so that one busy connection cannot starve the others
+    for (int i = 0; i < 16 && !conn.read_closed && !conn.blocked && !conn.failed; ++i) {
+        auto nr = read(conn.fd, conn.in.data()+conn.in_end, conn.in.size()-conn.in_end);
+        if (nr < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                if (errno != ECONNRESET) {
+                    Logger::Info("Input(%d): Stopping due to failed event read: %s", conn.fd, std::strerror(errno));
+                } else {
+                    Logger::Info("Input(%d): Stopping due to closed connection", conn.fd);
+                }
+                conn.failed = true;
+            }
+            return;
+        }
+        if (nr == 0) {
+            Logger::Info("Input(%d): Stopping due to closed connection", conn.fd);
+            conn.read_closed = true;
+            return;
+        }
+        conn.in_end += nr;
+        if (!process_input(conn)) {
+            conn.failed = true;
+        }
+    }
+}
+
+bool InputPoller::process_input(Connection& conn) {
+    while (true) {
+        auto avail = conn.in_end - conn.in_start;
+        if (conn.discard > 0) {
+            auto n = std::min(conn.discard, avail);
+            conn.in_start += n;
+            conn.discard -= n;
+            if (conn.discard > 0) {
+                break;
+            }
+            continue;
+        }
+        if (avail < sizeof(uint32_t)) {
+            break;
+        }
+
+        uint32_t hdr;
+        memcpy(&hdr, conn.in.data()+conn.in_start, sizeof(hdr));
+        uint32_t version = hdr >> 24;
+        uint32_t size = hdr & 0x00FFFFFF;
+        bool is_control = version == ACK_CONTROL_VERSION && size == ACK_CONTROL_SIZE;
+
+        if (!is_control && !Event::IsSupportedVersion(version)) {
+            Logger::Info("Input(%d): Stopping due to unsupported message version (%d)", conn.fd, version);
+            return false;
+        }
+        if (size < sizeof(uint32_t)) {
+            Logger::Info("Input(%d): Stopping due to invalid message size (%d)", conn.fd, size);
+            return false;
+        }
+        if (size > InputBuffer::MAX_DATA_SIZE) {
+            Logger::Info("Input(%d): Message size (%d) in header is too large (> %ld), discarding message contents", conn.fd, size, InputBuffer::MAX_DATA_SIZE);
+            conn.discard = size;
+            continue;
+        }
+        if (avail < size) {
+            if (conn.in.size() - conn.in_start < size) {
+                // Make room for the whole event
+                memmove(conn.in.data(), conn.in.data()+conn.in_start, avail);
+                conn.in_start = 0;
+                conn.in_end = avail;
+                if (conn.in.size() < size) {
+                    conn.in.resize(size);
+                }
+            }
+            break;
+        }
+
+        auto ptr = conn.in.data()+conn.in_start;
+        if (is_control) {
+            uint32_t ack_version;
+            uint32_t window;
+            ParseAckControl(ptr, &ack_version, &window);
+            if (ack_version >= ACK_PROTOCOL_V2 && _ack_batch_count > 1) {
+                conn.batch_count = std::max(static_cast<size_t>(1), std::min(_ack_batch_count, static_cast<size_t>(window/2)));
+                Logger::Info("Input(%d): Using v2 acks (batch size %ld, sender window %d)", conn.fd, conn.batch_count, window);
+            }
+            conn.in_start += size;
+            continue;
+        }
+
+        void* data = nullptr;
+        int slot = _buffer->TryBeginWrite(&data);
+        if (slot < 0) {
+            if (_buffer->IsClosed()) {
+                return false;
+            }
+            conn.blocked = true;
+            break;
+        }
+        memcpy(data, ptr, size);
+        Event event(data, size);
+        EventId event_id(event.Seconds(), event.Milliseconds(), event.Serial());
+        uint64_t seq;
+        if (!_buffer->CommitWrite(slot, size, &seq)) {
+            return false;
+        }
+        conn.pending.emplace_back(seq, event_id);
+        conn.in_start += size;
+    }
+
+    if (conn.in_start == conn.in_end) {
+        conn.in_start = 0;
+        conn.in_end = 0;
+        if (conn.in.size() > READ_BUFFER_SIZE) {
+            // Don't keep a large buffer around after an unusually large event
+            conn.in.resize(READ_BUFFER_SIZE);
+            conn.in.shrink_to_fit();
+        }
+    } else if (conn.in_end == conn.in.size() && conn.in_start > 0) {
+        auto avail = conn.in_end - conn.in_start;
+        memmove(conn.in.data(), conn.in.data()+conn.in_start, avail);
+        conn.in_start = 0;
+        conn.in_end = avail;
+    }
+    return true;
+}
+
+void InputPoller::process_acks(Connection& conn, uint64_t handled_seq, std::chrono::steady_clock::time_point now) {
+    while (!conn.pending.empty() && conn.pending.front().first < handled_seq) {
+        if (conn.unacked == 0) {
+            conn.deadline = now + std::chrono::microseconds(_ack_batch_usecs);
+        }
+        conn.last_id = conn.pending.front().second;
+        conn.pending.pop_front();
+        conn.unacked++;
+        if (conn.unacked >= conn.batch_count) {
+            queue_ack(conn, conn.last_id);
+            conn.unacked = 0;
+        }
+    }
+    if (conn.unacked > 0 && (now >= conn.deadline || conn.read_closed)) {
+        queue_ack(conn, conn.last_id);
+        conn.unacked = 0;
+    }
+}
+
+void InputPoller::queue_ack(Connection& conn, const EventId& event_id) {
+    if (conn.out_offset >= conn.out.size()) {
+        conn.out.clear();
+        conn.out_offset = 0;
+    }
+    auto offset = conn.out.size();
+    conn.out.resize(offset + ACK_SIZE);
+    EncodeAck(event_id, conn.out.data()+offset);
+}
+
+void InputPoller::flush_out(Connection& conn) {
+    while (!conn.failed && conn.out_offset < conn.out.size()) {
+        auto nw = write(conn.fd, conn.out.data()+conn.out_offset, conn.out.size()-conn.out_offset);
+        if (nw < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                Logger::Info("Input(%d): Stopping due to failed ack write: %s", conn.fd, std::strerror(errno));
+                conn.failed = true;
+            }
+            return;
+        }
+        conn.out_offset += nw;
+    }
+    conn.out.clear();
+    conn.out_offset = 0;
+}
+
+void InputPoller::update_events(Connection& conn) {
+    uint32_t events = 0;
+    if (!conn.read_closed && !conn.blocked && !conn.failed) {
+        events |= EPOLLIN;
+    }
+    if (conn.out_offset < conn.out.size()) {
+        events |= EPOLLOUT;
+    }
+    if (events == conn.events) {
+        return;
+    }
+
+    // A registered fd always reports EPOLLHUP, so remove it while not interested in any events
+    // (e.g. blocked on the InputBuffer) to avoid waking up constantly.
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = conn.fd;
+    int op = EPOLL_CTL_MOD;
+    if (events == 0) {
+        op = EPOLL_CTL_DEL;
+    } else if (conn.events == 0) {
+        op = EPOLL_CTL_ADD;
+    }
+    if (epoll_ctl(_epoll_fd, op, conn.fd, &ev) != 0) {
+        Logger::Error("Input(%d): epoll_ctl() failed: %s", conn.fd, std::strerror(errno));
+        conn.failed = true;
+        return;
+    }
+    conn.events = events;
+}
+
+void InputPoller::close_connection(int fd) {
+    auto itr = _conns.find(fd);
+    if (itr == _conns.end()) {
+        return;
+    }
+    if (itr->second->events != 0) {
+        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+    close(fd);
+    _conns.erase(itr);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _num_connections--;
+    }
+    Logger::Info("Input(%d): Stopped", fd);
+    _closed_fn(fd);
+}
+
+int InputPoller::next_timeout(std::chrono::steady_clock::time_point now) {
+    bool have_deadline = false;
+    std::chrono::steady_clock::time_point deadline;
+    for (auto& c : _conns) {
+        if (c.second->unacked > 0 && (!have_deadline || c.second->deadline < deadline)) {
+            deadline = c.second->deadline;
+            have_deadline = true;
+        }
+    }
+    if (!have_deadline) {
+        return -1;
+    }
+    if (deadline <= now) {
+        return 0;
+    }
+    // Round up, epoll_wait only has millisecond resolution
+    return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now + std::chrono::microseconds(999)).count());
+}
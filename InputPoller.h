@@ -0,0 +1,111 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef AUOMS_INPUTPOLLER_H
+#define AUOMS_INPUTPOLLER_H
+
+#include "RunBase.h"
+#include "InputBuffer.h"
+#include "EventId.h"
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Serves many input connections from a single thread using epoll.
+ *
+ * This is the alternative to running one Input (thread) per connection. Sockets are non-blocking, each connection
+ * has its own (small) read buffer from which complete events are copied into the InputBuffer, and acks
+ * (including the v2 ack protocol, see AckProtocol.h) are written without blocking once the events are handled.
+ *
+ * If the InputBuffer is full, reading from the connection stops until a slot is freed.
+ */
+class InputPoller: public RunBase {
+public:
+    static constexpr size_t READ_BUFFER_SIZE = 64*1024;
+    static constexpr int MAX_EVENTS_PER_WAKE = 64;
+
+    // closed_fn is called (from the poller thread) after a connection has been closed.
+    InputPoller(std::shared_ptr<InputBuffer> buffer, size_t ack_batch_count, long ack_batch_usecs, std::function<void(int)> closed_fn):
+        _buffer(std::move(buffer)), _ack_batch_count(ack_batch_count), _ack_batch_usecs(ack_batch_usecs), _closed_fn(std::move(closed_fn)),
+        _epoll_fd(-1), _event_fd(-1), _listener_id(-1), _num_connections(0) {}
+    ~InputPoller() override;
+
+    bool Initialize();
+
+    // Hand over a connected socket. The poller takes ownership of fd.
+    void AddConnection(int fd);
+
+    size_t NumConnections();
+
+protected:
+    void on_stopping() override;
+    void run() override;
+
+private:
+    struct Connection {
+        explicit Connection(int fd): fd(fd), in(READ_BUFFER_SIZE), in_start(0), in_end(0), discard(0), out_offset(0),
+            unacked(0), batch_count(1), events(0), read_closed(false), blocked(false), failed(false) {}
+
+        int fd;
+        std::vector<uint8_t> in;
+        size_t in_start;   // Start of unprocessed data in 'in'
+        size_t in_end;     // End of data in 'in'
+        size_t discard;    // Bytes still to be discarded from an oversized event
+        std::vector<uint8_t> out;  // Ack data not yet written
+        size_t out_offset;
+        std::deque<std::pair<uint64_t, EventId>> pending;  // Events committed to the buffer, but not yet handled
+        size_t unacked;    // Handled events not yet acked
+        EventId last_id;   // The last of the unacked events
+        std::chrono::steady_clock::time_point deadline;
+        size_t batch_count;
+        uint32_t events;   // The epoll events currently registered
+        bool read_closed;
+        bool blocked;      // Waiting for a free InputBuffer slot
+        bool failed;
+    };
+
+    void notify();
+    void add_new_connections();
+    void handle_read(Connection& conn);
+    // Returns false if the connection should be closed
+    bool process_input(Connection& conn);
+    void process_acks(Connection& conn, uint64_t handled_seq, std::chrono::steady_clock::time_point now);
+    void queue_ack(Connection& conn, const EventId& event_id);
+    void flush_out(Connection& conn);
+    void update_events(Connection& conn);
+    void close_connection(int fd);
+    int next_timeout(std::chrono::steady_clock::time_point now);
+
+    std::shared_ptr<InputBuffer> _buffer;
+    size_t _ack_batch_count;
+    long _ack_batch_usecs;
+    std::function<void(int)> _closed_fn;
+    int _epoll_fd;
+    int _event_fd;
+    int _listener_id;
+    std::mutex _mutex;
+    std::vector<int> _new_fds;
+    size_t _num_connections;
+    std::unordered_map<int, std::unique_ptr<Connection>> _conns;
+};
+
+#endif //AUOMS_INPUTPOLLER_H
@@ -14,6 +14,7 @@
     THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include <algorithm>
 #include <cstring>
 #include "Inputs.h"
 #include "Logger.h"
@@ -23,6 +24,17 @@ bool Inputs::Initialize() {
 
     _op_status->SetErrorCondition(ErrorCategory::DATA_COLLECTION, "No collectors connected!");
 
+    for (size_t i = 0; i < _num_pollers; ++i) {
+        auto poller = std::make_shared<InputPoller>(_buffer, _ack_batch_count, _ack_batch_usecs, [this](int fd) { remove_poller_connection(fd); });
+        if (!poller->Initialize()) {
+            return false;
+        }
+        _pollers.emplace_back(poller);
+    }
+    if (!_pollers.empty()) {
+        Logger::Info("Inputs: Using %ld epoll input threads", _pollers.size());
+    }
+
     return _listener.Open();
 }
 
@@ -47,12 +59,23 @@ void Inputs::on_stop() {
     _inputs.clear();
     cleanup();
 
+    auto pollers = _pollers;
+    lock.unlock();
+    for (auto& poller : pollers) {
+        poller->Stop();
+    }
+    lock.lock();
+
     Logger::Info("Inputs stopped");
 }
 
 void Inputs::run() {
     Logger::Info("Inputs starting");
 
+    for (auto& poller : _pollers) {
+        poller->Start();
+    }
+
     while(!IsStopping()) {
         int newfd = _listener.Accept();
         if (newfd > 0) {
@@ -80,7 +103,17 @@ void Inputs::add_connection(int fd) {
 
     cleanup();
 
-    auto input = std::make_shared<Input>(std::make_unique<IOBase>(fd), _buffer, [this, fd]() { remove_connection(fd); });
+    if (!_pollers.empty()) {
+        auto poller = *std::min_element(_pollers.begin(), _pollers.end(), [](const std::shared_ptr<InputPoller>& a, const std::shared_ptr<InputPoller>& b) {
+            return a->NumConnections() < b->NumConnections();
+        });
+        _num_poller_connections++;
+        poller->AddConnection(fd);
+        _op_status->ClearErrorCondition(ErrorCategory::DATA_COLLECTION);
+        return;
+    }
+
+    auto input = std::make_shared<Input>(std::make_unique<IOBase>(fd), _buffer, [this, fd]() { remove_connection(fd); }, _ack_batch_count, _ack_batch_usecs, _ring_size);
     _inputs.insert(std::make_pair(fd, input));
     input->Start();
     _op_status->ClearErrorCondition(ErrorCategory::DATA_COLLECTION);
@@ -98,3 +131,14 @@ void Inputs::remove_connection(int fd) {
         _op_status->SetErrorCondition(ErrorCategory::DATA_COLLECTION, "No collectors connected!");
     }
 }
+
+void Inputs::remove_poller_connection(int fd) {
+    std::lock_guard<std::mutex> lock(_run_mutex);
+    if (_num_poller_connections > 0) {
+        _num_poller_connections--;
+    }
+
+    if (_num_poller_connections == 0) {
+        _op_status->SetErrorCondition(ErrorCategory::DATA_COLLECTION, "No collectors connected!");
+    }
+}
@@ -22,19 +22,47 @@
 #include "RunBase.h"
 #include "InputBuffer.h"
 #include "Input.h"
+#include "InputPoller.h"
 #include "OperationalStatus.h"
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 class Inputs: public RunBase {
 public:
-    explicit Inputs(const std::string& addr, const std::shared_ptr<OperationalStatus>& op_status): _listener(addr), _buffer(std::make_shared<InputBuffer>()), _op_status(op_status) {}
+    explicit Inputs(const std::string& addr, const std::shared_ptr<OperationalStatus>& op_status, size_t buffer_slots = InputBuffer::DEFAULT_NUM_SLOTS):
+        _listener(addr), _buffer(std::make_shared<InputBuffer>(buffer_slots)), _op_status(op_status),
+        _ack_batch_count(InputAckWriter::DEFAULT_ACK_BATCH_COUNT), _ack_batch_usecs(InputAckWriter::DEFAULT_ACK_BATCH_USECS),
+        _ring_size(0), _num_pollers(0), _num_poller_connections(0) {}
+
+    // Must be called before Start(). A batch_count of 1 disables v2 (batched) acks.
+    void SetAckBatching(size_t batch_count, long batch_usecs) {
+        _ack_batch_count = batch_count;
+        _ack_batch_usecs = batch_usecs;
+    }
+
+    // Must be called before Start(). Offer a SharedRing of ring_size bytes to senders that request it
+    // (0 disables it). Only supported by the thread per connection model.
+    void SetSharedRing(size_t ring_size) {
+        _ring_size = ring_size;
+    }
+
+    // Must be called before Initialize(). Serve connections from num_pollers epoll threads (see InputPoller)
+    // instead of one thread per connection. A value of 0 selects the thread per connection model.
+    void SetEpoll(size_t num_pollers) {
+        _num_pollers = num_pollers;
+    }
 
     bool Initialize();
 
-    bool HandleData(const std::function<void(void*,size_t)>& fn) {
-        return _buffer->HandleData(fn);
+    void SetMetrics(const std::shared_ptr<Metrics>& metrics) {
+        _buffer->SetMetrics(metrics->AddMetric("input", "buffer_occupancy", MetricPeriod::SECOND, MetricPeriod::HOUR),
+                            metrics->AddMetric("input", "buffer_full", MetricPeriod::SECOND, MetricPeriod::HOUR));
+    }
+
+    bool HandleData(const std::function<void(void*,size_t)>& fn, const std::function<void()>& done_fn = nullptr) {
+        return _buffer->HandleData(fn, done_fn);
     }
 
 protected:
@@ -48,9 +76,16 @@ private:
     std::shared_ptr<InputBuffer> _buffer;
     std::shared_ptr<OperationalStatus> _op_status;
     std::vector<std::shared_ptr<Input>> _inputs_to_clean;
+    size_t _ack_batch_count;
+    long _ack_batch_usecs;
+    size_t _ring_size;
+    size_t _num_pollers;
+    std::vector<std::shared_ptr<InputPoller>> _pollers;
+    size_t _num_poller_connections;
 
     void add_connection(int fd);
     void remove_connection(int fd);
+    void remove_poller_connection(int fd);
     void cleanup();
 };
 
@@ -34,6 +34,10 @@
 
 template <typename T>
 inline bool field_to_int(const EventRecordField& field, T& val, int base) {
+    if (base == 10 && field.HasIntValue()) {
+        val = static_cast<T>(field.IntValue());
+        return true;
+    }
     errno = 0;
     val = static_cast<T>(strtol(field.RawValuePtr(), nullptr, base));
     return errno == 0;
@@ -41,12 +45,16 @@ inline bool field_to_int(const EventRecordField& field, T& val, int base) {
 
 template <typename T>
 inline bool field_to_uint(const EventRecordField& field, T& val, int base) {
+    if (base == 10 && field.HasIntValue()) {
+        val = static_cast<T>(field.IntValue());
+        return true;
+    }
     errno = 0;
     val = static_cast<T>(strtoul(field.RawValuePtr(), nullptr, base));
     return errno == 0;
 }
 
-static StringTable<int> s_fam_table(-1, {
+static constexpr auto s_fam_table = MakeStringTable<int>(-1, {
         {"local",      AF_LOCAL},
         {"inet",       AF_INET},
         {"ax25",       AF_AX25},
@@ -341,3 +349,30 @@ bool InterpretField(std::string& out, const EventRecord& record, const EventReco
             return false;
     }
 }
+
+bool IsDeferredInterpFieldType(field_type_t field_type) {
+    switch (field_type) {
+        case field_type_t::ARCH:
+        case field_type_t::SOCKADDR:
+        case field_type_t::SESSION:
+        case field_type_t::MODE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+std::string_view FieldInterpValue(const EventRecordField& field, std::string& buf) {
+    if (field.InterpValueSize() > 0) {
+        return field.InterpValue();
+    }
+    auto field_type = field.FieldType();
+    if (!IsDeferredInterpFieldType(field_type)) {
+        return std::string_view();
+    }
+    buf.resize(0);
+    if (!InterpretField(buf, field.Record(), field, field_type)) {
+        return std::string_view();
+    }
+    return buf;
+}
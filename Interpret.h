@@ -21,4 +21,11 @@
 
 bool InterpretField(std::string& out, const EventRecord& record, const EventRecordField& field, field_type_t field_type);
 
+// Field types whose interpretation depends only on the event itself, so it can be deferred until the event is written
+bool IsDeferredInterpFieldType(field_type_t field_type);
+
+// Returns the field's interp value. If the event has none and the field's interpretation was deferred,
+// the value is interpreted into buf. The result is only valid until buf is modified.
+std::string_view FieldInterpValue(const EventRecordField& field, std::string& buf);
+
 #endif //AUOMS_INTERPRET_H
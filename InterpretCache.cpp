@@ -0,0 +1,101 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "InterpretCache.h"
+
+// The hit/miss counts are only added to the metrics every METRICS_FLUSH_COUNT lookups to avoid taking the metric lock per field
+#define METRICS_FLUSH_COUNT 256
+
+InterpretCache::InterpretCache(size_t max_entries, const std::shared_ptr<Metrics>& metrics):
+    _max_entries(max_entries), _hits(0), _misses(0)
+{
+    _hits_metric = metrics->AddMetric("interpret_cache", "hits", MetricPeriod::SECOND, MetricPeriod::HOUR);
+    _misses_metric = metrics->AddMetric("interpret_cache", "misses", MetricPeriod::SECOND, MetricPeriod::HOUR);
+}
+
+InterpretCache::~InterpretCache() {
+    flush_metrics();
+}
+
+void InterpretCache::SetMaxEntries(size_t max_entries) {
+    _max_entries = max_entries;
+    _caches.clear();
+}
+
+bool InterpretCache::Get(field_type_t field_type, const std::string_view& key, std::string& out) {
+    if (_max_entries == 0 || key.size() > MAX_KEY_SIZE) {
+        return false;
+    }
+
+    auto itr = _caches.find(static_cast<int>(field_type));
+    bool found = false;
+    if (itr != _caches.end()) {
+        _key.assign(key);
+        found = itr->second->on(_key, [&out](size_t, const std::chrono::steady_clock::time_point&, std::string& value) {
+            out.assign(value);
+            return CacheEntryOP::TOUCH;
+        });
+    }
+
+    if (found) {
+        _hits++;
+    } else {
+        _misses++;
+    }
+    if (_hits + _misses >= METRICS_FLUSH_COUNT) {
+        flush_metrics();
+    }
+    return found;
+}
+
+void InterpretCache::Put(field_type_t field_type, const std::string_view& key, const std::string& value) {
+    if (_max_entries == 0 || key.size() > MAX_KEY_SIZE) {
+        return;
+    }
+
+    auto& cache = _caches[static_cast<int>(field_type)];
+    if (!cache) {
+        cache = std::make_unique<cache_t>();
+    }
+
+    _key.assign(key);
+    cache->add(_key, value);
+
+    if (cache->size() > _max_entries) {
+        cache->for_all_oldest_first([this](size_t entry_count, const std::chrono::steady_clock::time_point&, const std::string&, std::string&) {
+            if (entry_count > _max_entries) {
+                return CacheEntryOP::REMOVE;
+            }
+            return CacheEntryOP::STOP;
+        });
+    }
+}
+
+void InterpretCache::Clear(field_type_t field_type) {
+    _caches.erase(static_cast<int>(field_type));
+}
+
+void InterpretCache::flush_metrics() {
+    if (_hits > 0) {
+        _hits_metric->Add(static_cast<double>(_hits));
+        _hits = 0;
+    }
+    if (_misses > 0) {
+        _misses_metric->Add(static_cast<double>(_misses));
+        _misses = 0;
+    }
+}
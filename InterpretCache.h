@@ -0,0 +1,71 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef AUOMS_INTERPRETCACHE_H
+#define AUOMS_INTERPRETCACHE_H
+
+#include "Cache.h"
+#include "FieldType.h"
+#include "Metrics.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/*
+ * Bounded, per field type, LRU cache of interpreted field values, keyed by the raw value.
+ *
+ * Used by RawEventProcessor so that values that repeat (e.g. the syscall, saddr or proctitle of a busy process,
+ * uid -> user name) are only interpreted once. Not thread safe, each RawEventProcessor has its own.
+ */
+class InterpretCache {
+public:
+    static constexpr size_t DEFAULT_MAX_ENTRIES = 1024;
+    static constexpr size_t MAX_KEY_SIZE = 4096;
+
+    // max_entries is per field type. A max_entries of 0 disables the cache.
+    InterpretCache(size_t max_entries, const std::shared_ptr<Metrics>& metrics);
+    ~InterpretCache();
+
+    void SetMaxEntries(size_t max_entries);
+
+    inline bool Enabled() const { return _max_entries > 0; }
+
+    // Returns true (and sets out) if key is in the cache for field_type
+    bool Get(field_type_t field_type, const std::string_view& key, std::string& out);
+
+    void Put(field_type_t field_type, const std::string_view& key, const std::string& value);
+
+    // Remove all the entries for field_type
+    void Clear(field_type_t field_type);
+
+private:
+    using cache_t = Cache<std::string, std::string>;
+
+    void flush_metrics();
+
+    size_t _max_entries;
+    std::unordered_map<int, std::unique_ptr<cache_t>> _caches;
+    std::string _key;
+    std::shared_ptr<Metric> _hits_metric;
+    std::shared_ptr<Metric> _misses_metric;
+    uint64_t _hits;
+    uint64_t _misses;
+};
+
+#endif //AUOMS_INTERPRETCACHE_H
@@ -15,6 +15,7 @@
 */
 
 #include "JSONEventWriter.h"
+#include "Interpret.h"
 
 #include <cstdlib>
 #include <climits>
@@ -65,9 +66,10 @@ ssize_t JSONEventWriter::WriteEvent(const Event& event, IWriter* writer) {
         _writer.Key("interp-values");
         _writer.StartArray(); // Field Interp Values
         for (auto f: rec) {
-            if (f.InterpValueSize() > 0) {
+            auto interp_val = FieldInterpValue(f, _interp_buf);
+            if (!interp_val.empty()) {
                 _writer.Key("i");
-                _writer.Key(f.InterpValuePtr(), f.InterpValueSize(), true);
+                _writer.Key(interp_val.data(), interp_val.size(), true);
             } else {
                 _writer.Null();
             }
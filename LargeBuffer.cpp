@@ -0,0 +1,136 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "LargeBuffer.h"
+
+#include "Logger.h"
+
+#include <system_error>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+extern "C" {
+#include <sys/mman.h>
+#include <unistd.h>
+}
+
+bool LargeBuffer::_default_huge_pages = false;
+bool LargeBuffer::_default_lock = false;
+
+// Only warn once per process for each kind of failure, otherwise every buffer allocation would generate a log message.
+static std::atomic<bool> s_hugetlb_warned(false);
+static std::atomic<bool> s_mlock_warned(false);
+
+void LargeBuffer::SetDefaultPolicy(bool huge_pages, bool lock) {
+    _default_huge_pages = huge_pages;
+    _default_lock = lock;
+}
+
+LargeBuffer::LargeBuffer(size_t size): LargeBuffer() {
+    allocate(size, _default_huge_pages, _default_lock);
+}
+
+LargeBuffer::LargeBuffer(size_t size, bool huge_pages, bool lock): LargeBuffer() {
+    allocate(size, huge_pages, lock);
+}
+
+LargeBuffer::~LargeBuffer() {
+    release();
+}
+
+LargeBuffer::LargeBuffer(LargeBuffer&& other) noexcept:
+    _ptr(other._ptr), _size(other._size), _alloc_size(other._alloc_size), _huge_tlb(other._huge_tlb), _locked(other._locked)
+{
+    other._ptr = nullptr;
+    other._size = 0;
+    other._alloc_size = 0;
+    other._huge_tlb = false;
+    other._locked = false;
+}
+
+LargeBuffer& LargeBuffer::operator=(LargeBuffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        _ptr = other._ptr;
+        _size = other._size;
+        _alloc_size = other._alloc_size;
+        _huge_tlb = other._huge_tlb;
+        _locked = other._locked;
+        other._ptr = nullptr;
+        other._size = 0;
+        other._alloc_size = 0;
+        other._huge_tlb = false;
+        other._locked = false;
+    }
+    return *this;
+}
+
+void LargeBuffer::allocate(size_t size, bool huge_pages, bool lock) {
+    void* ptr = MAP_FAILED;
+    size_t alloc_size = 0;
+
+    if (huge_pages) {
+        alloc_size = ((size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE) * HUGE_PAGE_SIZE;
+        ptr = mmap(nullptr, alloc_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED) {
+            _huge_tlb = true;
+        } else if (!s_hugetlb_warned.exchange(true)) {
+            Logger::Warn("LargeBuffer: MAP_HUGETLB allocation failed, falling back to transparent huge pages: %s", std::strerror(errno));
+        }
+    }
+
+    if (ptr == MAP_FAILED) {
+        auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        alloc_size = ((size + page_size - 1) / page_size) * page_size;
+        ptr = mmap(nullptr, alloc_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            throw std::system_error(errno, std::system_category(), "LargeBuffer: mmap() failed");
+        }
+#ifdef MADV_HUGEPAGE
+        if (huge_pages) {
+            // Advisory only, THP may be disabled
+            madvise(ptr, alloc_size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+    _ptr = reinterpret_cast<char*>(ptr);
+    _size = size;
+    _alloc_size = alloc_size;
+
+    if (lock) {
+        if (mlock(_ptr, _alloc_size) == 0) {
+            _locked = true;
+        } else if (!s_mlock_warned.exchange(true)) {
+            Logger::Warn("LargeBuffer: mlock() failed, buffers may be swapped: %s", std::strerror(errno));
+        }
+    }
+}
+
+void LargeBuffer::release() {
+    if (_ptr != nullptr) {
+        if (_locked) {
+            munlock(_ptr, _alloc_size);
+        }
+        munmap(_ptr, _alloc_size);
+        _ptr = nullptr;
+        _size = 0;
+        _alloc_size = 0;
+        _huge_tlb = false;
+        _locked = false;
+    }
+}
@@ -0,0 +1,69 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef AUOMS_LARGEBUFFER_H
+#define AUOMS_LARGEBUFFER_H
+
+#include <cstddef>
+
+/*
+ * A large, long lived, anonymous memory allocation.
+ *
+ * If huge_pages is true, the buffer is first allocated with MAP_HUGETLB (explicit huge pages).
+ * If that fails (e.g. vm.nr_hugepages == 0) a normal mapping is used and advised with MADV_HUGEPAGE
+ * so that transparent huge pages can be used where available.
+ * If lock is true, the buffer is mlock'ed. Failure to lock is logged but is not fatal.
+ *
+ * The memory is always zero filled.
+ */
+class LargeBuffer {
+public:
+    static constexpr size_t HUGE_PAGE_SIZE = 2*1024*1024;
+
+    // Set the policy used by LargeBuffer(size_t).
+    // Should be called once at startup, before any buffers are allocated.
+    static void SetDefaultPolicy(bool huge_pages, bool lock);
+
+    LargeBuffer(): _ptr(nullptr), _size(0), _alloc_size(0), _huge_tlb(false), _locked(false) {}
+    explicit LargeBuffer(size_t size);
+    LargeBuffer(size_t size, bool huge_pages, bool lock);
+    ~LargeBuffer();
+
+    LargeBuffer(const LargeBuffer&) = delete;
+    LargeBuffer& operator=(const LargeBuffer&) = delete;
+    LargeBuffer(LargeBuffer&& other) noexcept;
+    LargeBuffer& operator=(LargeBuffer&& other) noexcept;
+
+    inline char* Data() const { return _ptr; }
+    inline size_t Size() const { return _size; }
+    inline bool IsHugeTLB() const { return _huge_tlb; }
+    inline bool IsLocked() const { return _locked; }
+
+private:
+    void allocate(size_t size, bool huge_pages, bool lock);
+    void release();
+
+    static bool _default_huge_pages;
+    static bool _default_lock;
+
+    char* _ptr;
+    size_t _size;
+    size_t _alloc_size;
+    bool _huge_tlb;
+    bool _locked;
+};
+
+#endif //AUOMS_LARGEBUFFER_H
@@ -37,12 +37,25 @@ std::shared_ptr<Metric> Metrics::AddMetric(const std::string namespace_name, con
     }
 }
 
+std::shared_ptr<LatencyHistogram> Metrics::AddLatencyHistogram(const std::string& namespace_name, const std::string& name, MetricPeriod agg_period) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto key = namespace_name + name;
+    auto it = _histograms.find(key);
+    if (it != _histograms.end()) {
+        return it->second;
+    } else {
+        auto r = _histograms.emplace(std::make_pair(key, std::make_shared<LatencyHistogram>(namespace_name, name, agg_period)));
+        return r.first->second;
+    }
+}
+
 void Metrics::run() {
     Logger::Info("Metrics starting");
 
     // Check for metrics to send once per second without drift
     while(!_sleep(1000)) {
-        if (!send_metrics()) {
+        if (!send_metrics() || !send_latency_histograms()) {
             return;
         }
     }
@@ -61,7 +74,7 @@ bool Metrics::send_metrics() {
     MetricAggregateSnapshot snap;
 
     auto rec_type = RecordType::AUOMS_METRIC;
-    auto rec_type_name = RecordTypeToName(RecordType::AUOMS_METRIC);
+    static auto rec_type_name = RecordTypeToName(RecordType::AUOMS_METRIC);
 
     for (auto& e : _metrics) {
         while (e.second->GetAggregateSnapshot(&snap)) {
@@ -135,3 +148,173 @@ bool Metrics::send_metrics() {
     }
     return true;
 }
+
+bool Metrics::send_latency_histograms() {
+    std::vector<std::shared_ptr<LatencyHistogram>> histograms;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        histograms.reserve(_histograms.size());
+        for (auto& e : _histograms) {
+            histograms.emplace_back(e.second);
+        }
+    }
+
+    LatencyHistogramSnapshot snap;
+
+    auto rec_type = RecordType::AUOMS_METRIC;
+    static auto rec_type_name = RecordTypeToName(RecordType::AUOMS_METRIC);
+
+    for (auto& hist : histograms) {
+        if (!hist->GetSnapshot(&snap)) {
+            continue;
+        }
+
+        struct timeval tv;
+        gettimeofday(&tv, nullptr);
+
+        uint64_t sec = static_cast<uint64_t>(tv.tv_sec);
+        uint32_t msec = static_cast<uint32_t>(tv.tv_usec) / 1000;
+
+        // Same fields as the other metrics (with the values in usecs) plus the percentiles and buckets
+        const std::pair<const char*, std::string> fields[] = {
+                {"version", AUOMS_VERSION},
+                {"StartTime", system_time_to_iso3339(snap.start_time)},
+                {"EndTime", system_time_to_iso3339(snap.end_time)},
+                {"Namespace", snap.namespace_name},
+                {"Name", snap.name},
+                {"SampleRate", std::to_string(LatencyHistogram::SampleRate())},
+                {"NumSamples", std::to_string(snap.count)},
+                {"Min", std::to_string(snap.min)},
+                {"Max", std::to_string(snap.max)},
+                {"Avg", std::to_string(snap.avg)},
+                {"P50", std::to_string(snap.p50)},
+                {"P90", std::to_string(snap.p90)},
+                {"P99", std::to_string(snap.p99)},
+                {"Buckets", snap.buckets},
+        };
+
+        if (_builder->BeginEvent(sec, msec, 0, 1) != 1) {
+            return false;
+        }
+        if (_builder->BeginRecord(static_cast<uint32_t>(rec_type), rec_type_name, "", sizeof(fields)/sizeof(fields[0])) != 1) {
+            _builder->CancelEvent();
+            return false;
+        }
+        for (auto& f : fields) {
+            if (_builder->AddField(f.first, f.second, nullptr, field_type_t::UNCLASSIFIED) != 1) {
+                _builder->CancelEvent();
+                return false;
+            }
+        }
+        if (_builder->EndRecord() != 1) {
+            _builder->CancelEvent();
+            return false;
+        }
+        if (_builder->EndEvent() != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+LatencyHistogram::LatencyHistogram(const std::string& namespace_name, const std::string& name, MetricPeriod agg_period):
+    _nsname(namespace_name), _name(name), _agg_period_size(static_cast<long>(agg_period)),
+    _buckets(), _count(0), _sum(0), _min(0), _max(0)
+{
+    _agg_start_time = std::chrono::system_clock::now();
+    _agg_start_steady = std::chrono::steady_clock::now();
+}
+
+void LatencyHistogram::Add(uint64_t usecs) {
+    int idx = 0;
+    if (usecs > 0) {
+        idx = std::min(64 - __builtin_clzll(usecs), NUM_BUCKETS-1);
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _buckets[idx]++;
+    if (_count == 0 || usecs < _min) {
+        _min = usecs;
+    }
+    if (usecs > _max) {
+        _max = usecs;
+    }
+    _count++;
+    _sum += usecs;
+}
+
+void LatencyHistogram::AddSinceEventTime(uint64_t sec, uint32_t msec) {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+
+    int64_t usecs = (static_cast<int64_t>(tv.tv_sec) - static_cast<int64_t>(sec)) * 1000000 + static_cast<int64_t>(tv.tv_usec) - static_cast<int64_t>(msec) * 1000;
+    if (usecs >= 0) {
+        Add(static_cast<uint64_t>(usecs));
+    }
+}
+
+bool LatencyHistogram::GetSnapshot(LatencyHistogramSnapshot* snap) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto now = std::chrono::steady_clock::now();
+    if (now < _agg_start_steady + _agg_period_size) {
+        return false;
+    }
+
+    auto nagg = (now - _agg_start_steady) / _agg_period_size;
+    auto inc = _agg_period_size * nagg;
+
+    bool have_data = _count > 0;
+    if (have_data) {
+        snap->namespace_name = _nsname;
+        snap->name = _name;
+        snap->start_time = _agg_start_time;
+        snap->end_time = _agg_start_time + std::chrono::duration_cast<std::chrono::system_clock::duration>(inc);
+        snap->count = _count;
+        snap->min = _min;
+        snap->max = _max;
+        snap->avg = static_cast<double>(_sum) / static_cast<double>(_count);
+
+        // The percentiles are the upper bound of the bucket they fall in
+        uint64_t p50 = (_count * 50 + 99) / 100;
+        uint64_t p90 = (_count * 90 + 99) / 100;
+        uint64_t p99 = (_count * 99 + 99) / 100;
+        snap->p50 = 0;
+        snap->p90 = 0;
+        snap->p99 = 0;
+        snap->buckets.clear();
+        uint64_t total = 0;
+        for (int i = 0; i < NUM_BUCKETS; ++i) {
+            if (_buckets[i] == 0) {
+                continue;
+            }
+            uint64_t upper = i < NUM_BUCKETS-1 ? (static_cast<uint64_t>(1) << i) : _max;
+            total += _buckets[i];
+            if (snap->p50 == 0 && total >= p50) {
+                snap->p50 = upper;
+            }
+            if (snap->p90 == 0 && total >= p90) {
+                snap->p90 = upper;
+            }
+            if (snap->p99 == 0 && total >= p99) {
+                snap->p99 = upper;
+            }
+            if (!snap->buckets.empty()) {
+                snap->buckets.push_back(',');
+            }
+            snap->buckets.append(std::to_string(upper));
+            snap->buckets.push_back(':');
+            snap->buckets.append(std::to_string(_buckets[i]));
+        }
+    }
+
+    _agg_start_time += std::chrono::duration_cast<std::chrono::system_clock::duration>(inc);
+    _agg_start_steady += inc;
+    _buckets.fill(0);
+    _count = 0;
+    _sum = 0;
+    _min = 0;
+    _max = 0;
+
+    return have_data;
+}
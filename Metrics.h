@@ -22,6 +22,7 @@
 #include "Queue.h"
 #include "Logger.h"
 
+#include <array>
 #include <atomic>
 #include <mutex>
 #include <chrono>
@@ -163,22 +164,107 @@ private:
     std::list<std::shared_ptr<MetricData>> _data;
 };
 
+struct LatencyHistogramSnapshot {
+    std::string namespace_name;
+    std::string name;
+    std::chrono::system_clock::time_point start_time;
+    std::chrono::system_clock::time_point end_time;
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    double avg;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    std::string buckets; // "<upper bound>:<count>" of the non-empty buckets, comma separated
+};
+
+/*
+ * A histogram of latencies (in microseconds) with power of two buckets.
+ *
+ * Only one in LatencyHistogram::SampleRate() events is timed: the caller checks Sample() before reading the
+ * clock, so when sampling is disabled (rate 0) or the event is not sampled, the cost is a thread local counter.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int NUM_BUCKETS = 32; // Bucket 0 is < 1us, bucket i is < 2^i usecs, the last one is everything else
+    static constexpr uint32_t DEFAULT_SAMPLE_RATE = 100;
+
+    LatencyHistogram(const std::string& namespace_name, const std::string& name, MetricPeriod agg_period);
+
+    static void SetSampleRate(uint32_t rate) {
+        _sample_rate.store(rate, std::memory_order_relaxed);
+    }
+
+    static uint32_t SampleRate() {
+        return _sample_rate.load(std::memory_order_relaxed);
+    }
+
+    // Returns true for one in SampleRate() calls (on each thread)
+    static inline bool Sample() {
+        auto rate = _sample_rate.load(std::memory_order_relaxed);
+        if (rate == 0) {
+            return false;
+        }
+        thread_local uint32_t count = 0;
+        if (++count >= rate) {
+            count = 0;
+            return true;
+        }
+        return false;
+    }
+
+    void Add(uint64_t usecs);
+
+    // Add the time elapsed since start (if start is not the epoch, i.e. it was set for a sampled event)
+    void AddSince(std::chrono::steady_clock::time_point start) {
+        if (start.time_since_epoch().count() != 0) {
+            Add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()));
+        }
+    }
+
+    // Add the time elapsed since the (wall clock) event timestamp, negative values (clock changes) are ignored
+    void AddSinceEventTime(uint64_t sec, uint32_t msec);
+
+    // Returns true (once per agg period) if the period has ended and there were samples in it
+    bool GetSnapshot(LatencyHistogramSnapshot* snap);
+
+private:
+    static inline std::atomic<uint32_t> _sample_rate{DEFAULT_SAMPLE_RATE};
+
+    std::string _nsname;
+    std::string _name;
+    std::chrono::milliseconds _agg_period_size;
+
+    std::mutex _mutex;
+    std::chrono::system_clock::time_point _agg_start_time;
+    std::chrono::steady_clock::time_point _agg_start_steady;
+    std::array<uint64_t, NUM_BUCKETS> _buckets;
+    uint64_t _count;
+    uint64_t _sum;
+    uint64_t _min;
+    uint64_t _max;
+};
+
 class Metrics: public RunBase {
 public:
     explicit Metrics(std::shared_ptr<EventBuilder> builder): _builder(std::move(builder)) {}
     explicit Metrics(std::shared_ptr<Queue> queue): _builder(std::make_shared<EventBuilder>(std::make_shared<EventQueue>(std::move(queue)))) {}
 
     std::shared_ptr<Metric> AddMetric(const std::string namespace_name, const std::string name, MetricPeriod sample_period, MetricPeriod agg_period);
+    std::shared_ptr<LatencyHistogram> AddLatencyHistogram(const std::string& namespace_name, const std::string& name, MetricPeriod agg_period = MetricPeriod::MINUTE);
 
 protected:
     void run() override;
 
 private:
     bool send_metrics();
+    bool send_latency_histograms();
 
     std::shared_ptr<EventBuilder> _builder;
     std::mutex _mutex;
     std::unordered_map<std::string, std::shared_ptr<Metric>> _metrics;
+    std::unordered_map<std::string, std::shared_ptr<LatencyHistogram>> _histograms;
 };
 
 
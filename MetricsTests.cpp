@@ -0,0 +1,173 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved. 
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "MetricsTests"
+#include <boost/test/unit_test.hpp>
+
+#include "Metrics.h"
+
+#include <sys/time.h>
+#include <thread>
+
+// Snapshots are only available once the (one second) agg period has ended
+static bool wait_for_snapshot(LatencyHistogram& hist, LatencyHistogramSnapshot* snap) {
+    for (int i = 0; i < 30; ++i) {
+        if (hist.GetSnapshot(snap)) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return false;
+}
+
+BOOST_AUTO_TEST_CASE( latency_histogram_buckets ) {
+    LatencyHistogram hist("test", "buckets", MetricPeriod::SECOND);
+
+    // Bucket 0 is 0us, bucket i holds [2^(i-1), 2^i), the last bucket holds everything >= 2^30
+    hist.Add(0);
+    hist.Add(1);
+    hist.Add(2);
+    hist.Add(3);
+    hist.Add(4);
+    hist.Add(7);
+    hist.Add(8);
+    hist.Add((static_cast<uint64_t>(1) << 30) - 1);
+    hist.Add(static_cast<uint64_t>(1) << 30);
+    hist.Add(static_cast<uint64_t>(1) << 40);
+
+    LatencyHistogramSnapshot snap;
+    BOOST_REQUIRE(wait_for_snapshot(hist, &snap));
+    BOOST_CHECK_EQUAL(snap.namespace_name, "test");
+    BOOST_CHECK_EQUAL(snap.name, "buckets");
+    BOOST_CHECK_EQUAL(snap.count, 10);
+    BOOST_CHECK_EQUAL(snap.min, 0);
+    BOOST_CHECK_EQUAL(snap.max, static_cast<uint64_t>(1) << 40);
+    // The upper bound of the last bucket is the max value
+    BOOST_CHECK_EQUAL(snap.buckets, "1:1,2:1,4:2,8:2,16:1,1073741824:1,1099511627776:2");
+}
+
+BOOST_AUTO_TEST_CASE( latency_histogram_percentiles ) {
+    LatencyHistogram hist("test", "percentiles", MetricPeriod::SECOND);
+
+    for (int i = 0; i < 50; ++i) {
+        hist.Add(10);
+    }
+    for (int i = 0; i < 40; ++i) {
+        hist.Add(100);
+    }
+    for (int i = 0; i < 9; ++i) {
+        hist.Add(1000);
+    }
+    hist.Add(100000);
+
+    LatencyHistogramSnapshot snap;
+    BOOST_REQUIRE(wait_for_snapshot(hist, &snap));
+    BOOST_CHECK_EQUAL(snap.count, 100);
+    BOOST_CHECK_EQUAL(snap.min, 10);
+    BOOST_CHECK_EQUAL(snap.max, 100000);
+    BOOST_CHECK_CLOSE(snap.avg, (50.0*10 + 40.0*100 + 9.0*1000 + 100000) / 100.0, 0.0001);
+    // The percentiles are the upper bound of the bucket they fall in
+    BOOST_CHECK_EQUAL(snap.p50, 16);
+    BOOST_CHECK_EQUAL(snap.p90, 128);
+    BOOST_CHECK_EQUAL(snap.p99, 1024);
+    BOOST_CHECK_EQUAL(snap.buckets, "16:50,128:40,1024:9,131072:1");
+}
+
+BOOST_AUTO_TEST_CASE( latency_histogram_single_value ) {
+    LatencyHistogram hist("test", "single", MetricPeriod::SECOND);
+
+    hist.Add(5);
+
+    LatencyHistogramSnapshot snap;
+    BOOST_REQUIRE(wait_for_snapshot(hist, &snap));
+    BOOST_CHECK_EQUAL(snap.count, 1);
+    BOOST_CHECK_EQUAL(snap.p50, 8);
+    BOOST_CHECK_EQUAL(snap.p90, 8);
+    BOOST_CHECK_EQUAL(snap.p99, 8);
+}
+
+BOOST_AUTO_TEST_CASE( latency_histogram_snapshot_resets ) {
+    LatencyHistogram hist("test", "reset", MetricPeriod::SECOND);
+
+    hist.Add(100);
+
+    LatencyHistogramSnapshot snap;
+    BOOST_REQUIRE(wait_for_snapshot(hist, &snap));
+    BOOST_CHECK_EQUAL(snap.count, 1);
+
+    // Nothing until the next period ends
+    hist.Add(1000);
+    BOOST_CHECK(!hist.GetSnapshot(&snap));
+
+    BOOST_REQUIRE(wait_for_snapshot(hist, &snap));
+    BOOST_CHECK_EQUAL(snap.count, 1);
+    BOOST_CHECK_EQUAL(snap.min, 1000);
+    BOOST_CHECK_EQUAL(snap.max, 1000);
+    BOOST_CHECK_EQUAL(snap.buckets, "1024:1");
+}
+
+BOOST_AUTO_TEST_CASE( latency_histogram_ignored_values ) {
+    LatencyHistogram hist("test", "ignored", MetricPeriod::SECOND);
+
+    // A start time that was never set (the event was not sampled)
+    hist.AddSince(std::chrono::steady_clock::time_point());
+
+    // An event time in the future (clock change)
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    hist.AddSinceEventTime(static_cast<uint64_t>(tv.tv_sec) + 100, 0);
+
+    hist.AddSince(std::chrono::steady_clock::now());
+
+    LatencyHistogramSnapshot snap;
+    BOOST_REQUIRE(wait_for_snapshot(hist, &snap));
+    BOOST_CHECK_EQUAL(snap.count, 1);
+}
+
+BOOST_AUTO_TEST_CASE( latency_histogram_sample ) {
+    LatencyHistogram::SetSampleRate(0);
+    for (int i = 0; i < 100; ++i) {
+        BOOST_REQUIRE(!LatencyHistogram::Sample());
+    }
+
+    // Every call is sampled, which also resets this thread's counter
+    LatencyHistogram::SetSampleRate(1);
+    for (int i = 0; i < 10; ++i) {
+        BOOST_REQUIRE(LatencyHistogram::Sample());
+    }
+
+    LatencyHistogram::SetSampleRate(4);
+    for (int i = 1; i <= 20; ++i) {
+        BOOST_REQUIRE_EQUAL(LatencyHistogram::Sample(), i % 4 == 0);
+    }
+
+    // The counter is per thread
+    BOOST_REQUIRE(!LatencyHistogram::Sample());
+    BOOST_REQUIRE(!LatencyHistogram::Sample());
+    int sampled_at = 0;
+    std::thread thread([&sampled_at]() {
+        for (int i = 1; i <= 4 && sampled_at == 0; ++i) {
+            if (LatencyHistogram::Sample()) {
+                sampled_at = i;
+            }
+        }
+    });
+    thread.join();
+    BOOST_CHECK_EQUAL(sampled_at, 4);
+
+    LatencyHistogram::SetSampleRate(LatencyHistogram::DEFAULT_SAMPLE_RATE);
+}
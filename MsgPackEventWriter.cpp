@@ -15,6 +15,7 @@
 */
 
 #include "MsgPackEventWriter.h"
+#include "Interpret.h"
 
 ssize_t MsgPackEventWriter::WriteEvent(const Event& event, IWriter* writer) {
     _buffer.clear();
@@ -63,9 +64,10 @@ ssize_t MsgPackEventWriter::WriteEvent(const Event& event, IWriter* writer) {
         _packer.pack("interp-values");
         _packer.pack_array(rec.NumFields());
         for (auto f: rec) {
-            if (f.InterpValueSize() > 0) {
-                _packer.pack_str(f.InterpValueSize());
-                _packer.pack_str_body(f.InterpValuePtr(), f.InterpValueSize());
+            auto interp_val = FieldInterpValue(f, _interp_buf);
+            if (!interp_val.empty()) {
+                _packer.pack_str(interp_val.size());
+                _packer.pack_str_body(interp_val.data(), interp_val.size());
             } else {
                 _packer.pack_nil();
             }
@@ -19,6 +19,8 @@
 
 #include "IEventWriter.h"
 
+#include <string>
+
 #include <msgpack.hpp>
 
 class MsgPackEventWriter: public IEventWriter {
@@ -30,6 +32,7 @@ public:
 private:
     msgpack::sbuffer _buffer;
     msgpack::packer<msgpack::sbuffer> _packer;
+    std::string _interp_buf;
 };
 
 
@@ -23,6 +23,7 @@
 #include "MsgPackEventWriter.h"
 #include "RawEventWriter.h"
 #include "SyslogEventWriter.h"
+#include "AckProtocol.h"
 
 extern "C" {
 #include <unistd.h>
@@ -44,6 +45,11 @@ void AckQueue::Close() {
     _cond.notify_all();
 }
 
+void AckQueue::SetLatencyHistogram(const std::shared_ptr<LatencyHistogram>& hist) {
+    std::unique_lock<std::mutex> _lock(_mutex);
+    _ack_latency = hist;
+}
+
 bool AckQueue::Add(const EventId& event_id, const QueueCursor& cursor, long timeout) {
     std::unique_lock<std::mutex> _lock(_mutex);
 
@@ -51,6 +57,9 @@ bool AckQueue::Add(const EventId& event_id, const QueueCursor& cursor, long time
         auto seq = _next_seq++;
         _event_ids.emplace(event_id, seq);
         _cursors.emplace(seq, std::make_pair(event_id, cursor));
+        if (_ack_latency && LatencyHistogram::Sample()) {
+            _sent_times.emplace(seq, std::chrono::steady_clock::now());
+        }
         return true;
     }
     return false;
@@ -86,6 +95,7 @@ void AckQueue::Remove(const EventId& event_id) {
     _event_ids.erase(eitr);
 
     _cursors.erase(seq);
+    _sent_times.erase(seq);
 }
 
 void AckQueue::Reset() {
@@ -94,6 +104,7 @@ void AckQueue::Reset() {
     _closed = false;
     _event_ids.clear();
     _cursors.clear();
+    _sent_times.clear();
     _next_seq = 0;
     _have_auto_cursor = false;
     _auto_cursor_seq = 0;
@@ -126,6 +137,11 @@ bool AckQueue::Ack(const EventId& event_id, QueueCursor& cursor) {
             _event_ids.erase(_cursors.begin()->second.first);
             _cursors.erase(_cursors.begin());
         }
+
+        while (!_sent_times.empty() && _sent_times.begin()->first <= seq) {
+            _ack_latency->AddSince(_sent_times.begin()->second);
+            _sent_times.erase(_sent_times.begin());
+        }
     }
 
     /*
@@ -261,12 +277,24 @@ void AckReader::Init(std::shared_ptr<IEventWriter> event_writer,
     _writer = writer;
     _queue = ack_queue;
     _cursor_writer = cursor_writer;
+    _peer_ack_version = 0;
+    _peer_ack_features = 0;
 }
 
 void AckReader::run() {
     EventId id;
     QueueCursor cursor;
     while(_event_writer->ReadAck(id, _writer.get()) == IO::OK) {
+        auto ack_version = GetAckHelloVersion(id);
+        if (ack_version != 0) {
+            _peer_ack_features = GetAckHelloFeatures(id);
+            _peer_ack_version = ack_version;
+            continue;
+        }
+        if (IsAckRingOffer(id)) {
+            // Handled by the SharedRingWriter
+            continue;
+        }
         if (_queue->Ack(id, cursor)) {
             _cursor_writer->UpdateCursor(cursor);
         }
@@ -343,11 +371,6 @@ bool Output::Load(std::unique_ptr<Config>& config) {
         _event_filter.reset();
     }
 
-    if (socket_path != _socket_path || !_writer) {
-        _socket_path = socket_path;
-        _writer = std::unique_ptr<UnixDomainWriter>(new UnixDomainWriter(_socket_path));
-    }
-
     if (_config->HasKey("enable_ack_mode")) {
         try {
             _ack_mode = _config->GetBool("enable_ack_mode");
@@ -357,6 +380,32 @@ bool Output::Load(std::unique_ptr<Config>& config) {
         }
     }
 
+    bool shm_ring = false;
+    if (_config->HasKey("enable_shm_ring")) {
+        try {
+            shm_ring = _config->GetBool("enable_shm_ring");
+        } catch (std::exception) {
+            Logger::Error("Output(%s): Invalid enable_shm_ring parameter value", _name.c_str());
+            return false;
+        }
+        if (shm_ring && (format != "raw" || !_ack_mode)) {
+            Logger::Warn("Output(%s): enable_shm_ring requires output_format 'raw' and enable_ack_mode, ignoring it", _name.c_str());
+            shm_ring = false;
+        }
+    }
+
+    if (socket_path != _socket_path || !_writer || shm_ring != _shm_ring) {
+        _socket_path = socket_path;
+        _shm_ring = shm_ring;
+        if (_shm_ring) {
+            _ring_writer = std::make_shared<SharedRingWriter>(_socket_path);
+            _writer = _ring_writer;
+        } else {
+            _ring_writer.reset();
+            _writer = std::unique_ptr<UnixDomainWriter>(new UnixDomainWriter(_socket_path));
+        }
+    }
+
     if (_ack_mode) {
         uint64_t ack_queue_size = DEFAULT_ACK_QUEUE_SIZE;
         if (_config->HasKey("ack_queue_size")) {
@@ -387,6 +436,9 @@ bool Output::Load(std::unique_ptr<Config>& config) {
 
         if (!_ack_queue || _ack_queue->MaxSize() != ack_queue_size) {
             _ack_queue = std::make_shared<AckQueue>(ack_queue_size);
+            if (_ack_latency) {
+                _ack_queue->SetLatencyHistogram(_ack_latency);
+            }
         }
     } else {
         if (_ack_queue) {
@@ -403,6 +455,15 @@ void Output::Delete() {
     Logger::Info("Output(%s): Removed", _name.c_str());
 }
 
+void Output::SetMetrics(const std::shared_ptr<Metrics>& metrics) {
+    _send_latency = metrics->AddLatencyHistogram("latency", "send_" + _name);
+    _ack_latency = metrics->AddLatencyHistogram("latency", "ack_" + _name);
+}
+
+void Output::GetLag(uint64_t* bytes, uint64_t* items) {
+    _queue->GetLag(_cursor_writer->GetCursor(), bytes, items);
+}
+
 bool Output::check_open()
 {
     int sleep_period = START_SLEEP_PERIOD;
@@ -438,7 +499,12 @@ bool Output::check_open()
 }
 
 bool Output::handle_events(bool checkOpen) {
-    std::array<uint8_t, Queue::MAX_ITEM_SIZE> data;
+    if (_data.Data() == nullptr) {
+        _data = LargeBuffer(BATCH_BUFFER_SIZE);
+        _batch_events.reserve(MAX_BATCH_EVENTS);
+        _batch_cursors.reserve(MAX_BATCH_EVENTS);
+        _batch_filtered.reserve(MAX_BATCH_EVENTS);
+    }
 
     _cursor = _cursor_writer->GetCursor();
     _cursor_writer->Start();
@@ -449,13 +515,15 @@ bool Output::handle_events(bool checkOpen) {
         _ack_queue->Reset();
     }
 
+    bool ack_control_sent = false;
+
     while(!IsStopping() && (!checkOpen || _writer->IsOpen())) {
         QueueCursor cursor;
-        size_t size = data.size();
+        size_t size = _data.Size();
 
         int ret;
         do {
-            ret = _queue->Get(_cursor, data.data(), &size, &cursor, 100);
+            ret = _queue->Get(_cursor, _data.Data(), &size, &cursor, 100);
         } while(ret == Queue::TIMEOUT && (!checkOpen || _writer->IsOpen()));
 
         if (ret == Queue::INTERRUPTED) {
@@ -468,17 +536,55 @@ bool Output::handle_events(bool checkOpen) {
             break;
         }
 
-        if (ret == Queue::OK && (!checkOpen || _writer->IsOpen()) && !IsStopping()) {
-            auto vs = Event::GetVersionAndSize(data.data());
+        if (ret != Queue::OK || (checkOpen && !_writer->IsOpen()) || IsStopping()) {
+            continue;
+        }
+
+        auto vs = Event::GetVersionAndSize(_data.Data());
+        if (vs.second != size) {
+            Logger::Error("Output(%s): Encountered possible corruption in queue, resetting queue", _name.c_str());
+            _queue->Reset();
+            break;
+        }
+
+        _batch_events.clear();
+        _batch_cursors.clear();
+        _batch_events.emplace_back(_data.Data(), size);
+        _batch_cursors.emplace_back(cursor);
+
+        // Add any other events that are already available to the batch.
+        // Stop before an item that looks corrupt, it will be handled as the first item of the next batch.
+        size_t offset = size;
+        while (_batch_events.size() < MAX_BATCH_EVENTS && _data.Size() - offset >= Queue::MAX_ITEM_SIZE) {
+            // Keep the event data 8 byte aligned
+            offset = (offset + 7) & ~static_cast<size_t>(7);
+            size = _data.Size() - offset;
+            if (_queue->Get(cursor, _data.Data()+offset, &size, &cursor, 0) != Queue::OK) {
+                break;
+            }
+            vs = Event::GetVersionAndSize(_data.Data()+offset);
             if (vs.second != size) {
-                Logger::Error("Output(%s): Encountered possible corruption in queue, resetting queue", _name.c_str());
-                _queue->Reset();
                 break;
             }
+            _batch_events.emplace_back(_data.Data()+offset, size);
+            _batch_cursors.emplace_back(cursor);
+            offset += size;
+        }
+
+        _batch_filtered.assign(_batch_events.size(), 0);
+        if (_event_filter) {
+            _batch_columns.Clear();
+            for (auto& event : _batch_events) {
+                _batch_columns.Add(event);
+            }
+            _event_filter->FilterEvents(_batch_columns, _batch_filtered);
+        }
 
-            Event event(data.data(), size);
-            bool filtered = _event_filter && _event_filter->IsEventFiltered(event);
-            if (!filtered) {
+        bool stop = false;
+        for (size_t i = 0; i < _batch_events.size() && !stop; ++i) {
+            auto& event = _batch_events[i];
+            cursor = _batch_cursors[i];
+            if (_batch_filtered[i] == 0) {
                 if (_ack_mode) {
                     // Avoid racing with receiver, add ack before sending event
                     if (!_ack_queue->Add(EventId(event.Seconds(), event.Milliseconds(), event.Serial()), cursor,
@@ -486,10 +592,25 @@ bool Output::handle_events(bool checkOpen) {
                         if (_writer->IsOpen()) {
                             Logger::Error("Output(%s): Timeout waiting for Acks", _name.c_str());
                         }
+                        stop = true;
                         break;
                     }
                 }
 
+                if (_ack_mode && !ack_control_sent && _ack_reader->PeerAckVersion() >= ACK_PROTOCOL_V2) {
+                    // The receiver offered v2 acks, tell it how many events may be in flight
+                    uint32_t flags = 0;
+                    if (_ring_writer && _ring_writer->RingEnabled() && (_ack_reader->PeerAckFeatures() & ACK_FEATURE_SHARED_RING) != 0) {
+                        flags |= ACK_CONTROL_FLAG_RING_REQUEST;
+                    }
+                    auto control = MakeAckControl(ACK_PROTOCOL_V2, static_cast<uint32_t>(_ack_queue->MaxSize()), flags);
+                    if (_writer->WriteAll(control.data(), control.size(), -1, nullptr) != IO::OK) {
+                        stop = true;
+                        break;
+                    }
+                    ack_control_sent = true;
+                }
+
                 auto ret = _event_writer->WriteEvent(event, _writer.get());
                 if (ret == IEventWriter::NOOP) {
                     if (_ack_mode) {
@@ -499,7 +620,10 @@ bool Output::handle_events(bool checkOpen) {
                         _ack_queue->SetAutoCursor(cursor);
                     }
                 } else if (ret != IWriter::OK) {
+                    stop = true;
                     break;
+                } else if (_send_latency && LatencyHistogram::Sample()) {
+                    _send_latency->AddSinceEventTime(event.Seconds(), event.Milliseconds());
                 }
                 _cursor = cursor;
 
@@ -514,6 +638,12 @@ bool Output::handle_events(bool checkOpen) {
                     _cursor_writer->UpdateCursor(cursor);
                 }
             }
+            if (IsStopping() || (checkOpen && !_writer->IsOpen())) {
+                break;
+            }
+        }
+        if (stop) {
+            break;
         }
     }
 
@@ -19,12 +19,17 @@
 
 #include "RunBase.h"
 #include "Queue.h"
+#include "LargeBuffer.h"
 #include "Config.h"
 #include "EventId.h"
 #include "OMSEventWriter.h"
 #include "IO.h"
 #include "IEventFilter.h"
+#include "EventColumns.h"
+#include "SharedRingWriter.h"
+#include "Metrics.h"
 
+#include <atomic>
 #include <string>
 #include <mutex>
 #include <memory>
@@ -44,6 +49,9 @@ public:
 
     void Close();
 
+    // Record the time from Add to Ack of sampled events in hist
+    void SetLatencyHistogram(const std::shared_ptr<LatencyHistogram>& hist);
+
     // Return false if timeout, true if added
     bool Add(const EventId& event_id, const QueueCursor& cursor, long timeout);
 
@@ -67,6 +75,9 @@ private:
     std::condition_variable _cond;
     std::unordered_map<EventId, uint64_t> _event_ids;
     std::map<uint64_t, std::pair<EventId,QueueCursor>> _cursors;
+    std::shared_ptr<LatencyHistogram> _ack_latency;
+    // The time sampled events were added
+    std::map<uint64_t, std::chrono::steady_clock::time_point> _sent_times;
     size_t _max_size;
     bool _closed;
     bool _have_auto_cursor;
@@ -114,7 +125,7 @@ class Output;
 class AckReader: public RunBase {
 public:
 
-    AckReader(const std::string& name): _name(name)
+    AckReader(const std::string& name): _name(name), _peer_ack_version(0), _peer_ack_features(0)
     {}
 
     void Init(std::shared_ptr<IEventWriter> event_writer,
@@ -122,6 +133,16 @@ public:
               std::shared_ptr<AckQueue> ack_queue,
               std::shared_ptr<CursorWriter> cursor_writer);
 
+    // The ack protocol version offered by the receiver (0 if the receiver did not send a hello)
+    uint32_t PeerAckVersion() const {
+        return _peer_ack_version.load();
+    }
+
+    // The ack protocol features (ACK_FEATURE_*) offered by the receiver
+    uint32_t PeerAckFeatures() const {
+        return _peer_ack_features.load();
+    }
+
 protected:
     virtual void run();
 
@@ -130,6 +151,8 @@ protected:
     std::shared_ptr<IOBase> _writer;
     std::shared_ptr<AckQueue> _queue;
     std::shared_ptr<CursorWriter> _cursor_writer;
+    std::atomic<uint32_t> _peer_ack_version;
+    std::atomic<uint32_t> _peer_ack_features;
 };
 
 /****************************************************************************
@@ -175,9 +198,12 @@ public:
     static constexpr int MAX_SLEEP_PERIOD = 60;
     static constexpr int DEFAULT_ACK_QUEUE_SIZE = 1000;
     static constexpr long MIN_ACK_TIMEOUT = 100;
+    // Events already in the queue are read, filtered and sent in batches of up to MAX_BATCH_EVENTS.
+    static constexpr size_t MAX_BATCH_EVENTS = 256;
+    static constexpr size_t BATCH_BUFFER_SIZE = Queue::MAX_ITEM_SIZE*2;
 
     Output(const std::string& name, const std::string& cursor_path, const std::shared_ptr<Queue>& queue, const std::shared_ptr<IEventWriterFactory>& writer_factory, const std::shared_ptr<IEventFilterFactory>& filter_factory):
-            _name(name), _cursor_path(cursor_path), _queue(queue), _writer_factory(writer_factory), _filter_factory(filter_factory), _ack_mode(false), _ack_timeout(10000)
+            _name(name), _cursor_path(cursor_path), _queue(queue), _writer_factory(writer_factory), _filter_factory(filter_factory), _ack_mode(false), _ack_timeout(10000), _shm_ring(false)
     {
         _cursor_writer = std::make_shared<CursorWriter>(name, cursor_path);
         _ack_reader = std::unique_ptr<AckReader>(new AckReader(name));
@@ -191,6 +217,12 @@ public:
     // Delete any resources associated with the output
     void Delete();
 
+    // Must be called before Load()
+    void SetMetrics(const std::shared_ptr<Metrics>& metrics);
+
+    // Get the amount of queue data (bytes and items) that has not yet been acked/committed by this output
+    void GetLag(uint64_t* bytes, uint64_t* items);
+
 protected:
     friend class AckReader;
 
@@ -218,9 +250,19 @@ protected:
     std::shared_ptr<IEventWriter> _event_writer;
     std::shared_ptr<IEventFilter> _event_filter;
     std::shared_ptr<IOBase> _writer;
+    // Set (and the same as _writer) if enable_shm_ring is true
+    std::shared_ptr<SharedRingWriter> _ring_writer;
+    bool _shm_ring;
     std::shared_ptr<AckQueue> _ack_queue;
     std::unique_ptr<AckReader> _ack_reader;
     std::shared_ptr<CursorWriter> _cursor_writer;
+    std::shared_ptr<LatencyHistogram> _send_latency; // Kernel timestamp -> event sent
+    std::shared_ptr<LatencyHistogram> _ack_latency; // Event sent -> event acked
+    LargeBuffer _data;
+    std::vector<Event> _batch_events;
+    std::vector<QueueCursor> _batch_cursors;
+    EventColumns _batch_columns; // Only built when there is an event filter
+    std::vector<uint8_t> _batch_filtered;
 };
 
 
@@ -28,8 +28,20 @@
 #include "Inputs.h"
 #include "InputBuffer.h"
 #include "Gate.h"
+#include "RawEventWriter.h"
+#include "UnixDomainWriter.h"
+#include "AckProtocol.h"
+#include "TestEventQueue.h"
 #include "Signals.h"
 #include "StringUtils.h"
+#include "SharedRing.h"
+
+extern "C" {
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+}
 
 bool BuildEvent(std::shared_ptr<EventBuilder>& builder, uint64_t sec, uint32_t msec, uint64_t serial, int seq) {
     if (builder->BeginEvent(sec, msec, serial, 1) != 1) {
@@ -39,7 +51,7 @@ bool BuildEvent(std::shared_ptr<EventBuilder>& builder, uint64_t sec, uint32_t m
         builder->CancelEvent();
         return false;
     }
-    if (builder->AddField("seq", std::to_string(seq), nullptr, field_type_t::UNCLASSIFIED) != 1) {
+    if (builder->AddField("seq", std::to_string(seq), "", field_type_t::UNCLASSIFIED) != 1) {
         builder->CancelEvent();
         return false;
     }
@@ -528,3 +540,666 @@ BOOST_AUTO_TEST_CASE( dropped_conn_test ) {
         BOOST_REQUIRE_EQUAL(i, event_seq);
     }
 }
+
+BOOST_AUTO_TEST_CASE( input_buffer_test ) {
+    constexpr int num_producers = 4;
+    constexpr int num_events = 1000;
+
+    InputBuffer buffer(8);
+    BOOST_REQUIRE_EQUAL(buffer.NumSlots(), 8);
+
+    // Each producer writes (producer, index) pairs and waits for the last one to be handled
+    std::vector<std::thread> producers;
+    std::vector<bool> handled_ok(num_producers, false);
+    for (int p = 0; p < num_producers; ++p) {
+        producers.emplace_back([&buffer, &handled_ok, p]() {
+            uint64_t seq = 0;
+            for (int i = 0; i < num_events; ++i) {
+                void* ptr = nullptr;
+                int slot = buffer.BeginWrite(&ptr);
+                if (slot < 0) {
+                    return;
+                }
+                if (i % 100 == 99) {
+                    buffer.AbandonWrite(slot);
+                    continue;
+                }
+                reinterpret_cast<int*>(ptr)[0] = p;
+                reinterpret_cast<int*>(ptr)[1] = i;
+                if (!buffer.CommitWrite(slot, sizeof(int)*2, &seq)) {
+                    return;
+                }
+            }
+            handled_ok[p] = buffer.WaitHandled(seq);
+        });
+    }
+
+    int expected_total = num_producers * (num_events - num_events/100);
+    int total = 0;
+    std::vector<int> last(num_producers, -1);
+    bool in_order = true;
+    while (total < expected_total) {
+        BOOST_REQUIRE(buffer.HandleData([&](void* ptr, size_t size) {
+            BOOST_REQUIRE_EQUAL(size, sizeof(int)*2);
+            auto p = reinterpret_cast<int*>(ptr)[0];
+            auto i = reinterpret_cast<int*>(ptr)[1];
+            if (i <= last[p]) {
+                in_order = false;
+            }
+            last[p] = i;
+            total++;
+        }));
+    }
+
+    for (auto& t : producers) {
+        t.join();
+    }
+
+    BOOST_CHECK(in_order);
+    BOOST_CHECK_EQUAL(total, expected_total);
+    for (int p = 0; p < num_producers; ++p) {
+        BOOST_CHECK(handled_ok[p]);
+        BOOST_CHECK_EQUAL(last[p], num_events-2);
+    }
+
+    // Committed but not handled data is not reported as handled once the buffer is closed
+    void* ptr = nullptr;
+    uint64_t seq = 0;
+    int slot = buffer.BeginWrite(&ptr);
+    BOOST_REQUIRE(slot >= 0);
+    BOOST_REQUIRE(buffer.CommitWrite(slot, 1, &seq));
+    buffer.Close();
+    BOOST_CHECK(!buffer.WaitHandled(seq));
+    BOOST_CHECK_EQUAL(buffer.BeginWrite(&ptr), -1);
+}
+
+BOOST_AUTO_TEST_CASE( v2_ack_test ) {
+    TempDir dir("/tmp/OutputInputTests");
+
+    std::string cursor_path = dir.Path() + "/input.cursor";
+    std::string queue_path = dir.Path() + "/input.queue";
+    std::string socket_path = dir.Path() + "/input.socket";
+
+    std::mutex log_mutex;
+    std::vector<std::string> log_lines;
+    Logger::SetLogFunction([&log_mutex,&log_lines](const char* ptr, size_t size){
+        std::lock_guard<std::mutex> lock(log_mutex);
+        log_lines.emplace_back(ptr, size);
+    });
+
+    Signals::Init();
+    Signals::Start();
+
+    auto queue = std::make_shared<Queue>(queue_path, 1024*1024);
+    queue->Open();
+
+    auto event_queue = std::make_shared<EventQueue>(queue);
+    auto builder = std::make_shared<EventBuilder>(event_queue);
+
+    auto output_config = std::make_unique<Config>(std::unordered_map<std::string, std::string>({
+        {"output_format","raw"},
+        {"output_socket", socket_path},
+        {"enable_ack_mode", "true"},
+        {"ack_queue_size", "20"},
+        {"ack_timeout", "1000"}
+    }));
+    auto writer_factory = std::shared_ptr<IEventWriterFactory>(static_cast<IEventWriterFactory*>(new RawOnlyEventWriterFactory()));
+    Output output("output", cursor_path, queue, writer_factory, nullptr);
+    output.Load(output_config);
+
+    auto operational_status = std::make_shared<OperationalStatus>("", nullptr);
+
+    Inputs inputs(socket_path, operational_status);
+    if (!inputs.Initialize()) {
+        BOOST_FAIL("Failed to initialize inputs");
+    }
+
+    constexpr int num_events = 500;
+
+    Gate done_gate;
+    std::vector<std::string> _outputs;
+    std::thread input_thread([&]() {
+        Signals::InitThread();
+        int num_received = 0;
+        while (num_received < num_events) {
+            if (!inputs.HandleData([&num_received,&_outputs](void* ptr, size_t size) {
+                _outputs.emplace_back(reinterpret_cast<char*>(ptr), size);
+                num_received += 1;
+            })) {
+                break;
+            };
+        }
+        done_gate.Open();
+    });
+
+    inputs.Start();
+    output.Start();
+
+    // Wait for output to start
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (int i = 0; i < num_events; i++) {
+        if (!BuildEvent(builder, 1, 1, i, i)) {
+            BOOST_FAIL("Failed to build event");
+        }
+    }
+
+    if (!done_gate.Wait(Gate::OPEN, 10000)) {
+        BOOST_FAIL("Time out waiting for inputs");
+    }
+
+    // All events must be acked
+    QueueCursor last_cursor;
+    for (int i = 0; i < 100; i++) {
+        uint64_t bytes = 0;
+        uint64_t items = 0;
+        output.GetLag(&bytes, &items);
+        if (items == 0) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    uint64_t lag_bytes = 0;
+    uint64_t lag_items = 0;
+    output.GetLag(&lag_bytes, &lag_items);
+
+    output.Stop();
+    inputs.Stop();
+    queue->Close();
+    input_thread.join();
+
+    BOOST_CHECK_EQUAL(lag_items, 0);
+
+    bool found_v2 = false;
+    for (auto& msg : log_lines) {
+        if (starts_with(msg, "Output(output): Timeout waiting for Acks")) {
+            BOOST_FAIL("Found 'Timeout waiting for Acks' in log output");
+        }
+        if (msg.find("Using v2 acks (batch size 10, sender window 20)") != std::string::npos) {
+            found_v2 = true;
+        }
+    }
+    BOOST_CHECK(found_v2);
+
+    BOOST_REQUIRE_EQUAL(num_events, _outputs.size());
+    for (int i = 0; i < num_events; i++) {
+        Event event(_outputs[i].data(), _outputs[i].size());
+        BOOST_REQUIRE_EQUAL(i, event.Serial());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( v1_ack_compat_test ) {
+    TempDir dir("/tmp/OutputInputTests");
+
+    std::string socket_path = dir.Path() + "/input.socket";
+
+    Logger::SetLogFunction([](const char* ptr, size_t size){});
+
+    Signals::Init();
+    Signals::Start();
+
+    auto event_queue = std::make_shared<TestEventQueue>();
+    auto builder = std::make_shared<EventBuilder>(event_queue);
+
+    auto operational_status = std::make_shared<OperationalStatus>("", nullptr);
+    Inputs inputs(socket_path, operational_status);
+    if (!inputs.Initialize()) {
+        BOOST_FAIL("Failed to initialize inputs");
+    }
+
+    constexpr int num_events = 50;
+
+    std::thread input_thread([&]() {
+        Signals::InitThread();
+        int num_received = 0;
+        while (num_received < num_events) {
+            if (!inputs.HandleData([&num_received](void* ptr, size_t size) {
+                num_received += 1;
+            })) {
+                break;
+            };
+        }
+    });
+
+    inputs.Start();
+
+    // A sender that doesn't know about v2 acks: It ignores the hello and waits for each event to be acked.
+    UnixDomainWriter writer(socket_path);
+    BOOST_REQUIRE(writer.Open());
+    RawEventWriter event_writer;
+
+    EventId id;
+    BOOST_REQUIRE_EQUAL(event_writer.ReadAck(id, &writer), IO::OK);
+    BOOST_CHECK_EQUAL(GetAckHelloVersion(id), ACK_PROTOCOL_V2);
+
+    for (int i = 0; i < num_events; i++) {
+        if (!BuildEvent(builder, 1, 1, i, i)) {
+            BOOST_FAIL("Failed to build event");
+        }
+        BOOST_REQUIRE_EQUAL(event_writer.WriteEvent(event_queue->GetEvent(i), &writer), IO::OK);
+        BOOST_REQUIRE_EQUAL(event_writer.ReadAck(id, &writer), IO::OK);
+        BOOST_REQUIRE_EQUAL(id.Serial(), i);
+    }
+
+    writer.Close();
+    input_thread.join();
+    inputs.Stop();
+}
+
+BOOST_AUTO_TEST_CASE( v2_ack_batch_test ) {
+    TempDir dir("/tmp/OutputInputTests");
+
+    std::string socket_path = dir.Path() + "/input.socket";
+
+    Logger::SetLogFunction([](const char* ptr, size_t size){});
+
+    Signals::Init();
+    Signals::Start();
+
+    auto event_queue = std::make_shared<TestEventQueue>();
+    auto builder = std::make_shared<EventBuilder>(event_queue);
+
+    auto operational_status = std::make_shared<OperationalStatus>("", nullptr);
+    Inputs inputs(socket_path, operational_status);
+    inputs.SetAckBatching(16, 100000);
+    if (!inputs.Initialize()) {
+        BOOST_FAIL("Failed to initialize inputs");
+    }
+
+    constexpr int num_events = 256;
+
+    std::thread input_thread([&]() {
+        Signals::InitThread();
+        int num_received = 0;
+        while (num_received < num_events) {
+            if (!inputs.HandleData([&num_received](void* ptr, size_t size) {
+                num_received += 1;
+            })) {
+                break;
+            };
+        }
+    });
+
+    inputs.Start();
+
+    UnixDomainWriter writer(socket_path);
+    BOOST_REQUIRE(writer.Open());
+    RawEventWriter event_writer;
+
+    EventId id;
+    BOOST_REQUIRE_EQUAL(event_writer.ReadAck(id, &writer), IO::OK);
+    BOOST_REQUIRE_EQUAL(GetAckHelloVersion(id), ACK_PROTOCOL_V2);
+
+    auto control = MakeAckControl(ACK_PROTOCOL_V2, 64);
+    BOOST_REQUIRE_EQUAL(writer.WriteAll(control.data(), control.size(), -1, nullptr), IO::OK);
+
+    for (int i = 0; i < num_events; i++) {
+        if (!BuildEvent(builder, 1, 1, i, i)) {
+            BOOST_FAIL("Failed to build event");
+        }
+        BOOST_REQUIRE_EQUAL(event_writer.WriteEvent(event_queue->GetEvent(i), &writer), IO::OK);
+    }
+
+    // Acks are cumulative, read them until the last event is acked
+    int num_acks = 0;
+    uint64_t last_serial = 0;
+    do {
+        BOOST_REQUIRE_EQUAL(event_writer.ReadAck(id, &writer), IO::OK);
+        BOOST_REQUIRE(id.Serial() >= last_serial);
+        last_serial = id.Serial();
+        num_acks++;
+    } while (last_serial != num_events-1);
+
+    BOOST_CHECK_EQUAL(num_acks, num_events/16);
+
+    writer.Close();
+    input_thread.join();
+    inputs.Stop();
+}
+
+BOOST_AUTO_TEST_CASE( epoll_input_test ) {
+    TempDir dir("/tmp/OutputInputTests");
+
+    std::string socket_path = dir.Path() + "/input.socket";
+
+    Logger::SetLogFunction([](const char* ptr, size_t size){});
+
+    Signals::Init();
+    Signals::Start();
+
+    auto event_queue = std::make_shared<TestEventQueue>();
+    auto builder = std::make_shared<EventBuilder>(event_queue);
+
+    constexpr int num_senders = 4;
+    constexpr int num_events = 200;
+
+    for (int s = 0; s < num_senders; s++) {
+        for (int i = 0; i < num_events; i++) {
+            if (!BuildEvent(builder, 1, 1, s*1000+i, i)) {
+                BOOST_FAIL("Failed to build event");
+            }
+        }
+    }
+
+    auto operational_status = std::make_shared<OperationalStatus>("", nullptr);
+    // Use a small buffer so that connections get blocked waiting for free slots
+    Inputs inputs(socket_path, operational_status, 2);
+    inputs.SetAckBatching(16, 1000);
+    inputs.SetEpoll(2);
+    if (!inputs.Initialize()) {
+        BOOST_FAIL("Failed to initialize inputs");
+    }
+
+    std::vector<int> received(num_senders, 0);
+    std::thread input_thread([&]() {
+        Signals::InitThread();
+        int num_received = 0;
+        while (num_received < num_senders*num_events) {
+            if (!inputs.HandleData([&num_received,&received](void* ptr, size_t size) {
+                Event event(ptr, size);
+                received[event.Serial()/1000] += 1;
+                num_received += 1;
+            })) {
+                break;
+            };
+        }
+    });
+
+    inputs.Start();
+
+    // Half the senders use v1 acks (one ack per event), the other half v2 (cumulative) acks
+    std::vector<int> last_acked(num_senders, -1);
+    std::vector<std::thread> senders;
+    for (int s = 0; s < num_senders; s++) {
+        senders.emplace_back([&, s]() {
+            UnixDomainWriter writer(socket_path);
+            if (!writer.Open()) {
+                return;
+            }
+            RawEventWriter event_writer;
+            EventId id;
+            if (event_writer.ReadAck(id, &writer) != IO::OK || GetAckHelloVersion(id) != ACK_PROTOCOL_V2) {
+                return;
+            }
+            bool v2 = (s % 2) == 1;
+            if (v2) {
+                auto control = MakeAckControl(ACK_PROTOCOL_V2, 64);
+                if (writer.WriteAll(control.data(), control.size(), -1, nullptr) != IO::OK) {
+                    return;
+                }
+            }
+            for (int i = 0; i < num_events; i++) {
+                if (event_writer.WriteEvent(event_queue->GetEvent(s*num_events+i), &writer) != IO::OK) {
+                    return;
+                }
+                if (!v2) {
+                    if (event_writer.ReadAck(id, &writer) != IO::OK || id.Serial() != s*1000+i) {
+                        return;
+                    }
+                    last_acked[s] = i;
+                }
+            }
+            while (v2 && last_acked[s] != num_events-1) {
+                if (event_writer.ReadAck(id, &writer) != IO::OK) {
+                    return;
+                }
+                last_acked[s] = static_cast<int>(id.Serial()) - s*1000;
+            }
+            writer.Close();
+        });
+    }
+
+    for (auto& t : senders) {
+        t.join();
+    }
+    input_thread.join();
+    inputs.Stop();
+
+    for (int s = 0; s < num_senders; s++) {
+        BOOST_CHECK_EQUAL(received[s], num_events);
+        BOOST_CHECK_EQUAL(last_acked[s], num_events-1);
+    }
+}
+
+void run_shm_ring_test(size_t ring_size) {
+    TempDir dir("/tmp/OutputInputTests");
+
+    std::string cursor_path = dir.Path() + "/input.cursor";
+    std::string queue_path = dir.Path() + "/input.queue";
+    std::string socket_path = dir.Path() + "/input.socket";
+
+    std::mutex log_mutex;
+    std::vector<std::string> log_lines;
+    Logger::SetLogFunction([&log_mutex,&log_lines](const char* ptr, size_t size){
+        std::lock_guard<std::mutex> lock(log_mutex);
+        log_lines.emplace_back(ptr, size);
+    });
+
+    Signals::Init();
+    Signals::Start();
+
+    auto queue = std::make_shared<Queue>(queue_path, 16*1024*1024);
+    queue->Open();
+
+    auto event_queue = std::make_shared<EventQueue>(queue);
+    auto builder = std::make_shared<EventBuilder>(event_queue);
+
+    auto output_config = std::make_unique<Config>(std::unordered_map<std::string, std::string>({
+        {"output_format","raw"},
+        {"output_socket", socket_path},
+        {"enable_ack_mode", "true"},
+        {"ack_queue_size", "100"},
+        {"ack_timeout", "1000"},
+        {"enable_shm_ring", "true"}
+    }));
+    auto writer_factory = std::shared_ptr<IEventWriterFactory>(static_cast<IEventWriterFactory*>(new RawOnlyEventWriterFactory()));
+    Output output("output", cursor_path, queue, writer_factory, nullptr);
+    output.Load(output_config);
+
+    auto operational_status = std::make_shared<OperationalStatus>("", nullptr);
+
+    Inputs inputs(socket_path, operational_status);
+    inputs.SetSharedRing(ring_size);
+    if (!inputs.Initialize()) {
+        BOOST_FAIL("Failed to initialize inputs");
+    }
+
+    // Enough events to wrap around the ring several times
+    constexpr int num_events = 30000;
+
+    Gate done_gate;
+    std::vector<std::string> _outputs;
+    std::thread input_thread([&]() {
+        Signals::InitThread();
+        int num_received = 0;
+        while (num_received < num_events) {
+            if (!inputs.HandleData([&num_received,&_outputs](void* ptr, size_t size) {
+                _outputs.emplace_back(reinterpret_cast<char*>(ptr), size);
+                num_received += 1;
+            })) {
+                break;
+            };
+        }
+        done_gate.Open();
+    });
+
+    inputs.Start();
+    output.Start();
+
+    // Wait for output to start
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (int i = 0; i < num_events; i++) {
+        if (!BuildEvent(builder, 1, 1, i, i)) {
+            BOOST_FAIL("Failed to build event");
+        }
+    }
+
+    if (!done_gate.Wait(Gate::OPEN, 10000)) {
+        BOOST_FAIL("Time out waiting for inputs");
+    }
+
+    // All events must be acked
+    for (int i = 0; i < 100; i++) {
+        uint64_t bytes = 0;
+        uint64_t items = 0;
+        output.GetLag(&bytes, &items);
+        if (items == 0) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    uint64_t lag_bytes = 0;
+    uint64_t lag_items = 0;
+    output.GetLag(&lag_bytes, &lag_items);
+
+    output.Stop();
+    inputs.Stop();
+    queue->Close();
+    input_thread.join();
+
+    BOOST_CHECK_EQUAL(lag_items, 0);
+
+    bool found_switch = false;
+    for (auto& msg : log_lines) {
+        if (starts_with(msg, "Output(output): Timeout waiting for Acks")) {
+            BOOST_FAIL("Found 'Timeout waiting for Acks' in log output");
+        }
+        if (msg.find("Reading events from shared memory ring") != std::string::npos) {
+            found_switch = true;
+        }
+    }
+    BOOST_CHECK_EQUAL(found_switch, ring_size > 0);
+
+    BOOST_REQUIRE_EQUAL(num_events, _outputs.size());
+    for (int i = 0; i < num_events; i++) {
+        Event event(_outputs[i].data(), _outputs[i].size());
+        BOOST_REQUIRE_EQUAL(i, event.Serial());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( shm_ring_test ) {
+    run_shm_ring_test(SharedRing::MIN_SIZE);
+}
+
+BOOST_AUTO_TEST_CASE( shm_ring_fallback_test ) {
+    // The receiver doesn't offer a ring, so the socket is used
+    run_shm_ring_test(0);
+}
+
+BOOST_AUTO_TEST_CASE( shm_ring_sealed_test ) {
+    Logger::SetLogFunction([](const char* ptr, size_t size){});
+
+    auto ring = SharedRing::Create(SharedRing::MIN_SIZE);
+    BOOST_REQUIRE(ring);
+
+    // The ring memory can't be resized
+    auto mem_fd = ring->Fds()[0];
+    struct stat st;
+    BOOST_REQUIRE_EQUAL(fstat(mem_fd, &st), 0);
+    BOOST_REQUIRE_NE(ftruncate(mem_fd, st.st_size/2), 0);
+    BOOST_REQUIRE_NE(ftruncate(mem_fd, st.st_size*2), 0);
+
+    std::vector<int> fds;
+    for (auto fd : ring->Fds()) {
+        fds.emplace_back(dup(fd));
+    }
+    auto producer = SharedRing::Attach(fds);
+    BOOST_REQUIRE(producer);
+    BOOST_REQUIRE_EQUAL(producer->Write("test", 4, ring->AckFd(), nullptr), IO::OK);
+    const void* data = nullptr;
+    BOOST_REQUIRE_EQUAL(ring->Peek(&data), 4);
+    BOOST_REQUIRE_EQUAL(std::string(reinterpret_cast<const char*>(data), 4), "test");
+
+    // A ring whose memory isn't sealed is refused
+    fds.clear();
+    fds.emplace_back(static_cast<int>(syscall(__NR_memfd_create, "test", 0)));
+    BOOST_REQUIRE(fds[0] >= 0);
+    BOOST_REQUIRE_EQUAL(ftruncate(fds[0], st.st_size), 0);
+    for (size_t i = 1; i < SharedRing::NUM_FDS; ++i) {
+        fds.emplace_back(eventfd(0, EFD_NONBLOCK));
+    }
+    BOOST_REQUIRE(!SharedRing::Attach(fds));
+}
+
+class CountingReader: public IOBase {
+public:
+    explicit CountingReader(int fd): IOBase(fd), num_reads(0) {}
+
+    ssize_t Read(void *buf, size_t buf_size, const std::function<bool()>& fn) override {
+        num_reads++;
+        return IOBase::Read(buf, buf_size, fn);
+    }
+
+    ssize_t ReadAll(void *buf, size_t buf_size, const std::function<bool()>& fn) override {
+        num_reads++;
+        return IOBase::ReadAll(buf, buf_size, fn);
+    }
+
+    int num_reads;
+};
+
+BOOST_AUTO_TEST_CASE( buffered_reader_test ) {
+    Logger::SetLogFunction([](const char* ptr, size_t size){});
+
+    auto event_queue = std::make_shared<TestEventQueue>();
+    auto builder = std::make_shared<EventBuilder>(event_queue);
+
+    constexpr int num_events = 2000;
+    for (int i = 0; i < num_events; i++) {
+        if (!BuildEvent(builder, 1, 1, i, i)) {
+            BOOST_FAIL("Failed to build event");
+        }
+    }
+
+    int fds[2];
+    BOOST_REQUIRE_EQUAL(pipe(fds), 0);
+
+    std::thread writer_thread([&]() {
+        IOBase output(fds[1]);
+        RawEventWriter event_writer;
+        for (int i = 0; i < num_events; i++) {
+            if (event_writer.WriteEvent(event_queue->GetEvent(i), &output) != IO::OK) {
+                return;
+            }
+            // Include an event larger than the BufferedReader's buffer
+            if (i == num_events/2) {
+                std::vector<uint8_t> big(BufferedReader::DEFAULT_BUFFER_SIZE + 1000, 0);
+                uint32_t hdr = (EVENT_FORMAT_V1 << 24) | static_cast<uint32_t>(big.size());
+                memcpy(big.data(), &hdr, sizeof(hdr));
+                if (output.WriteAll(big.data(), big.size(), -1, nullptr) != IO::OK) {
+                    return;
+                }
+            }
+        }
+    });
+
+    CountingReader input(fds[0]);
+    BufferedReader in(&input, 64*1024);
+    RawEventReader reader;
+
+    int num_received = 0;
+    int num_oversized = 0;
+    for (;;) {
+        const void* data = nullptr;
+        auto ret = reader.ReadEventView(&in, 1024*1024, &data, nullptr);
+        if (ret <= 0) {
+            BOOST_REQUIRE_EQUAL(ret, IO::CLOSED);
+            break;
+        }
+        if (static_cast<size_t>(ret) > BufferedReader::DEFAULT_BUFFER_SIZE) {
+            num_oversized++;
+            continue;
+        }
+        Event event(data, ret);
+        BOOST_REQUIRE_EQUAL(event.Serial(), num_received);
+        num_received++;
+    }
+    writer_thread.join();
+
+    BOOST_CHECK_EQUAL(num_received, num_events);
+    BOOST_CHECK_EQUAL(num_oversized, 1);
+    BOOST_TEST_MESSAGE("BufferedReader: " << input.num_reads << " reads for " << num_events+1 << " events");
+    // Unbuffered, each event takes at least two reads
+    BOOST_CHECK_LT(input.num_reads, num_events);
+}
@@ -76,6 +76,23 @@ void Outputs::Reload(const std::vector<std::string>& allowed_socket_dirs) {
     _run_cond.notify_all();
 }
 
+void Outputs::GetMaxLag(uint64_t* bytes, uint64_t* items) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    *bytes = 0;
+    *items = 0;
+    for (auto& ent: _outputs) {
+        uint64_t b = 0;
+        uint64_t i = 0;
+        ent.second->GetLag(&b, &i);
+        if (b > *bytes) {
+            *bytes = b;
+        }
+        if (i > *items) {
+            *items = i;
+        }
+    }
+}
+
 void Outputs::on_stop() {
     for( auto ent: _outputs) {
         ent.second->Stop();
@@ -244,6 +261,9 @@ void Outputs::do_conf_sync() {
         } else {
             auto cursor_file = _cursor_dir + "/" + ent.first + ".cursor";
             auto o = std::make_shared<Output>(ent.first, cursor_file, _queue, _writer_factory, _filter_factory);
+            if (_metrics) {
+                o->SetMetrics(_metrics);
+            }
             it = _outputs.insert(std::make_pair(ent.first, o)).first;
             load = true;
         }
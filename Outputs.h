@@ -58,6 +58,14 @@ public:
 
     void Reload(const std::vector<std::string>& allowed_socket_dirs);
 
+    // Must be called before Start()
+    void SetMetrics(const std::shared_ptr<Metrics>& metrics) {
+        _metrics = metrics;
+    }
+
+    // Get the largest lag (bytes and items) across all outputs
+    void GetMaxLag(uint64_t* bytes, uint64_t* items);
+
 protected:
     virtual void on_stop();
     virtual void run();
@@ -73,6 +81,7 @@ private:
     std::vector<std::string> _allowed_socket_dirs;
     std::shared_ptr<IEventWriterFactory> _writer_factory;
     std::shared_ptr<IEventFilterFactory> _filter_factory;
+    std::shared_ptr<Metrics> _metrics;
     bool _do_reload;
     std::mutex _mutex;
     std::condition_variable _cond;
@@ -0,0 +1,402 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "OverloadController.h"
+
+#include "Logger.h"
+#include "Translate.h"
+#include "StringUtils.h"
+
+#include <chrono>
+
+// Character that separates key in AUDIT_FILTERKEY field in rules
+// This value mirrors what is defined for AUDIT_KEY_SEPARATOR in libaudit.h
+#define KEY_SEP 0x01
+
+static const std::string CONFIG_PARAM_NAME = "overload_shed_classes";
+static const std::string DEGRADED_LAG_PARAM_NAME = "degraded_mode_lag";
+static const std::string DEGRADED_AGE_PARAM_NAME = "degraded_mode_age";
+
+/*****************************************************************************
+ ** OverloadShedClass
+ *****************************************************************************/
+
+bool OverloadShedClass::Matches(RecordType rtype, const std::string_view& syscall, const std::string_view& keys, const std::string_view& exe) const {
+    if (!_record_types.empty() && _record_types.count(static_cast<int>(rtype)) == 0) {
+        return false;
+    }
+
+    if (!_syscalls.empty() && (syscall.empty() || _syscalls.count(std::string(syscall)) == 0)) {
+        return false;
+    }
+
+    if (!_keys.empty()) {
+        bool found = false;
+        std::string_view rest = keys;
+        while (!rest.empty() && !found) {
+            auto idx = rest.find(static_cast<char>(KEY_SEP));
+            auto key = rest.substr(0, idx);
+            if (_keys.count(std::string(key)) > 0) {
+                found = true;
+            }
+            if (idx == std::string_view::npos) {
+                break;
+            }
+            rest = rest.substr(idx+1);
+        }
+        if (!found) {
+            return false;
+        }
+    }
+
+    if (!_exe_prefixes.empty()) {
+        bool found = false;
+        for (auto& prefix: _exe_prefixes) {
+            if (starts_with(exe, prefix)) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*****************************************************************************
+ ** OverloadController
+ *****************************************************************************/
+
+static bool parse_string_array(const rapidjson::Value& value, std::vector<std::string>& out) {
+    if (!value.IsArray()) {
+        return false;
+    }
+    for (auto it = value.Begin(); it != value.End(); ++it) {
+        if (!it->IsString()) {
+            return false;
+        }
+        out.emplace_back(it->GetString(), it->GetStringLength());
+    }
+    return true;
+}
+
+bool OverloadController::parse_degraded_config(const Config& config) {
+    _degraded_lag = 0;
+    _degraded_age = 0;
+
+    for (auto& param : {DEGRADED_LAG_PARAM_NAME, DEGRADED_AGE_PARAM_NAME}) {
+        if (config.HasKey(param)) {
+            uint64_t val;
+            try {
+                val = config.GetUint64(param);
+            } catch (std::exception& ex) {
+                Logger::Error("Invalid '%s' value: %s", param.c_str(), config.GetString(param).c_str());
+                return false;
+            }
+            if (param == DEGRADED_LAG_PARAM_NAME) {
+                _degraded_lag = val;
+            } else {
+                _degraded_age = val;
+            }
+        }
+    }
+
+    if (_degraded_lag > 0 || _degraded_age > 0) {
+        _occupancy_metric = _metrics->AddMetric("overload", "occupancy", MetricPeriod::SECOND, MetricPeriod::HOUR);
+        _degraded_metric = _metrics->AddMetric("overload", "degraded", MetricPeriod::SECOND, MetricPeriod::HOUR);
+        _degraded_events_metric = _metrics->AddMetric("overload", "degraded_events", MetricPeriod::SECOND, MetricPeriod::HOUR);
+        Logger::Info("OverloadController: Degraded mode enabled: lag %ld events, age %ld seconds", _degraded_lag, _degraded_age);
+    }
+
+    return true;
+}
+
+bool OverloadController::ParseConfig(const Config& config) {
+    _classes.clear();
+
+    if (!parse_degraded_config(config)) {
+        return false;
+    }
+
+    if (!config.HasKey(CONFIG_PARAM_NAME)) {
+        return true;
+    }
+
+    auto doc = config.GetJSON(CONFIG_PARAM_NAME);
+    if (!doc.IsArray()) {
+        Logger::Error("Invalid value for '%s': Expected JSON array", CONFIG_PARAM_NAME.c_str());
+        return false;
+    }
+
+    int idx = 0;
+    for (auto it = doc.Begin(); it != doc.End(); ++it, idx++) {
+        if (!it->IsObject()) {
+            Logger::Error("Invalid entry at (%d) in config for '%s'", idx, CONFIG_PARAM_NAME.c_str());
+            _classes.clear();
+            return false;
+        }
+
+        if (_classes.size() >= MAX_SHED_CLASSES) {
+            Logger::Error("Too many entries in config for '%s': Max is %ld", CONFIG_PARAM_NAME.c_str(), MAX_SHED_CLASSES);
+            _classes.clear();
+            return false;
+        }
+
+        rapidjson::Value::ConstMemberIterator mi;
+
+        mi = it->FindMember("name");
+        if (mi == it->MemberEnd() || !mi->value.IsString()) {
+            Logger::Error("Missing or invalid entry (name) at (%d) in config for '%s'", idx, CONFIG_PARAM_NAME.c_str());
+            _classes.clear();
+            return false;
+        }
+
+        auto sc = std::make_unique<OverloadShedClass>(std::string(mi->value.GetString(), mi->value.GetStringLength()));
+
+        mi = it->FindMember("occupancy");
+        if (mi != it->MemberEnd()) {
+            if (mi->value.IsNumber() && mi->value.GetDouble() > 0 && mi->value.GetDouble() <= 100) {
+                sc->_occupancy = mi->value.GetDouble();
+            } else {
+                Logger::Error("Invalid entry (%s) at (%d) in config for '%s'", mi->name.GetString(), idx, CONFIG_PARAM_NAME.c_str());
+                _classes.clear();
+                return false;
+            }
+        }
+
+        mi = it->FindMember("lag");
+        if (mi != it->MemberEnd()) {
+            if (mi->value.IsUint64() && mi->value.GetUint64() > 0) {
+                sc->_lag = mi->value.GetUint64();
+            } else {
+                Logger::Error("Invalid entry (%s) at (%d) in config for '%s'", mi->name.GetString(), idx, CONFIG_PARAM_NAME.c_str());
+                _classes.clear();
+                return false;
+            }
+        }
+
+        if (sc->_occupancy == 0 && sc->_lag == 0) {
+            Logger::Error("Entry (%s) at (%d) in config for '%s' must have an 'occupancy' or 'lag' threshold", sc->_name.c_str(), idx, CONFIG_PARAM_NAME.c_str());
+            _classes.clear();
+            return false;
+        }
+
+        std::vector<std::string> values;
+
+        mi = it->FindMember("record_types");
+        if (mi != it->MemberEnd()) {
+            values.clear();
+            if (!parse_string_array(mi->value, values)) {
+                Logger::Error("Invalid entry (%s) at (%d) in config for '%s'", mi->name.GetString(), idx, CONFIG_PARAM_NAME.c_str());
+                _classes.clear();
+                return false;
+            }
+            for (auto& name: values) {
+                auto rtype = RecordNameToType(name);
+                if (rtype == RecordType::UNKNOWN) {
+                    Logger::Error("Invalid record type (%s) at (%d) in config for '%s'", name.c_str(), idx, CONFIG_PARAM_NAME.c_str());
+                    _classes.clear();
+                    return false;
+                }
+                sc->_record_types.emplace(static_cast<int>(rtype));
+            }
+        }
+
+        mi = it->FindMember("syscalls");
+        if (mi != it->MemberEnd()) {
+            values.clear();
+            if (!parse_string_array(mi->value, values)) {
+                Logger::Error("Invalid entry (%s) at (%d) in config for '%s'", mi->name.GetString(), idx, CONFIG_PARAM_NAME.c_str());
+                _classes.clear();
+                return false;
+            }
+            sc->_syscalls.insert(values.begin(), values.end());
+        }
+
+        mi = it->FindMember("keys");
+        if (mi != it->MemberEnd()) {
+            values.clear();
+            if (!parse_string_array(mi->value, values)) {
+                Logger::Error("Invalid entry (%s) at (%d) in config for '%s'", mi->name.GetString(), idx, CONFIG_PARAM_NAME.c_str());
+                _classes.clear();
+                return false;
+            }
+            sc->_keys.insert(values.begin(), values.end());
+        }
+
+        mi = it->FindMember("exe_prefixes");
+        if (mi != it->MemberEnd()) {
+            if (!parse_string_array(mi->value, sc->_exe_prefixes)) {
+                Logger::Error("Invalid entry (%s) at (%d) in config for '%s'", mi->name.GetString(), idx, CONFIG_PARAM_NAME.c_str());
+                _classes.clear();
+                return false;
+            }
+        }
+
+        if (!AddShedClass(std::move(sc))) {
+            Logger::Error("Failed to add entry at (%d) in config for '%s'", idx, CONFIG_PARAM_NAME.c_str());
+            _classes.clear();
+            return false;
+        }
+    }
+
+    if (!_classes.empty()) {
+        Logger::Info("OverloadController: %ld shed classes configured", _classes.size());
+    }
+
+    return true;
+}
+
+bool OverloadController::AddShedClass(std::unique_ptr<OverloadShedClass> sc) {
+    if (_classes.size() >= MAX_SHED_CLASSES || (sc->_occupancy == 0 && sc->_lag == 0)) {
+        return false;
+    }
+
+    sc->_metric = _metrics->AddMetric("overload", "shed_" + sc->_name, MetricPeriod::SECOND, MetricPeriod::HOUR);
+    _classes.emplace_back(std::move(sc));
+
+    if (!_occupancy_metric) {
+        _occupancy_metric = _metrics->AddMetric("overload", "occupancy", MetricPeriod::SECOND, MetricPeriod::HOUR);
+    }
+
+    return true;
+}
+
+bool OverloadController::ShouldShed(RecordType rtype, const std::string_view& syscall, const std::string_view& keys, const std::string_view& exe) {
+    auto mask = _active_mask.load(std::memory_order_relaxed);
+    for (size_t i = 0; mask != 0 && i < _classes.size(); ++i, mask >>= 1) {
+        if ((mask & 1) != 0 && _classes[i]->Matches(rtype, syscall, keys, exe)) {
+            _classes[i]->_shed_count.fetch_add(1, std::memory_order_relaxed);
+            _classes[i]->_metric->Add(1.0);
+            return true;
+        }
+    }
+    return false;
+}
+
+void OverloadController::run() {
+    if (_classes.empty() && _degraded_lag == 0 && _degraded_age == 0) {
+        return;
+    }
+
+    Logger::Info("OverloadController: Starting");
+
+    auto last_report = std::chrono::steady_clock::now();
+    while (!_sleep(SAMPLE_INTERVAL)) {
+        uint64_t lag_bytes = 0;
+        uint64_t lag_items = 0;
+        _lag_fn(&lag_bytes, &lag_items);
+        Update(lag_bytes, lag_items);
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_report >= std::chrono::seconds(REPORT_INTERVAL)) {
+            report();
+            last_report = now;
+        }
+    }
+
+    Logger::Info("OverloadController: Stopping");
+}
+
+void OverloadController::Update(uint64_t lag_bytes, uint64_t lag_items) {
+    if (_classes.empty() && _degraded_lag == 0 && _degraded_age == 0) {
+        return;
+    }
+
+    double occupancy = (static_cast<double>(lag_bytes) * 100.0) / static_cast<double>(_queue->DataSize());
+    _last_occupancy = occupancy;
+    _last_lag = lag_items;
+    _occupancy_metric->Set(occupancy);
+
+    uint64_t mask = 0;
+    for (size_t i = 0; i < _classes.size(); ++i) {
+        auto& sc = _classes[i];
+        bool over = (sc->_occupancy > 0 && occupancy >= sc->_occupancy) || (sc->_lag > 0 && lag_items >= sc->_lag);
+        bool under = (sc->_occupancy == 0 || occupancy < (sc->_occupancy * HYSTERESIS_PCT) / 100.0) &&
+                (sc->_lag == 0 || static_cast<double>(lag_items) < (static_cast<double>(sc->_lag) * HYSTERESIS_PCT) / 100.0);
+
+        if (!sc->_active && over) {
+            sc->_active = true;
+            Logger::Warn("OverloadController: Started shedding '%s' events: queue occupancy %.1f%%, lag %ld events", sc->_name.c_str(), occupancy, lag_items);
+        } else if (sc->_active && under) {
+            sc->_active = false;
+            auto count = sc->_shed_count.load(std::memory_order_relaxed);
+            Logger::Info("OverloadController: Stopped shedding '%s' events: queue occupancy %.1f%%, lag %ld events, %ld events shed", sc->_name.c_str(), occupancy, lag_items, count - sc->_reported_count);
+            sc->_reported_count = count;
+        }
+        if (sc->_active) {
+            mask |= static_cast<uint64_t>(1) << i;
+        }
+    }
+
+    _active_mask.store(mask, std::memory_order_relaxed);
+
+    if (_degraded_lag > 0 || _degraded_age > 0) {
+        update_degraded(lag_items);
+    }
+}
+
+void OverloadController::update_degraded(uint64_t lag_items) {
+    // The age is only known if events were processed since the last update, an idle processor is not behind.
+    uint64_t age = 0;
+    auto event_sec = _last_event_sec.exchange(0, std::memory_order_relaxed);
+    if (event_sec != 0) {
+        auto now_sec = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+        if (now_sec > event_sec) {
+            age = now_sec - event_sec;
+        }
+    }
+    _last_age = age;
+
+    bool over = (_degraded_lag > 0 && lag_items >= _degraded_lag) || (_degraded_age > 0 && age >= _degraded_age);
+    bool under = (_degraded_lag == 0 || static_cast<double>(lag_items) < (static_cast<double>(_degraded_lag) * HYSTERESIS_PCT) / 100.0) &&
+            (_degraded_age == 0 || static_cast<double>(age) < (static_cast<double>(_degraded_age) * HYSTERESIS_PCT) / 100.0);
+
+    auto degraded = _degraded.load(std::memory_order_relaxed);
+    if (!degraded && over) {
+        degraded = true;
+        _degraded_start = std::chrono::steady_clock::now();
+        Logger::Warn("OverloadController: Entering degraded mode: lag %ld events, event age %ld seconds", lag_items, age);
+    } else if (degraded && under) {
+        degraded = false;
+        auto secs = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - _degraded_start).count();
+        auto count = _degraded_count.load(std::memory_order_relaxed);
+        Logger::Info("OverloadController: Leaving degraded mode after %ld seconds: lag %ld events, event age %ld seconds, %ld events degraded", secs, lag_items, age, count - _reported_degraded_count);
+        _reported_degraded_count = count;
+    }
+    _degraded.store(degraded, std::memory_order_relaxed);
+
+    // The avg over the agg period is the fraction of time spent in degraded mode
+    _degraded_metric->Set(degraded ? 1.0 : 0.0);
+}
+
+void OverloadController::report() {
+    for (auto& sc: _classes) {
+        auto count = sc->_shed_count.load(std::memory_order_relaxed);
+        if (sc->_active && count > sc->_reported_count) {
+            Logger::Warn("OverloadController: Shed %ld '%s' events in the last %d seconds: queue occupancy %.1f%%, lag %ld events", count - sc->_reported_count, sc->_name.c_str(), REPORT_INTERVAL, _last_occupancy, _last_lag);
+            sc->_reported_count = count;
+        }
+    }
+
+    auto count = _degraded_count.load(std::memory_order_relaxed);
+    if (_degraded.load(std::memory_order_relaxed) && count > _reported_degraded_count) {
+        Logger::Warn("OverloadController: Degraded %ld events in the last %d seconds: lag %ld events, event age %ld seconds", count - _reported_degraded_count, REPORT_INTERVAL, _last_lag, _last_age);
+        _reported_degraded_count = count;
+    }
+}
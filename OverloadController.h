@@ -0,0 +1,153 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef AUOMS_OVERLOADCONTROLLER_H
+#define AUOMS_OVERLOADCONTROLLER_H
+
+#include "RunBase.h"
+#include "Queue.h"
+#include "Config.h"
+#include "Metrics.h"
+#include "RecordType.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+/*
+ * A class of events that may be shed (dropped before processing) when auoms falls behind.
+ *
+ * A shed class becomes active when the queue occupancy (the percentage of the queue holding data not yet
+ * consumed by the slowest output) or the output lag (in events) reaches the configured threshold.
+ * It becomes inactive again once both values drop below HYSTERESIS_PCT percent of their thresholds.
+ *
+ * An event matches a class if it matches every criteria that the class defines.
+ * Criteria left unset match everything.
+ */
+class OverloadShedClass {
+public:
+    explicit OverloadShedClass(const std::string& name): _name(name), _occupancy(0), _lag(0), _active(false), _shed_count(0), _reported_count(0) {}
+
+    bool Matches(RecordType rtype, const std::string_view& syscall, const std::string_view& keys, const std::string_view& exe) const;
+
+    std::string _name;
+    double _occupancy; // Percent, 0 == not used
+    uint64_t _lag;     // Events, 0 == not used
+    std::unordered_set<int> _record_types;
+    std::unordered_set<std::string> _syscalls;
+    std::unordered_set<std::string> _keys;
+    std::vector<std::string> _exe_prefixes;
+
+    bool _active;
+    std::atomic<uint64_t> _shed_count;
+    uint64_t _reported_count;
+    std::shared_ptr<Metric> _metric;
+};
+
+/*
+ * Watches the queue and output lag and activates the shed classes (see OverloadShedClass) and degraded mode.
+ *
+ * Degraded mode becomes active when the output lag (in events) or the event age (how far, in seconds, the event
+ * processing is behind the kernel event timestamps) reaches the configured threshold. It becomes inactive
+ * again once both values drop below HYSTERESIS_PCT percent of their thresholds. While degraded, events are
+ * forwarded with their raw fields only (see RawEventProcessor) and marked with EVENT_FLAG_IS_DEGRADED.
+ */
+class OverloadController: public RunBase {
+public:
+    static constexpr int SAMPLE_INTERVAL = 1000; // Milliseconds
+    static constexpr int REPORT_INTERVAL = 60; // Seconds
+    static constexpr double HYSTERESIS_PCT = 80.0;
+    static constexpr size_t MAX_SHED_CLASSES = 64;
+
+    // lag_fn must return the bytes and items not yet consumed by the slowest consumer of queue
+    OverloadController(const std::shared_ptr<Queue>& queue, std::function<void(uint64_t* bytes, uint64_t* items)> lag_fn, const std::shared_ptr<Metrics>& metrics):
+        _queue(queue), _lag_fn(std::move(lag_fn)), _metrics(metrics), _active_mask(0), _last_occupancy(0), _last_lag(0),
+        _degraded_lag(0), _degraded_age(0), _degraded(false), _degraded_count(0), _reported_degraded_count(0), _last_event_sec(0), _last_age(0) {}
+
+    // Must be called before Start()
+    bool ParseConfig(const Config& config);
+
+    // Must be called before Start(). Returns false if there are already MAX_SHED_CLASSES classes, or
+    // the class has neither an occupancy nor a lag threshold.
+    bool AddShedClass(std::unique_ptr<OverloadShedClass> sc);
+
+    inline bool IsShedding() const {
+        return _active_mask.load(std::memory_order_relaxed) != 0;
+    }
+
+    inline bool IsDegraded() const {
+        return _degraded.load(std::memory_order_relaxed);
+    }
+
+    // Called by the event processor for each event, so that the event age can be tracked.
+    inline void SetLastEventTime(uint64_t sec) {
+        if (_last_event_sec.load(std::memory_order_relaxed) != sec) {
+            _last_event_sec.store(sec, std::memory_order_relaxed);
+        }
+    }
+
+    // Called by the event processor for each event processed in degraded mode
+    void AddDegradedEvent() {
+        _degraded_count.fetch_add(1, std::memory_order_relaxed);
+        _degraded_events_metric->Add(1.0);
+    }
+
+    uint64_t DegradedEventCount() const {
+        return _degraded_count.load(std::memory_order_relaxed);
+    }
+
+    // Activates or deactivates the shed classes and degraded mode. Called by run() every SAMPLE_INTERVAL.
+    void Update(uint64_t lag_bytes, uint64_t lag_items);
+
+    // Returns true if the event should be dropped.
+    // keys is the unescaped key field value (multiple keys are separated by 0x01).
+    bool ShouldShed(RecordType rtype, const std::string_view& syscall, const std::string_view& keys, const std::string_view& exe);
+
+protected:
+    void run() override;
+
+private:
+    bool parse_degraded_config(const Config& config);
+    void update_degraded(uint64_t lag_items);
+    void report();
+
+    std::shared_ptr<Queue> _queue;
+    std::function<void(uint64_t* bytes, uint64_t* items)> _lag_fn;
+    std::shared_ptr<Metrics> _metrics;
+    std::shared_ptr<Metric> _occupancy_metric;
+    std::vector<std::unique_ptr<OverloadShedClass>> _classes;
+    std::atomic<uint64_t> _active_mask;
+    double _last_occupancy;
+    uint64_t _last_lag;
+
+    uint64_t _degraded_lag; // Events, 0 == not used
+    uint64_t _degraded_age; // Seconds, 0 == not used
+    std::atomic<bool> _degraded;
+    std::atomic<uint64_t> _degraded_count;
+    uint64_t _reported_degraded_count;
+    std::chrono::steady_clock::time_point _degraded_start;
+    std::atomic<uint64_t> _last_event_sec;
+    uint64_t _last_age;
+    std::shared_ptr<Metric> _degraded_metric;
+    std::shared_ptr<Metric> _degraded_events_metric;
+};
+
+#endif //AUOMS_OVERLOADCONTROLLER_H
@@ -0,0 +1,305 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved. 
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "Config.h"
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "OverloadControllerTests"
+#include <boost/test/unit_test.hpp>
+
+#include "OverloadController.h"
+#include "TestEventQueue.h"
+
+#include <chrono>
+
+static uint64_t now_secs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+static std::shared_ptr<OverloadController> new_controller(const std::unordered_map<std::string, std::string>& params, const std::shared_ptr<Queue>& queue = std::make_shared<Queue>(Queue::MIN_QUEUE_SIZE)) {
+    auto metrics_allocator = std::shared_ptr<IEventBuilderAllocator>(new TestEventQueue());
+    auto metrics = std::make_shared<Metrics>(std::make_shared<EventBuilder>(metrics_allocator));
+    auto controller = std::make_shared<OverloadController>(queue, [](uint64_t* bytes, uint64_t* items) { *bytes = 0; *items = 0; }, metrics);
+    BOOST_REQUIRE(controller->ParseConfig(Config(params)));
+    return controller;
+}
+
+BOOST_AUTO_TEST_CASE( degraded_lag_enter_exit ) {
+    auto controller = new_controller({{"degraded_mode_lag", "1000"}});
+
+    controller->Update(0, 999);
+    BOOST_CHECK(!controller->IsDegraded());
+
+    controller->Update(0, 1000);
+    BOOST_CHECK(controller->IsDegraded());
+
+    // Stays degraded until the lag drops below HYSTERESIS_PCT of the threshold
+    controller->Update(0, 999);
+    BOOST_CHECK(controller->IsDegraded());
+    controller->Update(0, 800);
+    BOOST_CHECK(controller->IsDegraded());
+
+    controller->Update(0, 799);
+    BOOST_CHECK(!controller->IsDegraded());
+
+    controller->Update(0, 999);
+    BOOST_CHECK(!controller->IsDegraded());
+}
+
+BOOST_AUTO_TEST_CASE( degraded_age_enter_exit ) {
+    auto controller = new_controller({{"degraded_mode_age", "100"}});
+
+    controller->SetLastEventTime(now_secs() - 10);
+    controller->Update(0, 1000000);
+    BOOST_CHECK(!controller->IsDegraded());
+
+    controller->SetLastEventTime(now_secs() - 200);
+    controller->Update(0, 0);
+    BOOST_CHECK(controller->IsDegraded());
+
+    controller->SetLastEventTime(now_secs() - 90);
+    controller->Update(0, 0);
+    BOOST_CHECK(controller->IsDegraded());
+
+    controller->SetLastEventTime(now_secs() - 10);
+    controller->Update(0, 0);
+    BOOST_CHECK(!controller->IsDegraded());
+
+    // No events since the last update means the processor isn't behind
+    controller->SetLastEventTime(now_secs() - 200);
+    controller->Update(0, 0);
+    BOOST_CHECK(controller->IsDegraded());
+    controller->Update(0, 0);
+    BOOST_CHECK(!controller->IsDegraded());
+}
+
+BOOST_AUTO_TEST_CASE( degraded_lag_and_age ) {
+    auto controller = new_controller({{"degraded_mode_lag", "1000"}, {"degraded_mode_age", "100"}});
+
+    controller->SetLastEventTime(now_secs() - 200);
+    controller->Update(0, 0);
+    BOOST_CHECK(controller->IsDegraded());
+
+    // Both values must drop below the hysteresis threshold
+    controller->Update(0, 900);
+    BOOST_CHECK(controller->IsDegraded());
+    controller->Update(0, 0);
+    BOOST_CHECK(!controller->IsDegraded());
+}
+
+BOOST_AUTO_TEST_CASE( degraded_disabled ) {
+    auto controller = new_controller({});
+
+    controller->SetLastEventTime(now_secs() - 1000000);
+    controller->Update(0, 1000000);
+    BOOST_CHECK(!controller->IsDegraded());
+}
+
+BOOST_AUTO_TEST_CASE( degraded_event_count ) {
+    auto controller = new_controller({{"degraded_mode_lag", "1000"}});
+
+    BOOST_CHECK_EQUAL(controller->DegradedEventCount(), 0);
+
+    controller->Update(0, 1000);
+    for (int i = 0; i < 10; ++i) {
+        controller->AddDegradedEvent();
+    }
+    BOOST_CHECK_EQUAL(controller->DegradedEventCount(), 10);
+
+    // The count is cumulative across degraded periods
+    controller->Update(0, 0);
+    controller->Update(0, 1000);
+    controller->AddDegradedEvent();
+    BOOST_CHECK_EQUAL(controller->DegradedEventCount(), 11);
+}
+
+static std::unique_ptr<OverloadShedClass> new_shed_class(const std::string& name, double occupancy, uint64_t lag) {
+    auto sc = std::make_unique<OverloadShedClass>(name);
+    sc->_occupancy = occupancy;
+    sc->_lag = lag;
+    return sc;
+}
+
+static const std::string_view KEYS_SEP = "\x01";
+
+BOOST_AUTO_TEST_CASE( shed_class_matches_unset ) {
+    OverloadShedClass sc("all");
+
+    BOOST_CHECK(sc.Matches(RecordType::SYSCALL, "execve", "", "/usr/bin/ls"));
+    BOOST_CHECK(sc.Matches(RecordType::USER_LOGIN, "", "", ""));
+}
+
+BOOST_AUTO_TEST_CASE( shed_class_matches_record_type ) {
+    OverloadShedClass sc("rtype");
+    sc._record_types.emplace(static_cast<int>(RecordType::SYSCALL));
+
+    BOOST_CHECK(sc.Matches(RecordType::SYSCALL, "execve", "", ""));
+    BOOST_CHECK(!sc.Matches(RecordType::USER_LOGIN, "execve", "", ""));
+}
+
+BOOST_AUTO_TEST_CASE( shed_class_matches_syscall ) {
+    OverloadShedClass sc("syscall");
+    sc._syscalls.emplace("open");
+    sc._syscalls.emplace("openat");
+
+    BOOST_CHECK(sc.Matches(RecordType::SYSCALL, "open", "", ""));
+    BOOST_CHECK(sc.Matches(RecordType::SYSCALL, "openat", "", ""));
+    BOOST_CHECK(!sc.Matches(RecordType::SYSCALL, "execve", "", ""));
+    BOOST_CHECK(!sc.Matches(RecordType::SYSCALL, "ope", "", ""));
+    // Events without a syscall never match a class that lists syscalls
+    BOOST_CHECK(!sc.Matches(RecordType::USER_LOGIN, "", "", ""));
+}
+
+BOOST_AUTO_TEST_CASE( shed_class_matches_keys ) {
+    OverloadShedClass sc("keys");
+    sc._keys.emplace("noisy");
+
+    BOOST_CHECK(sc.Matches(RecordType::SYSCALL, "", "noisy", ""));
+    BOOST_CHECK(sc.Matches(RecordType::SYSCALL, "", std::string("a") + std::string(KEYS_SEP) + "noisy", ""));
+    BOOST_CHECK(sc.Matches(RecordType::SYSCALL, "", std::string("noisy") + std::string(KEYS_SEP) + "b", ""));
+    BOOST_CHECK(!sc.Matches(RecordType::SYSCALL, "", std::string("a") + std::string(KEYS_SEP) + "b", ""));
+    BOOST_CHECK(!sc.Matches(RecordType::SYSCALL, "", "noisy2", ""));
+    BOOST_CHECK(!sc.Matches(RecordType::SYSCALL, "", "", ""));
+}
+
+BOOST_AUTO_TEST_CASE( shed_class_matches_exe_prefixes ) {
+    OverloadShedClass sc("exe");
+    sc._exe_prefixes.emplace_back("/usr/sbin/");
+    sc._exe_prefixes.emplace_back("/opt/noisy");
+
+    BOOST_CHECK(sc.Matches(RecordType::SYSCALL, "", "", "/usr/sbin/cron"));
+    BOOST_CHECK(sc.Matches(RecordType::SYSCALL, "", "", "/opt/noisy/bin/agent"));
+    BOOST_CHECK(!sc.Matches(RecordType::SYSCALL, "", "", "/usr/bin/ls"));
+    BOOST_CHECK(!sc.Matches(RecordType::SYSCALL, "", "", "/usr/sbin"));
+    BOOST_CHECK(!sc.Matches(RecordType::SYSCALL, "", "", ""));
+}
+
+BOOST_AUTO_TEST_CASE( shed_class_matches_all_criteria ) {
+    OverloadShedClass sc("combined");
+    sc._record_types.emplace(static_cast<int>(RecordType::SYSCALL));
+    sc._syscalls.emplace("connect");
+    sc._keys.emplace("net");
+    sc._exe_prefixes.emplace_back("/usr/bin/");
+
+    BOOST_CHECK(sc.Matches(RecordType::SYSCALL, "connect", "net", "/usr/bin/curl"));
+    BOOST_CHECK(!sc.Matches(RecordType::USER_LOGIN, "connect", "net", "/usr/bin/curl"));
+    BOOST_CHECK(!sc.Matches(RecordType::SYSCALL, "bind", "net", "/usr/bin/curl"));
+    BOOST_CHECK(!sc.Matches(RecordType::SYSCALL, "connect", "other", "/usr/bin/curl"));
+    BOOST_CHECK(!sc.Matches(RecordType::SYSCALL, "connect", "net", "/usr/sbin/sshd"));
+}
+
+BOOST_AUTO_TEST_CASE( shed_add_class_invalid ) {
+    auto controller = new_controller({});
+
+    BOOST_CHECK(!controller->AddShedClass(new_shed_class("no_threshold", 0, 0)));
+    for (size_t i = 0; i < OverloadController::MAX_SHED_CLASSES; ++i) {
+        BOOST_REQUIRE(controller->AddShedClass(new_shed_class("c" + std::to_string(i), 0, 1000)));
+    }
+    BOOST_CHECK(!controller->AddShedClass(new_shed_class("too_many", 0, 1000)));
+}
+
+BOOST_AUTO_TEST_CASE( shed_lag_enter_exit ) {
+    auto controller = new_controller({});
+    BOOST_REQUIRE(controller->AddShedClass(new_shed_class("lag", 0, 1000)));
+
+    controller->Update(0, 999);
+    BOOST_CHECK(!controller->IsShedding());
+    BOOST_CHECK(!controller->ShouldShed(RecordType::SYSCALL, "execve", "", ""));
+
+    controller->Update(0, 1000);
+    BOOST_CHECK(controller->IsShedding());
+    BOOST_CHECK(controller->ShouldShed(RecordType::SYSCALL, "execve", "", ""));
+
+    // Stays active until the lag drops below HYSTERESIS_PCT of the threshold
+    controller->Update(0, 800);
+    BOOST_CHECK(controller->IsShedding());
+
+    controller->Update(0, 799);
+    BOOST_CHECK(!controller->IsShedding());
+    BOOST_CHECK(!controller->ShouldShed(RecordType::SYSCALL, "execve", "", ""));
+
+    controller->Update(0, 999);
+    BOOST_CHECK(!controller->IsShedding());
+}
+
+BOOST_AUTO_TEST_CASE( shed_occupancy_enter_exit ) {
+    auto queue = std::make_shared<Queue>(Queue::MIN_QUEUE_SIZE);
+    auto controller = new_controller({}, queue);
+    BOOST_REQUIRE(controller->AddShedClass(new_shed_class("occupancy", 50, 0)));
+
+    auto pct = [&queue](double pct) { return static_cast<uint64_t>((static_cast<double>(queue->DataSize()) * pct) / 100.0); };
+
+    controller->Update(pct(49), 1000000);
+    BOOST_CHECK(!controller->IsShedding());
+
+    controller->Update(pct(50), 0);
+    BOOST_CHECK(controller->IsShedding());
+
+    controller->Update(pct(41), 0);
+    BOOST_CHECK(controller->IsShedding());
+
+    controller->Update(pct(39), 0);
+    BOOST_CHECK(!controller->IsShedding());
+}
+
+BOOST_AUTO_TEST_CASE( shed_occupancy_and_lag ) {
+    auto queue = std::make_shared<Queue>(Queue::MIN_QUEUE_SIZE);
+    auto controller = new_controller({}, queue);
+    BOOST_REQUIRE(controller->AddShedClass(new_shed_class("both", 50, 1000)));
+
+    auto pct = [&queue](double pct) { return static_cast<uint64_t>((static_cast<double>(queue->DataSize()) * pct) / 100.0); };
+
+    // Either threshold activates the class
+    controller->Update(0, 1000);
+    BOOST_CHECK(controller->IsShedding());
+    controller->Update(0, 0);
+    BOOST_CHECK(!controller->IsShedding());
+    controller->Update(pct(50), 0);
+    BOOST_CHECK(controller->IsShedding());
+
+    // Both values must drop below the hysteresis threshold
+    controller->Update(0, 900);
+    BOOST_CHECK(controller->IsShedding());
+    controller->Update(pct(45), 0);
+    BOOST_CHECK(controller->IsShedding());
+    controller->Update(0, 0);
+    BOOST_CHECK(!controller->IsShedding());
+}
+
+BOOST_AUTO_TEST_CASE( shed_only_active_matching_classes ) {
+    auto controller = new_controller({});
+
+    auto low = new_shed_class("low", 0, 100);
+    low->_syscalls.emplace("open");
+    BOOST_REQUIRE(controller->AddShedClass(std::move(low)));
+
+    auto high = new_shed_class("high", 0, 1000);
+    high->_syscalls.emplace("connect");
+    BOOST_REQUIRE(controller->AddShedClass(std::move(high)));
+
+    controller->Update(0, 100);
+    BOOST_CHECK(controller->ShouldShed(RecordType::SYSCALL, "open", "", ""));
+    BOOST_CHECK(!controller->ShouldShed(RecordType::SYSCALL, "connect", "", ""));
+    BOOST_CHECK(!controller->ShouldShed(RecordType::SYSCALL, "execve", "", ""));
+
+    controller->Update(0, 1000);
+    BOOST_CHECK(controller->ShouldShed(RecordType::SYSCALL, "open", "", ""));
+    BOOST_CHECK(controller->ShouldShed(RecordType::SYSCALL, "connect", "", ""));
+    BOOST_CHECK(!controller->ShouldShed(RecordType::SYSCALL, "execve", "", ""));
+
+    // Each class has its own hysteresis
+    controller->Update(0, 700);
+    BOOST_CHECK(controller->ShouldShed(RecordType::SYSCALL, "open", "", ""));
+    BOOST_CHECK(!controller->ShouldShed(RecordType::SYSCALL, "connect", "", ""));
+}
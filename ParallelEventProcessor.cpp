@@ -0,0 +1,259 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "ParallelEventProcessor.h"
+#include "Queue.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+/**********************************************************************************************************************
+ ** EventBatchBuffer
+ *********************************************************************************************************************/
+
+int EventBatchBuffer::Allocate(void** data, size_t size) {
+    if (size > Queue::MAX_ITEM_SIZE) {
+        return Queue::BUFFER_TOO_SMALL;
+    }
+    // Grows (or shrinks) the event that is being built, which always starts right after the committed events.
+    _data.resize(_committed + size);
+    _size = size;
+    *data = _data.data() + _committed;
+    return 1;
+}
+
+int EventBatchBuffer::Commit() {
+    if (_size == 0) {
+        return 1;
+    }
+    _sizes.push_back(_size);
+    _committed += _size;
+    _size = 0;
+    return 1;
+}
+
+int EventBatchBuffer::Rollback() {
+    _data.resize(_committed);
+    _size = 0;
+    return 1;
+}
+
+void EventBatchBuffer::Clear() {
+    _data.clear();
+    _sizes.clear();
+    _committed = 0;
+    _size = 0;
+    _done_time = std::chrono::steady_clock::time_point();
+}
+
+void EventBatchBuffer::Swap(EventBatchBuffer& other) {
+    _data.swap(other._data);
+    _sizes.swap(other._sizes);
+    std::swap(_committed, other._committed);
+    std::swap(_size, other._size);
+    std::swap(_done_time, other._done_time);
+}
+
+/**********************************************************************************************************************
+ ** EventProcessorWorker
+ *********************************************************************************************************************/
+
+EventProcessorWorker::EventProcessorWorker(ParallelEventProcessor* parent, int index, std::shared_ptr<EventBatchBuffer> buffer,
+                                           std::unique_ptr<RawEventProcessor> rep, const std::shared_ptr<Metrics>& metrics):
+    _parent(parent), _index(index), _buffer(std::move(buffer)), _rep(std::move(rep))
+{
+    auto prefix = "worker_" + std::to_string(index) + "_";
+    _events_metric = metrics->AddMetric("event_processor", prefix + "events", MetricPeriod::SECOND, MetricPeriod::HOUR);
+    _queue_usecs_metric = metrics->AddMetric("event_processor", prefix + "queue_usecs", MetricPeriod::SECOND, MetricPeriod::HOUR);
+}
+
+void EventProcessorWorker::Add(uint64_t seq, const void* data, size_t size) {
+    std::lock_guard<std::mutex> lock(_run_mutex);
+    _items.emplace_back(WorkItem{seq, data, size, std::chrono::steady_clock::now()});
+    _run_cond.notify_one();
+}
+
+void EventProcessorWorker::run() {
+    std::unique_lock<std::mutex> lock(_run_mutex);
+    while (!_stop) {
+        _run_cond.wait(lock, [this]() { return _stop || !_items.empty(); });
+        if (_stop) {
+            return;
+        }
+        auto item = _items.front();
+        _items.pop_front();
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        _queue_usecs_metric->Add(static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(start - item.queued).count()));
+
+        try {
+            _rep->ProcessData(item.data, item.size);
+            _events_metric->Add(1.0);
+            if (LatencyHistogram::Sample()) {
+                _buffer->SetDoneTime(std::chrono::steady_clock::now());
+            }
+        } catch (...) {
+            _parent->worker_failed(std::current_exception());
+            return;
+        }
+        _parent->commit(item.seq, *_buffer);
+
+        lock.lock();
+    }
+}
+
+/**********************************************************************************************************************
+ ** ParallelEventProcessor
+ *********************************************************************************************************************/
+
+ParallelEventProcessor::ParallelEventProcessor(size_t num_workers, std::shared_ptr<IEventBuilderAllocator> output, uint32_t event_format_version,
+                                               bool field_hash_index, bool int_values, const std::shared_ptr<UserDB>& user_db,
+                                               const std::shared_ptr<ProcessTree>& processTree, const std::shared_ptr<FiltersEngine>& filtersEngine,
+                                               const std::shared_ptr<Metrics>& metrics, const std::shared_ptr<OverloadController>& overload):
+    _output(std::move(output)), _next_seq(0), _next_worker(0), _next_commit_seq(0), _closed(false)
+{
+    _commit_latency = metrics->AddLatencyHistogram("latency", "commit");
+    num_workers = std::min(std::max(num_workers, static_cast<size_t>(1)), MAX_WORKERS);
+    for (size_t i = 0; i < num_workers; ++i) {
+        auto buffer = std::make_shared<EventBatchBuffer>();
+        auto builder = std::make_shared<EventBuilder>(buffer, event_format_version);
+        builder->SetFieldHashIndex(field_hash_index);
+        builder->SetIntValues(int_values);
+        auto rep = std::make_unique<RawEventProcessor>(builder, user_db, processTree, filtersEngine, metrics, overload);
+        _workers.emplace_back(std::make_shared<EventProcessorWorker>(this, static_cast<int>(i), buffer, std::move(rep), metrics));
+    }
+}
+
+ParallelEventProcessor::~ParallelEventProcessor() {
+    Stop();
+}
+
+void ParallelEventProcessor::SetInterpretCacheSize(size_t size) {
+    for (auto& worker : _workers) {
+        worker->SetInterpretCacheSize(size);
+    }
+}
+
+void ParallelEventProcessor::SetDeferInterpretation(bool defer) {
+    for (auto& worker : _workers) {
+        worker->SetDeferInterpretation(defer);
+    }
+}
+
+void ParallelEventProcessor::SetRateLimiter(const std::shared_ptr<RateLimiter>& rate_limiter) {
+    for (auto& worker : _workers) {
+        worker->SetRateLimiter(rate_limiter);
+    }
+}
+
+void ParallelEventProcessor::Start() {
+    for (auto& worker : _workers) {
+        worker->Start();
+    }
+}
+
+void ParallelEventProcessor::Stop() {
+    for (auto& worker : _workers) {
+        worker->Stop();
+    }
+}
+
+void ParallelEventProcessor::ProcessData(const void* data, size_t data_len) {
+    _workers[select_worker(data, data_len)]->Add(_next_seq++, data, data_len);
+}
+
+void ParallelEventProcessor::Flush() {
+    std::unique_lock<std::mutex> lock(_commit_mutex);
+    _commit_cond.wait(lock, [this]() { return _error || _next_commit_seq == _next_seq; });
+    if (_error) {
+        std::rethrow_exception(_error);
+    }
+    if (_closed) {
+        throw std::runtime_error("Queue closed");
+    }
+}
+
+void ParallelEventProcessor::commit(uint64_t seq, EventBatchBuffer& buffer) {
+    std::lock_guard<std::mutex> lock(_commit_mutex);
+    if (seq != _next_commit_seq) {
+        _pending[seq].Swap(buffer);
+        buffer.Clear();
+        return;
+    }
+
+    write_events(buffer);
+    buffer.Clear();
+    _next_commit_seq++;
+
+    // Items completed by other workers may have been waiting for this one
+    for (auto it = _pending.begin(); it != _pending.end() && it->first == _next_commit_seq; it = _pending.erase(it)) {
+        write_events(it->second);
+        _next_commit_seq++;
+    }
+    _commit_cond.notify_all();
+}
+
+void ParallelEventProcessor::worker_failed(std::exception_ptr ex) {
+    std::lock_guard<std::mutex> lock(_commit_mutex);
+    if (!_error) {
+        _error = ex;
+    }
+    _commit_cond.notify_all();
+}
+
+// _commit_mutex must be locked
+void ParallelEventProcessor::write_events(const EventBatchBuffer& buffer) {
+    buffer.ForEach([this](const uint8_t* data, size_t size) {
+        if (_closed) {
+            return false;
+        }
+        auto ret = _output->Put(data, size);
+        if (ret == Queue::CLOSED) {
+            _closed = true;
+            return false;
+        } else if (ret != 1) {
+            Logger::Warn("ParallelEventProcessor: Failed to add event to output: error=%d", ret);
+        }
+        return true;
+    });
+    _commit_latency->AddSince(buffer.DoneTime());
+}
+
+size_t ParallelEventProcessor::select_worker(const void* data, size_t data_len) {
+    if (_workers.size() == 1) {
+        return 0;
+    }
+
+    Event event(data, data_len);
+    if (event.Validate() == 0 && event.NumRecords() > 0) {
+        auto pid_field = event.begin().FieldByName("pid");
+        if (pid_field) {
+            auto pid = pid_field.HasIntValue() ? pid_field.IntValue() : atol(pid_field.RawValuePtr());
+            if (pid > 0) {
+                return static_cast<size_t>(pid) % _workers.size();
+            }
+        }
+    }
+
+    // The worker does not matter for events without a pid
+    auto idx = _next_worker;
+    _next_worker = (_next_worker + 1) % _workers.size();
+    return idx;
+}
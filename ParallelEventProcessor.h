@@ -0,0 +1,182 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef AUOMS_PARALLELEVENTPROCESSOR_H
+#define AUOMS_PARALLELEVENTPROCESSOR_H
+
+#include "RunBase.h"
+#include "RawEventProcessor.h"
+
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Collects the events built for one input item so they can be added to the output later.
+class EventBatchBuffer: public IEventBuilderAllocator {
+public:
+    EventBatchBuffer(): _committed(0), _size(0) {}
+
+    int Allocate(void** data, size_t size) override;
+    int Commit() override;
+    int Rollback() override;
+
+    void Clear();
+    void Swap(EventBatchBuffer& other);
+
+    inline size_t NumEvents() const { return _sizes.size(); }
+
+    // Set by the worker (for items sampled for latency metrics) when it is done with the item
+    inline void SetDoneTime(std::chrono::steady_clock::time_point time) { _done_time = time; }
+    inline std::chrono::steady_clock::time_point DoneTime() const { return _done_time; }
+
+    // Calls fn(ptr, size) for each committed event, in commit order. Stops if fn returns false.
+    template<typename Fn>
+    void ForEach(Fn fn) const {
+        size_t offset = 0;
+        for (auto size : _sizes) {
+            if (!fn(_data.data() + offset, size)) {
+                return;
+            }
+            offset += size;
+        }
+    }
+
+private:
+    std::vector<uint8_t> _data;
+    std::vector<size_t> _sizes;
+    size_t _committed;
+    size_t _size;
+    std::chrono::steady_clock::time_point _done_time;
+};
+
+class ParallelEventProcessor;
+
+class EventProcessorWorker: public RunBase {
+public:
+    // rep must build its events into buffer
+    EventProcessorWorker(ParallelEventProcessor* parent, int index, std::shared_ptr<EventBatchBuffer> buffer,
+                         std::unique_ptr<RawEventProcessor> rep, const std::shared_ptr<Metrics>& metrics);
+
+    // data must remain valid until the item has been committed.
+    void Add(uint64_t seq, const void* data, size_t size);
+
+    // Must be called before Start()
+    void SetInterpretCacheSize(size_t size) {
+        _rep->SetInterpretCacheSize(size);
+    }
+
+    // Must be called before Start()
+    void SetDeferInterpretation(bool defer) {
+        _rep->SetDeferInterpretation(defer);
+    }
+
+    // Must be called before Start()
+    void SetRateLimiter(const std::shared_ptr<RateLimiter>& rate_limiter) {
+        _rep->SetRateLimiter(rate_limiter);
+    }
+
+protected:
+    void run() override;
+
+private:
+    struct WorkItem {
+        uint64_t seq;
+        const void* data;
+        size_t size;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    ParallelEventProcessor* _parent;
+    int _index;
+    std::shared_ptr<EventBatchBuffer> _buffer;
+    std::unique_ptr<RawEventProcessor> _rep;
+    std::shared_ptr<Metric> _events_metric;
+    std::shared_ptr<Metric> _queue_usecs_metric;
+    std::deque<WorkItem> _items;
+};
+
+/*
+ * Runs the RawEventProcessor on several threads.
+ *
+ * Each worker has its own RawEventProcessor, which builds its events into an EventBatchBuffer instead of the output.
+ * Events are assigned to workers by the pid of their first record, so all the events of a process are processed
+ * in order by the same worker (events without a pid are spread over the workers).
+ *
+ * Every item passed to ProcessData gets a sequence number. When a worker is done with an item, the events it built
+ * are added to the output in sequence order (by whichever worker completes the next expected item),
+ * so the output order is the same as when a single RawEventProcessor is used.
+ *
+ * ProcessData does not copy the data, the caller must keep it valid until Flush returns.
+ */
+class ParallelEventProcessor {
+public:
+    static constexpr size_t MAX_WORKERS = 64;
+
+    ParallelEventProcessor(size_t num_workers, std::shared_ptr<IEventBuilderAllocator> output, uint32_t event_format_version,
+                           bool field_hash_index, bool int_values, const std::shared_ptr<UserDB>& user_db,
+                           const std::shared_ptr<ProcessTree>& processTree, const std::shared_ptr<FiltersEngine>& filtersEngine,
+                           const std::shared_ptr<Metrics>& metrics, const std::shared_ptr<OverloadController>& overload = nullptr);
+    ~ParallelEventProcessor();
+
+    inline size_t NumWorkers() const { return _workers.size(); }
+
+    // Must be called before Start(). See RawEventProcessor::SetInterpretCacheSize
+    void SetInterpretCacheSize(size_t size);
+
+    // Must be called before Start(). See RawEventProcessor::SetDeferInterpretation
+    void SetDeferInterpretation(bool defer);
+
+    // Must be called before Start(). The rate_limiter is shared by all workers. See RawEventProcessor::SetRateLimiter
+    void SetRateLimiter(const std::shared_ptr<RateLimiter>& rate_limiter);
+
+    void Start();
+    void Stop();
+
+    void ProcessData(const void* data, size_t data_len);
+
+    // Wait until all the data passed to ProcessData has been processed and its events added to the output.
+    // Throws if the output was closed or a worker failed.
+    void Flush();
+
+private:
+    friend class EventProcessorWorker;
+
+    // Called by a worker when it is done with item seq. Swaps buffer with an empty one.
+    void commit(uint64_t seq, EventBatchBuffer& buffer);
+    void worker_failed(std::exception_ptr ex);
+    void write_events(const EventBatchBuffer& buffer);
+    size_t select_worker(const void* data, size_t data_len);
+
+    std::shared_ptr<IEventBuilderAllocator> _output;
+    std::shared_ptr<LatencyHistogram> _commit_latency; // Worker done -> events added to the output
+    std::vector<std::shared_ptr<EventProcessorWorker>> _workers;
+    uint64_t _next_seq;
+    size_t _next_worker;
+
+    std::mutex _commit_mutex;
+    std::condition_variable _commit_cond;
+    uint64_t _next_commit_seq;
+    std::map<uint64_t, EventBatchBuffer> _pending;
+    bool _closed;
+    std::exception_ptr _error;
+};
+
+#endif //AUOMS_PARALLELEVENTPROCESSOR_H
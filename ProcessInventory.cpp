@@ -0,0 +1,292 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "ProcessInventory.h"
+
+#include "Queue.h"
+#include "Logger.h"
+#include "Translate.h"
+
+#include <chrono>
+#include <cstring>
+
+#include <sys/time.h>
+
+ProcessInventory::ProcessInventory(const std::shared_ptr<EventBuilder>& builder, const std::shared_ptr<UserDB>& user_db, const std::shared_ptr<ProcessTree>& processTree,
+                                   const std::shared_ptr<Metrics>& metrics, uint64_t refresh_secs, uint64_t max_rate):
+    _builder(builder), _user_db(user_db), _processTree(processTree), _refresh_secs(std::max(refresh_secs, static_cast<uint64_t>(1))),
+    _max_rate(std::max(max_rate, static_cast<uint64_t>(1))), _sweep_count(0), _last_sweep_count(0)
+{
+    _changed_metric = metrics->AddMetric("process_inventory", "changed", MetricPeriod::SECOND, MetricPeriod::HOUR);
+    _sweep_metric = metrics->AddMetric("process_inventory", "sweep", MetricPeriod::SECOND, MetricPeriod::HOUR);
+    _processTree->TrackChanges(true);
+}
+
+void ProcessInventory::run() {
+    Logger::Info("ProcessInventory: starting");
+
+    constexpr long frequency = 1000;
+    auto next = std::chrono::steady_clock::now() + std::chrono::milliseconds(frequency);
+    long sleep_duration = 0;
+    do {
+        try {
+            DoProcessInventory();
+        } catch (const std::exception& ex) {
+            Logger::Info("ProcessInventory: stopping: %s", ex.what());
+            break;
+        }
+
+        sleep_duration = std::chrono::duration_cast<std::chrono::milliseconds>(next - std::chrono::steady_clock::now()).count();
+        next += std::chrono::milliseconds(frequency);
+        if (sleep_duration < 0) {
+            sleep_duration = 0;
+        }
+    } while (!_sleep(sleep_duration));
+
+    _processTree->TrackChanges(false);
+    Logger::Info("ProcessInventory: stopping");
+}
+
+void ProcessInventory::DoProcessInventory() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+
+    uint64_t sec = static_cast<uint64_t>(tv.tv_sec);
+    uint32_t msec = static_cast<uint32_t>(tv.tv_usec)/1000;
+
+    size_t budget = _max_rate;
+
+    auto num_changed = report_changed(budget, sec, msec);
+    _changed_metric->Add(static_cast<double>(num_changed));
+    budget -= num_changed;
+
+    // Sweep just fast enough to cover all processes every _refresh_secs, except for the first sweep.
+    if (_last_sweep_count > 0) {
+        budget = std::min(budget, (_last_sweep_count + _refresh_secs - 1) / _refresh_secs);
+    }
+    if (budget > 0) {
+        _sweep_metric->Add(static_cast<double>(report_sweep(budget, sec, msec)));
+    }
+}
+
+size_t ProcessInventory::report_changed(size_t budget, uint64_t sec, uint32_t msec) {
+    // The pids that don't fit in the budget are left in the ProcessTree for the next call
+    _changed_pids.resize(0);
+    _processTree->TakeChangedPids(_changed_pids, budget);
+
+    size_t count = 0;
+    for (auto pid : _changed_pids) {
+        // The process may have already exited
+        auto pinfo = ProcessInfo::Open(pid);
+        if (pinfo) {
+            generate_proc_event(pinfo.get(), sec, msec);
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t ProcessInventory::report_sweep(size_t budget, uint64_t sec, uint32_t msec) {
+    if (!_sweep) {
+        _sweep = ProcessInfo::Open();
+        _sweep_count = 0;
+        if (!_sweep) {
+            Logger::Error("Failed to open '/proc': %s", strerror(errno));
+            return 0;
+        }
+    }
+
+    size_t count = 0;
+    while (count < budget) {
+        if (!_sweep->next()) {
+            _last_sweep_count = _sweep_count;
+            _sweep.reset();
+            break;
+        }
+        generate_proc_event(_sweep.get(), sec, msec);
+        _sweep_count++;
+        count++;
+    }
+    return count;
+}
+
+void ProcessInventory::cancel_event() {
+    if (_builder->CancelEvent() != 1) {
+        throw std::runtime_error("Queue Closed");
+    }
+}
+
+bool ProcessInventory::generate_proc_event(ProcessInfo* pinfo, uint64_t sec, uint32_t msec) {
+    using namespace std::literals::string_view_literals;
+
+    auto ret = _builder->BeginEvent(sec, msec, 0, 1);
+    if (ret != 1) {
+        if (ret == Queue::CLOSED) {
+            throw std::runtime_error("Queue closed");
+        }
+        return false;
+    }
+
+    _builder->SetEventFlags(EVENT_FLAG_IS_AUOMS_EVENT);
+
+    uint16_t num_fields = 16;
+
+    static auto auoms_proc_inv_str = RecordTypeToName(RecordType::AUOMS_PROCESS_INVENTORY);
+    ret = _builder->BeginRecord(static_cast<uint32_t>(RecordType::AUOMS_PROCESS_INVENTORY), auoms_proc_inv_str, ""sv, num_fields);
+    if (ret != 1) {
+        if (ret == Queue::CLOSED) {
+            throw std::runtime_error("Queue closed");
+        }
+        cancel_event();
+        return false;
+    }
+
+    if (!add_int_field("pid"sv, pinfo->pid(), field_type_t::UNCLASSIFIED)) {
+        return false;
+    }
+
+    if (!add_int_field("ppid"sv, pinfo->ppid(), field_type_t::UNCLASSIFIED)) {
+        return false;
+    }
+
+    if (!add_int_field("ses"sv, pinfo->ses(), field_type_t::SESSION)) {
+        return false;
+    }
+
+    if (!add_str_field("starttime"sv, pinfo->starttime(), field_type_t::UNCLASSIFIED)) {
+        return false;
+    }
+
+    if (!add_uid_field("uid"sv, pinfo->uid(), field_type_t::UID)) {
+        return false;
+    }
+
+    if (!add_uid_field("euid"sv, pinfo->euid(), field_type_t::UID)) {
+        return false;
+    }
+
+    if (!add_uid_field("suid"sv, pinfo->suid(), field_type_t::UID)) {
+        return false;
+    }
+
+    if (!add_uid_field("fsuid"sv, pinfo->fsuid(), field_type_t::UID)) {
+        return false;
+    }
+
+    if (!add_gid_field("gid"sv, pinfo->gid(), field_type_t::GID)) {
+        return false;
+    }
+
+    if (!add_gid_field("egid"sv, pinfo->egid(), field_type_t::GID)) {
+        return false;
+    }
+
+    if (!add_gid_field("sgid"sv, pinfo->sgid(), field_type_t::GID)) {
+        return false;
+    }
+
+    if (!add_gid_field("fsgid"sv, pinfo->fsgid(), field_type_t::GID)) {
+        return false;
+    }
+
+    if (!add_str_field("comm"sv, pinfo->comm(), field_type_t::UNESCAPED)) {
+        return false;
+    }
+
+    if (!add_str_field("exe"sv, pinfo->exe(), field_type_t::UNESCAPED)) {
+        return false;
+    }
+
+    pinfo->format_cmdline(_tmp_val);
+
+    bool cmdline_truncated = false;
+    if (_tmp_val.size() > UINT16_MAX-1) {
+        _tmp_val.resize(UINT16_MAX-1);
+        cmdline_truncated = true;
+    }
+
+    if (!add_str_field("cmdline"sv, _tmp_val, field_type_t::UNESCAPED)) {
+        return false;
+    }
+
+    if (!add_str_field("cmdline_truncated"sv, cmdline_truncated ? "true"sv : "false"sv, field_type_t::UNCLASSIFIED)) {
+        return false;
+    }
+
+    ret = _builder->EndRecord();
+    if (ret != 1) {
+        if (ret == Queue::CLOSED) {
+            throw std::runtime_error("Queue closed");
+        }
+        cancel_event();
+        return false;
+    }
+
+    ret = _builder->EndEvent();
+    if (ret != 1) {
+        if (ret == Queue::CLOSED) {
+            throw std::runtime_error("Queue closed");
+        }
+        return false;
+    }
+    return true;
+}
+
+bool ProcessInventory::add_int_field(const std::string_view& name, int val, field_type_t ft) {
+    _tmp_val.assign(std::to_string(val));
+    return add_str_field(name, _tmp_val, ft);
+}
+
+bool ProcessInventory::add_uid_field(const std::string_view& name, int uid, field_type_t ft) {
+    _tmp_val.assign(std::to_string(uid));
+    _name_val = _user_db->GetUserName(uid);
+    int ret = _builder->AddField(name, _tmp_val, _name_val.c_str(), ft);
+    if (ret != 1) {
+        if (ret == Queue::CLOSED) {
+            throw std::runtime_error("Queue closed");
+        }
+        cancel_event();
+        return false;
+    }
+    return true;
+}
+
+bool ProcessInventory::add_gid_field(const std::string_view& name, int gid, field_type_t ft) {
+    _tmp_val.assign(std::to_string(gid));
+    _name_val = _user_db->GetGroupName(gid);
+    int ret = _builder->AddField(name, _tmp_val, _name_val.c_str(), ft);
+    if (ret != 1) {
+        if (ret == Queue::CLOSED) {
+            throw std::runtime_error("Queue closed");
+        }
+        cancel_event();
+        return false;
+    }
+    return true;
+}
+
+bool ProcessInventory::add_str_field(const std::string_view& name, const std::string_view& val, field_type_t ft) {
+    int ret = _builder->AddField(name, val, nullptr, ft);
+    if (ret != 1) {
+        if (ret == Queue::CLOSED) {
+            throw std::runtime_error("Queue closed");
+        }
+        cancel_event();
+        return false;
+    }
+    return true;
+}
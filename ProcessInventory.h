@@ -0,0 +1,80 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef AUOMS_PROCESSINVENTORY_H
+#define AUOMS_PROCESSINVENTORY_H
+
+#include "RunBase.h"
+#include "Event.h"
+#include "UserDB.h"
+#include "ProcessTree.h"
+#include "ProcessInfo.h"
+#include "Metrics.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Generates AUOMS_PROCESS_INVENTORY events from its own thread.
+ *
+ * Processes that the ProcessTree saw start (fork/exec) since the last report are reported once a second.
+ * In addition, /proc is swept slowly (a slice of it every second) so that every process is reported at least
+ * once every refresh_secs. The first sweep, started when the inventory starts, is only limited by max_rate.
+ * At most max_rate events are generated per second, changed processes first.
+ */
+class ProcessInventory: public RunBase {
+public:
+    static constexpr uint64_t DEFAULT_REFRESH_SECS = 3600;
+    static constexpr uint64_t DEFAULT_MAX_RATE = 1000;
+
+    ProcessInventory(const std::shared_ptr<EventBuilder>& builder, const std::shared_ptr<UserDB>& user_db, const std::shared_ptr<ProcessTree>& processTree,
+                     const std::shared_ptr<Metrics>& metrics, uint64_t refresh_secs = DEFAULT_REFRESH_SECS, uint64_t max_rate = DEFAULT_MAX_RATE);
+
+    // Report the changed processes and the next slice of the /proc sweep.
+    // Called once a second by run(). Throws if the queue is closed.
+    void DoProcessInventory();
+
+protected:
+    void run() override;
+
+private:
+    size_t report_changed(size_t budget, uint64_t sec, uint32_t msec);
+    size_t report_sweep(size_t budget, uint64_t sec, uint32_t msec);
+    bool generate_proc_event(ProcessInfo* pinfo, uint64_t sec, uint32_t msec);
+    bool add_int_field(const std::string_view& name, int val, field_type_t ft);
+    bool add_uid_field(const std::string_view& name, int uid, field_type_t ft);
+    bool add_gid_field(const std::string_view& name, int gid, field_type_t ft);
+    bool add_str_field(const std::string_view& name, const std::string_view& val, field_type_t ft);
+    void cancel_event();
+
+    std::shared_ptr<EventBuilder> _builder;
+    std::shared_ptr<UserDB> _user_db;
+    std::shared_ptr<ProcessTree> _processTree;
+    uint64_t _refresh_secs;
+    uint64_t _max_rate;
+    std::shared_ptr<Metric> _changed_metric;
+    std::shared_ptr<Metric> _sweep_metric;
+    std::vector<int> _changed_pids;
+    std::unique_ptr<ProcessInfo> _sweep;
+    size_t _sweep_count;
+    size_t _last_sweep_count;
+    std::string _tmp_val;
+    std::string _name_val;
+};
+
+#endif //AUOMS_PROCESSINVENTORY_H
@@ -240,6 +240,7 @@ void ProcessTree::AddPid(int pid, int ppid)
             process->_ancestors.emplace_back(anc);
         }
         _processes[pid] = process;
+        MarkChanged(pid);
     } 
 }
 
@@ -260,6 +261,7 @@ void ProcessTree::AddPid(int pid)
         process->_exec_propagation = 1;
         _processes[pid] = process;
     }
+    MarkChanged(pid);
 }
 
 /* Process event from AuditD (execve)
@@ -354,6 +356,7 @@ std::shared_ptr<ProcessTreeItem> ProcessTree::AddProcess(enum ProcessTreeSource
         ApplyFlags(process);
         _processes[pid] = process;
     }
+    MarkChanged(pid);
 
     return process;
 }
@@ -391,31 +394,70 @@ void ProcessTree::Clean()
 
 std::shared_ptr<ProcessTreeItem> ProcessTree::GetInfoForPid(int pid)
 {
+    // Called concurrently when the events are processed by more than one thread (see ParallelEventProcessor)
+    std::unique_lock<std::mutex> process_write_lock(_process_write_mutex);
     auto it = _processes.find(pid);
     if (it != _processes.end() && it->second->_source != ProcessTreeSource_pnotify) {
         return it->second;
-    } else {
-        // process doesn't currently exist, or we only have rudimentary information for it, so add it
-        std::unique_lock<std::mutex> process_write_lock(_process_write_mutex);
-        auto process = ReadProcEntry(pid);
-        if (process != nullptr) {
-            auto it2 = _processes.find(process->_ppid);
-            if (it2 != _processes.end()) {
-                auto parentproc = it2->second;
-                parentproc->_children.emplace_back(pid);
-                if (!(parentproc->_containeridfromhostprocess).empty()) {
-                    process->_containerid = parentproc->_containeridfromhostprocess;
-                } else {
-                    process->_containerid = parentproc->_containerid;
-                }
-                process->_ancestors = parentproc->_ancestors;
-                struct Ancestor anc = {process->_ppid, parentproc->_exe};
-                process->_ancestors.emplace_back(anc);
+    }
+
+    // process doesn't currently exist, or we only have rudimentary information for it, so add it
+    // Don't hold the lock while reading /proc, it would stall every other thread that needs the tree.
+    process_write_lock.unlock();
+    auto process = ReadProcEntry(pid);
+    process_write_lock.lock();
+
+    // Another thread may have added the process while the lock was released
+    it = _processes.find(pid);
+    if (it != _processes.end() && it->second->_source != ProcessTreeSource_pnotify) {
+        return it->second;
+    }
+
+    if (process != nullptr) {
+        auto it2 = _processes.find(process->_ppid);
+        if (it2 != _processes.end()) {
+            auto parentproc = it2->second;
+            parentproc->_children.emplace_back(pid);
+            if (!(parentproc->_containeridfromhostprocess).empty()) {
+                process->_containerid = parentproc->_containeridfromhostprocess;
+            } else {
+                process->_containerid = parentproc->_containerid;
             }
-            _processes[pid] = process;
-            ApplyFlags(process);
+            process->_ancestors = parentproc->_ancestors;
+            struct Ancestor anc = {process->_ppid, parentproc->_exe};
+            process->_ancestors.emplace_back(anc);
         }
-        return process;
+        _processes[pid] = process;
+        ApplyFlags(process);
+        MarkChanged(pid);
+    }
+    return process;
+}
+
+void ProcessTree::TrackChanges(bool enable)
+{
+    std::unique_lock<std::mutex> process_write_lock(_process_write_mutex);
+    _track_changes = enable;
+    if (!enable) {
+        _changed_pids.clear();
+    }
+}
+
+void ProcessTree::TakeChangedPids(std::vector<int>& pids, size_t max)
+{
+    std::unique_lock<std::mutex> process_write_lock(_process_write_mutex);
+    auto it = _changed_pids.begin();
+    for (size_t i = 0; i < max && it != _changed_pids.end(); ++i) {
+        pids.emplace_back(*it);
+        it = _changed_pids.erase(it);
+    }
+}
+
+// _process_write_mutex must be locked
+void ProcessTree::MarkChanged(int pid)
+{
+    if (_track_changes) {
+        _changed_pids.emplace(pid);
     }
 }
 
@@ -24,6 +24,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <queue>
 #include <chrono>
 #include <algorithm>
@@ -101,7 +102,7 @@ struct ProcessQueueItem {
 // Class that manages the process tree
 class ProcessTree: public RunBase {
 public:
-    ProcessTree(const std::shared_ptr<UserDB>& user_db, std::shared_ptr<FiltersEngine> filtersEngine): _user_db(user_db), _filtersEngine(filtersEngine), _queue_data_ready(false)
+    ProcessTree(const std::shared_ptr<UserDB>& user_db, std::shared_ptr<FiltersEngine> filtersEngine): _user_db(user_db), _filtersEngine(filtersEngine), _queue_data_ready(false), _track_changes(false)
     {
         _last_clean_time = std::chrono::system_clock::now();
     }
@@ -117,6 +118,11 @@ public:
     void ShowTree();
     void ShowProcess(std::shared_ptr<ProcessTreeItem> p);
 
+    // While enabled, the pids of processes that are added (fork) or changed (exec) are recorded (see ProcessInventory)
+    void TrackChanges(bool enable);
+    // Move up to max of the recorded pids into pids, the rest are left for the next call
+    void TakeChangedPids(std::vector<int>& pids, size_t max);
+
 protected:
     void on_stopping() override;
     void run() override;
@@ -132,6 +138,7 @@ private:
     void ApplyFlags(std::shared_ptr<ProcessTreeItem> process);
     void SetContainerId(std::shared_ptr<ProcessTreeItem> p, std::string containerid);
     std::string ExtractContainerId(std::string exe, const std::string& cmdline);
+    void MarkChanged(int pid);
 
     std::shared_ptr<UserDB> _user_db;
     std::shared_ptr<FiltersEngine> _filtersEngine;
@@ -142,6 +149,8 @@ private:
     std::condition_variable _queue_data;
     std::queue<struct ProcessQueueItem> _PnQueue;
     std::chrono::system_clock::time_point _last_clean_time;
+    bool _track_changes;
+    std::unordered_set<int> _changed_pids;
 };
 
 #endif //AUOMS_PROCESSTREE_H
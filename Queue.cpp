@@ -109,29 +109,54 @@ void _pwrite(int fd, void* ptr, size_t size, off_t offset)
     }
 }
 
+void _fdatasync(int fd)
+{
+    if (fdatasync(fd) != 0) {
+        throw std::system_error(errno, std::system_category(), "fdatasync()");
+    }
+}
+
+// Write the save regions as a single linked io_uring submission:
+//   before header, fdatasync, data regions, fdatasync, after header, fdatasync
+// The ordering and barriers match what the O_SYNC pwrite path provides.
+// Returns 0 on success or -errno.
+int _uring_save(IOUring* uring, int fd, FileHeader* before, _region* regions, int nregions, FileHeader* after)
+{
+    if (nregions > 0) {
+        uring->Write(fd, before, sizeof(FileHeader), 0);
+        uring->Fdatasync(fd);
+        for (int i = 0; i < nregions; i++) {
+            uring->Write(fd, regions[i].data, regions[i].size, regions[i].index);
+        }
+        uring->Fdatasync(fd);
+    }
+    uring->Write(fd, after, sizeof(FileHeader), 0);
+    uring->Fdatasync(fd);
+    return uring->Flush();
+}
+
 Queue::Queue(size_t size):
-        _path(), _file_size(size), _fd(-1), _next_id(1), _closed(true), _save_active(false), _int_id(0)
+        _path(), _file_size(size), _fd(-1), _next_id(1), _closed(true), _save_active(false), _int_id(0), _use_io_uring(false), _use_fdatasync(false)
 {
     if (_file_size < MIN_QUEUE_SIZE) {
         _file_size = MIN_QUEUE_SIZE;
     }
     _data_size = _file_size-FILE_DATA_OFFSET;
-    _ptr = new char[_data_size];
-
-    memset(_ptr, 0, _data_size);
+    _buffer = LargeBuffer(_data_size);
+    _ptr = _buffer.Data();
 
     _tail = _head = _saved_size = 0;
 }
 
 Queue::Queue(const std::string& path, size_t size):
-        _path(path), _file_size(size), _fd(-1), _next_id(1), _closed(true), _save_active(false), _int_id(0)
+        _path(path), _file_size(size), _fd(-1), _next_id(1), _closed(true), _save_active(false), _int_id(0), _use_io_uring(false), _use_fdatasync(false)
 {
     if (_file_size < MIN_QUEUE_SIZE) {
         _file_size = MIN_QUEUE_SIZE;
     }
     _data_size = _file_size-FILE_DATA_OFFSET;
-    _ptr = new char[_data_size];
-    memset(_ptr, 0, _data_size);
+    _buffer = LargeBuffer(_data_size);
+    _ptr = _buffer.Data();
 }
 
 Queue::~Queue()
@@ -139,7 +164,6 @@ Queue::~Queue()
     if (_fd > -1) {
         close(_fd);
     }
-    delete[] _ptr;
 }
 
 void Queue::Open()
@@ -157,7 +181,22 @@ void Queue::Open()
 
     _tail = _head = _saved_size = 0;
 
-    _fd = open(_path.c_str(), O_RDWR|O_CREAT|O_SYNC, 0600);
+    int flags = O_RDWR|O_CREAT|O_SYNC;
+    if (_use_io_uring && !_uring) {
+        _uring = std::make_unique<IOUring>();
+        if (!_uring->Open()) {
+            Logger::Warn("Queue: io_uring is not available, using synchronous writes");
+            _uring.reset();
+        }
+    }
+    _use_fdatasync = false;
+    if (_uring) {
+        // Durability is provided by explicit fdatasync calls
+        flags &= ~O_SYNC;
+        _use_fdatasync = true;
+    }
+
+    _fd = open(_path.c_str(), flags, 0600);
     if (_fd < 0) {
         throw std::system_error(errno, std::system_category(), "Failed to open queue file");
     }
@@ -219,9 +258,8 @@ void Queue::Open()
             Logger::Warn("Queue::Open: Requested queue size (%ld) does not match existing queue size (%ld). Ignoring requested file size and using actual file size.", _file_size, hdr.size);
             _file_size = hdr.size;
             _data_size = _file_size-FILE_DATA_OFFSET;
-            delete[] _ptr;
-            _ptr = new char[_data_size];
-            memset(_ptr, 0, _data_size);
+            _buffer = LargeBuffer(_data_size);
+            _ptr = _buffer.Data();
         }
     } else {
         hdr.magic = HEADER_MAGIC;
@@ -239,6 +277,7 @@ void Queue::Open()
         _pwrite(_fd, &hdr, sizeof(FileHeader), 0);
         // Make sure all the file blocks are allocated on disk.
         _pwrite(_fd, _ptr, _data_size, FILE_DATA_OFFSET);
+        sync_file();
     }
 
     _next_id = hdr.next_id;
@@ -317,6 +356,13 @@ void Queue::Save() {
     save_locked(lock);
 }
 
+// Only needed when the file was not opened with O_SYNC
+void Queue::sync_file() {
+    if (_use_fdatasync) {
+        _fdatasync(_fd);
+    }
+}
+
 void Queue::Interrupt() {
     std::unique_lock<std::mutex> lock(_lock);
     _int_id++;
@@ -394,20 +440,44 @@ void Queue::save_locked(std::unique_lock<std::mutex>& lock)
     lock.unlock();
 
     int64_t save_size = 0;
+    for (int i = 0; i < nregions; i++) {
+        save_size += regions[i].size;
+    }
 
-    if (nregions > 0) {
-        _pwrite(_fd, &before, sizeof(FileHeader), 0);
-
-        for (int i = 0; i < nregions; i++) {
-            _pwrite(_fd, regions[i].data, regions[i].size, regions[i].index);
-            save_size += regions[i].size;
+    bool saved = false;
+    bool uring_failed = false;
+    if (_uring) {
+        auto ret = _uring_save(_uring.get(), _fd, &before, regions, nregions, &after);
+        if (ret == 0) {
+            saved = true;
+        } else {
+            Logger::Warn("Queue: io_uring save failed, using synchronous writes from now on: %s", std::strerror(-ret));
+            uring_failed = true;
         }
     }
 
-    _pwrite(_fd, &after, sizeof(FileHeader), 0);
+    if (!saved) {
+        if (nregions > 0) {
+            _pwrite(_fd, &before, sizeof(FileHeader), 0);
+            sync_file();
+
+            for (int i = 0; i < nregions; i++) {
+                _pwrite(_fd, regions[i].data, regions[i].size, regions[i].index);
+            }
+            sync_file();
+        }
+
+        _pwrite(_fd, &after, sizeof(FileHeader), 0);
+        sync_file();
+    }
 
     lock.lock();
 
+    if (uring_failed) {
+        // The file is still not O_SYNC, so the synchronous writes keep using fdatasync (see sync_file)
+        _uring.reset();
+    }
+
     _saved_size += save_size;
     _save_active = false;
 
@@ -454,6 +524,7 @@ void Queue::Reset() {
     _saved_size = 0;
 
     _pwrite(_fd, _ptr+FILE_DATA_OFFSET, _data_size, FILE_DATA_OFFSET);
+    sync_file();
 
     _cond.notify_all();
 }
@@ -688,3 +759,49 @@ int Queue::Get(QueueCursor last, void*ptr, size_t* size, QueueCursor *item_curso
 
     return 1;
 }
+
+void Queue::GetLag(QueueCursor last, uint64_t* bytes, uint64_t* items) {
+    assert(bytes != nullptr);
+    assert(items != nullptr);
+
+    *bytes = 0;
+    *items = 0;
+
+    std::unique_lock<std::mutex> lock(_lock);
+
+    if (_closed || last.IsHead()) {
+        return;
+    }
+
+    uint64_t tail = _tail;
+    if (reinterpret_cast<BlockHeader*>(_ptr+tail)->state == WRAP) {
+        tail = 0;
+    }
+
+    if (tail == _head) {
+        return;
+    }
+
+    uint64_t index = tail;
+    uint64_t first_id = reinterpret_cast<BlockHeader*>(_ptr+tail)->id;
+
+    if (!last.IsTail() && last.index <= _data_size-sizeof(BlockHeader) && last.id >= first_id && last.id < _next_id) {
+        BlockHeader *hdr = reinterpret_cast<BlockHeader *>(_ptr + last.index);
+        if (hdr->id == last.id && hdr->state == ITEM) {
+            index = last.index + sizeof(BlockHeader) + hdr->size;
+            first_id = last.id + 1;
+            if (reinterpret_cast<BlockHeader*>(_ptr+index)->state == WRAP) {
+                index = 0;
+            }
+        }
+    }
+
+    if (index <= _head) {
+        /* [----<index>====<head>----] */
+        *bytes = _head - index;
+    } else {
+        /* [====<head>----<index>====] */
+        *bytes = _head + (_data_size - index);
+    }
+    *items = _next_id - first_id;
+}
@@ -16,12 +16,16 @@
 #ifndef AUOMS_QUEUE_H
 #define AUOMS_QUEUE_H
 
+#include "LargeBuffer.h"
+#include "IOUring.h"
+
 #include <array>
 #include <string>
 #include <cstdint>
 #include <mutex>
 #include <condition_variable>
 #include <functional>
+#include <memory>
 
 class QueueCursor {
 public:
@@ -71,6 +75,17 @@ public:
     Queue& operator=(const Queue&) = delete;
     Queue& operator=(Queue&&) = default;
 
+    // Use io_uring (if available) to persist the queue. Must be called before Open().
+    // Each save is submitted as one linked batch (fewer syscalls), but still waits for it to complete.
+    // If io_uring is not available, or fails, the queue falls back to synchronous writes.
+    void SetUseIOUring(bool use_io_uring) { _use_io_uring = use_io_uring; }
+
+    // True if the queue is saved with io_uring, false if it was not requested, is not available, or failed
+    bool IsUsingIOUring() {
+        std::lock_guard<std::mutex> lock(_lock);
+        return static_cast<bool>(_uring);
+    }
+
     void Open();
     void Close();
     void Close(bool save); // Only required for unit tests
@@ -98,8 +113,17 @@ public:
     // item_cursor is the cursor for the item returned.
     int Get(QueueCursor last, void* ptr, size_t* size, QueueCursor* item_cursor, int32_t milliseconds);
 
+    // The usable size (in bytes) of the in-memory ring
+    uint64_t DataSize() const { return _data_size; }
+
+    // Return the number of bytes and items that are in the queue after last.
+    // If last is TAIL or invalid, then the lag is the full queue contents.
+    // If last is HEAD, the lag is zero.
+    void GetLag(QueueCursor last, uint64_t* bytes, uint64_t* items);
+
 private:
     void save_locked(std::unique_lock<std::mutex>& lock);
+    void sync_file();
     int allocate_locked(std::unique_lock<std::mutex>& lock, void** ptr, size_t size);
     int commit_locked();
 
@@ -112,6 +136,7 @@ private:
     uint64_t _data_size;
     uint64_t _next_id;
     int _fd;
+    LargeBuffer _buffer;
     char* _ptr;
     bool _closed;
     uint64_t _head; // Newest item
@@ -121,6 +146,9 @@ private:
     std::mutex _lock;
     std::condition_variable _cond;
     uint64_t _int_id;
+    bool _use_io_uring;
+    bool _use_fdatasync; // The file is not O_SYNC, writes must be followed by fdatasync
+    std::unique_ptr<IOUring> _uring;
 };
 
 
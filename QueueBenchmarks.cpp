@@ -0,0 +1,68 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved. 
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "Queue.h"
+#include "LargeBuffer.h"
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "QueueBenchmarks"
+#include <boost/test/unit_test.hpp>
+
+#include "TempFile.h"
+#include <array>
+#include <chrono>
+
+#define ITEM_HEADER_SIZE 3*sizeof(uint64_t)
+
+// Reports the Put/Get throughput with and without huge page backed queue memory.
+BOOST_AUTO_TEST_CASE( queue_put_get_throughput ) {
+    constexpr size_t QUEUE_SIZE = 32*1024*1024;
+    constexpr int ROUNDS = 8;
+
+    std::array<char, 1024> data_in;
+    std::array<char, 1024> data_out;
+    data_in.fill('x');
+
+    for (bool huge_pages: {false, true}) {
+        TempFile file("/tmp/QueueTests.");
+        LargeBuffer::SetDefaultPolicy(huge_pages, false);
+        Queue queue(file.Path(), QUEUE_SIZE);
+        queue.Open();
+
+        int num_items = QUEUE_SIZE/(ITEM_HEADER_SIZE+data_in.size()) - 1;
+        QueueCursor cursor = QueueCursor::TAIL;
+        uint64_t count = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < ROUNDS; r++) {
+            for (int i = 0; i < num_items; i++) {
+                BOOST_REQUIRE_EQUAL(queue.Put(data_in.data(), data_in.size()), 1);
+            }
+            for (int i = 0; i < num_items; i++) {
+                size_t size = data_out.size();
+                if (queue.Get(cursor, data_out.data(), &size, &cursor, 0) != 1) {
+                    break;
+                }
+                count++;
+            }
+        }
+        auto usecs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+        BOOST_TEST_MESSAGE("Queue Put+Get (huge_pages=" << huge_pages << "): " << count << " items in " << usecs << " usec, "
+                           << (static_cast<double>(count)*1000000.0/static_cast<double>(usecs)) << " items/sec");
+        queue.Close(false);
+    }
+    LargeBuffer::SetDefaultPolicy(false, false);
+}
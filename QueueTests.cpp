@@ -16,12 +16,14 @@
 
 
 #include "Queue.h"
+#include "EventQueue.h"
 #define BOOST_TEST_DYN_LINK
 #define BOOST_TEST_MODULE "QueueTests"
 #include <boost/test/unit_test.hpp>
 
 #include "TempFile.h"
 #include <stdexcept>
+#include <cstring>
 #include <array>
 #include <iostream>
 #include <thread>
@@ -246,3 +248,158 @@ BOOST_AUTO_TEST_CASE( queue_reset ) {
         queue.Close(false);
     }
 }
+
+BOOST_AUTO_TEST_CASE( queue_lag ) {
+    TempFile file("/tmp/QueueTests.");
+
+    Queue queue(file.Path(), Queue::MIN_QUEUE_SIZE);
+    queue.Open();
+
+    uint64_t bytes = 0;
+    uint64_t items = 0;
+
+    queue.GetLag(QueueCursor::TAIL, &bytes, &items);
+    BOOST_REQUIRE_EQUAL(bytes, 0);
+    BOOST_REQUIRE_EQUAL(items, 0);
+
+    std::array<char, 1024> data_in;
+    data_in.fill('\0');
+
+    int num_items = 2*(Queue::MIN_QUEUE_SIZE/(ITEM_HEADER_SIZE+1024));
+    for (int i = 0; i < num_items; i++) {
+        if (queue.Put(data_in.data(), data_in.size()) != 1) {
+            BOOST_FAIL("Queue::Put failed");
+        }
+    }
+
+    uint64_t tail_bytes = 0;
+    uint64_t tail_items = 0;
+    queue.GetLag(QueueCursor::TAIL, &tail_bytes, &tail_items);
+    BOOST_REQUIRE(tail_items > 0);
+    BOOST_REQUIRE(tail_items < num_items);
+    BOOST_REQUIRE(tail_bytes <= queue.DataSize());
+    BOOST_REQUIRE(tail_bytes >= tail_items*(ITEM_HEADER_SIZE+1024));
+
+    queue.GetLag(QueueCursor::HEAD, &bytes, &items);
+    BOOST_REQUIRE_EQUAL(bytes, 0);
+    BOOST_REQUIRE_EQUAL(items, 0);
+
+    std::array<char, 1024> data_out;
+    QueueCursor cursor = QueueCursor::TAIL;
+    for (int i = 0; i < 10; i++) {
+        size_t size = data_out.size();
+        BOOST_REQUIRE_EQUAL(queue.Get(cursor, data_out.data(), &size, &cursor, 0), 1);
+    }
+
+    queue.GetLag(cursor, &bytes, &items);
+    BOOST_REQUIRE_EQUAL(items, tail_items-10);
+    BOOST_REQUIRE(bytes < tail_bytes);
+
+    for (;;) {
+        size_t size = data_out.size();
+        if (queue.Get(cursor, data_out.data(), &size, &cursor, 0) != 1) {
+            break;
+        }
+    }
+
+    queue.GetLag(cursor, &bytes, &items);
+    BOOST_REQUIRE_EQUAL(bytes, 0);
+    BOOST_REQUIRE_EQUAL(items, 0);
+}
+
+BOOST_AUTO_TEST_CASE( queue_io_uring_save_reopen ) {
+    TempFile file("/tmp/QueueTests.");
+
+    int num_items = 100;
+    bool have_io_uring = false;
+
+    {
+        Queue queue(file.Path(), Queue::MIN_QUEUE_SIZE);
+        queue.SetUseIOUring(true);
+        queue.Open();
+
+        // io_uring may not be available (e.g. disabled by seccomp), then only the fallback can be tested
+        have_io_uring = IOUring().Open();
+        BOOST_REQUIRE_EQUAL(queue.IsUsingIOUring(), have_io_uring);
+        if (!have_io_uring) {
+            BOOST_TEST_MESSAGE("io_uring is not available, testing the synchronous fallback");
+        }
+
+        std::array<char, 1024> data_in;
+        for (int i = 0; i < num_items; i++) {
+            data_in.fill(static_cast<char>(i));
+            BOOST_REQUIRE_EQUAL(queue.Put(data_in.data(), data_in.size()), 1);
+            if (i % 10 == 0) {
+                queue.Save();
+            }
+        }
+        // A failed io_uring save falls back to synchronous writes and stops using io_uring
+        BOOST_REQUIRE_EQUAL(queue.IsUsingIOUring(), have_io_uring);
+        queue.Close();
+        BOOST_REQUIRE_EQUAL(queue.IsUsingIOUring(), have_io_uring);
+    }
+
+    {
+        Queue queue(file.Path(), Queue::MIN_QUEUE_SIZE);
+        queue.Open();
+
+        std::array<char, 1024> data_out;
+        QueueCursor cursor = QueueCursor::TAIL;
+        for (int i = 0; i < num_items; i++) {
+            size_t size = data_out.size();
+            BOOST_REQUIRE_EQUAL(queue.Get(cursor, data_out.data(), &size, &cursor, 0), 1);
+            BOOST_REQUIRE_EQUAL(size, data_out.size());
+            BOOST_REQUIRE_EQUAL(data_out[0], static_cast<char>(i));
+            BOOST_REQUIRE_EQUAL(data_out[size-1], static_cast<char>(i));
+        }
+        size_t size = data_out.size();
+        BOOST_REQUIRE_EQUAL(queue.Get(cursor, data_out.data(), &size, &cursor, 0), Queue::TIMEOUT);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( event_queue_does_not_block_put ) {
+    TempFile file("/tmp/QueueTests.");
+
+    auto queue = std::make_shared<Queue>(file.Path(), Queue::MIN_QUEUE_SIZE);
+    queue->Open();
+
+    // An event that is being built is not in the queue yet, so other producers are not blocked
+    EventQueue event_queue(queue);
+    void* ptr = nullptr;
+    BOOST_REQUIRE_EQUAL(event_queue.Allocate(&ptr, 100), 1);
+    memset(ptr, 'a', 100);
+    BOOST_REQUIRE_EQUAL(event_queue.Allocate(&ptr, 200), 1);
+    memset(reinterpret_cast<char*>(ptr)+100, 'a', 100);
+
+    std::array<char, 100> data;
+    data.fill('b');
+    BOOST_REQUIRE_EQUAL(queue->Put(data.data(), data.size()), 1);
+
+    BOOST_REQUIRE_EQUAL(event_queue.Commit(), 1);
+
+    // Rolled back events are not added
+    BOOST_REQUIRE_EQUAL(event_queue.Allocate(&ptr, 100), 1);
+    BOOST_REQUIRE_EQUAL(event_queue.Rollback(), 1);
+
+    // Events that were already built are added as is
+    data.fill('c');
+    BOOST_REQUIRE_EQUAL(event_queue.Put(data.data(), data.size()), 1);
+
+    std::array<char, 200> data_out;
+    QueueCursor cursor = QueueCursor::TAIL;
+    size_t size = data_out.size();
+    BOOST_REQUIRE_EQUAL(queue->Get(cursor, data_out.data(), &size, &cursor, 0), 1);
+    BOOST_REQUIRE_EQUAL(size, 100);
+    BOOST_REQUIRE_EQUAL(data_out[0], 'b');
+    size = data_out.size();
+    BOOST_REQUIRE_EQUAL(queue->Get(cursor, data_out.data(), &size, &cursor, 0), 1);
+    BOOST_REQUIRE_EQUAL(size, 200);
+    BOOST_REQUIRE_EQUAL(data_out[0], 'a');
+    BOOST_REQUIRE_EQUAL(data_out[199], 'a');
+    size = data_out.size();
+    BOOST_REQUIRE_EQUAL(queue->Get(cursor, data_out.data(), &size, &cursor, 0), 1);
+    BOOST_REQUIRE_EQUAL(size, 100);
+    BOOST_REQUIRE_EQUAL(data_out[0], 'c');
+    size = data_out.size();
+    BOOST_REQUIRE_EQUAL(queue->Get(cursor, data_out.data(), &size, &cursor, 0), Queue::TIMEOUT);
+}
@@ -0,0 +1,435 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "RateLimiter.h"
+
+#include "Logger.h"
+#include "RecordType.h"
+#include "Translate.h"
+
+#include <algorithm>
+#include <functional>
+#include <chrono>
+
+// Character that separates key in AUDIT_FILTERKEY field in rules
+// This value mirrors what is defined for AUDIT_KEY_SEPARATOR in libaudit.h
+#define KEY_SEP 0x01
+
+static const std::string CONFIG_PARAM_NAME = "rate_limits";
+static const std::string MAX_BUCKETS_PARAM_NAME = "rate_limit_max_buckets";
+static const std::string REPORT_SECS_PARAM_NAME = "rate_limit_report_secs";
+
+/*****************************************************************************
+ ** RateLimit
+ *****************************************************************************/
+
+bool RateLimit::Matches(const std::string_view& keys) const {
+    if (_keys.empty()) {
+        return true;
+    }
+
+    std::string_view rest = keys;
+    while (!rest.empty()) {
+        auto idx = rest.find(static_cast<char>(KEY_SEP));
+        if (_keys.count(std::string(rest.substr(0, idx))) > 0) {
+            return true;
+        }
+        if (idx == std::string_view::npos) {
+            break;
+        }
+        rest = rest.substr(idx+1);
+    }
+    return false;
+}
+
+/*****************************************************************************
+ ** RateLimitConfig
+ *****************************************************************************/
+
+bool RateLimitConfig::ParseConfig(const Config& config) {
+    _limits.clear();
+
+    for (auto param : {&MAX_BUCKETS_PARAM_NAME, &REPORT_SECS_PARAM_NAME}) {
+        if (config.HasKey(*param)) {
+            uint64_t val;
+            try {
+                val = config.GetUint64(*param);
+            } catch (std::exception& ex) {
+                Logger::Error("Invalid '%s' value: %s", param->c_str(), config.GetString(*param).c_str());
+                return false;
+            }
+            if (val < 1) {
+                Logger::Error("Invalid '%s' value: %ld", param->c_str(), val);
+                return false;
+            }
+            if (param == &MAX_BUCKETS_PARAM_NAME) {
+                _max_buckets = val;
+            } else {
+                _report_secs = val;
+            }
+        }
+    }
+
+    if (!config.HasKey(CONFIG_PARAM_NAME)) {
+        return true;
+    }
+
+    auto doc = config.GetJSON(CONFIG_PARAM_NAME);
+    if (!doc.IsArray()) {
+        Logger::Error("Invalid value for '%s': Expected JSON array", CONFIG_PARAM_NAME.c_str());
+        return false;
+    }
+
+    int idx = 0;
+    for (auto it = doc.Begin(); it != doc.End(); ++it, idx++) {
+        if (!it->IsObject()) {
+            Logger::Error("Invalid entry at (%d) in config for '%s'", idx, CONFIG_PARAM_NAME.c_str());
+            _limits.clear();
+            return false;
+        }
+
+        if (_limits.size() >= MAX_RATE_LIMITS) {
+            Logger::Error("Too many entries in config for '%s': Max is %ld", CONFIG_PARAM_NAME.c_str(), MAX_RATE_LIMITS);
+            _limits.clear();
+            return false;
+        }
+
+        rapidjson::Value::ConstMemberIterator mi;
+
+        mi = it->FindMember("name");
+        if (mi == it->MemberEnd() || !mi->value.IsString()) {
+            Logger::Error("Missing or invalid entry (name) at (%d) in config for '%s'", idx, CONFIG_PARAM_NAME.c_str());
+            _limits.clear();
+            return false;
+        }
+
+        auto limit = std::make_unique<RateLimit>(std::string(mi->value.GetString(), mi->value.GetStringLength()));
+
+        mi = it->FindMember("by");
+        if (mi != it->MemberEnd()) {
+            std::string_view by;
+            if (mi->value.IsString()) {
+                by = std::string_view(mi->value.GetString(), mi->value.GetStringLength());
+            }
+            if (by == "exe_syscall") {
+                limit->_by = RateLimitBy::EXE_SYSCALL;
+            } else if (by == "pid") {
+                limit->_by = RateLimitBy::PID;
+            } else {
+                Logger::Error("Invalid entry (%s) at (%d) in config for '%s'", mi->name.GetString(), idx, CONFIG_PARAM_NAME.c_str());
+                _limits.clear();
+                return false;
+            }
+        }
+
+        mi = it->FindMember("rate");
+        if (mi == it->MemberEnd() || !mi->value.IsNumber() || mi->value.GetDouble() <= 0) {
+            Logger::Error("Missing or invalid entry (rate) at (%d) in config for '%s'", idx, CONFIG_PARAM_NAME.c_str());
+            _limits.clear();
+            return false;
+        }
+        limit->_rate = mi->value.GetDouble();
+        limit->_burst = std::max(limit->_rate, 1.0);
+
+        mi = it->FindMember("burst");
+        if (mi != it->MemberEnd()) {
+            if (mi->value.IsNumber() && mi->value.GetDouble() >= 1) {
+                limit->_burst = mi->value.GetDouble();
+            } else {
+                Logger::Error("Invalid entry (%s) at (%d) in config for '%s'", mi->name.GetString(), idx, CONFIG_PARAM_NAME.c_str());
+                _limits.clear();
+                return false;
+            }
+        }
+
+        mi = it->FindMember("keys");
+        if (mi != it->MemberEnd()) {
+            bool valid = mi->value.IsArray();
+            if (valid) {
+                for (auto kit = mi->value.Begin(); kit != mi->value.End(); ++kit) {
+                    if (!kit->IsString()) {
+                        valid = false;
+                        break;
+                    }
+                    limit->_keys.emplace(kit->GetString(), kit->GetStringLength());
+                }
+            }
+            if (!valid) {
+                Logger::Error("Invalid entry (%s) at (%d) in config for '%s'", mi->name.GetString(), idx, CONFIG_PARAM_NAME.c_str());
+                _limits.clear();
+                return false;
+            }
+        }
+
+        _limits.emplace_back(std::move(limit));
+    }
+
+    if (!_limits.empty()) {
+        Logger::Info("RateLimitConfig: %ld rate limits configured", _limits.size());
+    }
+
+    return true;
+}
+
+/*****************************************************************************
+ ** RateLimiter
+ *****************************************************************************/
+
+RateLimiter::RateLimiter(const std::shared_ptr<const RateLimitConfig>& config, const std::shared_ptr<EventBuilder>& builder, const std::shared_ptr<Metrics>& metrics):
+    _config(config), _builder(builder)
+{
+    for (auto& limit : _config->_limits) {
+        _metrics.emplace_back(metrics->AddMetric("rate_limit", "suppressed_" + limit->_name, MetricPeriod::SECOND, MetricPeriod::HOUR));
+    }
+
+    auto num_shards = static_cast<size_t>(std::clamp<uint64_t>(_config->_max_buckets / MIN_SHARD_BUCKETS, 1, MAX_SHARDS));
+    for (size_t i = 0; i < num_shards; ++i) {
+        // Spread the remainder so that the shards add up to _max_buckets
+        auto max_buckets = _config->_max_buckets / num_shards + (i < _config->_max_buckets % num_shards ? 1 : 0);
+        _shards.emplace_back(std::make_unique<Shard>(max_buckets));
+    }
+}
+
+bool RateLimiter::ShouldSuppress(const std::string_view& keys, const std::string_view& exe, const std::string_view& syscall, int pid, uint64_t sec, uint32_t msec) {
+    auto& limits = _config->_limits;
+
+    size_t idx = 0;
+    while (idx < limits.size() && (!limits[idx]->Matches(keys) || (pid < 0 && limits[idx]->_by == RateLimitBy::PID))) {
+        idx++;
+    }
+    if (idx >= limits.size()) {
+        return false;
+    }
+    auto& limit = *limits[idx];
+
+    // Pick the shard from the bucket key fields, before taking any lock
+    size_t hash;
+    if (limit._by == RateLimitBy::PID) {
+        hash = std::hash<int>()(pid);
+    } else {
+        hash = std::hash<std::string_view>()(exe) * 31 + std::hash<std::string_view>()(syscall);
+    }
+    hash = hash * 31 + idx;
+    auto& shard = *_shards[hash % _shards.size()];
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    // Events are not always in timestamp order, so time never goes backwards
+    uint64_t event_msec = sec*1000 + msec;
+    shard.now_msec = std::max(shard.now_msec, event_msec);
+    auto now_msec = shard.now_msec;
+
+    auto& key = shard.key;
+    key.assign(1, static_cast<char>(idx));
+    if (limit._by == RateLimitBy::PID) {
+        key.append(reinterpret_cast<const char*>(&pid), sizeof(pid));
+    } else {
+        key.append(exe);
+        key.push_back(0);
+        key.append(syscall);
+    }
+
+    bool suppress = false;
+    auto found = shard.buckets.on(key, [&shard,&limit,&suppress,now_msec,event_msec](size_t, const std::chrono::steady_clock::time_point&, Bucket& bucket) {
+        if (now_msec > bucket.last_msec) {
+            bucket.tokens = std::min(limit._burst, bucket.tokens + static_cast<double>(now_msec - bucket.last_msec) * limit._rate / 1000.0);
+            bucket.last_msec = now_msec;
+        }
+        if (bucket.tokens >= 1.0) {
+            bucket.tokens -= 1.0;
+        } else {
+            suppress = true;
+            if (bucket.suppressed == 0) {
+                bucket.first_suppressed_msec = event_msec;
+                shard.suppressed_keys.emplace_back(shard.key);
+            }
+            bucket.suppressed++;
+            bucket.last_suppressed_msec = event_msec;
+        }
+        return CacheEntryOP::TOUCH;
+    });
+
+    if (!found) {
+        Bucket bucket{static_cast<int>(idx), std::string(exe), std::string(), -1, limit._burst - 1.0, now_msec, 0, 0, 0};
+        if (limit._by == RateLimitBy::PID) {
+            bucket.pid = pid;
+        } else {
+            bucket.syscall = syscall;
+        }
+        shard.buckets.add(key, bucket);
+
+        shard.buckets.for_all_oldest_first([this,&shard](size_t entry_count, const std::chrono::steady_clock::time_point&, const std::string&, Bucket& bucket) {
+            if (entry_count > shard.max_buckets) {
+                add_summary(shard, bucket);
+                return CacheEntryOP::REMOVE;
+            }
+            return CacheEntryOP::STOP;
+        });
+    }
+
+    if (suppress) {
+        _metrics[idx]->Add(1.0);
+    }
+    return suppress;
+}
+
+bool RateLimiter::TakeSummaries(std::vector<RateLimitSummary>& summaries, bool all) {
+    bool added = false;
+    for (auto& shard_ptr : _shards) {
+        auto& shard = *shard_ptr;
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        // Keys are only added to suppressed_keys once per report, unless the bucket was evicted and added again.
+        if (all || shard.suppressed_keys.size() > shard.max_buckets) {
+            for (auto& key : shard.suppressed_keys) {
+                shard.buckets.on(key, [this,&shard](size_t, const std::chrono::steady_clock::time_point&, Bucket& bucket) {
+                    add_summary(shard, bucket);
+                    return CacheEntryOP::NOOP;
+                });
+            }
+            shard.suppressed_keys.clear();
+        }
+
+        if (shard.pending.empty()) {
+            continue;
+        }
+        for (auto& summary : shard.pending) {
+            summaries.emplace_back(std::move(summary));
+        }
+        shard.pending.clear();
+        added = true;
+    }
+    return added;
+}
+
+void RateLimiter::Flush(bool all) {
+    _summaries.clear();
+    if (!TakeSummaries(_summaries, all)) {
+        return;
+    }
+    for (auto& summary : _summaries) {
+        add_summary_event(summary);
+    }
+}
+
+void RateLimiter::run() {
+    Logger::Info("RateLimiter: starting");
+
+    auto next_report = std::chrono::steady_clock::now() + std::chrono::seconds(_config->_report_secs);
+    try {
+        while (!_sleep(FLUSH_INTERVAL)) {
+            auto now = std::chrono::steady_clock::now();
+            bool all = now >= next_report;
+            if (all) {
+                next_report = now + std::chrono::seconds(_config->_report_secs);
+            }
+            Flush(all);
+        }
+        // The event processors are stopped first, so the counts are complete
+        Flush(true);
+    } catch (const std::exception& ex) {
+        Logger::Info("RateLimiter: stopping: %s", ex.what());
+        return;
+    }
+
+    Logger::Info("RateLimiter: stopping");
+}
+
+void RateLimiter::add_summary(Shard& shard, Bucket& bucket) {
+    if (bucket.suppressed == 0) {
+        return;
+    }
+    shard.pending.emplace_back(RateLimitSummary{_config->_limits[bucket.limit_idx]->_name, bucket.exe, bucket.syscall, bucket.pid,
+                                           bucket.suppressed, bucket.first_suppressed_msec, bucket.last_suppressed_msec});
+    bucket.suppressed = 0;
+}
+
+void RateLimiter::cancel_event() {
+    if (_builder->CancelEvent() != 1) {
+        throw std::runtime_error("Queue Closed");
+    }
+}
+
+void RateLimiter::add_summary_event(const RateLimitSummary& summary) {
+    using namespace std::string_view_literals;
+
+    static auto SV_RATE_LIMIT = "rate_limit"sv;
+    static auto SV_EXE = "exe"sv;
+    static auto SV_SYSCALL = "syscall"sv;
+    static auto SV_PID = "pid"sv;
+    static auto SV_SUPPRESSED = "suppressed"sv;
+    static auto SV_FIRST = "first_suppressed"sv;
+    static auto SV_LAST = "last_suppressed"sv;
+    static auto rec_type_name = RecordTypeToName(RecordType::AUOMS_SUPPRESSED);
+
+    auto first = std::to_string(summary.first_msec/1000) + "." + std::to_string(1000 + summary.first_msec%1000).substr(1);
+    auto last = std::to_string(summary.last_msec/1000) + "." + std::to_string(1000 + summary.last_msec%1000).substr(1);
+    auto count = std::to_string(summary.count);
+    auto pid = std::to_string(summary.pid);
+    bool by_pid = summary.pid >= 0;
+
+    auto ret = _builder->BeginEvent(summary.last_msec/1000, static_cast<uint32_t>(summary.last_msec%1000), 0, 1);
+    if (ret != 1) {
+        if (ret == Queue::CLOSED) {
+            throw std::runtime_error("Queue closed");
+        }
+        return;
+    }
+    _builder->SetEventFlags(EVENT_FLAG_IS_AUOMS_EVENT);
+    if (by_pid) {
+        _builder->SetEventPid(summary.pid);
+    }
+    ret = _builder->BeginRecord(static_cast<uint32_t>(RecordType::AUOMS_SUPPRESSED), rec_type_name, ""sv, 6);
+    if (ret == 1) {
+        ret = _builder->AddField(SV_RATE_LIMIT, summary.limit_name, ""sv, field_type_t::UNCLASSIFIED);
+    }
+    if (ret == 1) {
+        ret = _builder->AddField(SV_EXE, summary.exe, ""sv, field_type_t::UNESCAPED);
+    }
+    if (ret == 1) {
+        if (by_pid) {
+            ret = _builder->AddField(SV_PID, pid, ""sv, field_type_t::UNCLASSIFIED);
+        } else {
+            ret = _builder->AddField(SV_SYSCALL, summary.syscall, ""sv, field_type_t::UNCLASSIFIED);
+        }
+    }
+    if (ret == 1) {
+        ret = _builder->AddField(SV_SUPPRESSED, count, ""sv, field_type_t::UNCLASSIFIED);
+    }
+    if (ret == 1) {
+        ret = _builder->AddField(SV_FIRST, first, ""sv, field_type_t::UNCLASSIFIED);
+    }
+    if (ret == 1) {
+        ret = _builder->AddField(SV_LAST, last, ""sv, field_type_t::UNCLASSIFIED);
+    }
+    if (ret == 1) {
+        ret = _builder->EndRecord();
+    }
+    if (ret != 1) {
+        if (ret == Queue::CLOSED) {
+            throw std::runtime_error("Queue closed");
+        }
+        cancel_event();
+        return;
+    }
+
+    ret = _builder->EndEvent();
+    if (ret != 1) {
+        if (ret == Queue::CLOSED) {
+            throw std::runtime_error("Queue closed");
+        }
+    }
+}
@@ -0,0 +1,161 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef AUOMS_RATELIMITER_H
+#define AUOMS_RATELIMITER_H
+
+#include "RunBase.h"
+#include "Config.h"
+#include "Metrics.h"
+#include "Cache.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+enum class RateLimitBy {
+    EXE_SYSCALL,
+    PID,
+};
+
+/*
+ * A token bucket rate limit for syscall events.
+ *
+ * Each distinct (exe, syscall) pair or pid (depending on _by) of the events matching the limit gets its own bucket
+ * that holds up to _burst tokens and is refilled at _rate tokens per second. An event that finds its bucket empty
+ * is suppressed (dropped) and counted instead.
+ */
+struct RateLimit {
+    explicit RateLimit(const std::string& name): _name(name), _by(RateLimitBy::EXE_SYSCALL), _rate(0), _burst(0) {}
+
+    bool Matches(const std::string_view& keys) const;
+
+    std::string _name;
+    RateLimitBy _by;
+    double _rate;  // Events per second
+    double _burst; // Max events
+    std::unordered_set<std::string> _keys; // Audit rule keys, empty == all events
+};
+
+class RateLimitConfig {
+public:
+    static constexpr size_t MAX_RATE_LIMITS = 64;
+    static constexpr uint64_t DEFAULT_MAX_BUCKETS = 4096;
+    static constexpr uint64_t DEFAULT_REPORT_SECS = 60;
+
+    RateLimitConfig(): _max_buckets(DEFAULT_MAX_BUCKETS), _report_secs(DEFAULT_REPORT_SECS) {}
+
+    // Return false (after logging the reason) if the config is invalid
+    bool ParseConfig(const Config& config);
+
+    inline bool Empty() const { return _limits.empty(); }
+
+    std::vector<std::unique_ptr<RateLimit>> _limits;
+    uint64_t _max_buckets;
+    uint64_t _report_secs;
+};
+
+// The number of events a bucket suppressed since it was last reported
+struct RateLimitSummary {
+    std::string limit_name;
+    std::string exe;
+    std::string syscall;
+    int pid;
+    uint64_t count;
+    uint64_t first_msec; // Event time of the first and last suppressed events (milliseconds since the epoch)
+    uint64_t last_msec;
+};
+
+/*
+ * The buckets of the rate limits in a RateLimitConfig, shared by all the event processors.
+ *
+ * ShouldSuppress is thread safe. Buckets are refilled according to the event timestamps.
+ * The buckets are split into shards by key hash, each with its own lock, so that event processors only contend
+ * when their events use buckets in the same shard. At most RateLimitConfig::_max_buckets buckets are kept (split
+ * evenly between the shards), the least recently used buckets of a shard are evicted first.
+ *
+ * The summaries are added (as AUOMS_SUPPRESSED events) by the RateLimiter thread: those of evicted buckets every
+ * FLUSH_INTERVAL, those of all buckets every RateLimitConfig::_report_secs and when the RateLimiter is stopped.
+ */
+class RateLimiter: public RunBase {
+public:
+    static constexpr int FLUSH_INTERVAL = 1000; // Milliseconds
+
+    RateLimiter(const std::shared_ptr<const RateLimitConfig>& config, const std::shared_ptr<EventBuilder>& builder, const std::shared_ptr<Metrics>& metrics);
+
+    // Returns true if the event should be suppressed.
+    // keys is the unescaped key field value (multiple keys are separated by 0x01).
+    // The limits by pid don't apply if pid is < 0.
+    bool ShouldSuppress(const std::string_view& keys, const std::string_view& exe, const std::string_view& syscall, int pid, uint64_t sec, uint32_t msec);
+
+    // Moves the summaries of evicted buckets into summaries.
+    // If all is true, the summaries of all buckets with suppressed events are moved.
+    // Returns true if any summaries were added.
+    bool TakeSummaries(std::vector<RateLimitSummary>& summaries, bool all = false);
+
+    // Adds the summaries (see TakeSummaries) as AUOMS_SUPPRESSED events. Called by run(). Throws if the queue is closed.
+    void Flush(bool all);
+
+protected:
+    void run() override;
+
+private:
+    // Each shard keeps at least this many buckets, so small _max_buckets values get fewer shards
+    static constexpr uint64_t MIN_SHARD_BUCKETS = 256;
+    static constexpr size_t MAX_SHARDS = 16;
+
+    struct Bucket {
+        int limit_idx;
+        std::string exe;
+        std::string syscall;
+        int pid;
+        double tokens;
+        uint64_t last_msec;
+        uint64_t suppressed;
+        uint64_t first_suppressed_msec;
+        uint64_t last_suppressed_msec;
+    };
+
+    struct Shard {
+        explicit Shard(uint64_t max_buckets): max_buckets(max_buckets), now_msec(0) {}
+
+        std::mutex mutex;
+        uint64_t max_buckets;
+        Cache<std::string, Bucket> buckets;
+        std::vector<RateLimitSummary> pending;
+        // The keys of the buckets that suppressed events since the last report
+        std::vector<std::string> suppressed_keys;
+        std::string key;
+        uint64_t now_msec;
+    };
+
+    void add_summary(Shard& shard, Bucket& bucket);
+    void add_summary_event(const RateLimitSummary& summary);
+    void cancel_event();
+
+    std::shared_ptr<const RateLimitConfig> _config;
+    std::shared_ptr<EventBuilder> _builder;
+    std::vector<std::shared_ptr<Metric>> _metrics;
+    std::vector<std::unique_ptr<Shard>> _shards;
+    // Only used by Flush()
+    std::vector<RateLimitSummary> _summaries;
+};
+
+#endif //AUOMS_RATELIMITER_H
@@ -107,13 +107,15 @@ int RawEvent::AddEvent(EventBuilder& builder) {
         }
     }
     if (_num_dropped_records > 0 && _drop_count.size() > 0) {
-        ret = builder.BeginRecord(static_cast<uint32_t>(RecordType::AUOMS_DROPPED_RECORDS), std::string_view(RecordTypeToName(RecordType::AUOMS_DROPPED_RECORDS)), std::string_view(""), static_cast<uint16_t>(_drop_count.size()));
+        static auto dropped_records_name = RecordTypeToName(RecordType::AUOMS_DROPPED_RECORDS);
+        std::string unknown_str;
+        ret = builder.BeginRecord(static_cast<uint32_t>(RecordType::AUOMS_DROPPED_RECORDS), std::string_view(dropped_records_name), std::string_view(""), static_cast<uint16_t>(_drop_count.size()));
         if (ret != 1) {
             builder.CancelEvent();
             return ret;
         }
         for (auto& e: _drop_count) {
-            ret = builder.AddField(RecordTypeToName(e.first), std::to_string(e.second), "", field_type_t::UNCLASSIFIED);
+            ret = builder.AddField(RecordTypeToName(e.first, unknown_str), std::to_string(e.second), "", field_type_t::UNCLASSIFIED);
             if (ret != 1) {
                 builder.CancelEvent();
                 return ret;
@@ -128,6 +130,19 @@ int RawEvent::AddEvent(EventBuilder& builder) {
     return builder.EndEvent();
 }
 
+int RawEventAccumulator::add_event(RawEvent& event) {
+    auto receive_time = event.GetReceiveTime();
+    if (receive_time.time_since_epoch().count() == 0) {
+        return event.AddEvent(*_builder);
+    }
+
+    auto complete_time = std::chrono::steady_clock::now();
+    _complete_latency->AddSince(receive_time);
+    auto ret = event.AddEvent(*_builder);
+    _commit_latency->AddSince(complete_time);
+    return ret;
+}
+
 int RawEventAccumulator::AddRecord(std::unique_ptr<RawEventRecord> record) {
     std::lock_guard<std::mutex> lock(_mutex);
 
@@ -143,7 +158,7 @@ int RawEventAccumulator::AddRecord(std::unique_ptr<RawEventRecord> record) {
     int ret = 0;
     auto found = _events.on(event_id, [this,&record,&ret](size_t entry_count, const std::chrono::steady_clock::time_point& last_touched, std::shared_ptr<RawEvent>& event) {
         if (event->AddRecord(std::move(record))) {
-            ret = event->AddEvent(*_builder);
+            ret = add_event(*event);
             return CacheEntryOP::REMOVE;
         } else {
             return CacheEntryOP::TOUCH;
@@ -151,9 +166,13 @@ int RawEventAccumulator::AddRecord(std::unique_ptr<RawEventRecord> record) {
     });
     if (!found) {
         auto event = std::make_shared<RawEvent>(record->GetEventId());
+        if (LatencyHistogram::Sample()) {
+            event->SetReceiveTime(std::chrono::steady_clock::now());
+            _receive_latency->AddSinceEventTime(event_id.Seconds(), event_id.Milliseconds());
+        }
         if (event->AddRecord(std::move(record))) {
             _event_metric->Add(1.0);
-            return event->AddEvent(*_builder);
+            return add_event(*event);
         } else {
             _events.add(event_id, event);
         }
@@ -161,7 +180,7 @@ int RawEventAccumulator::AddRecord(std::unique_ptr<RawEventRecord> record) {
     // Don't wait for Flush to be called, preemptively flush oldest if the cache size limit is exceeded
     _events.for_all_oldest_first([this](size_t entry_count, const std::chrono::steady_clock::time_point& last_touched, const EventId& key, std::shared_ptr<RawEvent>& event) {
         if (entry_count > MAX_CACHE_ENTRY) {
-            event->AddEvent(*_builder);
+            add_event(*event);
             _event_metric->Add(1.0);
             return CacheEntryOP::REMOVE;
         }
@@ -177,7 +196,7 @@ void RawEventAccumulator::Flush(long milliseconds) {
 
         _events.for_all_oldest_first([this,now,milliseconds](size_t entry_count, const std::chrono::steady_clock::time_point& last_touched, const EventId& key, std::shared_ptr<RawEvent>& event) {
             if (entry_count > MAX_CACHE_ENTRY || std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()-last_touched.time_since_epoch()) > std::chrono::milliseconds(milliseconds)) {
-                event->AddEvent(*_builder);
+                add_event(*event);
                 _event_metric->Add(1.0);
                 return CacheEntryOP::REMOVE;
             }
@@ -185,7 +204,7 @@ void RawEventAccumulator::Flush(long milliseconds) {
         });
     } else {
         _events.for_all_oldest_first([this](size_t entry_count, const std::chrono::steady_clock::time_point& last_touched, const EventId& key, std::shared_ptr<RawEvent>& event) {
-            event->AddEvent(*_builder);
+            add_event(*event);
             _event_metric->Add(1.0);
             return CacheEntryOP::REMOVE;
         });
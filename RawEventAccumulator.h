@@ -35,6 +35,10 @@ public:
 
     inline EventId GetEventId() { return _event_id; }
 
+    // Only set for events sampled for latency metrics
+    inline void SetReceiveTime(std::chrono::steady_clock::time_point time) { _receive_time = time; }
+    inline std::chrono::steady_clock::time_point GetReceiveTime() const { return _receive_time; }
+
     // Returns true if the event is now complete;
     bool AddRecord(std::unique_ptr<RawEventRecord> record);
 
@@ -42,6 +46,7 @@ public:
 
 private:
     EventId _event_id;
+    std::chrono::steady_clock::time_point _receive_time;
     std::vector<std::unique_ptr<RawEventRecord>> _records;
     std::vector<std::unique_ptr<RawEventRecord>> _execve_records;
     std::unordered_map<RecordType, int> _drop_count;
@@ -58,6 +63,9 @@ public:
         _bytes_metric = _metrics->AddMetric("raw_data", "bytes", MetricPeriod::SECOND, MetricPeriod::HOUR);
         _record_metric = _metrics->AddMetric("raw_data", "records", MetricPeriod::SECOND, MetricPeriod::HOUR);
         _event_metric = _metrics->AddMetric("raw_data", "events", MetricPeriod::SECOND, MetricPeriod::HOUR);
+        _receive_latency = _metrics->AddLatencyHistogram("latency", "collect_receive");
+        _complete_latency = _metrics->AddLatencyHistogram("latency", "collect_complete");
+        _commit_latency = _metrics->AddLatencyHistogram("latency", "collect_commit");
     }
 
     int AddRecord(std::unique_ptr<RawEventRecord> record);
@@ -65,12 +73,18 @@ public:
 
 private:
     static constexpr size_t MAX_CACHE_ENTRY = 256;
+
+    int add_event(RawEvent& event);
+
     std::mutex _mutex;
     std::shared_ptr<EventBuilder> _builder;
     std::shared_ptr<Metrics> _metrics;
     std::shared_ptr<Metric> _bytes_metric;
     std::shared_ptr<Metric> _record_metric;
     std::shared_ptr<Metric> _event_metric;
+    std::shared_ptr<LatencyHistogram> _receive_latency; // Kernel timestamp -> first record received
+    std::shared_ptr<LatencyHistogram> _complete_latency; // First record received -> event complete
+    std::shared_ptr<LatencyHistogram> _commit_latency; // Event complete -> added to the queue
     Cache<EventId, std::shared_ptr<RawEvent>> _events;
 };
 
@@ -21,6 +21,7 @@
 #include "Translate.h"
 #include "Interpret.h"
 #include "StringUtils.h"
+#include "StringTable.h"
 
 #include <climits>
 #include <algorithm>
@@ -30,7 +31,150 @@
 // This value mirrors what is defined for AUDIT_KEY_SEPARATOR in libaudit.h
 #define KEY_SEP 0x01
 
-#define PROCESS_INVENTORY_EVENT_INTERVAL 3600
+// Use the integer parsed when the event was collected, if there is one
+static inline int64_t field_int_value(const EventRecordField& field) {
+    if (field.HasIntValue()) {
+        return field.IntValue();
+    }
+    return atol(field.RawValuePtr());
+}
+
+/*
+ * process_syscall_event merges the records of a syscall event into a single record.
+ * How each record is merged is decided by its handler, looked up by record type, and the handler's field plan,
+ * which maps the names of the fields that need special treatment to an action.
+ */
+
+enum class SyscallRecordKind: uint8_t {
+    OTHER,          // All fields are copied, prefixed with the record type name
+    SYSCALL,        // Fields are copied, some values are also used for filtering
+    EXECVE,         // Converted into the cmdline field, the argc field is copied
+    PATH,           // The fields of item 0 are copied, the others are merged into the path_* fields
+    SINGLE_FIELD,   // Only the one field (FieldAction::KEEP) of the first record with that field is copied
+    PROCTITLE,      // Converted into the proctitle field (if there are no EXECVE records)
+    DROPPED,        // All fields are copied, prefixed with "dropped_"
+};
+
+enum class FieldAction: uint8_t {
+    COPY,
+    DROP,
+    KEEP,
+    // SYSCALL: The field is copied and the value is kept
+    SYSCALL,
+    PID,
+    PPID,
+    UID,
+    GID,
+    EXE,
+    // PATH: Merged into the path_* fields
+    PATH_ITEM,
+    PATH_NAME,
+    PATH_NAMETYPE,
+    PATH_MODE,
+    PATH_OUID,
+    PATH_OGID,
+};
+
+// The fields taken from SINGLE_FIELD records, in the order they are added to the merged record.
+// The cwd field is added before the path fields, the others after the cmdline field.
+enum SingleFieldSlot: int {
+    SINGLE_FIELD_CWD,
+    SINGLE_FIELD_SADDR,
+    SINGLE_FIELD_INTEGRITY_HASH,
+    NUM_SINGLE_FIELDS
+};
+
+struct SyscallRecordHandler {
+    RecordType type;
+    SyscallRecordKind kind;
+    FieldAction (*field_action)(const std::string_view& name);
+    int slot; // SINGLE_FIELD only
+};
+
+template <const auto& Plan>
+FieldAction plan_field_action(const std::string_view& name) {
+    return Plan.ToInt(name);
+}
+
+static FieldAction copy_field_action(const std::string_view& name) {
+    return FieldAction::COPY;
+}
+
+static constexpr auto s_syscall_field_plan = MakeStringTable<FieldAction>(FieldAction::COPY, {
+        {"type", FieldAction::DROP},
+        {"items", FieldAction::DROP},
+        {"syscall", FieldAction::SYSCALL},
+        {"pid", FieldAction::PID},
+        {"ppid", FieldAction::PPID},
+        {"uid", FieldAction::UID},
+        {"gid", FieldAction::GID},
+        {"exe", FieldAction::EXE},
+});
+
+static constexpr auto s_execve_field_plan = MakeStringTable<FieldAction>(FieldAction::DROP, {
+        {"argc", FieldAction::KEEP},
+});
+
+static constexpr auto s_path_field_plan = MakeStringTable<FieldAction>(FieldAction::COPY, {
+        {"item", FieldAction::PATH_ITEM},
+        {"node", FieldAction::DROP},
+        {"name", FieldAction::PATH_NAME},
+        // This assumes there will only be a nametype field or an objtype field but never both
+        {"nametype", FieldAction::PATH_NAMETYPE},
+        {"objtype", FieldAction::PATH_NAMETYPE},
+        {"mode", FieldAction::PATH_MODE},
+        {"ouid", FieldAction::PATH_OUID},
+        {"ogid", FieldAction::PATH_OGID},
+});
+
+static constexpr auto s_cwd_field_plan = MakeStringTable<FieldAction>(FieldAction::DROP, {
+        {"cwd", FieldAction::KEEP},
+});
+
+static constexpr auto s_sockaddr_field_plan = MakeStringTable<FieldAction>(FieldAction::DROP, {
+        {"saddr", FieldAction::KEEP},
+});
+
+static constexpr auto s_integrity_field_plan = MakeStringTable<FieldAction>(FieldAction::DROP, {
+        {"hash", FieldAction::KEEP},
+});
+
+static constexpr auto s_proctitle_field_plan = MakeStringTable<FieldAction>(FieldAction::DROP, {
+        {"proctitle", FieldAction::KEEP},
+});
+
+static constexpr SyscallRecordHandler s_syscall_record_handlers[] = {
+        {RecordType::SYSCALL, SyscallRecordKind::SYSCALL, plan_field_action<s_syscall_field_plan>, -1},
+        {RecordType::PATH, SyscallRecordKind::PATH, plan_field_action<s_path_field_plan>, -1},
+        {RecordType::EXECVE, SyscallRecordKind::EXECVE, plan_field_action<s_execve_field_plan>, -1},
+        {RecordType::CWD, SyscallRecordKind::SINGLE_FIELD, plan_field_action<s_cwd_field_plan>, SINGLE_FIELD_CWD},
+        {RecordType::SOCKADDR, SyscallRecordKind::SINGLE_FIELD, plan_field_action<s_sockaddr_field_plan>, SINGLE_FIELD_SADDR},
+        {RecordType::INTEGRITY_RULE, SyscallRecordKind::SINGLE_FIELD, plan_field_action<s_integrity_field_plan>, SINGLE_FIELD_INTEGRITY_HASH},
+        {RecordType::PROCTITLE, SyscallRecordKind::PROCTITLE, plan_field_action<s_proctitle_field_plan>, -1},
+        {RecordType::AUOMS_DROPPED_RECORDS, SyscallRecordKind::DROPPED, copy_field_action, -1},
+};
+
+static constexpr SyscallRecordHandler s_other_record_handler = {RecordType::UNKNOWN, SyscallRecordKind::OTHER, copy_field_action, -1};
+
+static inline const SyscallRecordHandler& get_syscall_record_handler(RecordType rtype) {
+    for (auto& handler : s_syscall_record_handlers) {
+        if (handler.type == rtype) {
+            return handler;
+        }
+    }
+    return s_other_record_handler;
+}
+
+// Returns the first of the (max_fields) fields for which the plan returns action
+static EventRecordField find_plan_field(const EventRecord& rec, const SyscallRecordHandler& handler, FieldAction action, int max_fields = INT_MAX) {
+    for (int i = 0; i < rec.NumFields() && i < max_fields; ++i) {
+        auto field = rec.FieldAt(i);
+        if (handler.field_action(field.FieldName()) == action) {
+            return field;
+        }
+    }
+    return EventRecordField();
+}
 
 void RawEventProcessor::ProcessData(const void* data, size_t data_len) {
 
@@ -46,20 +190,102 @@ void RawEventProcessor::ProcessData(const void* data, size_t data_len) {
         return;
     }
 
+    std::chrono::steady_clock::time_point start_time;
+    if (LatencyHistogram::Sample()) {
+        start_time = std::chrono::steady_clock::now();
+        _input_latency->AddSinceEventTime(event.Seconds(), event.Milliseconds());
+    }
+
+    static auto S_EXECVE = std::string("execve");
+
     auto rec = event.begin();
     auto rtype = static_cast<RecordType>(rec.RecordType());
 
+    if (_overload && _overload->IsShedding()) {
+        load_drop_fields(event);
+        if (_overload->ShouldShed(rtype, _tmp_val, _drop_key, _drop_exe)) {
+            // A shed execve is not sent, but the process tree still has to be updated (as in degraded mode)
+            if (rtype == RecordType::SYSCALL && starts_with(_tmp_val, S_EXECVE)) {
+                process_syscall_event(event, true, true);
+            }
+            return;
+        }
+    }
+
+    if (_overload) {
+        _overload->SetLastEventTime(event.Seconds());
+    }
+
+    // In degraded mode the process tree is still updated and filters still apply, but the records are forwarded
+    // without interpretation, user/group name lookups or syscall record merging (EXECVE, PATH etc.)
+    bool degraded = _overload && _overload->IsDegraded();
+
     if (rtype == RecordType::SYSCALL || rtype == RecordType::EXECVE || rtype == RecordType::CWD || rtype == RecordType::PATH ||
                 rtype == RecordType::SOCKADDR || rtype == RecordType::INTEGRITY_RULE) {
-        if (!process_syscall_event(event)) {
-            process_event(event);
+        if (!process_syscall_event(event, degraded, false)) {
+            process_event(event, degraded);
         }
     } else {
-        process_event(event);
+        process_event(event, degraded);
     }
+
+    _process_latency->AddSince(start_time);
 }
 
-void RawEventProcessor::process_event(const Event& event) {
+// Only the raw SYSCALL record is examined, so that shedding costs as little as possible.
+void RawEventProcessor::load_drop_fields(const Event& event) {
+    using namespace std::string_view_literals;
+
+    static auto SV_SYSCALL = "syscall"sv;
+    static auto SV_KEY = "key"sv;
+    static auto SV_EXE = "exe"sv;
+
+    _tmp_val.resize(0);
+    _drop_key.resize(0);
+    _drop_exe.resize(0);
+
+    for (auto& rec: event) {
+        if (static_cast<RecordType>(rec.RecordType()) == RecordType::SYSCALL) {
+            auto field = rec.FieldByName(SV_SYSCALL);
+            if (field && !interpret_field(_tmp_val, rec, field, field_type_t::SYSCALL)) {
+                _tmp_val.resize(0);
+            }
+            field = rec.FieldByName(SV_KEY);
+            if (field && unescape_raw_field(_drop_key, field.RawValuePtr(), field.RawValueSize()) <= 0) {
+                _drop_key.resize(0);
+            }
+            field = rec.FieldByName(SV_EXE);
+            if (field && unescape_raw_field(_drop_exe, field.RawValuePtr(), field.RawValueSize()) <= 0) {
+                _drop_exe.resize(0);
+            }
+            break;
+        }
+    }
+}
+
+// Called after the filters, so that only the events that would otherwise be sent count against the rate limits
+bool RawEventProcessor::should_suppress(const Event& event, const EventRecord& syscall_rec, int pid) {
+    using namespace std::string_view_literals;
+
+    static auto SV_KEY = "key"sv;
+    static auto SV_EXE = "exe"sv;
+
+    _drop_key.resize(0);
+    _drop_exe.resize(0);
+
+    auto field = syscall_rec.FieldByName(SV_KEY);
+    if (field && unescape_raw_field(_drop_key, field.RawValuePtr(), field.RawValueSize()) <= 0) {
+        _drop_key.resize(0);
+    }
+    field = syscall_rec.FieldByName(SV_EXE);
+    if (field && unescape_raw_field(_drop_exe, field.RawValuePtr(), field.RawValueSize()) <= 0) {
+        _drop_exe.resize(0);
+    }
+
+    return _rate_limiter->ShouldSuppress(_drop_key, _drop_exe, _syscall, pid, event.Seconds(), event.Milliseconds());
+}
+
+void RawEventProcessor::process_event(const Event& event, bool degraded) {
 
     using namespace std::string_literals;
 
@@ -90,16 +316,16 @@ void RawEventProcessor::process_event(const Event& event) {
 
         auto pid_field = rec.FieldByName(S_PID);
         if (pid_field) {
-            _pid = atoi(pid_field.RawValuePtr());
+            _pid = static_cast<int>(field_int_value(pid_field));
             _builder->SetEventPid(_pid);
         }
         auto ppid_field = rec.FieldByName(S_PPID);
         if (ppid_field) {
-            _ppid = atoi(ppid_field.RawValuePtr());
+            _ppid = static_cast<int>(field_int_value(ppid_field));
         }
 
         for (auto& field: rec) {
-            if (!process_field(rec, field, false)) {
+            if (!(degraded ? process_raw_field(field) : process_field(rec, field, false))) {
                 cancel_event();
                 return;
             }
@@ -115,28 +341,19 @@ void RawEventProcessor::process_event(const Event& event) {
         }
     }
 
+    if (degraded) {
+        _event_flags |= EVENT_FLAG_IS_DEGRADED;
+        _overload->AddDegradedEvent();
+    }
     end_event();
 }
 
-bool RawEventProcessor::process_syscall_event(const Event& event) {
+bool RawEventProcessor::process_syscall_event(const Event& event, bool degraded, bool shed) {
 
     using namespace std::string_view_literals;
 
     static auto SV_ZERO = "0"sv;
-    static auto SV_TYPE = "type"sv;
-    static auto SV_ITEMS = "items"sv;
     static auto SV_ITEM = "item"sv;
-    static auto SV_NODE = "node"sv;
-    static auto SV_ARGC = "argc"sv;
-    static auto SV_CWD = "cwd"sv;
-    static auto SV_SADDR = "saddr"sv;
-    static auto SV_INTEGRITY_HASH = "hash"sv;
-    static auto SV_NAME = "name"sv;
-    static auto SV_NAMETYPE = "nametype"sv;
-    static auto SV_OBJTYPE = "objtype"sv;
-    static auto SV_MODE = "mode"sv;
-    static auto SV_OUID = "ouid"sv;
-    static auto SV_OGID = "ogid"sv;
     static auto SV_PATH_NAME = "path_name"sv;
     static auto SV_PATH_NAMETYPE = "path_nametype"sv;
     static auto SV_PATH_MODE = "path_mode"sv;
@@ -146,9 +363,6 @@ bool RawEventProcessor::process_syscall_event(const Event& event) {
     static auto SV_CMDLINE = "cmdline"sv;
     static auto SV_CONTAINERID = "containerid"sv;
     static auto SV_DROPPED = "dropped_"sv;
-    static auto SV_PID = "pid"sv;
-    static auto SV_PPID = "ppid"sv;
-    static auto SV_SYSCALL = "syscall"sv;
     static auto SV_PROCTITLE = "proctitle"sv;
     static auto S_EXECVE = std::string("execve");
     static auto SV_JSON_ARRAY_START = "[\""sv;
@@ -161,8 +375,9 @@ bool RawEventProcessor::process_syscall_event(const Event& event) {
     int num_fields = 0;
     int num_path = 0;
     int num_execve = 0;
-    int uid;
-    int gid;
+    int pid = -1;
+    int uid = -1;
+    int gid = -1;
     std::string exe;
     std::string syscall;
 
@@ -171,170 +386,140 @@ bool RawEventProcessor::process_syscall_event(const Event& event) {
 
     EventRecord syscall_rec;
     EventRecordField syscall_field;
-    EventRecord cwd_rec;
-    EventRecordField cwd_field;
     EventRecord path_rec;
-    std::vector<EventRecord> path_recs;
-    std::vector<EventRecord> execve_recs;
     EventRecord argc_rec;
     EventRecordField argc_field;
-    EventRecord sockaddr_rec;
-    EventRecordField sockaddr_field;
-    EventRecord integrity_rec;
-    EventRecordField integrity_field;
+    EventRecord single_recs[NUM_SINGLE_FIELDS];
+    EventRecordField single_fields[NUM_SINGLE_FIELDS];
     EventRecord proctitle_rec;
     EventRecordField proctitle_field;
     EventRecord dropped_rec;
-    std::vector<EventRecord> other_recs;
+
+    // Reused between events, so that they don't have to be allocated for every event
+    _execve_recs.resize(0);
+    _path_recs.resize(0);
+    _other_recs.resize(0);
 
     for (auto& rec: event) {
-        switch(static_cast<RecordType>(rec.RecordType())) {
-            case RecordType::SYSCALL:
+        auto& handler = get_syscall_record_handler(static_cast<RecordType>(rec.RecordType()));
+        switch(handler.kind) {
+            case SyscallRecordKind::SYSCALL:
                 if (!syscall_rec) {
                     rec_type = RecordType::AUOMS_SYSCALL;
                     rec_type_name = auoms_syscall_name;
+                    // The actions are kept so that the plan isn't consulted again when the fields are added
+                    _syscall_field_actions.resize(0);
                     for (auto &f : rec) {
-                        auto fname = f.FieldName();
-                        switch (fname[0]) {
-                            case 't': {
-                                if (fname != SV_TYPE) {
-                                    num_fields += 1;
-                                }
+                        auto action = handler.field_action(f.FieldName());
+                        _syscall_field_actions.push_back(action);
+                        switch (action) {
+                            case FieldAction::DROP:
+                                continue;
+                            case FieldAction::SYSCALL:
+                                syscall_field = f;
                                 break;
-                            }
-                            case 'i': {
-                                if (fname != SV_ITEMS) {
-                                    num_fields += 1;
-                                }
+                            case FieldAction::PID:
+                                _pid = static_cast<int>(field_int_value(f));
+                                pid = _pid;
                                 break;
-                            }
-                            case 's': {
-                                if (fname == SV_SYSCALL) {
-                                    syscall_field = f;
-                                }
-                                num_fields += 1;
+                            case FieldAction::PPID:
+                                _ppid = static_cast<int>(field_int_value(f));
+                                break;
+                            case FieldAction::UID:
+                                uid = static_cast<int>(field_int_value(f));
+                                break;
+                            case FieldAction::GID:
+                                gid = static_cast<int>(field_int_value(f));
+                                break;
+                            case FieldAction::EXE:
+                                exe.assign(f.RawValuePtr(), f.RawValueSize());
                                 break;
-                            }
                             default:
-                                num_fields += 1;
                                 break;
                         }
+                        num_fields += 1;
                     }
                     syscall_rec = rec;
                 }
                 break;
-            case RecordType::EXECVE: {
+            case SyscallRecordKind::EXECVE: {
                 if (rec.NumFields() > 0) {
                     if (num_execve == 0) {
                         num_fields += 1;
                         if (!argc_rec) {
                             // the argc field should be the first (or second if node field is present) field in the record but check the first four just in case
-                            for(uint16_t i = 0; i < rec.NumFields() && i < 4 ; i++) {
-                                auto field = rec.FieldAt(i);
-                                if (field.FieldName() == SV_ARGC) {
-                                    num_fields += 1;
-                                    argc_rec = rec;
-                                    argc_field = field;
-                                    break;
-                                }
+                            auto field = find_plan_field(rec, handler, FieldAction::KEEP, 4);
+                            if (field) {
+                                num_fields += 1;
+                                argc_rec = rec;
+                                argc_field = field;
                             }
                         }
                     }
                     num_execve += 1;
-                    execve_recs.emplace_back(rec);
+                    _execve_recs.emplace_back(rec);
                 }
                 break;
             }
-            case RecordType::CWD:
-                if (!cwd_rec) {
-                    for (int i = 0; i < rec.NumFields(); ++i) {
-                        auto field = rec.FieldAt(i);
-                        if (field.FieldName() == SV_CWD) {
-                            num_fields += 1;
-                            cwd_rec = rec;
-                            cwd_field = field;
-                            break;
-                        }
-                    }
-                }
-                break;
-            case RecordType::PATH:
+            case SyscallRecordKind::PATH:
                 if (rec.NumFields() > 0) {
                     if (num_path == 0) {
-                        // This assumes there will only be a nametype field or an objtype field but never both
                         num_fields += 5; // name, mode, ouid, ogid, (nametype or objtype)
                     }
                     num_path += 1;
-                    path_recs.emplace_back(rec);
+                    _path_recs.emplace_back(rec);
                     if (!path_rec) {
                         bool isItemZero = false;
-                        unsigned int numNodeFields = 0;
+                        unsigned int numDropFields = 0;
                         for (auto& f: rec) {
-                            if (f.FieldName() == SV_ITEM && f.RawValue() == SV_ZERO) {
+                            auto action = handler.field_action(f.FieldName());
+                            if (action == FieldAction::PATH_ITEM && f.RawValue() == SV_ZERO) {
                                 isItemZero = true;
                                 path_rec = rec;
-                            } else if (f.FieldName() == SV_NODE) {
-                                numNodeFields++;
+                            } else if (action == FieldAction::DROP) {
+                                numDropFields++;
                             }
                         }
                         if (isItemZero) {
-                            num_fields += rec.NumFields() - 1 - numNodeFields; // exclude item and node fields
+                            num_fields += rec.NumFields() - 1 - numDropFields; // exclude item and node fields
                         }
                     }
                 }
                 break;
-            case RecordType::SOCKADDR:
-                if (!sockaddr_rec) {
-                    for (int i = 0; i < rec.NumFields(); ++i) {
-                        auto field = rec.FieldAt(i);
-                        if (field.FieldName() == SV_SADDR) {
-                            sockaddr_rec = rec;
-                            sockaddr_field = field;
-                            num_fields += 1;
-                            break;
-                        }
-                    }
-                }
-                break;
-            case RecordType::INTEGRITY_RULE:
-                if (!integrity_rec) {
-                    for (int i = 0; i < rec.NumFields(); ++i) {
-                        auto field = rec.FieldAt(i);
-                        if (field.FieldName() == SV_INTEGRITY_HASH) {
-                            integrity_rec = rec;
-                            integrity_field = field;
-                            num_fields += 1;
-                        }
+            case SyscallRecordKind::SINGLE_FIELD:
+                if (!single_recs[handler.slot]) {
+                    auto field = find_plan_field(rec, handler, FieldAction::KEEP);
+                    if (field) {
+                        num_fields += 1;
+                        single_recs[handler.slot] = rec;
+                        single_fields[handler.slot] = field;
                     }
                 }
                 break;
-            case RecordType::PROCTITLE:
+            case SyscallRecordKind::PROCTITLE:
                 if (!proctitle_rec) {
-                    for (int i = 0; i < rec.NumFields(); ++i) {
-                        auto field = rec.FieldAt(i);
-                        if (field.FieldName() == SV_PROCTITLE) {
-                            num_fields += 1;
-                            proctitle_rec = rec;
-                            proctitle_field = field;
-                            break;
-                        }
+                    auto field = find_plan_field(rec, handler, FieldAction::KEEP);
+                    if (field) {
+                        num_fields += 1;
+                        proctitle_rec = rec;
+                        proctitle_field = field;
                     }
                 }
                 break;
-            case RecordType::AUOMS_DROPPED_RECORDS:
+            case SyscallRecordKind::DROPPED:
                 dropped_rec = rec;
                 break;
-            default:
+            case SyscallRecordKind::OTHER:
                 if (rec.NumFields() > 0) {
                     num_fields += rec.NumFields();
-                    other_recs.emplace_back(rec);
+                    _other_recs.emplace_back(rec);
                 }
                 break;
         }
     }
 
     // Sort PATH records by item field
-    std::sort(path_recs.begin(), path_recs.end(), [](const EventRecord& a, const EventRecord& b) -> int {
+    std::sort(_path_recs.begin(), _path_recs.end(), [](const EventRecord& a, const EventRecord& b) -> int {
         auto fa = a.FieldByName(SV_ITEM);
         auto fb = b.FieldByName(SV_ITEM);
         int a_num = INT32_MAX; // PATH records with a missing or invalid item value should be sorted to the end;
@@ -360,7 +545,7 @@ bool RawEventProcessor::process_syscall_event(const Event& event) {
     });
 
     if (syscall_rec && syscall_field) {
-        if (InterpretField(_tmp_val, syscall_rec, syscall_field, field_type_t::SYSCALL)) {
+        if (interpret_field(_tmp_val, syscall_rec, syscall_field, field_type_t::SYSCALL)) {
             if (starts_with(_tmp_val, S_EXECVE)) {
                 rec_type = RecordType::AUOMS_EXECVE;
                 rec_type_name = auoms_execve_name;
@@ -370,7 +555,7 @@ bool RawEventProcessor::process_syscall_event(const Event& event) {
     }
 
     // Exclude proctitle if EXECVE is present
-    if (execve_recs.size() > 0 && proctitle_rec && proctitle_field) {
+    if (_execve_recs.size() > 0 && proctitle_rec && proctitle_field) {
         num_fields -= 1;
     }
 
@@ -378,6 +563,45 @@ bool RawEventProcessor::process_syscall_event(const Event& event) {
         return false;
     }
 
+    // The cmdline is needed by the process tree (for execve), so it is the only value converted before filtering
+    if (_execve_recs.size() > 0) {
+        _execve_converter.Convert(_execve_recs, _cmdline);
+    } else if (proctitle_rec && proctitle_field && !degraded) {
+        // The same (hex encoded) proctitle is seen for every syscall of a process
+        if (!_interp_cache.Get(field_type_t::PROCTITLE, proctitle_field.RawValue(), _cmdline)) {
+            unescape_raw_field(_unescaped_val, proctitle_field.RawValuePtr(), proctitle_field.RawValueSize());
+            ExecveConverter::ConvertRawCmdline(_unescaped_val, _cmdline);
+            _interp_cache.Put(field_type_t::PROCTITLE, proctitle_field.RawValue(), _cmdline);
+        }
+    } else {
+        _cmdline.resize(0);
+    }
+
+    // Filter on the process (pid, exe, uid, gid, cmdline) and syscall before building the event
+    std::shared_ptr<ProcessTreeItem> p;
+    if (!_syscall.empty() && starts_with(_syscall, S_EXECVE)) {
+        p = _processTree->AddProcess(ProcessTreeSource_execve, _pid, _ppid, uid, gid, exe, _cmdline);
+    } else if (!_syscall.empty()) {
+        p = _processTree->GetInfoForPid(_pid);
+    }
+
+    if (shed) {
+        return true;
+    }
+
+    if (_filtersEngine->IsEventFiltered(_syscall, p, _filtersEngine->GetCommonFlagsMask())) {
+        return true;
+    }
+
+    if (_rate_limiter && syscall_rec && should_suppress(event, syscall_rec, pid)) {
+        return true;
+    }
+
+    if (degraded) {
+        process_event(event, true);
+        return true;
+    }
+
     // For containerid
     num_fields += 1;
 
@@ -400,65 +624,24 @@ bool RawEventProcessor::process_syscall_event(const Event& event) {
     }
 
     if (syscall_rec) {
+        size_t idx = 0;
         for (auto &f : syscall_rec) {
-            auto fname = f.FieldName();
-            bool add_field = false;
-            switch (fname[0]) {
-                case 't': {
-                    if (fname != SV_TYPE) {
-                        add_field = true;
-                    }
-                    break;
-                }
-                case 'i': {
-                    if (fname != SV_ITEMS) {
-                        add_field = true;
-                    }
-                    break;
-                }
-                case 'p':
-                    if (fname == SV_PID) {
-                        _pid = atoi(f.RawValuePtr());
-                        _builder->SetEventPid(_pid);
-                    }
-                    if (fname == SV_PPID) {
-                        _ppid = atoi(f.RawValuePtr());
-                    }
-                    add_field = true;
-                    break;
-                case 'u':
-                    if (fname == "uid") {
-                        uid = atoi(f.RawValuePtr());
-                    }
-                    add_field = true;
-                    break;
-                case 'g':
-                    if (fname == "gid") {
-                        gid = atoi(f.RawValuePtr());
-                    }
-                    add_field = true;
-                    break;
-                case 'e':
-                    if (fname == "exe") {
-                        exe = std::string(f.RawValuePtr());
-                    }
-                    add_field = true;
-                    break;
-                default:
-                    add_field = true;
-                    break;
-            }
-            if (add_field) {
-                if (!process_field(syscall_rec, f, false)) {
-                    cancel_event();
-                    return false;
-                }
+            auto action = _syscall_field_actions[idx++];
+            if (action == FieldAction::DROP) {
+                continue;
+            }
+            if (action == FieldAction::PID) {
+                _builder->SetEventPid(_pid);
+            }
+            if (!process_field(syscall_rec, f, false)) {
+                cancel_event();
+                return false;
             }
         }
     }
 
-    if (cwd_rec && cwd_field) {
-        if (!process_field(cwd_rec, cwd_field, false)) {
+    if (single_recs[SINGLE_FIELD_CWD]) {
+        if (!process_field(single_recs[SINGLE_FIELD_CWD], single_fields[SINGLE_FIELD_CWD], false)) {
             cancel_event();
             return false;
         }
@@ -466,8 +649,8 @@ bool RawEventProcessor::process_syscall_event(const Event& event) {
 
     if (path_rec) {
         for (auto &f : path_rec) {
-            auto fname = f.FieldName();
-            if (fname != SV_ITEM && fname != SV_NODE) {
+            auto action = s_path_field_plan.ToInt(f.FieldName());
+            if (action != FieldAction::PATH_ITEM && action != FieldAction::DROP) {
                 if (!process_field(path_rec, f, false)) {
                     cancel_event();
                     return false;
@@ -482,7 +665,7 @@ bool RawEventProcessor::process_syscall_event(const Event& event) {
     _path_ouid.resize(0);
     _path_ogid.resize(0);
 
-    if (path_recs.size() > 0) {
+    if (_path_recs.size() > 0) {
         _path_name = SV_JSON_ARRAY_START;
         _path_nametype = SV_JSON_ARRAY_START;
         _path_mode = SV_JSON_ARRAY_START;
@@ -491,71 +674,49 @@ bool RawEventProcessor::process_syscall_event(const Event& event) {
 
         int path_num = 0;
 
-        for (auto& rec: path_recs) {
+        for (auto& rec: _path_recs) {
             bool found_nametype = false;
             for (auto &f : rec) {
-                auto fname = f.FieldName();
-                if (fname.size() >= 2) {
-                    switch (fname[0]) {
-                        case 'm': {
-                            if (fname == SV_MODE) {
-                                if (path_num != 0) {
-                                    _path_mode.append(SV_JSON_ARRAY_SEP);
-                                }
-                                _path_mode.append(f.RawValuePtr(), f.RawValueSize());
-                            }
-                            break;
+                switch (s_path_field_plan.ToInt(f.FieldName())) {
+                    case FieldAction::PATH_NAME:
+                        if (path_num != 0) {
+                            _path_name.append(SV_JSON_ARRAY_SEP);
                         }
-                        case 'n': {
-                            if (fname == SV_NAME) {
-                                if (path_num != 0) {
-                                    _path_name.append(SV_JSON_ARRAY_SEP);
-                                }
-                                // name might be escaped
-                                unescape_raw_field(_unescaped_val, f.RawValuePtr(), f.RawValueSize());
-                                // Path names might have non-ASCII/non-printable chars, escape the name before adding it.
-                                json_escape_string(_tmp_val, _unescaped_val.data(), _unescaped_val.size());
-                                _path_name.append(_tmp_val);
-                            } else if (fname == SV_NAMETYPE && !found_nametype) {
-                                if (path_num != 0) {
-                                    _path_nametype.append(SV_JSON_ARRAY_SEP);
-                                }
-                                _path_nametype.append(f.RawValuePtr(), f.RawValueSize());
-                                found_nametype = true;
+                        // name might be escaped
+                        unescape_raw_field(_unescaped_val, f.RawValuePtr(), f.RawValueSize());
+                        // Path names might have non-ASCII/non-printable chars, escape the name before adding it.
+                        json_escape_string(_tmp_val, _unescaped_val.data(), _unescaped_val.size());
+                        _path_name.append(_tmp_val);
+                        break;
+                    case FieldAction::PATH_NAMETYPE:
+                        if (!found_nametype) {
+                            if (path_num != 0) {
+                                _path_nametype.append(SV_JSON_ARRAY_SEP);
                             }
-                            break;
+                            _path_nametype.append(f.RawValuePtr(), f.RawValueSize());
+                            found_nametype = true;
                         }
-                        case 'o': {
-                            switch (fname[1]) {
-                                case 'b':
-                                    if (fname == SV_OBJTYPE && !found_nametype) {
-                                        if (path_num != 0) {
-                                            _path_nametype.append(SV_JSON_ARRAY_SEP);
-                                        }
-                                        _path_nametype.append(f.RawValuePtr(), f.RawValueSize());
-                                        found_nametype = true;
-                                    }
-                                    break;
-                                case 'g':
-                                    if (fname == SV_OGID) {
-                                        if (path_num != 0) {
-                                            _path_ogid.append(SV_JSON_ARRAY_SEP);
-                                        }
-                                        _path_ogid.append(f.RawValuePtr(), f.RawValueSize());
-                                    }
-                                    break;
-                                case 'u':
-                                    if (fname == SV_OUID) {
-                                        if (path_num != 0) {
-                                            _path_ouid.append(SV_JSON_ARRAY_SEP);
-                                        }
-                                        _path_ouid.append(f.RawValuePtr(), f.RawValueSize());
-                                    }
-                                    break;
-                            }
-                            break;
+                        break;
+                    case FieldAction::PATH_MODE:
+                        if (path_num != 0) {
+                            _path_mode.append(SV_JSON_ARRAY_SEP);
                         }
-                    }
+                        _path_mode.append(f.RawValuePtr(), f.RawValueSize());
+                        break;
+                    case FieldAction::PATH_OUID:
+                        if (path_num != 0) {
+                            _path_ouid.append(SV_JSON_ARRAY_SEP);
+                        }
+                        _path_ouid.append(f.RawValuePtr(), f.RawValueSize());
+                        break;
+                    case FieldAction::PATH_OGID:
+                        if (path_num != 0) {
+                            _path_ogid.append(SV_JSON_ARRAY_SEP);
+                        }
+                        _path_ogid.append(f.RawValuePtr(), f.RawValueSize());
+                        break;
+                    default:
+                        break;
                 }
             }
             path_num += 1;
@@ -620,12 +781,11 @@ bool RawEventProcessor::process_syscall_event(const Event& event) {
         }
     }
 
-    if (execve_recs.size() > 0) {
+    if (_execve_recs.size() > 0) {
         // Exclude proctitle since we have EXECVE
         proctitle_rec = EventRecord();
         proctitle_field = EventRecordField();
 
-        _execve_converter.Convert(execve_recs, _cmdline);
         ret = _builder->AddField(SV_CMDLINE, _cmdline, nullptr, field_type_t::UNESCAPED);
 
         if (ret != 1) {
@@ -635,28 +795,18 @@ bool RawEventProcessor::process_syscall_event(const Event& event) {
             cancel_event();
             return false;
         }
-    } else {
-        _cmdline.resize(0);
-    }
-
-    if (sockaddr_rec && sockaddr_field) {
-        if (!process_field(sockaddr_rec, sockaddr_field, false)) {
-            cancel_event();
-            return false;
-        }
     }
 
-    if (integrity_rec && integrity_field) {
-        if (!process_field(integrity_rec, integrity_field, false)) {
-            cancel_event();
-            return false;
+    for (int slot = SINGLE_FIELD_CWD+1; slot < NUM_SINGLE_FIELDS; ++slot) {
+        if (single_recs[slot]) {
+            if (!process_field(single_recs[slot], single_fields[slot], false)) {
+                cancel_event();
+                return false;
+            }
         }
     }
 
     if (proctitle_rec && proctitle_field) {
-        unescape_raw_field(_unescaped_val, proctitle_field.RawValuePtr(), proctitle_field.RawValueSize());
-        ExecveConverter::ConvertRawCmdline(_unescaped_val, _cmdline);
-
         ret = _builder->AddField(SV_PROCTITLE, _cmdline, nullptr, field_type_t::PROCTITLE);
         if (ret != 1) {
             if (ret == Queue::CLOSED) {
@@ -667,8 +817,8 @@ bool RawEventProcessor::process_syscall_event(const Event& event) {
         }
     }
 
-    if (other_recs.size() > 0) {
-        for (auto& rec : other_recs) {
+    if (_other_recs.size() > 0) {
+        for (auto& rec : _other_recs) {
             for (auto &field: rec) {
                 if (!process_field(rec, field, true)) {
                     cancel_event();
@@ -693,15 +843,6 @@ bool RawEventProcessor::process_syscall_event(const Event& event) {
         }
     }
 
-    std::shared_ptr<ProcessTreeItem> p;
-    std::string cmdline;
-
-    if (!_syscall.empty() && starts_with(_syscall, "execve")) {
-        p = _processTree->AddProcess(ProcessTreeSource_execve, _pid, _ppid, uid, gid, exe, _cmdline);
-    } else if (!_syscall.empty()) {
-        p = _processTree->GetInfoForPid(_pid);
-    }
-
     std::string containerid = "";
     if (p) {
         containerid = p->_containerid;
@@ -725,16 +866,7 @@ bool RawEventProcessor::process_syscall_event(const Event& event) {
         return false;
     }
 
-    bool filtered = false;
-    if (_filtersEngine->IsEventFiltered(_syscall, p, _filtersEngine->GetCommonFlagsMask())) {
-        filtered = true;
-    }
-
-    if (!filtered) {
-        end_event();
-    } else {
-        cancel_event();
-    }
+    end_event();
 
     return true;
 }
@@ -785,11 +917,11 @@ bool RawEventProcessor::process_field(const EventRecord& record, const EventReco
 
     switch (field_type) {
         case field_type_t::UID: {
-            int uid = static_cast<int>(strtoul(val_ptr, NULL, 10));
+            int uid = static_cast<int>(field.HasIntValue() ? field.IntValue() : strtoul(val_ptr, NULL, 10));
             if (uid < 0) {
                 _tmp_val = S_UNSET;
             } else {
-                _tmp_val = _user_db->GetUserName(uid);
+                get_user_name(uid, val, _tmp_val);
             }
             if (_tmp_val.size() == 0) {
                 _tmp_val = "unknown-uid(" + std::to_string(uid) + ")";
@@ -797,11 +929,11 @@ bool RawEventProcessor::process_field(const EventRecord& record, const EventReco
             break;
         }
         case field_type_t::GID: {
-            int gid = static_cast<int>(strtoul(val_ptr, NULL, 10));
+            int gid = static_cast<int>(field.HasIntValue() ? field.IntValue() : strtoul(val_ptr, NULL, 10));
             if (gid < 0) {
                 _tmp_val = S_UNSET;
             } else {
-                _tmp_val = _user_db->GetGroupName(gid);
+                get_group_name(gid, val, _tmp_val);
             }
             if (_tmp_val.size() == 0) {
                 _tmp_val = "unknown-gid(" + std::to_string(gid) + ")";
@@ -820,203 +952,109 @@ bool RawEventProcessor::process_field(const EventRecord& record, const EventReco
         case field_type_t::PROCTITLE:
             break;
         default:
-            if (!InterpretField(_tmp_val, record, field, field_type)) {
+            if (_defer_interp && IsDeferredInterpFieldType(field_type)) {
+                break;
+            }
+            if (!interpret_field(_tmp_val, record, field, field_type)) {
                 _tmp_val.resize(0);
             }
             break;
     }
 
-    auto ret = _builder->AddField(_field_name, val, _tmp_val, field_type);
-    if (ret != 1) {
-        if (ret == Queue::CLOSED) {
-            throw std::runtime_error("Queue closed");
-        }
-        return false;
+    int ret;
+    if (field.HasIntValue()) {
+        ret = _builder->AddField(_field_name, val, _tmp_val, field_type, field.IntValue());
+    } else {
+        ret = _builder->AddField(_field_name, val, _tmp_val, field_type);
     }
-    return true;
-}
-
-bool RawEventProcessor::add_int_field(const std::string_view& name, int val, field_type_t ft) {
-    _tmp_val.assign(std::to_string(val));
-    return add_str_field(name, _tmp_val, ft);
-}
-
-bool RawEventProcessor::add_str_field(const std::string_view& name, const std::string_view& val, field_type_t ft) {
-    int ret = _builder->AddField(name, val, nullptr, ft);
     if (ret != 1) {
         if (ret == Queue::CLOSED) {
             throw std::runtime_error("Queue closed");
         }
-        cancel_event();
         return false;
     }
     return true;
 }
 
-bool RawEventProcessor::add_uid_field(const std::string_view& name, int uid, field_type_t ft) {
-    _tmp_val.assign(std::to_string(uid));
-    std::string user = _user_db->GetUserName(uid);
-    int ret = _builder->AddField(name, _tmp_val, user.c_str(), ft);
-    if (ret != 1) {
-        if (ret == Queue::CLOSED) {
-            throw std::runtime_error("Queue closed");
-        }
-        cancel_event();
-        return false;
+bool RawEventProcessor::process_raw_field(const EventRecordField& field)
+{
+    // The field type is still set so that outputs can do deferred interpretation
+    auto field_type = FieldNameToType(static_cast<RecordType>(field.RecordType()), field.FieldName(), field.RawValue());
+    if (field_type == field_type_t::UNCLASSIFIED && field.FieldType() == field_type_t::UNESCAPED) {
+        field_type = field_type_t::UNESCAPED;
     }
-    return true;
-}
 
-bool RawEventProcessor::add_gid_field(const std::string_view& name, int gid, field_type_t ft) {
-    _tmp_val.assign(std::to_string(gid));
-    std::string user = _user_db->GetGroupName(gid);
-    int ret = _builder->AddField(name, _tmp_val, user.c_str(), ft);
+    int ret;
+    if (field.HasIntValue()) {
+        ret = _builder->AddField(field.FieldName(), field.RawValue(), std::string_view(), field_type, field.IntValue());
+    } else {
+        ret = _builder->AddField(field.FieldName(), field.RawValue(), std::string_view(), field_type);
+    }
     if (ret != 1) {
         if (ret == Queue::CLOSED) {
             throw std::runtime_error("Queue closed");
         }
-        cancel_event();
         return false;
     }
     return true;
 }
 
-bool RawEventProcessor::generate_proc_event(ProcessInfo* pinfo, uint64_t sec, uint32_t msec) {
-    using namespace std::literals::string_view_literals;
-
-    auto ret = _builder->BeginEvent(sec, msec, 0, 1);
-    if (ret != 1) {
-        if (ret == Queue::CLOSED) {
-            throw std::runtime_error("Queue closed");
-        }
-        return false;
-    }
-
-    _builder->SetEventFlags(EVENT_FLAG_IS_AUOMS_EVENT);
-
-    uint16_t num_fields = 16;
-
-    static auto auoms_proc_inv_str = RecordTypeToName(RecordType::AUOMS_PROCESS_INVENTORY);
-    ret = _builder->BeginRecord(static_cast<uint32_t>(RecordType::AUOMS_PROCESS_INVENTORY), auoms_proc_inv_str, ""sv, num_fields);
-    if (ret != 1) {
-        if (ret == Queue::CLOSED) {
-            throw std::runtime_error("Queue closed");
+// Same as InterpretField, but the result of the expensive interpretations is cached
+bool RawEventProcessor::interpret_field(std::string& out, const EventRecord& record, const EventRecordField& field, field_type_t field_type) {
+    std::string_view key;
+    switch (field_type) {
+        case field_type_t::SYSCALL: {
+            // The syscall name also depends on the arch
+            auto arch_field = record.FieldByName("arch");
+            _cache_key.assign(field.RawValue());
+            _cache_key.push_back('/');
+            if (arch_field) {
+                _cache_key.append(arch_field.RawValue());
+            }
+            key = _cache_key;
+            break;
         }
-        cancel_event();
-        return false;
-    }
-
-    if (!add_int_field("pid"sv, pinfo->pid(), field_type_t::UNCLASSIFIED)) {
-        return false;
-    }
-
-    if (!add_int_field("ppid"sv, pinfo->ppid(), field_type_t::UNCLASSIFIED)) {
-        return false;
-    }
-
-    if (!add_int_field("ses"sv, pinfo->ses(), field_type_t::SESSION)) {
-        return false;
-    }
-
-    if (!add_str_field("starttime"sv, pinfo->starttime(), field_type_t::UNCLASSIFIED)) {
-        return false;
-    }
-
-    if (!add_uid_field("uid"sv, pinfo->uid(), field_type_t::UID)) {
-        return false;
-    }
-
-    if (!add_uid_field("euid"sv, pinfo->euid(), field_type_t::UID)) {
-        return false;
-    }
-
-    if (!add_uid_field("suid"sv, pinfo->suid(), field_type_t::UID)) {
-        return false;
-    }
-
-    if (!add_uid_field("fsuid"sv, pinfo->fsuid(), field_type_t::UID)) {
-        return false;
-    }
-
-    if (!add_gid_field("gid"sv, pinfo->gid(), field_type_t::GID)) {
-        return false;
-    }
-
-    if (!add_gid_field("egid"sv, pinfo->egid(), field_type_t::GID)) {
-        return false;
-    }
-
-    if (!add_gid_field("sgid"sv, pinfo->sgid(), field_type_t::GID)) {
-        return false;
-    }
-
-    if (!add_gid_field("fsgid"sv, pinfo->fsgid(), field_type_t::GID)) {
-        return false;
-    }
-
-    if (!add_str_field("comm"sv, pinfo->comm(), field_type_t::UNESCAPED)) {
-        return false;
+        case field_type_t::ARCH:
+        case field_type_t::SOCKADDR:
+        case field_type_t::MODE:
+            key = field.RawValue();
+            break;
+        default:
+            return InterpretField(out, record, field, field_type);
     }
 
-    if (!add_str_field("exe"sv, pinfo->exe(), field_type_t::UNESCAPED)) {
-        return false;
+    if (_interp_cache.Get(field_type, key, out)) {
+        return true;
     }
-
-    pinfo->format_cmdline(_tmp_val);
-
-    bool cmdline_truncated = false;
-    if (_tmp_val.size() > UINT16_MAX-1) {
-        _tmp_val.resize(UINT16_MAX-1);
-        cmdline_truncated = true;
-    }
-
-    if (!add_str_field("cmdline"sv, _tmp_val, field_type_t::UNESCAPED)) {
-        return false;
-    }
-
-    if (!add_str_field("cmdline_truncated"sv, cmdline_truncated ? "true"sv : "false"sv, field_type_t::UNCLASSIFIED)) {
-        return false;
-    }
-
-    ret = _builder->EndRecord();
-    if (ret != 1) {
-        if (ret == Queue::CLOSED) {
-            throw std::runtime_error("Queue closed");
-        }
-        cancel_event();
-        return false;
-    }
-
-    ret = _builder->EndEvent();
-    if (ret != 1) {
-        if (ret == Queue::CLOSED) {
-            throw std::runtime_error("Queue closed");
-        }
+    if (!InterpretField(out, record, field, field_type)) {
         return false;
     }
+    // key may refer to _cache_key, which InterpretField does not modify
+    _interp_cache.Put(field_type, key, out);
     return true;
 }
 
-void RawEventProcessor::DoProcessInventory() {
-    struct timeval tv;
-    gettimeofday(&tv, nullptr);
-
-    uint64_t sec = static_cast<uint64_t>(tv.tv_sec);
-    uint32_t msec = static_cast<uint32_t>(tv.tv_usec)/1000;
-
-    if (_last_proc_event_gen+PROCESS_INVENTORY_EVENT_INTERVAL > sec) {
-        return;
+void RawEventProcessor::check_user_db_gen() {
+    auto gen = _user_db->Generation();
+    if (gen != _user_db_gen) {
+        _interp_cache.Clear(field_type_t::UID);
+        _interp_cache.Clear(field_type_t::GID);
+        _user_db_gen = gen;
     }
+}
 
-    auto pinfo = ProcessInfo::Open();
-    if (!pinfo) {
-        Logger::Error("Failed to open '/proc': %s", strerror(errno));
-        return;
+void RawEventProcessor::get_user_name(int uid, const std::string_view& raw_uid, std::string& out) {
+    check_user_db_gen();
+    if (!_interp_cache.Get(field_type_t::UID, raw_uid, out)) {
+        out = _user_db->GetUserName(uid);
+        _interp_cache.Put(field_type_t::UID, raw_uid, out);
     }
+}
 
-    while(pinfo->next()) {
-        generate_proc_event(pinfo.get(), sec, msec);
+void RawEventProcessor::get_group_name(int gid, const std::string_view& raw_gid, std::string& out) {
+    check_user_db_gen();
+    if (!_interp_cache.Get(field_type_t::GID, raw_gid, out)) {
+        out = _user_db->GetGroupName(gid);
+        _interp_cache.Put(field_type_t::GID, raw_gid, out);
     }
-
-    _last_proc_event_gen = sec;
 }
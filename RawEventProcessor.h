@@ -22,32 +22,61 @@
 #include "ProcessTree.h"
 #include "ExecveConverter.h"
 #include "Metrics.h"
+#include "OverloadController.h"
+#include "RateLimiter.h"
+#include "InterpretCache.h"
+
+enum class FieldAction: uint8_t;
 
 class RawEventProcessor {
 public:
-    RawEventProcessor(const std::shared_ptr<EventBuilder>& builder, const std::shared_ptr<UserDB>& user_db, const std::shared_ptr<ProcessTree>& processTree, const std::shared_ptr<FiltersEngine> filtersEngine, const std::shared_ptr<Metrics>& metrics):
-    _builder(builder), _user_db(user_db), _state_ptr(nullptr), _processTree(processTree), _filtersEngine(filtersEngine), _metrics(metrics),
-        _event_flags(0), _pid(0), _ppid(0), _uid(-1), _last_proc_event_gen(0)
+    RawEventProcessor(const std::shared_ptr<EventBuilder>& builder, const std::shared_ptr<UserDB>& user_db, const std::shared_ptr<ProcessTree>& processTree, const std::shared_ptr<FiltersEngine> filtersEngine, const std::shared_ptr<Metrics>& metrics, const std::shared_ptr<OverloadController>& overload = nullptr):
+    _builder(builder), _user_db(user_db), _state_ptr(nullptr), _processTree(processTree), _filtersEngine(filtersEngine), _metrics(metrics), _overload(overload),
+        _event_flags(0), _pid(0), _ppid(0), _uid(-1),
+        _interp_cache(InterpretCache::DEFAULT_MAX_ENTRIES, metrics), _user_db_gen(0), _defer_interp(false)
     {
         _bytes_metric = _metrics->AddMetric("data", "bytes", MetricPeriod::SECOND, MetricPeriod::HOUR);
         _record_metric = _metrics->AddMetric("data", "records", MetricPeriod::SECOND, MetricPeriod::HOUR);
         _event_metric = _metrics->AddMetric("data", "events", MetricPeriod::SECOND, MetricPeriod::HOUR);
+        _input_latency = _metrics->AddLatencyHistogram("latency", "input");
+        _process_latency = _metrics->AddLatencyHistogram("latency", "process");
     }
 
     void ProcessData(const void* data, size_t data_len);
-    void DoProcessInventory();
+
+    // The max number of interpreted values cached per field type, 0 disables the cache
+    void SetInterpretCacheSize(size_t size) {
+        _interp_cache.SetMaxEntries(size);
+    }
+
+    // Store only the raw value of fields whose interpretation can be deferred (see IsDeferredInterpFieldType)
+    // and leave the interpretation to the event writers
+    void SetDeferInterpretation(bool defer) {
+        _defer_interp = defer;
+    }
+
+    // Suppress the events that exceed the rate limits (see RateLimiter). The RateLimiter may be shared by several processors.
+    void SetRateLimiter(const std::shared_ptr<RateLimiter>& rate_limiter) {
+        _rate_limiter = rate_limiter;
+    }
 
 private:
     void end_event();
     void cancel_event();
-    void process_event(const Event& event);
-    bool process_syscall_event(const Event& event);
+    // Load the syscall, key and exe of the SYSCALL record into _tmp_val, _drop_key and _drop_exe.
+    void load_drop_fields(const Event& event);
+    // Returns true if the event exceeds its rate limit. pid is -1 if the SYSCALL record has no pid.
+    bool should_suppress(const Event& event, const EventRecord& syscall_rec, int pid);
+    // If degraded, the fields are copied as is (not interpreted) and the event is flagged as degraded
+    void process_event(const Event& event, bool degraded = false);
+    // If shed, only the process tree is updated, the event is not sent
+    bool process_syscall_event(const Event& event, bool degraded, bool shed);
     bool process_field(const EventRecord& record, const EventRecordField& field, bool prepend_rec_type);
-    bool add_int_field(const std::string_view& name, int val, field_type_t ft);
-    bool add_uid_field(const std::string_view& name, int uid, field_type_t ft);
-    bool add_gid_field(const std::string_view& name, int gid, field_type_t ft);
-    bool add_str_field(const std::string_view& name, const std::string_view& val, field_type_t ft);
-    bool generate_proc_event(ProcessInfo* pinfo, uint64_t sec, uint32_t nsec);
+    bool process_raw_field(const EventRecordField& field);
+    bool interpret_field(std::string& out, const EventRecord& record, const EventRecordField& field, field_type_t field_type);
+    void get_user_name(int uid, const std::string_view& raw_uid, std::string& out);
+    void get_group_name(int gid, const std::string_view& raw_gid, std::string& out);
+    void check_user_db_gen();
 
     std::shared_ptr<EventBuilder> _builder;
     std::shared_ptr<UserDB> _user_db;
@@ -55,9 +84,13 @@ private:
     std::shared_ptr<ProcessTree> _processTree;
     std::shared_ptr<FiltersEngine> _filtersEngine;
     std::shared_ptr<Metrics> _metrics;
+    std::shared_ptr<OverloadController> _overload;
+    std::shared_ptr<RateLimiter> _rate_limiter;
     std::shared_ptr<Metric> _bytes_metric;
     std::shared_ptr<Metric> _record_metric;
     std::shared_ptr<Metric> _event_metric;
+    std::shared_ptr<LatencyHistogram> _input_latency; // Kernel timestamp -> event read from the collector
+    std::shared_ptr<LatencyHistogram> _process_latency; // Time spent in ProcessData
     uint32_t _event_flags;
     pid_t _pid;
     pid_t _ppid;
@@ -75,8 +108,17 @@ private:
     std::string _path_mode;
     std::string _path_ouid;
     std::string _path_ogid;
-    uint64_t _last_proc_event_gen;
+    std::string _drop_key;
+    std::string _drop_exe;
+    std::vector<EventRecord> _execve_recs;
+    std::vector<EventRecord> _path_recs;
+    std::vector<EventRecord> _other_recs;
+    std::vector<FieldAction> _syscall_field_actions;
     ExecveConverter _execve_converter;
+    InterpretCache _interp_cache;
+    std::string _cache_key;
+    uint64_t _user_db_gen;
+    bool _defer_interp;
 };
 
 
@@ -18,6 +18,8 @@
 #define AUOMS_RAWEVENTREADER_H
 
 #include "IEventReader.h"
+#include "AckProtocol.h"
+#include "BufferedReader.h"
 #include "Logger.h"
 
 #include <cstring>
@@ -44,7 +46,8 @@ public:
         uint32_t version = hdr >> 24;
         uint32_t event_size = hdr & 0x00FFFFFF;
 
-        if (version != 1) {
+        // Ack control frames (see AckProtocol.h) are passed on to the caller like events
+        if (!Event::IsSupportedVersion(version) && !(version == ACK_CONTROL_VERSION && event_size == ACK_CONTROL_SIZE)) {
             Logger::Info("RawEventReader: Message version (%d) is not supported", version);
             return IO::FAILED;
         }
@@ -73,6 +76,63 @@ public:
         return event_size;
     };
 
+    /*
+     * Like ReadEvent(), but without copying: *data points at the event inside the reader's buffer, and remains valid
+     * until the next read from reader.
+     * Return the event size on success, otherwise the same as ReadEvent().
+     */
+    ssize_t ReadEventView(BufferedReader* reader, size_t max_size, const void** data, const std::function<bool()>& fn) {
+        uint32_t hdr;
+        const void* ptr = nullptr;
+
+    retry:
+        ssize_t ret = reader->Peek(sizeof(uint32_t), &ptr, fn);
+        if (ret != IO::OK) {
+            if (ret == IO::FAILED) {
+                Logger::Info("RawEventReader: Unexpected error while reading message header: %s", std::strerror(errno));
+            }
+            return ret;
+        }
+        memcpy(&hdr, ptr, sizeof(hdr));
+
+        uint32_t version = hdr >> 24;
+        uint32_t event_size = hdr & 0x00FFFFFF;
+
+        if (!Event::IsSupportedVersion(version) && !(version == ACK_CONTROL_VERSION && event_size == ACK_CONTROL_SIZE)) {
+            Logger::Info("RawEventReader: Message version (%d) is not supported", version);
+            return IO::FAILED;
+        }
+
+        if (event_size < sizeof(uint32_t)) {
+            Logger::Info("RawEventReader: Message size (%d) in header is invalid", event_size);
+            return IO::FAILED;
+        }
+
+        if (event_size > max_size) {
+            Logger::Info("RawEventReader: Message size (%d) in header is too large (> %ld), reading and discarding message contents", event_size, max_size);
+            ret = reader->DiscardAll(event_size, fn);
+            if (ret != IO::OK) {
+                if (ret == IO::FAILED) {
+                    Logger::Info("RawEventReader: Unexpected error while reading message");
+                }
+                return ret;
+            }
+            goto retry;
+        }
+
+        ret = reader->Peek(event_size, &ptr, fn);
+        if (ret != IO::OK) {
+            if (ret == IO::FAILED) {
+                Logger::Info("RawEventReader: Unexpected error while reading message");
+            }
+            return ret;
+        }
+        // Consume() doesn't move the buffered data, so ptr stays valid until the next read
+        reader->Consume(event_size);
+        *data = ptr;
+        return event_size;
+    }
+
     ssize_t WriteAck(const Event& event, IWriter* writer) override {
         std::array<uint8_t, 8+4+8> ack_data;
         *reinterpret_cast<uint64_t*>(ack_data.data()) = event.Seconds();
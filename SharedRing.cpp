@@ -0,0 +1,484 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "SharedRing.h"
+#include "Logger.h"
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+extern "C" {
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+}
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS 1033
+#define F_GET_SEALS 1034
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#endif
+
+// The ring size is fixed once it is created, so neither side can make the other's mapping fault (SIGBUS)
+static constexpr int RING_SEALS = F_SEAL_SHRINK|F_SEAL_GROW;
+
+static constexpr uint32_t RING_MAGIC = 0x474E4952; // "RING"
+static constexpr uint32_t RING_VERSION = 1;
+static constexpr size_t HEADER_SIZE = 4096;
+static constexpr uint32_t WRAP_MARKER = 0xFFFFFFFF;
+// Each entry is: size (u32), reserved (u32), data padded to a multiple of 8
+static constexpr uint64_t ENTRY_HEADER_SIZE = 8;
+
+struct SharedRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t data_size;
+    // Written by the producer
+    alignas(64) std::atomic<uint64_t> write_pos;
+    std::atomic<uint32_t> consumer_waiting;
+    // Written by the consumer
+    alignas(64) std::atomic<uint64_t> read_pos;
+    std::atomic<uint32_t> producer_waiting;
+    // Written by the consumer, ack_seq is odd while the ack is being updated
+    alignas(64) std::atomic<uint64_t> ack_seq;
+    std::atomic<uint64_t> ack_sec;
+    std::atomic<uint32_t> ack_msec;
+    std::atomic<uint64_t> ack_serial;
+};
+
+static_assert(sizeof(SharedRingHeader) <= HEADER_SIZE, "SharedRingHeader is too large");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Process shared atomics must be lock free");
+
+static int sys_memfd_create(const char* name, unsigned int flags) {
+#ifdef __NR_memfd_create
+    return static_cast<int>(syscall(__NR_memfd_create, name, flags));
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static inline uint64_t entry_size(uint64_t size) {
+    return ENTRY_HEADER_SIZE + ((size + 7) & ~static_cast<uint64_t>(7));
+}
+
+std::shared_ptr<SharedRing> SharedRing::Create(size_t data_size) {
+    auto ring = std::shared_ptr<SharedRing>(new SharedRing());
+    ring->_data_size = (data_size + 7) & ~static_cast<size_t>(7);
+
+    ring->_mem_fd = sys_memfd_create("auoms-ring", MFD_CLOEXEC|MFD_ALLOW_SEALING);
+    if (ring->_mem_fd < 0) {
+        Logger::Error("SharedRing: memfd_create() failed: %s", std::strerror(errno));
+        return nullptr;
+    }
+    if (ftruncate(ring->_mem_fd, HEADER_SIZE + ring->_data_size) != 0) {
+        Logger::Error("SharedRing: ftruncate() failed: %s", std::strerror(errno));
+        return nullptr;
+    }
+    if (fcntl(ring->_mem_fd, F_ADD_SEALS, RING_SEALS) != 0) {
+        Logger::Error("SharedRing: fcntl(F_ADD_SEALS) failed: %s", std::strerror(errno));
+        return nullptr;
+    }
+
+    for (auto fdp : {&ring->_data_fd, &ring->_space_fd, &ring->_ack_fd}) {
+        *fdp = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+        if (*fdp < 0) {
+            Logger::Error("SharedRing: eventfd() failed: %s", std::strerror(errno));
+            return nullptr;
+        }
+    }
+
+    if (!ring->map(true)) {
+        return nullptr;
+    }
+    return ring;
+}
+
+std::shared_ptr<SharedRing> SharedRing::Attach(const std::vector<int>& fds) {
+    auto ring = std::shared_ptr<SharedRing>(new SharedRing());
+    if (fds.size() != NUM_FDS) {
+        for (auto fd : fds) {
+            close(fd);
+        }
+        Logger::Error("SharedRing: Expected %ld fds, got %ld", NUM_FDS, fds.size());
+        return nullptr;
+    }
+    ring->_mem_fd = fds[0];
+    ring->_data_fd = fds[1];
+    ring->_space_fd = fds[2];
+    ring->_ack_fd = fds[3];
+
+    struct stat st;
+    if (fstat(ring->_mem_fd, &st) != 0) {
+        Logger::Error("SharedRing: fstat() failed: %s", std::strerror(errno));
+        return nullptr;
+    }
+    if (st.st_size < static_cast<off_t>(HEADER_SIZE + MIN_SIZE) || st.st_size > static_cast<off_t>(HEADER_SIZE + MAX_SIZE)) {
+        Logger::Error("SharedRing: Invalid ring size (%ld)", static_cast<long>(st.st_size));
+        return nullptr;
+    }
+    ring->_data_size = static_cast<uint64_t>(st.st_size) - HEADER_SIZE;
+
+    auto seals = fcntl(ring->_mem_fd, F_GET_SEALS);
+    if (seals < 0 || (seals & RING_SEALS) != RING_SEALS) {
+        Logger::Error("SharedRing: Ring memory is not sealed");
+        return nullptr;
+    }
+
+    if (!ring->map(false)) {
+        return nullptr;
+    }
+    return ring;
+}
+
+SharedRing::~SharedRing() {
+    if (_map != nullptr) {
+        munmap(_map, _map_size);
+    }
+    for (auto fd : {_mem_fd, _data_fd, _space_fd, _ack_fd}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+bool SharedRing::map(bool init) {
+    _map_size = HEADER_SIZE + _data_size;
+    auto ptr = mmap(nullptr, _map_size, PROT_READ|PROT_WRITE, MAP_SHARED, _mem_fd, 0);
+    if (ptr == MAP_FAILED) {
+        Logger::Error("SharedRing: mmap() failed: %s", std::strerror(errno));
+        return false;
+    }
+    _map = ptr;
+    _data = reinterpret_cast<uint8_t*>(_map) + HEADER_SIZE;
+
+    if (init) {
+        _hdr = new (_map) SharedRingHeader();
+        _hdr->magic = RING_MAGIC;
+        _hdr->version = RING_VERSION;
+        _hdr->data_size = _data_size;
+        _hdr->write_pos = 0;
+        _hdr->consumer_waiting = 0;
+        _hdr->read_pos = 0;
+        _hdr->producer_waiting = 0;
+        _hdr->ack_seq = 0;
+    } else {
+        _hdr = reinterpret_cast<SharedRingHeader*>(_map);
+        if (_hdr->magic != RING_MAGIC || _hdr->version != RING_VERSION || _hdr->data_size != _data_size || (_data_size & 7) != 0) {
+            Logger::Error("SharedRing: Invalid ring header");
+            return false;
+        }
+        _last_ack_seq = _hdr->ack_seq.load(std::memory_order_acquire);
+    }
+    return true;
+}
+
+void SharedRing::signal(int fd) {
+    uint64_t val = 1;
+    // Can only fail if the counter would overflow, in which case the eventfd is already signaled
+    auto ret = write(fd, &val, sizeof(val));
+    (void)ret;
+}
+
+ssize_t SharedRing::wait(int efd, int sock_fd, short sock_events, const std::function<bool()>& fn) {
+    if (sock_fd < 0) {
+        return IO::CLOSED;
+    }
+    struct pollfd fds[2];
+    fds[0].fd = efd;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    fds[1].fd = sock_fd;
+    fds[1].events = sock_events;
+    fds[1].revents = 0;
+
+    auto ret = poll(fds, 2, WAIT_CHECK_MILLIS);
+    if (ret < 0) {
+        if (errno != EINTR) {
+            return IO::FAILED;
+        }
+        if (fn && fn()) {
+            return IO::INTERRUPTED;
+        }
+        return IO::TIMEOUT;
+    } else if (ret == 0) {
+        return IO::TIMEOUT;
+    }
+    if (fds[1].revents != 0) {
+        return IO::CLOSED;
+    }
+    uint64_t val;
+    auto nr = read(efd, &val, sizeof(val));
+    (void)nr;
+    return IO::OK;
+}
+
+ssize_t SharedRing::Write(const void* data, size_t size, int sock_fd, const std::function<bool()>& fn) {
+    auto need = entry_size(size);
+    if (size == 0 || size >= WRAP_MARKER || need > _data_size/2) {
+        return IO::FAILED;
+    }
+
+    // Only the producer modifies write_pos
+    // The positions are in memory the peer can write, so they are checked before they are used.
+    auto wpos = _hdr->write_pos.load(std::memory_order_relaxed);
+    if ((wpos & 7) != 0) {
+        return IO::FAILED;
+    }
+    auto offset = wpos % _data_size;
+    auto contiguous = _data_size - offset;
+    auto total = contiguous < need ? contiguous + need : need;
+
+    while (true) {
+        auto used = wpos - _hdr->read_pos.load(std::memory_order_acquire);
+        if (used > _data_size) {
+            return IO::FAILED;
+        }
+        if (_data_size - used >= total) {
+            break;
+        }
+        _hdr->producer_waiting.store(1);
+        used = wpos - _hdr->read_pos.load();
+        if (used <= _data_size && _data_size - used >= total) {
+            _hdr->producer_waiting.store(0);
+            break;
+        }
+        auto ret = wait(_space_fd, sock_fd, 0, fn);
+        if (ret == IO::TIMEOUT) {
+            if (fn && fn()) {
+                return IO::INTERRUPTED;
+            }
+        } else if (ret != IO::OK) {
+            return ret;
+        }
+    }
+
+    if (contiguous < need) {
+        memcpy(_data+offset, &WRAP_MARKER, sizeof(WRAP_MARKER));
+        wpos += contiguous;
+        offset = 0;
+    }
+
+    uint32_t entry_hdr[2] = {static_cast<uint32_t>(size), 0};
+    memcpy(_data+offset, entry_hdr, sizeof(entry_hdr));
+    memcpy(_data+offset+ENTRY_HEADER_SIZE, data, size);
+    _hdr->write_pos.store(wpos + need);
+
+    if (_hdr->consumer_waiting.load() != 0 && _hdr->consumer_waiting.exchange(0) != 0) {
+        signal(_data_fd);
+    }
+    return IO::OK;
+}
+
+bool SharedRing::GetAck(EventId& event_id) {
+    auto seq = _hdr->ack_seq.load(std::memory_order_acquire);
+    if (seq == _last_ack_seq || (seq & 1) != 0) {
+        // No new ack, or the ack is being updated (the consumer signals the ack fd when done)
+        return false;
+    }
+    auto sec = _hdr->ack_sec.load(std::memory_order_relaxed);
+    auto msec = _hdr->ack_msec.load(std::memory_order_relaxed);
+    auto serial = _hdr->ack_serial.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (_hdr->ack_seq.load(std::memory_order_relaxed) != seq) {
+        return false;
+    }
+    _last_ack_seq = seq;
+    event_id = EventId(sec, msec, serial);
+    return true;
+}
+
+ssize_t SharedRing::Peek(const void** data) {
+    // Only the consumer modifies read_pos
+    // The positions are in memory the peer can write, so they are checked before they are used.
+    auto rpos = _hdr->read_pos.load(std::memory_order_relaxed);
+    auto wpos = _hdr->write_pos.load(std::memory_order_acquire);
+    if (wpos - rpos > _data_size || (rpos & 7) != 0 || (wpos & 7) != 0) {
+        return IO::FAILED;
+    }
+    while (rpos != wpos) {
+        auto offset = rpos % _data_size;
+        auto contiguous = _data_size - offset;
+        uint32_t entry_hdr[2];
+        memcpy(entry_hdr, _data+offset, sizeof(entry_hdr));
+        if (entry_hdr[0] == WRAP_MARKER) {
+            // The wrap must not skip past the write position
+            if (contiguous > wpos - rpos) {
+                return IO::FAILED;
+            }
+            rpos += contiguous;
+            continue;
+        }
+        auto need = entry_size(entry_hdr[0]);
+        if (entry_hdr[0] == 0 || need > contiguous || need > wpos - rpos) {
+            return IO::FAILED;
+        }
+        *data = _data+offset+ENTRY_HEADER_SIZE;
+        _peek_next = rpos + need;
+        return entry_hdr[0];
+    }
+    return 0;
+}
+
+void SharedRing::Consume() {
+    _hdr->read_pos.store(_peek_next);
+    if (_hdr->producer_waiting.load() != 0 && _hdr->producer_waiting.exchange(0) != 0) {
+        signal(_space_fd);
+    }
+}
+
+ssize_t SharedRing::WaitData(int sock_fd, const std::function<bool()>& fn) {
+    while (true) {
+        auto rpos = _hdr->read_pos.load(std::memory_order_relaxed);
+        if (_hdr->write_pos.load(std::memory_order_acquire) != rpos) {
+            return IO::OK;
+        }
+        _hdr->consumer_waiting.store(1);
+        if (_hdr->write_pos.load() != rpos) {
+            _hdr->consumer_waiting.store(0);
+            return IO::OK;
+        }
+        auto ret = wait(_data_fd, sock_fd, POLLIN, fn);
+        if (ret == IO::TIMEOUT) {
+            if (fn && fn()) {
+                return IO::INTERRUPTED;
+            }
+        } else if (ret != IO::OK) {
+            return ret;
+        }
+    }
+}
+
+void SharedRing::Ack(const EventId& event_id) {
+    // Only the consumer modifies the ack
+    auto seq = _hdr->ack_seq.load(std::memory_order_relaxed);
+    _hdr->ack_seq.store(seq+1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    _hdr->ack_sec.store(event_id.Seconds(), std::memory_order_relaxed);
+    _hdr->ack_msec.store(event_id.Milliseconds(), std::memory_order_relaxed);
+    _hdr->ack_serial.store(event_id.Serial(), std::memory_order_relaxed);
+    _hdr->ack_seq.store(seq+2, std::memory_order_release);
+    signal(_ack_fd);
+}
+
+ssize_t SharedRing::SendWithFds(int sock_fd, const void* data, size_t size, const int* fds, size_t num_fds) {
+    if (num_fds > NUM_FDS) {
+        return IO::FAILED;
+    }
+
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int)*NUM_FDS)];
+    } cbuf;
+    memset(&cbuf, 0, sizeof(cbuf));
+
+    struct iovec iov;
+    iov.iov_base = const_cast<void*>(data);
+    iov.iov_len = size;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf.buf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int)*num_fds);
+
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int)*num_fds);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int)*num_fds);
+
+    size_t nleft = size;
+    while (nleft > 0) {
+        ssize_t nw;
+        if (nleft == size) {
+            nw = sendmsg(sock_fd, &msg, MSG_NOSIGNAL);
+        } else {
+            // The fds were sent along with the first byte(s)
+            nw = send(sock_fd, reinterpret_cast<const uint8_t*>(data)+(size-nleft), nleft, MSG_NOSIGNAL);
+        }
+        if (nw < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EPIPE || errno == ECONNRESET) {
+                return IO::CLOSED;
+            }
+            return IO::FAILED;
+        }
+        nleft -= nw;
+    }
+    return IO::OK;
+}
+
+ssize_t SharedRing::RecvWithFds(int sock_fd, void* data, size_t size, std::vector<int>& fds) {
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int)*NUM_FDS)];
+    } cbuf;
+
+    struct iovec iov;
+    iov.iov_base = data;
+    iov.iov_len = size;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf.buf;
+    msg.msg_controllen = sizeof(cbuf.buf);
+
+    auto nr = recvmsg(sock_fd, &msg, MSG_CMSG_CLOEXEC);
+    if (nr < 0) {
+        if (errno == EINTR) {
+            return IO::INTERRUPTED;
+        }
+        if (errno == ECONNRESET) {
+            return IO::CLOSED;
+        }
+        return IO::FAILED;
+    } else if (nr == 0) {
+        return IO::CLOSED;
+    }
+
+    for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            auto num = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (size_t i = 0; i < num; ++i) {
+                int fd;
+                memcpy(&fd, CMSG_DATA(cmsg) + i*sizeof(int), sizeof(int));
+                fds.push_back(fd);
+            }
+        }
+    }
+    return nr;
+}
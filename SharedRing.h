@@ -0,0 +1,136 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef AUOMS_SHAREDRING_H
+#define AUOMS_SHAREDRING_H
+
+#include "IO.h"
+#include "EventId.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+struct SharedRingHeader;
+
+/*
+ * Single producer, single consumer ring of events in shared memory (a memfd), used as an optional transport
+ * between auomscollect (producer) and auoms (consumer) over an existing unix domain socket connection.
+ *
+ * The consumer creates the ring and passes its fds to the producer (SCM_RIGHTS):
+ *      memfd (header + event data), data eventfd (producer -> consumer), space eventfd and ack eventfd (consumer -> producer)
+ * Events are written into the ring once by the producer. The eventfds are only signaled when the other side is
+ * (about to be) waiting. The consumer publishes the last acked event id in the header (acks are cumulative).
+ *
+ * The socket remains the liveness signal: either side stops waiting when the socket is closed.
+ */
+class SharedRing {
+public:
+    static constexpr size_t MIN_SIZE = 1024*1024;
+    static constexpr size_t MAX_SIZE = 1024*1024*1024;
+    static constexpr size_t NUM_FDS = 4;
+    static constexpr long WAIT_CHECK_MILLIS = 100;
+
+    // Create a new ring with data_size bytes (rounded up to a multiple of 8) of event space.
+    // Returns nullptr (and logs the error) on failure.
+    static std::shared_ptr<SharedRing> Create(size_t data_size);
+
+    // Map a ring created by the peer. Takes ownership of the fds (in the order returned by Fds()).
+    // Returns nullptr (and logs the error) on failure.
+    static std::shared_ptr<SharedRing> Attach(const std::vector<int>& fds);
+
+    ~SharedRing();
+
+    SharedRing(const SharedRing&) = delete;
+    SharedRing& operator=(const SharedRing&) = delete;
+
+    std::array<int, NUM_FDS> Fds() const {
+        return {_mem_fd, _data_fd, _space_fd, _ack_fd};
+    }
+
+    int AckFd() const {
+        return _ack_fd;
+    }
+
+    /*
+     * Producer: Write one event, waiting for space if the ring is full.
+     * Return OK on success
+     * Return CLOSED if the socket was closed (or sock_fd < 0)
+     * Return FAILED if the event is too large for the ring, or the ring positions are invalid
+     * Return INTERRUPTED if signal received and fn() returned true
+     */
+    ssize_t Write(const void* data, size_t size, int sock_fd, const std::function<bool()>& fn);
+
+    // Producer: Return true (and the acked event id) if a new ack was published since the last call.
+    bool GetAck(EventId& event_id);
+
+    /*
+     * Consumer: Get the next event without removing it.
+     * Return the event size (the data remains valid until Consume() is called)
+     * Return 0 if the ring is empty
+     * Return FAILED if the ring content is invalid
+     */
+    ssize_t Peek(const void** data);
+
+    // Consumer: Remove the event returned by the last Peek().
+    void Consume();
+
+    /*
+     * Consumer: Wait for data.
+     * Return OK if data is available
+     * Return CLOSED if the socket became readable (the producer sends nothing on the socket once it uses the ring)
+     * Return FAILED if poll failed
+     * Return INTERRUPTED if signal received and fn() returned true
+     */
+    ssize_t WaitData(int sock_fd, const std::function<bool()>& fn);
+
+    // Consumer: Publish the (cumulative) ack and signal the producer.
+    void Ack(const EventId& event_id);
+
+    // Send data on a unix domain socket with fds attached. Return OK, CLOSED or FAILED.
+    static ssize_t SendWithFds(int sock_fd, const void* data, size_t size, const int* fds, size_t num_fds);
+
+    // Read up to size bytes from a unix domain socket, collecting any attached fds.
+    // Return the number of bytes read, CLOSED or FAILED, or INTERRUPTED (if EINTR).
+    static ssize_t RecvWithFds(int sock_fd, void* data, size_t size, std::vector<int>& fds);
+
+private:
+    SharedRing(): _mem_fd(-1), _data_fd(-1), _space_fd(-1), _ack_fd(-1), _map(nullptr), _map_size(0),
+        _hdr(nullptr), _data(nullptr), _data_size(0), _last_ack_seq(0), _peek_next(0) {}
+
+    bool map(bool init);
+    static void signal(int fd);
+    // Wait for efd to be signaled or sock_fd to report sock_events (or HUP/ERR).
+    ssize_t wait(int efd, int sock_fd, short sock_events, const std::function<bool()>& fn);
+
+    int _mem_fd;
+    int _data_fd;
+    int _space_fd;
+    int _ack_fd;
+    void* _map;
+    size_t _map_size;
+    SharedRingHeader* _hdr;
+    uint8_t* _data;
+    uint64_t _data_size;
+    uint64_t _last_ack_seq;
+    uint64_t _peek_next;
+};
+
+#endif //AUOMS_SHAREDRING_H
@@ -0,0 +1,171 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "SharedRingWriter.h"
+#include "AckProtocol.h"
+#include "Logger.h"
+
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include <poll.h>
+#include <unistd.h>
+}
+
+bool SharedRingWriter::Open() {
+    {
+        std::lock_guard<std::mutex> lock(_ring_mutex);
+        _ring.reset();
+    }
+    _switched = false;
+    return UnixDomainWriter::Open();
+}
+
+void SharedRingWriter::Close() {
+    {
+        std::lock_guard<std::mutex> lock(_ring_mutex);
+        _ring.reset();
+    }
+    UnixDomainWriter::Close();
+}
+
+std::shared_ptr<SharedRing> SharedRingWriter::get_ring() {
+    std::lock_guard<std::mutex> lock(_ring_mutex);
+    return _ring;
+}
+
+ssize_t SharedRingWriter::ReadAll(void *buf, size_t buf_size, const std::function<bool()>& fn) {
+    auto ring = get_ring();
+    if (ring) {
+        return read_ring_ack(ring, buf, buf_size, fn);
+    }
+
+    std::vector<int> fds;
+    size_t nleft = buf_size;
+    while (nleft > 0) {
+        int fd = _fd.load();
+        ssize_t ret = IO::CLOSED;
+        if (fd >= 0 && !_rclosed.load()) {
+            ret = SharedRing::RecvWithFds(fd, reinterpret_cast<uint8_t*>(buf) + (buf_size - nleft), nleft, fds);
+        }
+        if (ret == IO::INTERRUPTED && !(fn && fn())) {
+            continue;
+        }
+        if (ret <= 0) {
+            for (auto rfd : fds) {
+                close(rfd);
+            }
+            return ret;
+        }
+        nleft -= ret;
+    }
+
+    if (!fds.empty()) {
+        auto data = reinterpret_cast<uint8_t*>(buf);
+        uint64_t sec = 0;
+        uint32_t msec = 0;
+        if (buf_size == ACK_SIZE) {
+            memcpy(&sec, data, sizeof(sec));
+            memcpy(&msec, data+8, sizeof(msec));
+        }
+        if (buf_size != ACK_SIZE || !IsAckRingOffer(EventId(sec, msec, 0))) {
+            for (auto rfd : fds) {
+                close(rfd);
+            }
+            return IO::OK;
+        }
+        ring = SharedRing::Attach(fds);
+        if (!ring) {
+            // The receiver now publishes its acks in the ring, so this connection cannot be used anymore.
+            Logger::Warn("SharedRingWriter(%d): Failed to attach shared memory ring, falling back to the socket", _fd.load());
+            _enabled = false;
+            return IO::FAILED;
+        }
+        std::lock_guard<std::mutex> lock(_ring_mutex);
+        _ring = ring;
+    }
+    return IO::OK;
+}
+
+ssize_t SharedRingWriter::read_ring_ack(const std::shared_ptr<SharedRing>& ring, void *buf, size_t buf_size, const std::function<bool()>& fn) {
+    if (buf_size != ACK_SIZE) {
+        return IO::FAILED;
+    }
+    while (true) {
+        EventId event_id;
+        if (ring->GetAck(event_id)) {
+            EncodeAck(event_id, reinterpret_cast<uint8_t*>(buf));
+            return IO::OK;
+        }
+
+        int fd = _fd.load();
+        if (fd < 0 || _rclosed.load()) {
+            return IO::CLOSED;
+        }
+
+        struct pollfd fds[2];
+        fds[0].fd = ring->AckFd();
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = fd;
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        auto ret = poll(fds, 2, SharedRing::WAIT_CHECK_MILLIS);
+        if (ret < 0) {
+            if (errno != EINTR) {
+                return IO::FAILED;
+            }
+            if (fn && fn()) {
+                return IO::INTERRUPTED;
+            }
+            continue;
+        }
+        if (fds[0].revents != 0) {
+            uint64_t val;
+            auto nr = read(fds[0].fd, &val, sizeof(val));
+            (void)nr;
+        }
+        if (fds[1].revents != 0) {
+            // Nothing but acks sent before the ring offer, or EOF, can arrive on the socket
+            return IOBase::ReadAll(buf, buf_size, fn);
+        }
+    }
+}
+
+ssize_t SharedRingWriter::WriteAll(const void *buf, size_t size, long timeout, const std::function<bool()>& fn) {
+    auto ring = get_ring();
+    if (!ring) {
+        return IOBase::WriteAll(buf, size, timeout, fn);
+    }
+
+    if (!_switched) {
+        // Tell the receiver that the events that follow are in the ring
+        auto control = MakeAckControl(ACK_PROTOCOL_V2, 0, ACK_CONTROL_FLAG_RING_SWITCH);
+        auto ret = IOBase::WriteAll(control.data(), control.size(), timeout, fn);
+        if (ret != IO::OK) {
+            return ret;
+        }
+        _switched = true;
+        Logger::Info("SharedRingWriter(%d): Switched to shared memory ring", _fd.load());
+    }
+
+    auto ret = ring->Write(buf, size, _fd.load(), [this,&fn]() { return !IsOpen() || _wclosed.load() || (fn && fn()); });
+    if (ret == IO::INTERRUPTED && (!IsOpen() || _wclosed.load())) {
+        return IO::CLOSED;
+    }
+    return ret;
+}
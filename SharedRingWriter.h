@@ -0,0 +1,62 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef AUOMS_SHAREDRINGWRITER_H
+#define AUOMS_SHAREDRINGWRITER_H
+
+#include "UnixDomainWriter.h"
+#include "SharedRing.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+/*
+ * A UnixDomainWriter that moves the event stream to a SharedRing once the receiver offers one (see AckProtocol.h).
+ *
+ * Until then it behaves exactly like UnixDomainWriter, except that acks are read with recvmsg() so that the ring
+ * fds sent along with the ring offer are received. Once the ring is attached, the next WriteAll() sends the ring
+ * switch control frame on the socket, and each following WriteAll() writes one event into the ring.
+ * ReadAll() then returns the acks published in the ring.
+ *
+ * WriteAll() must be called with whole events (as RawEventWriter does).
+ */
+class SharedRingWriter: public UnixDomainWriter {
+public:
+    explicit SharedRingWriter(const std::string& addr): UnixDomainWriter(addr), _enabled(true), _switched(false) {}
+
+    bool Open() override;
+    void Close() override;
+
+    // False if attaching a ring failed, in which case the ring should not be requested again.
+    bool RingEnabled() const {
+        return _enabled.load();
+    }
+
+    ssize_t ReadAll(void *buf, size_t buf_size, const std::function<bool()>& fn) override;
+    ssize_t WriteAll(const void *buf, size_t size, long timeout, const std::function<bool()>& fn) override;
+
+private:
+    std::shared_ptr<SharedRing> get_ring();
+    ssize_t read_ring_ack(const std::shared_ptr<SharedRing>& ring, void *buf, size_t buf_size, const std::function<bool()>& fn);
+
+    std::mutex _ring_mutex;
+    std::shared_ptr<SharedRing> _ring;
+    std::atomic<bool> _enabled;
+    bool _switched;
+};
+
+#endif //AUOMS_SHAREDRINGWRITER_H
@@ -0,0 +1,98 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved. 
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "StringUtils.h"
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "StringBenchmarks"
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+static std::vector<StringKernels> supported_kernels() {
+    std::vector<StringKernels> kernels;
+    for (auto k : {StringKernels::SCALAR, StringKernels::SSE42, StringKernels::AVX2}) {
+        if (set_string_kernels(k)) {
+            kernels.emplace_back(k);
+        }
+    }
+    return kernels;
+}
+
+// Restores the kernels selected at startup
+class KernelsGuard {
+public:
+    KernelsGuard(): _kernels(get_string_kernels()) {}
+    ~KernelsGuard() { set_string_kernels(_kernels); }
+private:
+    StringKernels _kernels;
+};
+
+// Reports the per call time and throughput of each supported string kernel set.
+BOOST_AUTO_TEST_CASE( string_kernels_benchmark ) {
+    KernelsGuard guard;
+    constexpr size_t total_bytes = 16*1024*1024;
+
+    struct Input {
+        const char* name;
+        std::string str;
+    };
+
+    std::vector<Input> inputs;
+    std::string hex;
+    std::string text;
+    std::string pattern = "/usr/bin/python3 -m some_module.main --config=/etc/app.conf ";
+    for (size_t i = 0; i < 4096; ++i) {
+        text.push_back(pattern[i % pattern.size()]);
+    }
+    for (auto c : text) {
+        hex.push_back("0123456789ABCDEF"[static_cast<uint8_t>(c) >> 4]);
+        hex.push_back("0123456789ABCDEF"[c & 0xF]);
+    }
+    inputs.emplace_back(Input{"short", text.substr(0, 24)});
+    inputs.emplace_back(Input{"long", text});
+    std::vector<Input> hex_inputs = {Input{"short", hex.substr(0, 48)}, Input{"long", hex}};
+
+    std::string out;
+    for (auto k : supported_kernels()) {
+        BOOST_REQUIRE(set_string_kernels(k));
+
+        auto run = [&](const char* func, const Input& input, auto fn) {
+            size_t loops = total_bytes / input.str.size();
+            size_t checksum = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < loops; ++i) {
+                fn(input.str);
+                checksum += out.size();
+            }
+            auto usecs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+            BOOST_TEST_MESSAGE(string_kernels_name(k) << " " << func << " " << input.name << " (" << input.str.size() << " bytes): "
+                << (usecs*1000.0)/loops << " nsec/call, " << (usecs > 0 ? (loops*input.str.size())/usecs : 0) << " MB/s (" << checksum << ")");
+        };
+
+        for (auto& input : hex_inputs) {
+            run("decode_hex", input, [&](const std::string& str) { decode_hex(out, str.data(), str.size()); });
+            run("unescape_raw_field", input, [&](const std::string& str) { unescape_raw_field(out, str.data(), str.size()); });
+        }
+        for (auto& input : inputs) {
+            run("tty_escape_string", input, [&](const std::string& str) { tty_escape_string(out, str.data(), str.size()); });
+            run("json_escape_string", input, [&](const std::string& str) { json_escape_string(out, str.data(), str.size()); });
+            run("bash_escape_string", input, [&](const std::string& str) { out.clear(); bash_escape_string(out, str.data(), str.size()); });
+        }
+    }
+}
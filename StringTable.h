@@ -17,59 +17,144 @@
 #ifndef AUOMS_STRINGTABLE_H
 #define AUOMS_STRINGTABLE_H
 
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
 #include <string_view>
-#include <vector>
-#include <unordered_map>
-#include <initializer_list>
 
 template <typename V>
+struct StringTableEntry {
+    std::string_view str{};
+    V val{};
+};
+
+/*
+ * A two way string <-> value table that is built at compile time.
+ *
+ * Both directions are open addressing hash tables (at most a quarter full) of indexes into the entries, so a lookup
+ * is a hash and (almost always) one or two compares. If a string or value is present more than once, the
+ * last entry wins. Entries with a value < 0 are ignored (in both directions), so ToString() of a negative value
+ * is always empty and ToInt() of their string returns the unknown_val.
+ *
+ * Tables must be constructed with MakeStringTable() and declared constexpr, e.g.:
+ *   static constexpr auto s_table = MakeStringTable<int>(-1, {{"one", 1}, {"two", 2}});
+ */
+template <typename V, size_t N>
 class StringTable {
 public:
-    explicit StringTable(V unknown_val, std::initializer_list<std::pair<std::string, V>> values): _str(), _itos(), _stoi(values.size()), _unknown_val(unknown_val) {
-        int max  = 0;
-        int str_size = 0;
-        for(auto& e: values) {
-            str_size += e.first.size()+1;
-            if (max < static_cast<int>(e.second)) {
-                max = static_cast<int>(e.second);
-            }
-        }
-        _str.reserve(str_size);
-        _itos.resize(max+1);
-        for(auto& e: values) {
-            auto idx = _str.size();
-            _str.append(e.first);
-            _str.push_back(0);
-            std::string_view sv(&_str[idx], e.first.size());
+    static_assert(N > 0 && N < 0x7FFF, "StringTable size out of range");
+
+    // The max number of slots a lookup may have to look at. Checked when the table is built.
+    static constexpr int MAX_PROBES = 8;
+
+    constexpr StringTable(V unknown_val, const StringTableEntry<V> (&values)[N]): _entries(), _str_slots(), _val_slots(), _unknown_val(unknown_val) {
+        for (size_t i = 0; i < N; ++i) {
+            _entries[i] = values[i];
             // Ignore values where V < 0
-            if (static_cast<int>(e.second) >= 0) {
-                _itos[static_cast<int>(e.second)] = sv;
-                _stoi[sv] = e.second;
+            if (static_cast<int64_t>(values[i].val) >= 0) {
+                insert_str(i);
+                insert_val(i);
             }
         }
     }
 
-    std::string_view ToString(V i) const noexcept {
-        if (static_cast<int>(i) < _itos.size()) {
-            return _itos[static_cast<int>(i)];
-        } else {
-            return std::string_view();
+    constexpr size_t Size() const noexcept {
+        return N;
+    }
+
+    // Returns an empty string_view if the value is not in the table
+    constexpr std::string_view ToString(V val) const noexcept {
+        for (size_t slot = val_hash(val); ; slot = (slot + 1) & HASH_MASK) {
+            auto idx = _val_slots[slot];
+            if (idx == 0) {
+                return std::string_view();
+            }
+            if (_entries[idx-1].val == val) {
+                return _entries[idx-1].str;
+            }
         }
     }
 
-    V ToInt(const std::string_view& str) const noexcept {
-        auto itr = _stoi.find(str);
-        if (itr != _stoi.end()) {
-            return itr->second;
-        } else {
-            return _unknown_val;
+    // Returns the unknown_val if the string is not in the table
+    constexpr V ToInt(const std::string_view& str) const noexcept {
+        for (size_t slot = str_hash(str); ; slot = (slot + 1) & HASH_MASK) {
+            auto idx = _str_slots[slot];
+            if (idx == 0) {
+                return _unknown_val;
+            }
+            if (_entries[idx-1].str == str) {
+                return _entries[idx-1].val;
+            }
         }
     }
+
 private:
-    std::string _str;
-    std::vector<std::string_view> _itos;
-    std::unordered_map<std::string_view, V> _stoi;
+    static constexpr size_t hash_size() {
+        size_t size = 1;
+        while (size < N*4) {
+            size *= 2;
+        }
+        return size;
+    }
+
+    static constexpr size_t HASH_SIZE = hash_size();
+    static constexpr size_t HASH_MASK = HASH_SIZE-1;
+
+    // FNV-1a
+    static constexpr size_t str_hash(const std::string_view& str) noexcept {
+        uint32_t hash = 2166136261u;
+        for (auto c : str) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 16777619u;
+        }
+        return hash & HASH_MASK;
+    }
+
+    // Fibonacci hashing, the high bits are the well mixed ones
+    static constexpr size_t val_hash(V val) noexcept {
+        auto hash = static_cast<uint32_t>(static_cast<uint64_t>(val)) * 2654435769u;
+        return (hash ^ (hash >> 16)) & HASH_MASK;
+    }
+
+    constexpr void insert_str(size_t idx) {
+        auto& str = _entries[idx].str;
+        size_t slot = str_hash(str);
+        for (int probe = 0; _str_slots[slot] != 0; ++probe, slot = (slot + 1) & HASH_MASK) {
+            if (probe >= MAX_PROBES) {
+                throw std::logic_error("StringTable: Too many string hash collisions");
+            }
+            if (_entries[_str_slots[slot]-1].str == str) {
+                break;
+            }
+        }
+        _str_slots[slot] = static_cast<uint16_t>(idx+1);
+    }
+
+    constexpr void insert_val(size_t idx) {
+        auto val = _entries[idx].val;
+        size_t slot = val_hash(val);
+        for (int probe = 0; _val_slots[slot] != 0; ++probe, slot = (slot + 1) & HASH_MASK) {
+            if (probe >= MAX_PROBES) {
+                throw std::logic_error("StringTable: Too many value hash collisions");
+            }
+            if (_entries[_val_slots[slot]-1].val == val) {
+                break;
+            }
+        }
+        _val_slots[slot] = static_cast<uint16_t>(idx+1);
+    }
+
+    std::array<StringTableEntry<V>, N> _entries;
+    // Index (+1) of the entry, 0 if the slot is empty
+    std::array<uint16_t, HASH_SIZE> _str_slots;
+    std::array<uint16_t, HASH_SIZE> _val_slots;
     V _unknown_val;
 };
 
+template <typename V, size_t N>
+constexpr StringTable<V, N> MakeStringTable(V unknown_val, const StringTableEntry<V> (&values)[N]) {
+    return StringTable<V, N>(unknown_val, values);
+}
+
 #endif //AUOMS_STRINGTABLE_H
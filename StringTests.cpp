@@ -280,3 +280,195 @@ BOOST_AUTO_TEST_CASE( time_whitespace ) {
     BOOST_REQUIRE_EQUAL("test", trim_whitespace(" test \t\n "));
     BOOST_REQUIRE_EQUAL("test", trim_whitespace("\t\n test \t\n "));
 }
+
+/*
+ * The byte at a time implementations the string kernels must match
+ */
+
+static int ref_hex2int(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+static int ref_decode_hex(std::string& out, const char* hex, size_t len) {
+    if (len % 2 != 0) {
+        out.assign(hex, len);
+        return -1;
+    }
+    out.resize(0);
+
+    bool needs_escaping = false;
+    auto p = hex;
+    auto endp = hex+len;
+    while (p != endp) {
+        int i1 = ref_hex2int(*p);
+        ++p;
+        int i2 = ref_hex2int(*p);
+        ++p;
+        if (i1 < 0 || i2 < 0) {
+            out.assign(hex, len);
+            return -1;
+        }
+        char c = static_cast<char>(i1 << 4 | i2);
+        out.push_back(c);
+        needs_escaping |= (c < 0x20 || c > 0x7E);
+    }
+    return needs_escaping ? 1 : 0;
+}
+
+static const char ref_int2hex[16] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
+
+static void ref_tty_escape_string(std::string& out, const char* in, size_t in_len) {
+    out.clear();
+    for (auto ptr = in; ptr < in+in_len; ++ptr) {
+        if (*ptr < 0x20 || *ptr > 0x7E) {
+            out.push_back('\\');
+            out.push_back('x');
+            out.push_back(ref_int2hex[static_cast<uint8_t>(*ptr) >> 4]);
+            out.push_back(ref_int2hex[*ptr & 0xF]);
+        } else {
+            out.push_back(*ptr);
+        }
+    }
+}
+
+static void ref_json_escape_string(std::string& out, const char* in, size_t in_len) {
+    out.clear();
+    for (auto ptr = in; ptr < in+in_len; ++ptr) {
+        if (*ptr < 0x20 || *ptr > 0x7E) {
+            out.push_back('\\');
+            out.push_back('x');
+            out.push_back(ref_int2hex[static_cast<uint8_t>(*ptr) >> 4]);
+            out.push_back(ref_int2hex[*ptr & 0xF]);
+        } else if (*ptr == '"') {
+            out.push_back('\\');
+            out.push_back('"');
+        } else {
+            out.push_back(*ptr);
+        }
+    }
+}
+
+static std::vector<StringKernels> supported_kernels() {
+    std::vector<StringKernels> kernels;
+    for (auto k : {StringKernels::SCALAR, StringKernels::SSE42, StringKernels::AVX2}) {
+        if (set_string_kernels(k)) {
+            kernels.emplace_back(k);
+        }
+    }
+    return kernels;
+}
+
+// Restores the kernels selected at startup
+class KernelsGuard {
+public:
+    KernelsGuard(): _kernels(get_string_kernels()) {}
+    ~KernelsGuard() { set_string_kernels(_kernels); }
+private:
+    StringKernels _kernels;
+};
+
+// Calls fn with every string of up to max_len chars made of fill, with one char replaced by each of the 256 byte values
+template <typename Fn>
+void for_each_single_byte_variant(size_t max_len, const std::string& fill, Fn fn) {
+    std::string str;
+    fn(str);
+    for (size_t len = 1; len <= max_len; ++len) {
+        str.resize(0);
+        for (size_t i = 0; i < len; ++i) {
+            str.push_back(fill[i % fill.size()]);
+        }
+        fn(str);
+        for (size_t pos = 0; pos < len; ++pos) {
+            auto orig = str[pos];
+            for (int c = 0; c < 256; ++c) {
+                str[pos] = static_cast<char>(c);
+                fn(str);
+            }
+            str[pos] = orig;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( string_kernels_hex_equivalence ) {
+    KernelsGuard guard;
+    std::string expected;
+    std::string out;
+    std::vector<uint8_t> buf;
+
+    for (auto k : supported_kernels()) {
+        BOOST_TEST_MESSAGE("Kernels: " << string_kernels_name(k));
+        BOOST_REQUIRE(set_string_kernels(k));
+        BOOST_REQUIRE(get_string_kernels() == k);
+
+        for_each_single_byte_variant(80, "0123456789abcdefABCDEF", [&](const std::string& hex) {
+            auto expected_ret = ref_decode_hex(expected, hex.data(), hex.size());
+            auto ret = decode_hex(out, hex.data(), hex.size());
+            BOOST_REQUIRE_EQUAL(ret, expected_ret);
+            BOOST_REQUIRE_EQUAL(out, expected);
+
+            buf.assign(hex.size()/2+1, 0);
+            auto size = decode_hex(buf.data(), buf.size(), hex.data(), hex.size());
+            BOOST_REQUIRE_EQUAL(size, expected_ret < 0 ? 0 : expected.size());
+            BOOST_REQUIRE(std::equal(expected.begin(), expected.begin() + size, reinterpret_cast<const char*>(buf.data())));
+        });
+
+        // Every byte value as decoded output, at every position of a block
+        for (size_t offset = 0; offset < 64; ++offset) {
+            std::string hex(offset*2, '4');
+            for (int c = 0; c < 256; ++c) {
+                hex.push_back(ref_int2hex[c >> 4]);
+                hex.push_back(ref_int2hex[c & 0xF]);
+            }
+            auto expected_ret = ref_decode_hex(expected, hex.data(), hex.size());
+            BOOST_REQUIRE_EQUAL(decode_hex(out, hex.data(), hex.size()), expected_ret);
+            BOOST_REQUIRE_EQUAL(out, expected);
+            BOOST_REQUIRE_EQUAL(unescape_raw_field(out, hex.data(), hex.size()), 3);
+            BOOST_REQUIRE_EQUAL(out, expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( string_kernels_escape_equivalence ) {
+    KernelsGuard guard;
+    std::string expected;
+    std::string out;
+
+    // bash_escape_string is compared to the scalar kernels, which have the original byte at a time behavior
+    std::vector<std::string> bash_expected;
+    std::vector<size_t> bash_expected_ret;
+    BOOST_REQUIRE(set_string_kernels(StringKernels::SCALAR));
+    for_each_single_byte_variant(70, "abc/_-.XYZ019", [&](const std::string& str) {
+        std::string esc;
+        bash_expected_ret.emplace_back(bash_escape_string(esc, str.data(), str.size()));
+        bash_expected.emplace_back(esc);
+    });
+
+    for (auto k : supported_kernels()) {
+        BOOST_TEST_MESSAGE("Kernels: " << string_kernels_name(k));
+        BOOST_REQUIRE(set_string_kernels(k));
+
+        size_t idx = 0;
+        for_each_single_byte_variant(70, "abc/_-.XYZ019", [&](const std::string& str) {
+            ref_tty_escape_string(expected, str.data(), str.size());
+            tty_escape_string(out, str.data(), str.size());
+            BOOST_REQUIRE_EQUAL(out, expected);
+
+            ref_json_escape_string(expected, str.data(), str.size());
+            json_escape_string(out, str.data(), str.size());
+            BOOST_REQUIRE_EQUAL(out, expected);
+
+            out.clear();
+            auto ret = bash_escape_string(out, str.data(), str.size());
+            BOOST_REQUIRE_EQUAL(ret, bash_expected_ret[idx]);
+            BOOST_REQUIRE_EQUAL(out, bash_expected[idx]);
+            idx++;
+        });
+    }
+}
@@ -17,6 +17,10 @@
 #include "StringUtils.h"
 #include <cstring>
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 static const int s_hex2int[256] {
         // 0   1   2   3   4   5   6   7   8   9   A   B   C   D   E   F
         -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0F
@@ -37,23 +41,375 @@ static const int s_hex2int[256] {
         -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // FF
 };
 
-// Return -1 if string was not hex
-// Return 0 if string was hex and was decoded
-// Return 1 if decoded string needs escaping
-int decode_hex(std::string& out, const char* hex, size_t len)
-{
-    if (len % 2 != 0) {
-        // Not hex like we expected, just output the raw value
-        out.assign(hex, len);
-        return -1;
+/*
+ * String kernels
+ *
+ * The byte at a time loops below are sped up by kernels that scan (or decode) whole 16 or 32 byte blocks.
+ * Each kernel processes the longest prefix of the input it can and leaves the rest to the scalar code.
+ *   decode_hex - Decodes whole blocks of hex chars, stops at the first block that has a non hex char.
+ *                Returns the number of hex chars decoded.
+ *   tty_span   - Returns the number of leading bytes that don't need tty escaping.
+ *   json_span  - Same as tty_span, but also stops at '"'.
+ *   bash_span  - Returns the number of leading bytes that are neither special to bash nor need escaping (or NULL).
+ *
+ * The kernels are selected once, at startup, based on the CPU features.
+ */
+
+struct string_kernels_impl {
+    StringKernels kernels;
+    size_t (*decode_hex)(uint8_t* out, const char* hex, size_t len, bool& needs_escaping);
+    size_t (*tty_span)(const char* in, size_t len);
+    size_t (*json_span)(const char* in, size_t len);
+    size_t (*bash_span)(const char* in, size_t len);
+};
+
+extern const char* char_category_codes;
+
+static inline bool needs_tty_escape(char c) {
+    return c < 0x20 || c > 0x7E;
+}
+
+// Decodes nothing, decode_hex_bytes() handles the whole input with its byte at a time loop
+static size_t decode_hex_scalar(uint8_t*, const char*, size_t, bool&) {
+    return 0;
+}
+
+static size_t tty_span_scalar(const char* in, size_t len) {
+    size_t i = 0;
+    while (i < len && !needs_tty_escape(in[i])) {
+        ++i;
+    }
+    return i;
+}
+
+static size_t json_span_scalar(const char* in, size_t len) {
+    size_t i = 0;
+    while (i < len && !needs_tty_escape(in[i]) && in[i] != '"') {
+        ++i;
     }
-    if (out.capacity() < len*2) {
-        out.reserve(len*2);
+    return i;
+}
+
+static size_t bash_span_scalar(const char* in, size_t len) {
+    size_t i = 0;
+    while (i < len && char_category_codes[static_cast<uint8_t>(in[i])] == '*') {
+        ++i;
     }
-    out.resize(0);
+    return i;
+}
 
-    bool needs_escaping = false;
-    auto p = hex;
+static constexpr string_kernels_impl s_scalar_kernels = {
+        StringKernels::SCALAR,
+        decode_hex_scalar,
+        tty_span_scalar,
+        json_span_scalar,
+        bash_span_scalar,
+};
+
+#if defined(__x86_64__)
+
+/*
+ * The 16 byte block helpers are inlined into both the SSE4.2 and the AVX2 kernels (which use them for the tail),
+ * so that the AVX2 kernels never run legacy (non VEX) SSE instructions.
+ */
+
+// Bytes (mask 0xFF) that need tty escaping: 0x00-0x1F, 0x7F-0xFF
+__attribute__((target("sse4.2")))
+static inline __m128i tty_escape_mask_sse42(__m128i v) {
+    // Signed compare, 0x80-0xFF are negative
+    return _mm_or_si128(_mm_cmpgt_epi8(_mm_set1_epi8(0x20), v), _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7F)));
+}
+
+// Bytes that are not '*' in char_category_codes.
+// Each byte is classified by looking up its low and high nibble, the byte is special if the two lookups share a bit.
+//   0x01 - 0x00-0x1F, 0x80-0xFF
+//   0x02 - 0x20-0x22, 0x24, 0x26-0x29
+//   0x04 - 0x3B, 0x3C, 0x3E
+//   0x08 - 0x5C
+//   0x10 - 0x60
+//   0x20 - 0x7C, 0x7F
+#define BASH_SPECIAL_LO_NIBBLE 19, 3, 3, 1, 3, 1, 3, 3, 3, 3, 1, 5, 45, 1, 5, 33
+#define BASH_SPECIAL_HI_NIBBLE 1, 1, 2, 4, 0, 8, 16, 32, 1, 1, 1, 1, 1, 1, 1, 1
+
+// The tty_escape_mask of the 16 bytes at in
+__attribute__((target("sse4.2")))
+static inline int tty_block_sse42(const char* in) {
+    return _mm_movemask_epi8(tty_escape_mask_sse42(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in))));
+}
+
+__attribute__((target("sse4.2")))
+static inline int json_block_sse42(const char* in) {
+    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    return _mm_movemask_epi8(_mm_or_si128(tty_escape_mask_sse42(v), _mm_cmpeq_epi8(v, _mm_set1_epi8('"'))));
+}
+
+__attribute__((target("sse4.2")))
+static inline int bash_block_sse42(const char* in) {
+    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    const __m128i lo_tbl = _mm_setr_epi8(BASH_SPECIAL_LO_NIBBLE);
+    const __m128i hi_tbl = _mm_setr_epi8(BASH_SPECIAL_HI_NIBBLE);
+    auto nibble_mask = _mm_set1_epi8(0x0F);
+    auto lo = _mm_shuffle_epi8(lo_tbl, _mm_and_si128(v, nibble_mask));
+    auto hi = _mm_shuffle_epi8(hi_tbl, _mm_and_si128(_mm_srli_epi16(v, 4), nibble_mask));
+    return ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) & 0xFFFF;
+}
+
+// Decodes the 16 hex chars at hex into 8 bytes. Returns false if there is a non hex char.
+__attribute__((target("sse4.2")))
+static inline bool decode_hex_block_sse42(uint8_t* out, const char* hex, bool& needs_escaping) {
+    auto c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hex));
+    // '0'-'9' -> 0-9
+    auto d = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    auto is_digit = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+    // 'A'-'F' and 'a'-'f' -> 0-5
+    auto a = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    auto is_alpha = _mm_cmpeq_epi8(_mm_min_epu8(a, _mm_set1_epi8(5)), a);
+    if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_alpha)) != 0xFFFF) {
+        return false;
+    }
+    auto val = _mm_or_si128(_mm_and_si128(is_digit, d), _mm_and_si128(is_alpha, _mm_add_epi8(a, _mm_set1_epi8(10))));
+    // hi*16 + lo for each pair of nibbles
+    auto bytes = _mm_maddubs_epi16(val, _mm_set1_epi16(0x0110));
+    bytes = _mm_packus_epi16(bytes, bytes);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out), bytes);
+    if (_mm_movemask_epi8(tty_escape_mask_sse42(bytes)) != 0) {
+        needs_escaping = true;
+    }
+    return true;
+}
+
+__attribute__((target("sse4.2")))
+static size_t decode_hex_sse42(uint8_t* out, const char* hex, size_t len, bool& needs_escaping) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        if (!decode_hex_block_sse42(out + i/2, hex + i, needs_escaping)) {
+            break;
+        }
+    }
+    return i;
+}
+
+__attribute__((target("sse4.2")))
+static size_t tty_span_sse42(const char* in, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        auto mask = tty_block_sse42(in + i);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + tty_span_scalar(in + i, len - i);
+}
+
+__attribute__((target("sse4.2")))
+static size_t json_span_sse42(const char* in, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        auto mask = json_block_sse42(in + i);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + json_span_scalar(in + i, len - i);
+}
+
+__attribute__((target("sse4.2")))
+static size_t bash_span_sse42(const char* in, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        auto mask = bash_block_sse42(in + i);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + bash_span_scalar(in + i, len - i);
+}
+
+static constexpr string_kernels_impl s_sse42_kernels = {
+        StringKernels::SSE42,
+        decode_hex_sse42,
+        tty_span_sse42,
+        json_span_sse42,
+        bash_span_sse42,
+};
+
+__attribute__((target("avx2")))
+static inline __m256i tty_escape_mask_avx2(__m256i v) {
+    // Signed compare, 0x80-0xFF are negative
+    return _mm256_or_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), v), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7F)));
+}
+
+__attribute__((target("avx2")))
+static inline uint32_t bash_special_movemask_avx2(__m256i v) {
+    // _mm256_shuffle_epi8 does the lookup within each 128bit lane, so the tables are repeated in both lanes
+    const __m256i lo_tbl = _mm256_setr_epi8(BASH_SPECIAL_LO_NIBBLE, BASH_SPECIAL_LO_NIBBLE);
+    const __m256i hi_tbl = _mm256_setr_epi8(BASH_SPECIAL_HI_NIBBLE, BASH_SPECIAL_HI_NIBBLE);
+    auto nibble_mask = _mm256_set1_epi8(0x0F);
+    auto lo = _mm256_shuffle_epi8(lo_tbl, _mm256_and_si256(v, nibble_mask));
+    auto hi = _mm256_shuffle_epi8(hi_tbl, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble_mask));
+    return ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), _mm256_setzero_si256())));
+}
+
+__attribute__((target("avx2")))
+static size_t decode_hex_avx2(uint8_t* out, const char* hex, size_t len, bool& needs_escaping) {
+    auto escape = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        auto c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hex + i));
+        auto d = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+        auto is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d);
+        auto a = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+        auto is_alpha = _mm256_cmpeq_epi8(_mm256_min_epu8(a, _mm256_set1_epi8(5)), a);
+        if (static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(is_digit, is_alpha))) != 0xFFFFFFFF) {
+            break;
+        }
+        auto val = _mm256_or_si256(_mm256_and_si256(is_digit, d), _mm256_and_si256(is_alpha, _mm256_add_epi8(a, _mm256_set1_epi8(10))));
+        auto bytes = _mm256_maddubs_epi16(val, _mm256_set1_epi16(0x0110));
+        // The pack is done per 128bit lane, move the two decoded 8 byte halves together
+        bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(bytes, bytes), 0x88);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i/2), _mm256_castsi256_si128(bytes));
+        escape = _mm256_or_si256(escape, tty_escape_mask_avx2(bytes));
+    }
+    if (_mm256_movemask_epi8(escape) != 0) {
+        needs_escaping = true;
+    }
+    if (i + 16 <= len && decode_hex_block_sse42(out + i/2, hex + i, needs_escaping)) {
+        i += 16;
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t tty_span_avx2(const char* in, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(tty_escape_mask_avx2(v)));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    if (i + 16 <= len) {
+        auto mask = tty_block_sse42(in + i);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+        i += 16;
+    }
+    return i + tty_span_scalar(in + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t json_span_avx2(const char* in, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(tty_escape_mask_avx2(v), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')))));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    if (i + 16 <= len) {
+        auto mask = json_block_sse42(in + i);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+        i += 16;
+    }
+    return i + json_span_scalar(in + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t bash_span_avx2(const char* in, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        auto mask = bash_special_movemask_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    if (i + 16 <= len) {
+        auto mask = bash_block_sse42(in + i);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+        i += 16;
+    }
+    return i + bash_span_scalar(in + i, len - i);
+}
+
+static constexpr string_kernels_impl s_avx2_kernels = {
+        StringKernels::AVX2,
+        decode_hex_avx2,
+        tty_span_avx2,
+        json_span_avx2,
+        bash_span_avx2,
+};
+
+#endif // defined(__x86_64__)
+
+static const string_kernels_impl* get_kernels_impl(StringKernels kernels) {
+    switch (kernels) {
+        case StringKernels::SCALAR:
+            return &s_scalar_kernels;
+#if defined(__x86_64__)
+        case StringKernels::SSE42:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse4.2") ? &s_sse42_kernels : nullptr;
+        case StringKernels::AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") ? &s_avx2_kernels : nullptr;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+static const string_kernels_impl* select_kernels_impl() {
+    for (auto kernels : {StringKernels::AVX2, StringKernels::SSE42}) {
+        auto impl = get_kernels_impl(kernels);
+        if (impl != nullptr) {
+            return impl;
+        }
+    }
+    return &s_scalar_kernels;
+}
+
+// Starts out as the scalar kernels so that the string functions are usable during static initialization
+static const string_kernels_impl* s_kernels = &s_scalar_kernels;
+[[maybe_unused]] static const bool s_kernels_selected = (s_kernels = select_kernels_impl()) != nullptr;
+
+StringKernels get_string_kernels() {
+    return s_kernels->kernels;
+}
+
+bool set_string_kernels(StringKernels kernels) {
+    auto impl = get_kernels_impl(kernels);
+    if (impl == nullptr) {
+        return false;
+    }
+    s_kernels = impl;
+    return true;
+}
+
+const char* string_kernels_name(StringKernels kernels) {
+    switch (kernels) {
+        case StringKernels::SCALAR:
+            return "scalar";
+        case StringKernels::SSE42:
+            return "sse4.2";
+        case StringKernels::AVX2:
+            return "avx2";
+        default:
+            return "unknown";
+    }
+}
+
+// Returns false if hex (len must be even) contains non hex chars
+static bool decode_hex_bytes(uint8_t* out, const char* hex, size_t len, bool& needs_escaping) {
+    auto n = s_kernels->decode_hex(out, hex, len, needs_escaping);
+    out += n/2;
+    auto p = hex+n;
     auto endp = hex+len;
     while (p != endp) {
         int i1 = s_hex2int[static_cast<uint8_t>(*p)];
@@ -61,19 +417,38 @@ int decode_hex(std::string& out, const char* hex, size_t len)
         int i2 = s_hex2int[static_cast<uint8_t>(*p)];
         ++p;
         if (i1 < 0 || i2 < 0) {
-            // Not hex like we expected, just output the raw value
-            out.assign(hex, len);
-            return -1;
+            return false;
         }
         char c = static_cast<char>(i1 << 4 | i2);
-        out.push_back(c);
-        needs_escaping |= (c < 0x20 || c > 0x7E);
+        *out = static_cast<uint8_t>(c);
+        ++out;
+        needs_escaping |= needs_tty_escape(c);
+    }
+    return true;
+}
+
+// Return -1 if string was not hex
+// Return 0 if string was hex and was decoded
+// Return 1 if decoded string needs escaping
+int decode_hex(std::string& out, const char* hex, size_t len)
+{
+    if (len % 2 != 0) {
+        // Not hex like we expected, just output the raw value
+        out.assign(hex, len);
+        return -1;
+    }
+    out.resize(len/2);
+
+    bool needs_escaping = false;
+    if (!decode_hex_bytes(reinterpret_cast<uint8_t*>(&out[0]), hex, len, needs_escaping)) {
+        // Not hex like we expected, just output the raw value
+        out.assign(hex, len);
+        return -1;
     }
     return needs_escaping ? 1 : 0;
 }
 
 size_t decode_hex(void* buf, size_t buf_len, const char* hex, size_t len) {
-    size_t size = 0;
     if (len % 2 != 0) {
         return 0;
     }
@@ -81,23 +456,11 @@ size_t decode_hex(void* buf, size_t buf_len, const char* hex, size_t len) {
         return 0;
     }
 
-    uint8_t* out = reinterpret_cast<uint8_t*>(buf);
-    auto p = hex;
-    auto endp = hex+len;
-    while (p != endp) {
-        int i1 = s_hex2int[static_cast<uint8_t>(*p)];
-        ++p;
-        int i2 = s_hex2int[static_cast<uint8_t>(*p)];
-        ++p;
-        if (i1 < 0 || i2 < 0) {
-            return 0;
-        }
-        uint8_t c = static_cast<uint8_t>(i1 << 4 | i2);
-        *out = c;
-        ++out;
-        ++size;
+    bool needs_escaping = false;
+    if (!decode_hex_bytes(reinterpret_cast<uint8_t*>(buf), hex, len, needs_escaping)) {
+        return 0;
     }
-    return size;
+    return len/2;
 }
 
 // Return -1 if string was NULL, empty or copied as is
@@ -147,14 +510,16 @@ void tty_escape_string(std::string& out, const char* in, size_t in_len) {
 void tty_escape_string_append(std::string& out, const char* in, size_t in_len) {
     auto ptr = in;
     auto end = ptr+in_len;
-    for (; ptr < end; ++ptr) {
-        if (*ptr < 0x20 || *ptr > 0x7E) {
+    while (ptr < end) {
+        auto n = s_kernels->tty_span(ptr, end-ptr);
+        out.append(ptr, n);
+        ptr += n;
+        if (ptr < end) {
             out.push_back('\\');
             out.push_back('x');
             out.push_back(int2hex[static_cast<uint8_t>(*ptr) >> 4]);
             out.push_back(int2hex[*ptr & 0xF]);
-        } else {
-            out.push_back(*ptr);
+            ++ptr;
         }
     }
 }
@@ -163,17 +528,21 @@ void json_escape_string(std::string& out, const char* in, size_t in_len) {
     out.clear();
     auto ptr = in;
     auto end = ptr+in_len;
-    for (; ptr < end; ++ptr) {
-        if (*ptr < 0x20 || *ptr > 0x7E) {
-            out.push_back('\\');
-            out.push_back('x');
-            out.push_back(int2hex[static_cast<uint8_t>(*ptr) >> 4]);
-            out.push_back(int2hex[*ptr & 0xF]);
-        } else if (*ptr == '"') {
-            out.push_back('\\');
-            out.push_back('"');
-        } else {
-            out.push_back(*ptr);
+    while (ptr < end) {
+        auto n = s_kernels->json_span(ptr, end-ptr);
+        out.append(ptr, n);
+        ptr += n;
+        if (ptr < end) {
+            if (*ptr == '"') {
+                out.push_back('\\');
+                out.push_back('"');
+            } else {
+                out.push_back('\\');
+                out.push_back('x');
+                out.push_back(int2hex[static_cast<uint8_t>(*ptr) >> 4]);
+                out.push_back(int2hex[*ptr & 0xF]);
+            }
+            ++ptr;
         }
     }
 }
@@ -302,6 +671,13 @@ size_t bash_escape_string(std::string& out, const char* in, size_t in_len) {
     const char *ptr = in;
     const char* end = in+in_len;
     for(; ptr < end; ++ptr, ++size) {
+        // Skip over the chars that don't need quoting or escaping
+        auto n = s_kernels->bash_span(ptr, end-ptr);
+        ptr += n;
+        size += n;
+        if (ptr >= end) {
+            break;
+        }
         switch (char_category_codes[static_cast<uint8_t>(*ptr)]) {
             case 'Z':
                 end = ptr;
@@ -363,6 +739,13 @@ size_t bash_escape_string(std::string& out, const char* in, size_t in_len) {
     ptr = in;
     end = in+size;
     for(; ptr < end; ++ptr) {
+        // The chars that don't need quoting or escaping don't need escaping in any of the escape_codes either
+        auto n = s_kernels->bash_span(ptr, end-ptr);
+        out.append(ptr, n);
+        ptr += n;
+        if (ptr >= end) {
+            break;
+        }
         switch (escape_codes[static_cast<uint8_t>(*ptr)]) {
             case '-':
                 out.push_back('\\');
@@ -39,6 +39,21 @@ size_t bash_escape_string(std::string& out, const char* in, size_t in_len);
 
 void append_hex(std::string& out, uint32_t val);
 
+// The implementation used by decode_hex, unescape_raw_field and the escape functions.
+// The fastest one supported by the CPU is selected at startup.
+enum class StringKernels: int {
+    SCALAR,
+    SSE42,
+    AVX2,
+};
+
+StringKernels get_string_kernels();
+
+// Returns false if the kernels are not supported by the CPU. Not thread safe, meant for tests and benchmarks.
+bool set_string_kernels(StringKernels kernels);
+
+const char* string_kernels_name(StringKernels kernels);
+
 template <typename Int>
 void append_int(std::string& out, Int i) {
     if (std::is_signed<Int>::value) {
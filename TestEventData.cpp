@@ -466,4 +466,83 @@ const std::unordered_set<std::string> TestConfigFilterFieldNameSet = {
     "syscall_r",
 };
 
-const std::string TestConfigHostnameValue = "TestHostname";
\ No newline at end of file
+const std::string TestConfigHostnameValue = "TestHostname";
+
+std::vector<TestRecord> make_test_records() {
+    std::vector<TestRecord> records;
+
+    records.emplace_back(TestRecord{1300, "SYSCALL", "", {
+        {"arch", "c000003e", "x86_64", field_type_t::ARCH},
+        {"syscall", "59", "execve", field_type_t::SYSCALL},
+        {"success", "yes", "", field_type_t::UNCLASSIFIED},
+        {"exit", "0", "", field_type_t::EXIT},
+        {"a0", "55d782c96198", "", field_type_t::A0},
+        {"a1", "55d782c96120", "", field_type_t::A1},
+        {"a2", "55d782c96158", "", field_type_t::A2},
+        {"a3", "1", "", field_type_t::A3},
+        {"items", "2", "", field_type_t::UNCLASSIFIED},
+        {"ppid", "26595", "", field_type_t::UNCLASSIFIED},
+        {"pid", "26918", "", field_type_t::UNCLASSIFIED},
+        {"auid", "0", "root", field_type_t::UID},
+        {"uid", "0", "root", field_type_t::UID},
+        {"gid", "0", "root", field_type_t::GID},
+        {"euid", "0", "root", field_type_t::UID},
+        {"suid", "0", "root", field_type_t::UID},
+        {"fsuid", "0", "root", field_type_t::UID},
+        {"egid", "0", "root", field_type_t::GID},
+        {"sgid", "0", "root", field_type_t::GID},
+        {"fsgid", "0", "root", field_type_t::GID},
+        {"tty", "(none)", "", field_type_t::UNCLASSIFIED},
+        {"ses", "842", "", field_type_t::SESSION},
+        {"comm", "\"logger\"", "logger", field_type_t::ESCAPED},
+        {"exe", "\"/usr/bin/logger\"", "/usr/bin/logger", field_type_t::ESCAPED},
+        {"key", "\"auoms\"", "auoms", field_type_t::ESCAPED_KEY},
+        {"x_custom_field", "custom", "", field_type_t::UNCLASSIFIED},
+    }});
+    records.emplace_back(TestRecord{1302, "PATH", "", {
+        {"item", "0", "", field_type_t::UNCLASSIFIED},
+        {"name", "\"/usr/bin/logger\"", "/usr/bin/logger", field_type_t::ESCAPED},
+        {"inode", "312545", "", field_type_t::UNCLASSIFIED},
+        {"dev", "00:13", "", field_type_t::UNCLASSIFIED},
+        {"mode", "0100755", "file,755", field_type_t::MODE},
+        {"ouid", "0", "root", field_type_t::UID},
+        {"ogid", "0", "root", field_type_t::GID},
+        {"rdev", "00:00", "", field_type_t::UNCLASSIFIED},
+        {"nametype", "NORMAL", "", field_type_t::UNCLASSIFIED},
+    }});
+    records.emplace_back(TestRecord{1309, "EXECVE", "argc=6 a0=\"logger\"", {
+        {"argc", "6", "", field_type_t::UNCLASSIFIED},
+        {"a0", "\"logger\"", "", field_type_t::UNCLASSIFIED},
+        {"a1", "\"-t\"", "", field_type_t::UNCLASSIFIED},
+        {"a2", "\"zfs-backup\"", "", field_type_t::UNCLASSIFIED},
+        {"a3", "\"-p\"", "", field_type_t::UNCLASSIFIED},
+        {"a4", "\"daemon.err\"", "", field_type_t::UNCLASSIFIED},
+        {"a5", "7A667320696E6372656D656E74616C206261636B7570206F662072706F6F6C2F6C7864206661696C65643A20", "", field_type_t::UNCLASSIFIED},
+    }});
+
+    return records;
+}
+
+int build_test_event(EventBuilder& builder, const std::vector<TestRecord>& records, uint64_t serial) {
+    int ret = builder.BeginEvent(1521757638, 392, serial, static_cast<uint16_t>(records.size()));
+    if (ret != 1) {
+        return ret;
+    }
+    for (auto& rec : records) {
+        ret = builder.BeginRecord(rec.type, rec.name, rec.text, static_cast<uint16_t>(rec.fields.size()));
+        if (ret != 1) {
+            return ret;
+        }
+        for (auto& f : rec.fields) {
+            ret = builder.AddField(f.name, f.raw, f.interp, f.type);
+            if (ret != 1) {
+                return ret;
+            }
+        }
+        ret = builder.EndRecord();
+        if (ret != 1) {
+            return ret;
+        }
+    }
+    return builder.EndEvent();
+}
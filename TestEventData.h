@@ -91,6 +91,24 @@ struct TestEvent {
     }
 };
 
+struct TestField {
+    std::string name;
+    std::string raw;
+    std::string interp;
+    field_type_t type;
+};
+
+struct TestRecord {
+    uint32_t type;
+    std::string name;
+    std::string text;
+    std::vector<TestField> fields;
+};
+
+// The records of an execve event as collected (before processing)
+std::vector<TestRecord> make_test_records();
+int build_test_event(EventBuilder& builder, const std::vector<TestRecord>& records, uint64_t serial);
+
 extern const std::string passwd_file_text;
 extern const std::string group_file_text;
 
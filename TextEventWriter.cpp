@@ -16,6 +16,7 @@
 
 #include "TextEventWriter.h"
 #include "StringUtils.h"
+#include "Interpret.h"
 #include "Logger.h"
 
 #include <cstdlib>
@@ -198,21 +199,24 @@ bool TextEventWriter::write_field(const EventRecordField& field)
             ret = true;
 		}
 	} else {
-        if (field.InterpValueSize() > 0) {
+        std::string_view interp_val;
+        if (_config.FilterFieldNameSet.count(interp_name) == 0 || _config.FilterFieldNameSet.count(raw_name) == 0) {
+            interp_val = FieldInterpValue(field, _interp_buf);
+        }
+        if (!interp_val.empty()) {
 			if (_config.FilterFieldNameSet.count(interp_name) == 0) {
 				switch (field.FieldType()) {
 					case field_type_t::SESSION:
 						// Since the interpreted value for SES is also (normally) an int
 						// Replace "unset" and "4294967295" with "-1"
-						if ((field.InterpValueSize() == 5 && std::strncmp("unset", field.InterpValuePtr(), field.InterpValueSize()) == 0) ||
-								(field.InterpValueSize() == 10 && strncmp("4294967295", field.InterpValuePtr(), field.InterpValueSize()) == 0)) {
+						if (interp_val == "unset" || interp_val == "4294967295") {
 							write_string_field(interp_name, "-1");
 						} else {
-							write_raw_field(interp_name, field.InterpValuePtr(), field.InterpValueSize());
+							write_raw_field(interp_name, interp_val.data(), interp_val.size());
 						}
 						break;
 					default:
-						write_raw_field(interp_name, field.InterpValuePtr(), field.InterpValueSize());
+						write_raw_field(interp_name, interp_val.data(), interp_val.size());
 				}
                 ret = true;
 			}
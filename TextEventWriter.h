@@ -32,6 +32,8 @@ public:
 protected:
 
     TextEventWriterConfig _config;
+    // Holds the interp value of fields whose interpretation was deferred (see FieldInterpValue)
+    std::string _interp_buf;
 
     virtual void write_raw_field(const std::string& name, const char* value_data, size_t value_size) = 0;
     virtual void write_int32_field(const std::string& name, int32_t value);
@@ -32,6 +32,12 @@ MachineType ArchToMachine(uint32_t arch);
 uint32_t MachineToArch(MachineType mach);
 std::string ArchToName(uint32_t arch);
 
+/*
+ * The *ToName() overloads that return std::string allocate on every call. Hot paths should use the
+ * overloads that take a std::string& instead, which only write to (and return a view of) the string when
+ * the value is not in the table.
+ */
+
 bool SyscallToName(MachineType mtype, int syscall, std::string& str);
 std::string SyscallToName(MachineType mtype, int syscall);
 int SyscallNameToNumber(MachineType mtype, const std::string_view& syscall_name);
@@ -43,10 +49,12 @@ RecordType RecordNameToType(const std::string_view& name);
 field_type_t FieldNameToType(const std::string_view& name);
 field_type_t FieldNameToType(RecordType rtype, const std::string_view& name, const std::string_view& val);
 
+std::string_view FieldIdToName(int field, std::string& unknown_str);
 std::string FieldIdToName(int field);
 int FieldNameToId(const std::string_view& name);
 
-std::string ErrnoToName(int field);
+std::string_view ErrnoToName(int n, std::string& unknown_str);
+std::string ErrnoToName(int n);
 int NameToErrno(const std::string_view& name);
 
 #endif //AUOMS_TRANSLATE_H
@@ -56,14 +56,19 @@ MachineType DetectMachine() {
     return s_machine_type;
 }
 
-static std::unordered_map<std::string, MachineType> s_name2mach({
-     {"i386", MachineType::X86},
-     {"i486", MachineType::X86},
-     {"i586", MachineType::X86},
-     {"i686", MachineType::X86},
-     {"x86_64", MachineType::X86_64},
-     {"arm", MachineType::ARM},
-     {"aarch64", MachineType::ARM64},
+static constexpr auto s_name2mach = MakeStringTable<MachineType>(MachineType::UNKNOWN, {
+        {"i386", MachineType::X86},
+        {"i486", MachineType::X86},
+        {"i586", MachineType::X86},
+        {"i686", MachineType::X86},
+        {"x86_64", MachineType::X86_64},
+        {"arm", MachineType::ARM},
+        {"armeb", MachineType::ARM},
+        {"armv5tejl", MachineType::ARM},
+        {"armv5tel", MachineType::ARM},
+        {"armv6l", MachineType::ARM},
+        {"armv7l", MachineType::ARM},
+        {"aarch64", MachineType::ARM64},
 });
 
 MachineType ArchNameToMachine(const std::string_view& arch) {
@@ -91,21 +96,8 @@ MachineType ArchNameToMachine(const std::string_view& arch) {
                 return MachineType::ARM;
         }
         return mach;
-    } else if (arch == "x86_64") {
-        return MachineType ::X86_64;
-    } else if (arch == "i686" || arch == "i386" || arch == "i486" || arch == "i586") {
-        return MachineType::X86;
-    } else if (arch == "arm" || arch == "armeb" || arch == "armv5tejl" || arch == "armv5tel" || arch == "armv6l" || arch == "armv7l") {
-        return MachineType::ARM;
-    } else if (arch == "aarch64") {
-        return MachineType::ARM64;
-    } else {
-        auto itr = s_name2mach.find(std::string(arch));
-        if (itr != s_name2mach.end()) {
-            return itr->second;
-        }
     }
-    return MachineType::UNKNOWN;
+    return s_name2mach.ToInt(arch);
 }
 
 bool MachineToName(MachineType mach, std::string& str) {
@@ -128,7 +120,7 @@ bool MachineToName(MachineType mach, std::string& str) {
     }
 }
 
-static std::unordered_map<std::string, uint32_t> s_name2arch({
+static constexpr auto s_name2arch = MakeStringTable<uint32_t>(0, {
         {"i386", AUDIT_ARCH_I386},
         {"i486", AUDIT_ARCH_I386},
         {"i586", AUDIT_ARCH_I386},
@@ -162,13 +154,8 @@ uint32_t ArchNameToArch(const std::string_view& arch) {
             default:
                 return 0;
         }
-    } else {
-        auto itr = s_name2arch.find(std::string(arch));
-        if (itr != s_name2arch.end()) {
-            return itr->second;
-        }
     }
-    return 0;
+    return s_name2arch.ToInt(arch);
 }
 
 MachineType ArchToMachine(uint32_t arch) {
@@ -21,7 +21,7 @@
 
 #include <errno.h>
 
-static StringTable<int> s_errno_table(0, {
+static constexpr auto s_errno_table = MakeStringTable<int>(0, {
         {"EPERM", EPERM},
         {"ENOENT", ENOENT},
         {"ESRCH", ESRCH},
@@ -157,6 +157,19 @@ static StringTable<int> s_errno_table(0, {
         {"EHWPOISON", EHWPOISON},
 });
 
+std::string_view ErrnoToName(int n, std::string& unknown_str) {
+    auto str = s_errno_table.ToString(n);
+    if (str.empty()) {
+        unknown_str = std::to_string(n);
+        str = unknown_str;
+    }
+    if (n < 0) {
+        unknown_str = "-" + std::string(str);
+        str = unknown_str;
+    }
+    return str;
+}
+
 std::string ErrnoToName(int n) {
     int err = n;
     if (err < 0) {
@@ -19,7 +19,7 @@
 #include "Translate.h"
 #include "StringTable.h"
 
-static StringTable<int> s_field_name_table(-1, {
+static constexpr auto s_field_name_table = MakeStringTable<int>(-1, {
 	{"pid", 0},
 	{"uid", 1},
 	{"euid", 2},
@@ -66,6 +66,15 @@ static StringTable<int> s_field_name_table(-1, {
 	{"exe", 112},
 });
 
+std::string_view FieldIdToName(int field, std::string& unknown_str) {
+    auto str = s_field_name_table.ToString(field);
+    if (str.empty()) {
+        unknown_str = "f" + std::to_string(field);
+        str = unknown_str;
+    }
+    return str;
+}
+
 std::string FieldIdToName(int field) {
     auto str = std::string(s_field_name_table.ToString(field));
     if (str.empty()) {
@@ -20,7 +20,7 @@
 
 #include <algorithm>
 
-static StringTable<field_type_t> s_field_table(field_type_t::UNCLASSIFIED, {
+static constexpr auto s_field_table = MakeStringTable<field_type_t>(field_type_t::UNCLASSIFIED, {
         {"auid", field_type_t::UID},
         {"uid", field_type_t::UID},
         {"euid", field_type_t::UID},
@@ -18,7 +18,7 @@
 #include "StringTable.h"
 #include "StringUtils.h"
 
-static StringTable<RecordType> s_record_type_table(RecordType ::UNKNOWN, {
+static constexpr auto s_record_type_table = MakeStringTable<RecordType>(RecordType::UNKNOWN, {
         {"GET",RecordType::GET},
         {"SET",RecordType::SET},
         {"LIST",RecordType::LIST},
@@ -223,6 +223,7 @@ static StringTable<RecordType> s_record_type_table(RecordType ::UNKNOWN, {
         {"AUOMS_DROPPED_RECORDS", RecordType::AUOMS_DROPPED_RECORDS},
         {"AUOMS_STATUS", RecordType::AUOMS_STATUS},
         {"AUOMS_METRIC", RecordType::AUOMS_METRIC},
+        {"AUOMS_SUPPRESSED", RecordType::AUOMS_SUPPRESSED},
         {"AUOMS_EXECVE", RecordType::AUOMS_EXECVE},
 });
 
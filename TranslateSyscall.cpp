@@ -17,7 +17,7 @@
 #include "Translate.h"
 #include "StringTable.h"
 
-static StringTable<uint32_t> s_i386_table(-1, {
+static constexpr auto s_i386_table = MakeStringTable<uint32_t>(-1, {
 	{"restart_syscall", 0},
 	{"exit", 1},
 	{"fork", 2},
@@ -401,7 +401,7 @@ static StringTable<uint32_t> s_i386_table(-1, {
 	{"statx", 383},
 });
 
-static StringTable<uint32_t> s_86_64_table(-1, {
+static constexpr auto s_86_64_table = MakeStringTable<uint32_t>(-1, {
 	{"read", 0},
 	{"write", 1},
 	{"open", 2},
@@ -737,7 +737,7 @@ static StringTable<uint32_t> s_86_64_table(-1, {
 	{"statx", 332},
 });
 
-static StringTable<uint32_t> s_arm_table(-1, {
+static constexpr auto s_arm_table = MakeStringTable<uint32_t>(-1, {
     {"restart_syscall", 0},
     {"exit", 1},
     {"fork", 2},
@@ -1101,7 +1101,7 @@ static StringTable<uint32_t> s_arm_table(-1, {
     {"pkey_free", 396},
 });
 
-static StringTable<uint32_t> s_aarch64_table(-1, {
+static constexpr auto s_aarch64_table = MakeStringTable<uint32_t>(-1, {
     {"io_setup", 0},
     {"io_destroy", 1},
     {"io_submit", 2},
@@ -0,0 +1,234 @@
+/*
+    microsoft-oms-auditd-plugin
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "Translate.h"
+#include "StringTable.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "TranslateTests"
+#include <boost/test/unit_test.hpp>
+
+// Upper bounds of the ranges that are swept for the round trip checks
+static constexpr int RECORD_TYPE_MAX = 20000;
+static constexpr int SYSCALL_MAX = 1000;
+static constexpr int FIELD_ID_MAX = 1000;
+static constexpr int ERRNO_MAX = 1000;
+
+BOOST_AUTO_TEST_CASE( record_type_known_values ) {
+    BOOST_REQUIRE_EQUAL(RecordTypeToName(RecordType::SYSCALL), "SYSCALL");
+    BOOST_REQUIRE_EQUAL(RecordTypeToName(RecordType::EXECVE), "EXECVE");
+    BOOST_REQUIRE_EQUAL(RecordTypeToName(RecordType::PROCTITLE), "PROCTITLE");
+    BOOST_REQUIRE_EQUAL(RecordTypeToName(RecordType::EOE), "EOE");
+    BOOST_REQUIRE_EQUAL(RecordTypeToName(RecordType::AUOMS_SYSCALL), "AUOMS_SYSCALL");
+    BOOST_REQUIRE_EQUAL(RecordTypeToName(static_cast<RecordType>(1399)), "UNKNOWN[1399]");
+
+    BOOST_REQUIRE_EQUAL(static_cast<int>(RecordNameToType("SYSCALL")), 1300);
+    BOOST_REQUIRE_EQUAL(static_cast<int>(RecordNameToType("EXECVE")), 1309);
+    BOOST_REQUIRE_EQUAL(static_cast<int>(RecordNameToType("PROCTITLE")), 1327);
+    BOOST_REQUIRE_EQUAL(static_cast<int>(RecordNameToType("UNKNOWN[1300]")), 1300);
+    BOOST_REQUIRE_EQUAL(static_cast<int>(RecordNameToType("UNKNOWN[19999]")), static_cast<int>(RecordType::UNKNOWN));
+    BOOST_REQUIRE_EQUAL(static_cast<int>(RecordNameToType("NOT_A_RECORD_TYPE")), static_cast<int>(RecordType::UNKNOWN));
+}
+
+BOOST_AUTO_TEST_CASE( record_type_round_trip ) {
+    std::string unknown_str;
+    int known = 0;
+    for (int i = -1; i <= RECORD_TYPE_MAX; ++i) {
+        auto rtype = static_cast<RecordType>(i);
+        auto name = RecordTypeToName(rtype);
+        BOOST_REQUIRE_EQUAL(RecordTypeToName(rtype, unknown_str), name);
+        if (name != "UNKNOWN[" + std::to_string(i) + "]") {
+            BOOST_REQUIRE_EQUAL(static_cast<int>(RecordNameToType(name)), i);
+            known++;
+        }
+    }
+    BOOST_REQUIRE(known > 200);
+}
+
+static void check_syscall_round_trip(MachineType mtype) {
+    std::string str;
+    int known = 0;
+    for (int i = -1; i <= SYSCALL_MAX; ++i) {
+        auto name = SyscallToName(mtype, i);
+        if (SyscallToName(mtype, i, str)) {
+            BOOST_REQUIRE_EQUAL(str, name);
+            BOOST_REQUIRE_EQUAL(SyscallNameToNumber(mtype, name), i);
+            known++;
+        } else {
+            BOOST_REQUIRE_EQUAL(name, "unknown-syscall(" + std::to_string(i) + ")");
+            BOOST_REQUIRE_EQUAL(str, name);
+        }
+    }
+    BOOST_REQUIRE(known > 250);
+    BOOST_REQUIRE_EQUAL(SyscallNameToNumber(mtype, "not_a_syscall"), -1);
+}
+
+BOOST_AUTO_TEST_CASE( syscall_known_values ) {
+    BOOST_REQUIRE_EQUAL(SyscallToName(MachineType::X86_64, 0), "read");
+    BOOST_REQUIRE_EQUAL(SyscallToName(MachineType::X86_64, 42), "connect");
+    BOOST_REQUIRE_EQUAL(SyscallToName(MachineType::X86_64, 59), "execve");
+    BOOST_REQUIRE_EQUAL(SyscallToName(MachineType::X86_64, 257), "openat");
+    BOOST_REQUIRE_EQUAL(SyscallToName(MachineType::X86, 11), "execve");
+    BOOST_REQUIRE_EQUAL(SyscallToName(MachineType::X86, 102), "socketcall");
+    BOOST_REQUIRE_EQUAL(SyscallToName(MachineType::ARM, 3), "read");
+    BOOST_REQUIRE_EQUAL(SyscallToName(MachineType::ARM, 11), "execve");
+    BOOST_REQUIRE_EQUAL(SyscallToName(MachineType::ARM64, 56), "openat");
+    BOOST_REQUIRE_EQUAL(SyscallToName(MachineType::ARM64, 63), "read");
+    BOOST_REQUIRE_EQUAL(SyscallToName(MachineType::ARM64, 221), "execve");
+    BOOST_REQUIRE_EQUAL(SyscallToName(MachineType::X86_64, 5000), "unknown-syscall(5000)");
+
+    BOOST_REQUIRE_EQUAL(SyscallNameToNumber(MachineType::X86_64, "execve"), 59);
+    BOOST_REQUIRE_EQUAL(SyscallNameToNumber(MachineType::X86, "execve"), 11);
+    BOOST_REQUIRE_EQUAL(SyscallNameToNumber(MachineType::ARM64, "execve"), 221);
+}
+
+BOOST_AUTO_TEST_CASE( syscall_round_trip ) {
+    for (auto mtype : {MachineType::X86, MachineType::X86_64, MachineType::ARM, MachineType::ARM64}) {
+        check_syscall_round_trip(mtype);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( field_id ) {
+    BOOST_REQUIRE_EQUAL(FieldIdToName(0), "pid");
+    BOOST_REQUIRE_EQUAL(FieldIdToName(1), "uid");
+    BOOST_REQUIRE_EQUAL(FieldIdToName(11), "arch");
+    BOOST_REQUIRE_EQUAL(FieldIdToName(112), "exe");
+    BOOST_REQUIRE_EQUAL(FieldIdToName(200), "a0");
+    BOOST_REQUIRE_EQUAL(FieldIdToName(999), "f999");
+    BOOST_REQUIRE_EQUAL(FieldNameToId("arch"), 11);
+    BOOST_REQUIRE_EQUAL(FieldNameToId("success"), 104);
+    BOOST_REQUIRE_EQUAL(FieldNameToId("not_a_field"), -1);
+
+    std::string unknown_str;
+    int known = 0;
+    for (int i = -1; i <= FIELD_ID_MAX; ++i) {
+        auto name = FieldIdToName(i);
+        BOOST_REQUIRE_EQUAL(FieldIdToName(i, unknown_str), name);
+        if (name != "f" + std::to_string(i)) {
+            BOOST_REQUIRE_EQUAL(FieldNameToId(name), i);
+            known++;
+        }
+    }
+    BOOST_REQUIRE(known > 40);
+}
+
+BOOST_AUTO_TEST_CASE( errno_names ) {
+    BOOST_REQUIRE_EQUAL(ErrnoToName(1), "EPERM");
+    BOOST_REQUIRE_EQUAL(ErrnoToName(2), "ENOENT");
+    BOOST_REQUIRE_EQUAL(ErrnoToName(999), "999");
+    BOOST_REQUIRE_EQUAL(NameToErrno("EPERM"), 1);
+    BOOST_REQUIRE_EQUAL(NameToErrno("ENOENT"), 2);
+
+    std::string unknown_str;
+    int known = 0;
+    for (int i = 0; i <= ERRNO_MAX; ++i) {
+        auto name = ErrnoToName(i);
+        BOOST_REQUIRE_EQUAL(ErrnoToName(i, unknown_str), name);
+        if (name != std::to_string(i)) {
+            BOOST_REQUIRE_EQUAL(NameToErrno(name), i);
+            known++;
+        }
+    }
+    for (int i = -ERRNO_MAX; i < 0; ++i) {
+        BOOST_REQUIRE_EQUAL(ErrnoToName(i, unknown_str), ErrnoToName(i));
+    }
+    BOOST_REQUIRE(known > 100);
+}
+
+BOOST_AUTO_TEST_CASE( field_name_to_type ) {
+    BOOST_REQUIRE(FieldNameToType("uid") == field_type_t::UID);
+    BOOST_REQUIRE(FieldNameToType("syscall") == field_type_t::SYSCALL);
+    BOOST_REQUIRE(FieldNameToType("arch") == field_type_t::ARCH);
+    BOOST_REQUIRE(FieldNameToType("exe") == field_type_t::ESCAPED);
+    BOOST_REQUIRE(FieldNameToType("a0") == field_type_t::A0);
+    BOOST_REQUIRE(FieldNameToType("not_a_field") == field_type_t::UNCLASSIFIED);
+}
+
+BOOST_AUTO_TEST_CASE( arch_names ) {
+    BOOST_REQUIRE(ArchNameToMachine("i386") == MachineType::X86);
+    BOOST_REQUIRE(ArchNameToMachine("x86_64") == MachineType::X86_64);
+    BOOST_REQUIRE(ArchNameToMachine("armeb") == MachineType::ARM);
+    BOOST_REQUIRE(ArchNameToMachine("aarch64") == MachineType::ARM64);
+    BOOST_REQUIRE(ArchNameToMachine("not_an_arch") == MachineType::UNKNOWN);
+
+    BOOST_REQUIRE_EQUAL(ArchNameToArch("i386"), 0x40000003);
+    BOOST_REQUIRE_EQUAL(ArchNameToArch("x86_64"), 0xC000003E);
+    BOOST_REQUIRE_EQUAL(ArchNameToArch("armeb"), 0x40000028);
+    BOOST_REQUIRE_EQUAL(ArchNameToArch("aarch64"), 0xC00000B7);
+    BOOST_REQUIRE_EQUAL(ArchNameToArch("not_an_arch"), 0);
+
+    for (auto arch : {"i386", "x86_64", "aarch64"}) {
+        BOOST_REQUIRE_EQUAL(ArchToName(ArchNameToArch(arch)), arch);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( string_table ) {
+    static constexpr auto table = MakeStringTable<int>(-1, {{"one", 1}, {"two", 2}, {"uno", 1}, {"neg", -2}});
+    static_assert(table.ToInt("two") == 2);
+
+    // The last entry wins
+    BOOST_REQUIRE_EQUAL(table.ToString(1), "uno");
+    BOOST_REQUIRE_EQUAL(table.ToInt("one"), 1);
+    BOOST_REQUIRE_EQUAL(table.ToInt("uno"), 1);
+    // Negative values are ignored
+    BOOST_REQUIRE_EQUAL(table.ToString(-2), "");
+    BOOST_REQUIRE_EQUAL(table.ToInt("neg"), -1);
+    BOOST_REQUIRE_EQUAL(table.ToString(3), "");
+    BOOST_REQUIRE_EQUAL(table.ToInt("three"), -1);
+}
+
+// Same as StringTable::str_hash()
+static uint32_t fnv1a(const std::string& str) {
+    uint32_t hash = 2166136261u;
+    for (auto c : str) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+BOOST_AUTO_TEST_CASE( string_table_probe_limit ) {
+    constexpr size_t N = 16;
+    constexpr uint32_t HASH_MASK = N*4-1;
+
+    // More strings in the same hash slot than a lookup may probe must be refused
+    std::vector<std::string> strs;
+    for (int i = 0; strs.size() < N; ++i) {
+        auto str = "s" + std::to_string(i);
+        if ((fnv1a(str) & HASH_MASK) == 0) {
+            strs.emplace_back(str);
+        }
+    }
+    StringTableEntry<int> entries[N];
+    for (size_t i = 0; i < N; ++i) {
+        entries[i] = {strs[i], static_cast<int>(i)};
+    }
+    BOOST_REQUIRE_THROW((StringTable<int, N>(-1, entries)), std::logic_error);
+
+    // Up to MAX_PROBES collisions are fine
+    for (size_t i = StringTable<int, N>::MAX_PROBES; i < N; ++i) {
+        entries[i] = {"", -1};
+    }
+    StringTable<int, N> table(-1, entries);
+    for (size_t i = 0; i < StringTable<int, N>::MAX_PROBES; ++i) {
+        BOOST_REQUIRE_EQUAL(table.ToInt(strs[i]), i);
+        BOOST_REQUIRE_EQUAL(table.ToString(i), strs[i]);
+    }
+}
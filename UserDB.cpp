@@ -264,6 +264,7 @@ void UserDB::update()
     std::lock_guard<std::mutex> lock(_lock);
     _users = users;
     _groups = groups;
+    _generation.fetch_add(1, std::memory_order_release);
 }
 
 int UserDB::UserNameToUid(const std::string& name) {
@@ -16,6 +16,7 @@
 #ifndef AUOMS_USERDB_H
 #define AUOMS_USERDB_H
 
+#include <atomic>
 #include <string>
 #include <unordered_map>
 #include <mutex>
@@ -24,14 +25,17 @@
 
 class UserDB {
 public:
-    UserDB(): _dir("/etc"), _stop(true), _inotify_fd(-1), _need_update(true) {}
+    UserDB(): _dir("/etc"), _stop(true), _inotify_fd(-1), _need_update(true), _generation(0) {}
 
     // This constructor exists solely to enable testing.
-    UserDB(const std::string& dir): _dir(dir), _stop(true), _inotify_fd(-1), _need_update(true) {}
+    UserDB(const std::string& dir): _dir(dir), _stop(true), _inotify_fd(-1), _need_update(true), _generation(0) {}
 
     std::string GetUserName(int uid);
     std::string GetGroupName(int gid);
 
+    // Incremented each time the user and group names are reloaded
+    inline uint64_t Generation() const { return _generation.load(std::memory_order_acquire); }
+
     void Start();
     void Stop();
 
@@ -59,6 +63,7 @@ private:
     bool _need_update;
 
     int _inotify_fd;
+    std::atomic<uint64_t> _generation;
 
     std::thread _inotify_thread;
     std::thread _update_thread;
@@ -14,11 +14,15 @@
     THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 #include "RawEventProcessor.h"
+#include "ParallelEventProcessor.h"
+#include "OverloadController.h"
+#include "RateLimiter.h"
 #include "StdoutWriter.h"
 #include "StdinReader.h"
 #include "UnixDomainWriter.h"
 #include "Signals.h"
 #include "Queue.h"
+#include "LargeBuffer.h"
 #include "Config.h"
 #include "Logger.h"
 #include "EventQueue.h"
@@ -31,6 +35,7 @@
 #include "FileUtils.h"
 #include "FiltersEngine.h"
 #include "ProcessTree.h"
+#include "ProcessInventory.h"
 #include "Metrics.h"
 #include "SyscallMetrics.h"
 #include "SystemMetrics.h"
@@ -224,6 +229,195 @@ int main(int argc, char**argv) {
         Logger::OpenSyslog("auoms", LOG_DAEMON);
     }
 
+    bool buffer_huge_pages = false;
+    if (config.HasKey("buffer_huge_pages")) {
+        buffer_huge_pages = config.GetBool("buffer_huge_pages");
+    }
+
+    bool buffer_mlock = false;
+    if (config.HasKey("buffer_mlock")) {
+        buffer_mlock = config.GetBool("buffer_mlock");
+    }
+
+    LargeBuffer::SetDefaultPolicy(buffer_huge_pages, buffer_mlock);
+
+    bool queue_io_uring = false;
+    if (config.HasKey("queue_io_uring")) {
+        queue_io_uring = config.GetBool("queue_io_uring");
+    }
+
+    uint32_t event_format_version = EVENT_FORMAT_V1;
+    if (config.HasKey("event_format_version")) {
+        try {
+            event_format_version = static_cast<uint32_t>(config.GetUint64("event_format_version"));
+        } catch(std::exception& ex) {
+            Logger::Error("Invalid 'event_format_version' value: %s", config.GetString("event_format_version").c_str());
+            exit(1);
+        }
+        if (!Event::IsSupportedVersion(event_format_version)) {
+            Logger::Error("Unsupported 'event_format_version' value: %d", event_format_version);
+            exit(1);
+        }
+    }
+
+    bool event_field_hash_index = false;
+    if (config.HasKey("event_field_hash_index")) {
+        event_field_hash_index = config.GetBool("event_field_hash_index");
+    }
+
+    bool event_int_values = false;
+    if (config.HasKey("event_int_values")) {
+        event_int_values = config.GetBool("event_int_values");
+    }
+
+    size_t input_buffer_slots = InputBuffer::DEFAULT_NUM_SLOTS;
+    if (config.HasKey("input_buffer_slots")) {
+        try {
+            input_buffer_slots = config.GetUint64("input_buffer_slots");
+        } catch(std::exception& ex) {
+            Logger::Error("Invalid 'input_buffer_slots' value: %s", config.GetString("input_buffer_slots").c_str());
+            exit(1);
+        }
+        if (input_buffer_slots < 1 || input_buffer_slots > InputBuffer::MAX_NUM_SLOTS) {
+            Logger::Error("Invalid 'input_buffer_slots' value: %ld (must be between 1 and %ld)", input_buffer_slots, InputBuffer::MAX_NUM_SLOTS);
+            exit(1);
+        }
+    }
+
+    uint64_t input_ack_batch_count = InputAckWriter::DEFAULT_ACK_BATCH_COUNT;
+    if (config.HasKey("input_ack_batch_count")) {
+        try {
+            input_ack_batch_count = config.GetUint64("input_ack_batch_count");
+        } catch(std::exception& ex) {
+            Logger::Error("Invalid 'input_ack_batch_count' value: %s", config.GetString("input_ack_batch_count").c_str());
+            exit(1);
+        }
+        if (input_ack_batch_count < 1) {
+            Logger::Error("Invalid 'input_ack_batch_count' value: %ld", input_ack_batch_count);
+            exit(1);
+        }
+    }
+
+    uint64_t input_ack_batch_usecs = InputAckWriter::DEFAULT_ACK_BATCH_USECS;
+    if (config.HasKey("input_ack_batch_usecs")) {
+        try {
+            input_ack_batch_usecs = config.GetUint64("input_ack_batch_usecs");
+        } catch(std::exception& ex) {
+            Logger::Error("Invalid 'input_ack_batch_usecs' value: %s", config.GetString("input_ack_batch_usecs").c_str());
+            exit(1);
+        }
+    }
+
+    uint64_t input_shm_ring_size = 0;
+    if (config.HasKey("input_shm_ring_size")) {
+        try {
+            input_shm_ring_size = config.GetUint64("input_shm_ring_size");
+        } catch(std::exception& ex) {
+            Logger::Error("Invalid 'input_shm_ring_size' value: %s", config.GetString("input_shm_ring_size").c_str());
+            exit(1);
+        }
+        if (input_shm_ring_size != 0 && (input_shm_ring_size < SharedRing::MIN_SIZE || input_shm_ring_size > SharedRing::MAX_SIZE)) {
+            Logger::Error("Invalid 'input_shm_ring_size' value: %ld (must be 0 or between %ld and %ld)", input_shm_ring_size, SharedRing::MIN_SIZE, SharedRing::MAX_SIZE);
+            exit(1);
+        }
+    }
+
+    size_t input_epoll_threads = 0;
+    if (config.HasKey("input_engine")) {
+        auto input_engine = config.GetString("input_engine");
+        if (input_engine == "epoll") {
+            input_epoll_threads = 1;
+        } else if (input_engine != "thread") {
+            Logger::Error("Invalid 'input_engine' value: %s (must be 'thread' or 'epoll')", input_engine.c_str());
+            exit(1);
+        }
+    }
+
+    if (input_epoll_threads > 0 && config.HasKey("input_epoll_threads")) {
+        try {
+            input_epoll_threads = config.GetUint64("input_epoll_threads");
+        } catch(std::exception& ex) {
+            Logger::Error("Invalid 'input_epoll_threads' value: %s", config.GetString("input_epoll_threads").c_str());
+            exit(1);
+        }
+        if (input_epoll_threads < 1) {
+            Logger::Error("Invalid 'input_epoll_threads' value: %ld", input_epoll_threads);
+            exit(1);
+        }
+    }
+
+    size_t event_processor_threads = 1;
+    if (config.HasKey("event_processor_threads")) {
+        try {
+            event_processor_threads = config.GetUint64("event_processor_threads");
+        } catch(std::exception& ex) {
+            Logger::Error("Invalid 'event_processor_threads' value: %s", config.GetString("event_processor_threads").c_str());
+            exit(1);
+        }
+        if (event_processor_threads < 1 || event_processor_threads > ParallelEventProcessor::MAX_WORKERS) {
+            Logger::Error("Invalid 'event_processor_threads' value: %ld (must be between 1 and %ld)", event_processor_threads, ParallelEventProcessor::MAX_WORKERS);
+            exit(1);
+        }
+    }
+
+    uint64_t interpret_cache_size = InterpretCache::DEFAULT_MAX_ENTRIES;
+    if (config.HasKey("interpret_cache_size")) {
+        try {
+            interpret_cache_size = config.GetUint64("interpret_cache_size");
+        } catch(std::exception& ex) {
+            Logger::Error("Invalid 'interpret_cache_size' value: %s", config.GetString("interpret_cache_size").c_str());
+            exit(1);
+        }
+    }
+
+    bool defer_interpretation = false;
+    if (config.HasKey("defer_interpretation")) {
+        defer_interpretation = config.GetBool("defer_interpretation");
+    }
+
+    uint64_t process_inventory_refresh_secs = ProcessInventory::DEFAULT_REFRESH_SECS;
+    if (config.HasKey("process_inventory_refresh_secs")) {
+        try {
+            process_inventory_refresh_secs = config.GetUint64("process_inventory_refresh_secs");
+        } catch(std::exception& ex) {
+            Logger::Error("Invalid 'process_inventory_refresh_secs' value: %s", config.GetString("process_inventory_refresh_secs").c_str());
+            exit(1);
+        }
+        if (process_inventory_refresh_secs < 1) {
+            Logger::Error("Invalid 'process_inventory_refresh_secs' value: %ld", process_inventory_refresh_secs);
+            exit(1);
+        }
+    }
+
+    uint64_t process_inventory_max_rate = ProcessInventory::DEFAULT_MAX_RATE;
+    if (config.HasKey("process_inventory_max_rate")) {
+        try {
+            process_inventory_max_rate = config.GetUint64("process_inventory_max_rate");
+        } catch(std::exception& ex) {
+            Logger::Error("Invalid 'process_inventory_max_rate' value: %s", config.GetString("process_inventory_max_rate").c_str());
+            exit(1);
+        }
+        if (process_inventory_max_rate < 1) {
+            Logger::Error("Invalid 'process_inventory_max_rate' value: %ld", process_inventory_max_rate);
+            exit(1);
+        }
+    }
+
+    uint64_t latency_sample_rate = LatencyHistogram::DEFAULT_SAMPLE_RATE;
+    if (config.HasKey("latency_sample_rate")) {
+        try {
+            latency_sample_rate = config.GetUint64("latency_sample_rate");
+        } catch(std::exception& ex) {
+            Logger::Error("Invalid 'latency_sample_rate' value: %s", config.GetString("latency_sample_rate").c_str());
+            exit(1);
+        }
+        if (latency_sample_rate > UINT32_MAX) {
+            Logger::Error("Invalid 'latency_sample_rate' value: %ld", latency_sample_rate);
+            exit(1);
+        }
+    }
+    LatencyHistogram::SetSampleRate(static_cast<uint32_t>(latency_sample_rate));
+
     bool reset_queue = false;
     bool reset_flagged = false;
 
@@ -275,6 +469,7 @@ int main(int argc, char**argv) {
     }
 
     auto queue = std::make_shared<Queue>(queue_file, queue_size);
+    queue->SetUseIOUring(queue_io_uring);
     try {
         Logger::Info("Opening queue: %s", queue_file.c_str());
         queue->Open();
@@ -302,11 +497,18 @@ int main(int argc, char**argv) {
     auto proc_metrics = std::make_shared<ProcMetrics>("auoms", metrics);
     proc_metrics->Start();
 
-    Inputs inputs(input_socket_path, operational_status);
+    Inputs inputs(input_socket_path, operational_status, input_buffer_slots);
+    inputs.SetAckBatching(input_ack_batch_count, static_cast<long>(input_ack_batch_usecs));
+    inputs.SetEpoll(input_epoll_threads);
+    inputs.SetSharedRing(input_shm_ring_size);
+    if (input_shm_ring_size > 0 && input_epoll_threads > 0) {
+        Logger::Warn("input_shm_ring_size is ignored when input_engine is 'epoll'");
+    }
     if (!inputs.Initialize()) {
         Logger::Error("Failed to initialize inputs");
         exit(1);
     }
+    inputs.SetMetrics(metrics);
 
     CollectionMonitor collection_monitor(queue, auditd_path, collector_path, collector_config_path);
     collection_monitor.Start();
@@ -331,6 +533,7 @@ int main(int argc, char**argv) {
     processTree->PopulateTree(); // Pre-populate tree
 
     Outputs outputs(queue, outconf_dir, cursor_dir, allowed_socket_dirs, user_db, filtersEngine, processTree);
+    outputs.SetMetrics(metrics);
 
     std::thread autosave_thread([&]() {
         Signals::InitThread();
@@ -352,6 +555,21 @@ int main(int argc, char**argv) {
         exit(1);
     }
 
+    auto overload_controller = std::make_shared<OverloadController>(queue, [&outputs](uint64_t* bytes, uint64_t* items) {
+        outputs.GetMaxLag(bytes, items);
+    }, metrics);
+    if (!overload_controller->ParseConfig(config)) {
+        Logger::Error("Invalid overload ('overload_shed_classes', 'degraded_mode_lag' or 'degraded_mode_age') config");
+        exit(1);
+    }
+    overload_controller->Start();
+
+    auto rate_limit_config = std::make_shared<RateLimitConfig>();
+    if (!rate_limit_config->ParseConfig(config)) {
+        Logger::Error("Invalid rate limit ('rate_limits', 'rate_limit_max_buckets' or 'rate_limit_report_secs') config");
+        exit(1);
+    }
+
     Signals::SetHupHandler([&outputs,&config_file](){
         Config config;
 
@@ -384,9 +602,46 @@ int main(int argc, char**argv) {
     processNotify->Start();
 
     auto event_queue = std::make_shared<EventQueue>(queue);
-    auto builder = std::make_shared<EventBuilder>(event_queue);
+    auto builder = std::make_shared<EventBuilder>(event_queue, event_format_version);
+    builder->SetFieldHashIndex(event_field_hash_index);
+    builder->SetIntValues(event_int_values);
+
+    // The AUOMS_SUPPRESSED events are added to the queue from the rate limiter thread, so it needs its own builder
+    std::shared_ptr<RateLimiter> rate_limiter;
+    if (!rate_limit_config->Empty()) {
+        auto rate_limit_builder = std::make_shared<EventBuilder>(std::make_shared<EventQueue>(queue), event_format_version);
+        rate_limit_builder->SetFieldHashIndex(event_field_hash_index);
+        rate_limit_builder->SetIntValues(event_int_values);
+        rate_limiter = std::make_shared<RateLimiter>(rate_limit_config, rate_limit_builder, metrics);
+        rate_limiter->Start();
+    }
+
+    std::unique_ptr<RawEventProcessor> rep;
+    std::unique_ptr<ParallelEventProcessor> pep;
+    if (event_processor_threads > 1) {
+        Logger::Info("Using %ld event processor threads", event_processor_threads);
+        auto output_queue = std::make_shared<EventQueue>(queue);
+        pep = std::make_unique<ParallelEventProcessor>(event_processor_threads, output_queue, event_format_version, event_field_hash_index,
+                                                       event_int_values, user_db, processTree, filtersEngine, metrics, overload_controller);
+        pep->SetInterpretCacheSize(interpret_cache_size);
+        pep->SetDeferInterpretation(defer_interpretation);
+        pep->SetRateLimiter(rate_limiter);
+        pep->Start();
+    } else {
+        rep = std::make_unique<RawEventProcessor>(builder, user_db, processTree, filtersEngine, metrics, overload_controller);
+        rep->SetInterpretCacheSize(interpret_cache_size);
+        rep->SetDeferInterpretation(defer_interpretation);
+        rep->SetRateLimiter(rate_limiter);
+    }
+
+    // The inventory events are added to the queue from their own thread, so they need their own builder
+    auto inventory_builder = std::make_shared<EventBuilder>(std::make_shared<EventQueue>(queue), event_format_version);
+    inventory_builder->SetFieldHashIndex(event_field_hash_index);
+    inventory_builder->SetIntValues(event_int_values);
+    auto process_inventory = std::make_shared<ProcessInventory>(inventory_builder, user_db, processTree, metrics,
+                                                                process_inventory_refresh_secs, process_inventory_max_rate);
+    process_inventory->Start();
 
-    RawEventProcessor rep(builder, user_db, processTree, filtersEngine, metrics);
     inputs.Start();
 
     Signals::SetExitHandler([&inputs]() {
@@ -398,12 +653,22 @@ int main(int argc, char**argv) {
     try {
         Logger::Info("Starting input loop");
         while (!Signals::IsExit()) {
-            if (!inputs.HandleData([&rep](void* ptr, size_t size) {
-                rep.ProcessData(reinterpret_cast<char*>(ptr), size);
-                rep.DoProcessInventory();
-            })) {
+            bool ok;
+            if (pep) {
+                // The input data is only valid until HandleData returns, and must not be acked before it is in the queue
+                ok = inputs.HandleData([&pep](void* ptr, size_t size) {
+                    pep->ProcessData(ptr, size);
+                }, [&pep]() {
+                    pep->Flush();
+                });
+            } else {
+                ok = inputs.HandleData([&rep](void* ptr, size_t size) {
+                    rep->ProcessData(reinterpret_cast<char*>(ptr), size);
+                });
+            }
+            if (!ok) {
                 break;
-            };
+            }
         }
         Logger::Info("Input loop stopped");
     } catch (const std::exception& ex) {
@@ -418,6 +683,13 @@ int main(int argc, char**argv) {
 
     try {
         collection_monitor.Stop();
+        if (pep) {
+            pep->Stop();
+        }
+        if (rate_limiter) {
+            rate_limiter->Stop(); // Reports the remaining suppressed counts
+        }
+        process_inventory->Stop();
         processNotify->Stop();
         processTree->Stop();
         proc_metrics->Stop();
@@ -426,6 +698,7 @@ int main(int argc, char**argv) {
         metrics->Stop();
         rules_monitor.Stop();
         inputs.Stop();
+        overload_controller->Stop();
         outputs.Stop(false); // Trigger outputs shutdown but don't block
         user_db->Stop(); // Stop user db monitoring
         queue->Close(); // Close queue, this will trigger exit of autosave thread
@@ -0,0 +1 @@
+#define AUOMS_VERSION "2.2.5.0"
\ No newline at end of file
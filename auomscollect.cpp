@@ -18,6 +18,7 @@
 #include "UnixDomainWriter.h"
 #include "Signals.h"
 #include "Queue.h"
+#include "LargeBuffer.h"
 #include "Config.h"
 #include "Logger.h"
 #include "EventQueue.h"
@@ -403,6 +404,81 @@ int main(int argc, char**argv) {
         Logger::OpenSyslog("auomscollect", LOG_DAEMON);
     }
 
+    bool buffer_huge_pages = false;
+    if (config.HasKey("buffer_huge_pages")) {
+        buffer_huge_pages = config.GetBool("buffer_huge_pages");
+    }
+
+    bool buffer_mlock = false;
+    if (config.HasKey("buffer_mlock")) {
+        buffer_mlock = config.GetBool("buffer_mlock");
+    }
+
+    LargeBuffer::SetDefaultPolicy(buffer_huge_pages, buffer_mlock);
+
+    bool queue_io_uring = false;
+    if (config.HasKey("queue_io_uring")) {
+        queue_io_uring = config.GetBool("queue_io_uring");
+    }
+
+    uint32_t event_format_version = EVENT_FORMAT_V1;
+    if (config.HasKey("event_format_version")) {
+        try {
+            event_format_version = static_cast<uint32_t>(config.GetUint64("event_format_version"));
+        } catch(std::exception& ex) {
+            Logger::Error("Invalid 'event_format_version' value: %s", config.GetString("event_format_version").c_str());
+            exit(1);
+        }
+        if (!Event::IsSupportedVersion(event_format_version)) {
+            Logger::Error("Unsupported 'event_format_version' value: %d", event_format_version);
+            exit(1);
+        }
+    }
+
+    bool event_field_hash_index = false;
+    if (config.HasKey("event_field_hash_index")) {
+        event_field_hash_index = config.GetBool("event_field_hash_index");
+    }
+
+    bool event_int_values = false;
+    if (config.HasKey("event_int_values")) {
+        event_int_values = config.GetBool("event_int_values");
+    }
+
+    uint64_t ack_queue_size = 100;
+    if (config.HasKey("ack_queue_size")) {
+        try {
+            ack_queue_size = config.GetUint64("ack_queue_size");
+        } catch(std::exception& ex) {
+            Logger::Error("Invalid 'ack_queue_size' value: %s", config.GetString("ack_queue_size").c_str());
+            exit(1);
+        }
+        if (ack_queue_size < 1) {
+            Logger::Error("Invalid 'ack_queue_size' value: %ld", ack_queue_size);
+            exit(1);
+        }
+    }
+
+    bool use_shm_ring = false;
+    if (config.HasKey("use_shm_ring")) {
+        use_shm_ring = config.GetBool("use_shm_ring");
+    }
+
+    uint64_t latency_sample_rate = LatencyHistogram::DEFAULT_SAMPLE_RATE;
+    if (config.HasKey("latency_sample_rate")) {
+        try {
+            latency_sample_rate = config.GetUint64("latency_sample_rate");
+        } catch(std::exception& ex) {
+            Logger::Error("Invalid 'latency_sample_rate' value: %s", config.GetString("latency_sample_rate").c_str());
+            exit(1);
+        }
+        if (latency_sample_rate > UINT32_MAX) {
+            Logger::Error("Invalid 'latency_sample_rate' value: %ld", latency_sample_rate);
+            exit(1);
+        }
+    }
+    LatencyHistogram::SetSampleRate(static_cast<uint32_t>(latency_sample_rate));
+
     bool reset_queue = false;
     bool reset_flagged = false;
 
@@ -453,6 +529,7 @@ int main(int argc, char**argv) {
 
 
     auto queue = std::make_shared<Queue>(queue_file, queue_size);
+    queue->SetUseIOUring(queue_io_uring);
     try {
         Logger::Info("Opening queue: %s", queue_file.c_str());
         queue->Open();
@@ -462,7 +539,9 @@ int main(int argc, char**argv) {
     }
 
     auto event_queue = std::make_shared<EventQueue>(queue);
-    auto builder = std::make_shared<EventBuilder>(event_queue);
+    auto builder = std::make_shared<EventBuilder>(event_queue, event_format_version);
+    builder->SetFieldHashIndex(event_field_hash_index);
+    builder->SetIntValues(event_int_values);
 
     auto metrics = std::make_shared<Metrics>(queue);
     metrics->Start();
@@ -476,10 +555,12 @@ int main(int argc, char**argv) {
         {"output_format","raw"},
         {"output_socket", socket_path},
         {"enable_ack_mode", "true"},
-        {"ack_queue_size", "10"}
+        {"ack_queue_size", std::to_string(ack_queue_size)},
+        {"enable_shm_ring", use_shm_ring ? "true" : "false"}
     }));
     auto writer_factory = std::shared_ptr<IEventWriterFactory>(static_cast<IEventWriterFactory*>(new RawOnlyEventWriterFactory()));
     Output output("output", cursor_path, queue, writer_factory, nullptr);
+    output.SetMetrics(metrics);
     output.Load(output_config);
 
     std::thread autosave_thread([&]() {
@@ -29,6 +29,9 @@
 #include "Translate.h"
 #include "UnixDomainListener.h"
 #include "Event.h"
+#include "IO.h"
+#include "BufferedReader.h"
+#include "RawEventReader.h"
 
 #include <iostream>
 
@@ -974,45 +977,21 @@ int tap_audit() {
 }
 
 void handle_raw_connection(int fd) {
-    std::array<uint8_t, 1024*256> data;
+    IOBase conn(fd);
+    BufferedReader in(&conn);
+    RawEventReader reader;
 
     for (;;) {
-        auto nread = 0;
-        auto nleft = 4;
-        while (nleft > 0) {
-            auto nr = read(fd, data.data() + nread, nleft);
-            if (nr <= 0) {
-                if (nr < 0) {
-                    Logger::Error("Failed to read frame size: %s", std::strerror(errno));
-                    return;
-                } else {
-                    return;
-                }
+        const void* data = nullptr;
+        auto ret = reader.ReadEventView(&in, 1024*256, &data, nullptr);
+        if (ret <= 0) {
+            if (ret != IO::CLOSED) {
+                Logger::Error("Failed to read frame: %s", std::strerror(errno));
             }
-            nleft -= nr;
-            nread += nr;
-        }
-        auto size = *reinterpret_cast<uint32_t *>(data.data()) & 0x00FFFFFF;
-        if (size <= 4 || size > 1024 * 256) {
-            Logger::Error("Invalid frame size");
-        }
-        nread = 4;
-        nleft = size - 4;
-        while (nleft > 0) {
-            auto nr = read(fd, data.data() + nread, nleft);
-            if (nr <= 0) {
-                if (nr < 0) {
-                    Logger::Error("Failed to read frame: %s", std::strerror(errno));
-                    return;
-                } else {
-                    return;
-                }
-            }
-            nleft -= nr;
-            nread += nr;
+            return;
         }
-
-        Event event(data.data(), size);
+        auto size = static_cast<size_t>(ret);
+        Event event(data, size);
         std::cout << EventToRawText(event, true);
 
         std::array<uint8_t, 8+8+4> ack_data;
@@ -1089,8 +1068,8 @@ int monitor_auoms_events() {
         retcode = 1;
     } else {
         std::cerr << "Connected" << std::endl;
+        // Closes fd
         handle_raw_connection(fd);
-        close(fd);
     }
 
     listener.Close();
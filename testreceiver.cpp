@@ -28,6 +28,9 @@
 #include "rapidjson/filewritestream.h"
 #include "rapidjson/writer.h"
 #include "UnixDomainListener.h"
+#include "IO.h"
+#include "BufferedReader.h"
+#include "RawEventReader.h"
 
 extern "C" {
 #include <unistd.h>
@@ -154,54 +157,29 @@ void handle_oms_connection(int fd, int out_fd, bool ack, bool drop_ack) {
 }
 
 void handle_raw_connection(int fd, int out_fd, bool ack, bool drop_ack, bool raw_out) {
-    std::array<uint8_t, 1024*256> data;
     auto out = fdopen(out_fd, "w");
     if (out == nullptr) {
         fprintf(stderr, "fdopen failed\n");
         return;
     }
 
+    IOBase conn(fd);
+    BufferedReader in(&conn);
+    RawEventReader reader;
+
     for (;;) {
-        auto nread = 0;
-        auto nleft = 4;
-        while (nleft > 0) {
-            auto nr = read(fd, data.data() + nread, nleft);
-            if (nr <= 0) {
-                if (nr < 0) {
-                    fclose(out);
-                    throw std::system_error(errno, std::system_category(), "Read frame size");
-                } else {
-                    fprintf(stderr, "EOF in input\n");
-                    fclose(out);
-                    return;
-                }
-            }
-            nleft -= nr;
-            nread += nr;
-        }
-        auto size = *reinterpret_cast<uint32_t *>(data.data()) & 0x00FFFFFF;
-        if (size <= 4 || size > 1024 * 256) {
+        const void* data = nullptr;
+        auto ret = reader.ReadEventView(&in, 1024*256, &data, nullptr);
+        if (ret <= 0) {
             fclose(out);
-            throw std::runtime_error("Invalid frame size: " + std::to_string(size));
-        }
-        nread = 4;
-        nleft = size - 4;
-        while (nleft > 0) {
-            auto nr = read(fd, data.data() + nread, nleft);
-            if (nr <= 0) {
-                if (nr < 0) {
-                    fclose(out);
-                    throw std::system_error(errno, std::system_category(), "Read frame");
-                } else {
-                    fclose(out);
-                    throw std::runtime_error("Read frame failed: EOF");
-                }
+            if (ret == IO::CLOSED) {
+                fprintf(stderr, "EOF in input\n");
+                return;
             }
-            nleft -= nr;
-            nread += nr;
+            throw std::runtime_error("Read frame failed");
         }
-
-        Event event(data.data(), size);
+        auto size = static_cast<size_t>(ret);
+        Event event(data, size);
         if (raw_out) {
             if (out_fd != 1) {
                 fprintf(stderr, "%lld.%ld:%lld\n",
@@ -209,7 +187,7 @@ void handle_raw_connection(int fd, int out_fd, bool ack, bool drop_ack, bool raw
                         static_cast<unsigned long>(event.Milliseconds()),
                         static_cast<unsigned long long>(event.Serial()));
             }
-            write(out_fd, data.data(), size);
+            write(out_fd, data, size);
         } else {
             fprintf(out, "\n======================================================================\n");
             auto str = EventToRawText(event, true);